@@ -0,0 +1,164 @@
+/*! \file
+ *
+ * \brief Benchmark of the heap allocations of the basic promise operations.
+ *
+ * Each operation is executed a number of times and the average number of allocations,
+ * deallocations and allocated bytes per execution is reported. An execution includes the
+ * processing of the events posted by the operation, so the figures cover the complete lifecycle
+ * of the involved objects.
+ *
+ * The allocations are counted with the AllocationCounter of the test support. When the benchmark
+ * is built with a sanitizer, no allocations are counted and the benchmark only reports that.
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#include "Promise.h"
+#include "PromiseSitter.h"
+#include "AllocationCounter.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QTextStream>
+
+#include <functional>
+
+namespace QtPromise
+{
+namespace Benchmarks
+{
+
+using Tests::AllocationCounter;
+
+/*! Processes the events posted by an operation.
+ */
+void processPostedEvents()
+{
+	QCoreApplication::sendPostedEvents();
+	QCoreApplication::processEvents();
+}
+
+/*! Waits for the \p promise to be settled.
+ */
+void waitForSettled(Promise::Ptr promise)
+{
+	if (promise->state() != Deferred::Pending)
+		return;
+	QEventLoop loop;
+	promise->always([&loop](const QVariant&) { loop.quit(); });
+	loop.exec();
+}
+
+/*! Executes \p operation \p iterations times and prints the average counts per execution.
+ *
+ * The \p operation is executed once before counting to exclude one-time allocations
+ * like meta type registrations and thread local data.
+ */
+void measure(QTextStream& out, const QString& label, int iterations, const std::function<void()>& operation)
+{
+	operation();
+	processPostedEvents();
+
+	AllocationCounter counter;
+	for (int i = 0; i < iterations; ++i)
+	{
+		operation();
+		processPostedEvents();
+	}
+	const AllocationCounter::Counts counts = counter.counts();
+
+	const double divisor = static_cast<double>(iterations);
+	out << QString("%1 %2 %3 %4\n")
+	       .arg(label, -36)
+	       .arg(static_cast<double>(counts.allocations) / divisor, 12, 'f', 2)
+	       .arg(static_cast<double>(counts.deallocations) / divisor, 12, 'f', 2)
+	       .arg(static_cast<double>(counts.bytes) / divisor, 12, 'f', 1);
+	out.flush();
+}
+
+}  // namespace Benchmarks
+}  // namespace QtPromise
+
+
+int main(int argc, char* argv[])
+{
+	using namespace QtPromise;
+	using namespace QtPromise::Benchmarks;
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("benchmark_Allocations");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Benchmark of the heap allocations of the basic promise operations.");
+	parser.addHelpOption();
+	QCommandLineOption iterationsOption("iterations", "Number of executions of each operation.", "count", "10000");
+	parser.addOptions({iterationsOption});
+	parser.process(app);
+
+	const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+	QTextStream out(stdout);
+	if (!AllocationCounter::isSupported())
+	{
+		out << "Allocations are not counted in this build\n";
+		return 0;
+	}
+	if (!AllocationCounter::countsMalloc())
+		out << "Note: only allocations using operator new are counted on this platform\n";
+
+	out << "Average per operation (" << iterations << " iterations)\n"
+	    << QString("%1 %2 %3 %4\n").arg("operation", -36).arg("allocations", 12)
+	       .arg("deallocations", 12).arg("bytes", 12);
+
+	const auto noop = [](const QVariant&) {};
+
+	measure(out, "Deferred::create()", iterations, []() {
+		Deferred::create();
+	});
+	measure(out, "Deferred::create() + resolve()", iterations, []() {
+		Deferred::create()->resolve(1);
+	});
+	measure(out, "Promise::create()", iterations, []() {
+		Deferred::Ptr deferred = Deferred::create();
+		Promise::create(deferred);
+	});
+	measure(out, "then() on pending + resolve()", iterations, [noop]() {
+		Deferred::Ptr deferred = Deferred::create();
+		Promise::Ptr promise = Promise::create(deferred)->then(noop);
+		deferred->resolve(1);
+	});
+	measure(out, "then() on resolved", iterations, [noop]() {
+		Promise::Ptr promise = Promise::createResolved(1);
+		waitForSettled(promise->then(noop));
+	});
+	measure(out, "then() chain of 4 + resolve()", iterations, [noop]() {
+		Deferred::Ptr deferred = Deferred::create();
+		Promise::Ptr promise = Promise::create(deferred)->then(noop)->then(noop)->then(noop)->then(noop);
+		deferred->resolve(1);
+	});
+	measure(out, "Promise::createResolved()", iterations, []() {
+		waitForSettled(Promise::createResolved(1));
+	});
+	measure(out, "Promise::delayedResolve()", iterations, []() {
+		waitForSettled(Promise::delayedResolve(1));
+	});
+	measure(out, "Promise::all() of 4", iterations, []() {
+		QVector<Deferred::Ptr> deferreds{Deferred::create(), Deferred::create(), Deferred::create(), Deferred::create()};
+		QVector<Promise::Ptr> promises;
+		for (const Deferred::Ptr& deferred : deferreds)
+			promises.append(Promise::create(deferred));
+		Promise::Ptr all = Promise::all(promises);
+		for (const Deferred::Ptr& deferred : deferreds)
+			deferred->resolve(1);
+	});
+	PromiseSitter sitter;
+	measure(out, "PromiseSitter::add() + resolve()", iterations, [&sitter]() {
+		Deferred::Ptr deferred = Deferred::create();
+		sitter.add(Promise::create(deferred));
+		deferred->resolve(1);
+	});
+
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*! \file
+ *
+ * \brief Benchmark of the basic Deferred operations and of the cost of the diagnostics.
+ *
+ * Each operation is executed a number of times and the average time per execution is reported.
+ * Resolving an already resolved Deferred, which is common in cancellation heavy code, is measured
+ * with the `qtpromise.deferred` logging category enabled, with the category disabled and with the
+ * message disabled per Deferred.
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#include "Deferred.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QTextStream>
+
+#include <functional>
+
+namespace QtPromise
+{
+namespace Benchmarks
+{
+
+/*! Deferred which allows disabling the message about invalid actions from the outside.
+ */
+class QuietDeferred : public Deferred
+{
+public:
+	QuietDeferred() : Deferred() {}
+
+	using Deferred::setLogInvalidActionMessage;
+};
+
+/*! Discards all messages so that the console output does not dominate the measurement.
+ */
+void discardMessage(QtMsgType, const QMessageLogContext&, const QString&)
+{
+}
+
+/*! Executes \p operation \p iterations times and prints the average time per execution.
+ */
+void measure(QTextStream& out, const QString& label, int iterations, const std::function<void()>& operation)
+{
+	operation();
+
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < iterations; ++i)
+		operation();
+	const qint64 elapsedNs = timer.nsecsElapsed();
+
+	out << QString("%1 %2\n").arg(label, -48).arg(static_cast<double>(elapsedNs) / iterations, 12, 'f', 1);
+	out.flush();
+}
+
+}  // namespace Benchmarks
+}  // namespace QtPromise
+
+
+int main(int argc, char* argv[])
+{
+	using namespace QtPromise;
+	using namespace QtPromise::Benchmarks;
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("benchmark_Deferred");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Benchmark of the basic Deferred operations and of the cost of the diagnostics.");
+	parser.addHelpOption();
+	QCommandLineOption iterationsOption("iterations", "Number of executions of each operation.", "count", "100000");
+	parser.addOptions({iterationsOption});
+	parser.process(app);
+
+	const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+
+	QTextStream out(stdout);
+	out << "Average per operation (" << iterations << " iterations)\n"
+	    << QString("%1 %2\n").arg("operation", -48).arg("ns", 12);
+
+	measure(out, "Deferred::create() + resolve()", iterations, []() {
+		Deferred::create()->resolve();
+	});
+	int calls = 0;
+	measure(out, "resolve() with connected slot", iterations, [&calls]() {
+		Deferred::Ptr deferred = Deferred::create();
+		QObject::connect(deferred.data(), &Deferred::resolved, [&calls]() { ++calls; });
+		deferred->resolve(calls);
+	});
+
+	QtMessageHandler previousHandler = qInstallMessageHandler(discardMessage);
+
+	Deferred::Ptr resolved = Deferred::create();
+	resolved->resolve();
+	measure(out, "resolve() when resolved, category enabled", iterations, [resolved]() {
+		resolved->resolve();
+	});
+
+	QLoggingCategory::setFilterRules("qtpromise.deferred.debug=false");
+	measure(out, "resolve() when resolved, category disabled", iterations, [resolved]() {
+		resolved->resolve();
+	});
+	QLoggingCategory::setFilterRules(QString());
+
+	QSharedPointer<QuietDeferred> quiet(new QuietDeferred);
+	quiet->setLogInvalidActionMessage(false);
+	quiet->resolve();
+	measure(out, "resolve() when resolved, message disabled", iterations, [quiet]() {
+		quiet->resolve();
+	});
+
+	qInstallMessageHandler(previousHandler);
+	return 0;
+}
@@ -0,0 +1,300 @@
+/*! \file
+ *
+ * \brief Benchmark of FuturePromise compared to using QFutureWatcher directly.
+ *
+ * Sweeps
+ * - the QtConcurrent workload: QtConcurrent::run(), QtConcurrent::mapped() and
+ * QtConcurrent::filtered(),
+ * - the number of results from 1 to 1M,
+ * - the number of concurrent futures and
+ * - the number of progress updates.
+ *
+ * For each combination, the time until all results are available in the main thread is measured
+ * once with a QFutureWatcher and QFuture::results() and once with a FuturePromise, which converts
+ * the results to a QVariantList. The overhead of the FuturePromise is reported relative to the
+ * QFutureWatcher and per result. With `--lazy-results`, the FuturePromises are created with the
+ * FutureDeferred::LazyResults option and the results are read directly from the QFuture.
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#include "FuturePromise.h"
+#include "PromiseLatency.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QFutureInterface>
+#include <QFutureWatcher>
+#include <QTextStream>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+namespace QtPromise
+{
+namespace Benchmarks
+{
+
+/*! The QtConcurrent algorithms used as workload.
+ */
+enum Workload
+{
+	RunWorkload,
+	MappedWorkload,
+	FilteredWorkload
+};
+
+QString workloadName(Workload workload)
+{
+	switch (workload)
+	{
+	case RunWorkload:      return QStringLiteral("run");
+	case MappedWorkload:   return QStringLiteral("mapped");
+	case FilteredWorkload: return QStringLiteral("filtered");
+	}
+	return QString();
+}
+
+int square(const int& value)
+{
+	return value * value;
+}
+
+bool isEven(const int& value)
+{
+	return value % 2 == 0;
+}
+
+QFuture<int> startWorkload(Workload workload, const QVector<int>& items)
+{
+	switch (workload)
+	{
+	case MappedWorkload:
+		return QtConcurrent::mapped(items, square);
+	case FilteredWorkload:
+		return QtConcurrent::filtered(items, isEven);
+	case RunWorkload:
+	default:
+		return QtConcurrent::run([]() { return square(42); });
+	}
+}
+
+/*! The measurement of one combination.
+ */
+struct Measurement
+{
+	qint64 durationNs = 0;
+	qint64 resultCount = 0;
+	quint64 notifications = 0;
+};
+
+/*! The FutureDeferred options used by measure(). */
+FutureDeferred::Options promiseOptions = FutureDeferred::NoOptions;
+
+/*! Starts \p futureCount futures using \p start and waits until the results of all of them
+ * are available in the current thread.
+ *
+ * \param usePromises If \c true, the futures are observed using FuturePromises.
+ * Else, they are observed using QFutureWatchers.
+ */
+Measurement measure(const std::function<QFuture<int>()>& start, int futureCount, bool usePromises)
+{
+	Measurement result;
+	QEventLoop loop;
+	int remaining = futureCount;
+	auto finished = [&](qint64 resultCount) {
+		result.resultCount += resultCount;
+		if (--remaining == 0)
+			loop.quit();
+	};
+
+	std::vector<std::unique_ptr<QFutureWatcher<int>>> watchers;
+	QVector<Promise::Ptr> promises;
+	const qint64 begin = PromiseLatency::now();
+	for (int i = 0; i < futureCount; ++i)
+	{
+		QFuture<int> future = start();
+		if (usePromises)
+		{
+			FuturePromise::Ptr promise = FuturePromise::create(future, promiseOptions);
+			const auto resultCount = [future](const QVariant& data) -> qint64 {
+				if (promiseOptions.testFlag(FutureDeferred::LazyResults))
+				{
+					std::for_each(future.constBegin(), future.constEnd(), [](int) {});
+					return future.resultCount();
+				}
+				return data.toList().size();
+			};
+			promises.append(promise->then(
+				[&finished, resultCount](const QVariant& data) { finished(resultCount(data)); },
+				[&finished, resultCount](const QVariant& data) { finished(resultCount(data)); },
+				[&result](const QVariant&) { ++result.notifications; }));
+		}
+		else
+		{
+			QFutureWatcher<int>* watcher = new QFutureWatcher<int>;
+			watchers.emplace_back(watcher);
+			QObject::connect(watcher, &QFutureWatcher<int>::finished, [watcher, &finished]() {
+				finished(watcher->future().results().size());
+			});
+			QObject::connect(watcher, &QFutureWatcher<int>::progressValueChanged, [&result](int) { ++result.notifications; });
+			watcher->setFuture(future);
+		}
+	}
+	if (futureCount > 0)
+		loop.exec();
+	result.durationNs = PromiseLatency::now() - begin;
+	return result;
+}
+
+/*! Repeats a measurement and returns the one with the median duration.
+ */
+Measurement medianOf(int repetitions, const std::function<Measurement()>& measurement)
+{
+	std::vector<Measurement> measurements;
+	for (int i = 0; i < qMax(1, repetitions); ++i)
+		measurements.push_back(measurement());
+	std::sort(measurements.begin(), measurements.end(), [](const Measurement& left, const Measurement& right) {
+		return left.durationNs < right.durationNs;
+	});
+	return measurements.at(measurements.size() / 2);
+}
+
+/*! Creates a future reporting \p updateCount progress updates from a thread of the global
+ * QThreadPool.
+ */
+QFuture<int> startProgressReporter(int updateCount)
+{
+	QFutureInterface<int> futureInterface;
+	futureInterface.reportStarted();
+	futureInterface.setProgressRange(0, updateCount);
+	QtConcurrent::run([futureInterface, updateCount]() mutable {
+		for (int value = 1; value <= updateCount; ++value)
+			futureInterface.setProgressValue(value);
+		futureInterface.reportResult(updateCount);
+		futureInterface.reportFinished();
+	});
+	return futureInterface.future();
+}
+
+QString formatMs(qint64 nanoseconds)
+{
+	return QString::number(static_cast<double>(nanoseconds) / 1e6, 'f', 3);
+}
+
+void printComparison(QTextStream& out, const QString& label, const Measurement& raw, const Measurement& promise)
+{
+	const qint64 overhead = promise.durationNs - raw.durationNs;
+	const double relative = raw.durationNs > 0 ? 100.0 * static_cast<double>(overhead) / static_cast<double>(raw.durationNs) : 0.0;
+	const double perResult = promise.resultCount > 0 ? static_cast<double>(overhead) / static_cast<double>(promise.resultCount) : 0.0;
+	out << QString("%1 %2 %3 %4 %5\n")
+	       .arg(label, -36)
+	       .arg(formatMs(raw.durationNs), 12)
+	       .arg(formatMs(promise.durationNs), 12)
+	       .arg(QString::number(relative, 'f', 1) + " %", 10)
+	       .arg(QString::number(perResult, 'f', 1), 12);
+	out.flush();
+}
+
+void printHeader(QTextStream& out, const QString& title)
+{
+	out << '\n' << title << '\n'
+	    << QString("%1 %2 %3 %4 %5\n").arg("", -36).arg("watcher [ms]", 12).arg("promise [ms]", 12)
+	       .arg("overhead", 10).arg("ns/result", 12);
+}
+
+}  // namespace Benchmarks
+}  // namespace QtPromise
+
+
+int main(int argc, char* argv[])
+{
+	using namespace QtPromise;
+	using namespace QtPromise::Benchmarks;
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("benchmark_FuturePromise");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Benchmark of FuturePromise compared to QFutureWatcher.");
+	parser.addHelpOption();
+	QCommandLineOption maxResultsOption("max-results", "Maximum number of results of the mapped and filtered workloads.", "count", "1000000");
+	QCommandLineOption maxFuturesOption("max-futures", "Maximum number of concurrent futures.", "count", "64");
+	QCommandLineOption futureSizeOption("future-size", "Number of items per future when sweeping the number of futures.", "count", "1000");
+	QCommandLineOption maxProgressOption("max-progress-updates", "Maximum number of progress updates.", "count", "100000");
+	QCommandLineOption repetitionsOption("repetitions", "Number of repetitions of each measurement. The median is reported.", "count", "5");
+	QCommandLineOption lazyResultsOption("lazy-results", "Create the FuturePromises with FutureDeferred::LazyResults.");
+	parser.addOptions({maxResultsOption, maxFuturesOption, futureSizeOption, maxProgressOption, repetitionsOption, lazyResultsOption});
+	parser.process(app);
+
+	const int maxResults = qMax(1, parser.value(maxResultsOption).toInt());
+	const int maxFutures = qMax(1, parser.value(maxFuturesOption).toInt());
+	const int futureSize = qMax(1, parser.value(futureSizeOption).toInt());
+	const int maxProgressUpdates = qMax(1, parser.value(maxProgressOption).toInt());
+	const int repetitions = qMax(1, parser.value(repetitionsOption).toInt());
+	if (parser.isSet(lazyResultsOption))
+		promiseOptions = FutureDeferred::LazyResults;
+
+	QTextStream out(stdout);
+	out << "Thread pool size: " << QThreadPool::globalInstance()->maxThreadCount()
+	    << ", repetitions: " << repetitions
+	    << ", lazy results: " << (promiseOptions.testFlag(FutureDeferred::LazyResults) ? "yes" : "no") << '\n';
+
+	// Warm up the thread pool and the meta type registrations
+	measure([]() { return startWorkload(RunWorkload, QVector<int>()); }, 4, true);
+
+	printHeader(out, "Workload and result count (1 future)");
+	{
+		const std::function<QFuture<int>()> run = []() { return startWorkload(RunWorkload, QVector<int>()); };
+		printComparison(out, "run, 1 result",
+		                medianOf(repetitions, [&]() { return measure(run, 1, false); }),
+		                medianOf(repetitions, [&]() { return measure(run, 1, true); }));
+	}
+	for (Workload workload : {MappedWorkload, FilteredWorkload})
+	{
+		for (int itemCount = 1; itemCount <= maxResults; itemCount *= 10)
+		{
+			QVector<int> items(itemCount);
+			std::iota(items.begin(), items.end(), 0);
+			const std::function<QFuture<int>()> start = [workload, &items]() { return startWorkload(workload, items); };
+			printComparison(out, QString("%1, %2 items").arg(workloadName(workload)).arg(itemCount),
+			                medianOf(repetitions, [&]() { return measure(start, 1, false); }),
+			                medianOf(repetitions, [&]() { return measure(start, 1, true); }));
+		}
+	}
+
+	printHeader(out, QString("Concurrent futures (mapped, %1 items each)").arg(futureSize));
+	{
+		QVector<int> items(futureSize);
+		std::iota(items.begin(), items.end(), 0);
+		const std::function<QFuture<int>()> start = [&items]() { return startWorkload(MappedWorkload, items); };
+		for (int futureCount = 1; futureCount <= maxFutures; futureCount *= 4)
+		{
+			printComparison(out, QString("%1 futures").arg(futureCount),
+			                medianOf(repetitions, [&]() { return measure(start, futureCount, false); }),
+			                medianOf(repetitions, [&]() { return measure(start, futureCount, true); }));
+		}
+	}
+
+	out << "\nProgress updates (QFutureInterface throttles the progress signals)\n"
+	    << QString("%1 %2 %3 %4 %5\n").arg("updates", -12).arg("watcher [ms]", 12).arg("promise [ms]", 12)
+	       .arg("watcher signals", 16).arg("notifications", 14);
+	for (int updateCount = 10; updateCount <= maxProgressUpdates; updateCount *= 10)
+	{
+		const std::function<QFuture<int>()> start = [updateCount]() { return startProgressReporter(updateCount); };
+		const Measurement raw = medianOf(repetitions, [&]() { return measure(start, 1, false); });
+		const Measurement promise = medianOf(repetitions, [&]() { return measure(start, 1, true); });
+		out << QString("%1 %2 %3 %4 %5\n").arg(updateCount, -12)
+		       .arg(formatMs(raw.durationNs), 12).arg(formatMs(promise.durationNs), 12)
+		       .arg(raw.notifications, 16).arg(promise.notifications, 14);
+		out.flush();
+	}
+
+	return 0;
+}
@@ -0,0 +1,285 @@
+/*! \file
+ *
+ * \brief Benchmark of concurrent NetworkPromise requests against a local HTTP server.
+ *
+ * Measures
+ * - the throughput of concurrent requests in requests per second,
+ * - the overhead per request of a NetworkPromise compared to handling the QNetworkReply directly,
+ * - the memory per in-flight reply with and without a NetworkPromise and
+ * - the rate of progress notifications of a large download.
+ *
+ * The requests are answered by an in-process LocalHttpServer so the results do not depend on the
+ * network. Note that the server runs in the same thread as the client side of the benchmark.
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#include "NetworkPromise.h"
+#include "PromiseSitter.h"
+#include "PromiseLatency.h"
+#include "LocalHttpServer.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QTextStream>
+#include <QTimer>
+
+#include <functional>
+
+#if defined(Q_OS_UNIX)
+#	include <unistd.h>
+#endif
+
+namespace QtPromise
+{
+namespace Benchmarks
+{
+
+using Tests::LocalHttpServer;
+
+/*! The measurements of a series of requests.
+ */
+struct RequestRunResult
+{
+	int completed = 0;
+	int failed = 0;
+	qint64 elapsedNs = 0;
+	quint64 notifications = 0;
+
+	double requestsPerSecond() const
+	{
+		return elapsedNs > 0 ? static_cast<double>(completed) * 1e9 / static_cast<double>(elapsedNs) : 0.0;
+	}
+
+	double microsecondsPerRequest() const
+	{
+		return completed > 0 ? static_cast<double>(elapsedNs) / 1000.0 / static_cast<double>(completed) : 0.0;
+	}
+};
+
+/*! \return The current resident set size of the process in bytes or \c -1 if unknown.
+ */
+qint64 currentRssBytes()
+{
+#if defined(Q_OS_LINUX)
+	QFile statm(QStringLiteral("/proc/self/statm"));
+	if (!statm.open(QIODevice::ReadOnly))
+		return -1;
+	const QList<QByteArray> fields = statm.readAll().split(' ');
+	if (fields.size() < 2)
+		return -1;
+	return fields.at(1).toLongLong() * static_cast<qint64>(sysconf(_SC_PAGESIZE));
+#else
+	return -1;
+#endif
+}
+
+/*! Processes the events of the current thread for \p milliseconds.
+ */
+void processEventsFor(int milliseconds)
+{
+	QEventLoop loop;
+	QTimer::singleShot(milliseconds, &loop, &QEventLoop::quit);
+	loop.exec();
+}
+
+/*! Executes \p requestCount GET requests with at most \p concurrency requests in flight.
+ *
+ * \param usePromises If \c true, the replies are handled using NetworkPromises which are held by
+ * a PromiseSitter. Else, the QNetworkReply::finished() signal is handled directly.
+ */
+RequestRunResult runRequests(QNetworkAccessManager& qnam, const QUrl& url, int requestCount, int concurrency, bool usePromises)
+{
+	RequestRunResult result;
+	PromiseSitter sitter;
+	QEventLoop loop;
+	int started = 0;
+	int finished = 0;
+
+	std::function<void()> startNext;
+	auto onFinished = [&](bool success) {
+		++finished;
+		if (success)
+			++result.completed;
+		else
+			++result.failed;
+		if (finished == requestCount)
+			loop.quit();
+		else
+			startNext();
+	};
+	startNext = [&]() {
+		if (started >= requestCount)
+			return;
+		++started;
+		QNetworkReply* reply = qnam.get(QNetworkRequest(url));
+		if (usePromises)
+		{
+			Promise::Ptr promise = NetworkPromise::create(reply)->then(
+				[&onFinished](const QVariant&) { onFinished(true); },
+				[&onFinished](const QVariant&) { onFinished(false); },
+				[&result](const QVariant&) { ++result.notifications; });
+			sitter.add(promise);
+		}
+		else
+		{
+			QObject::connect(reply, &QNetworkReply::downloadProgress, [&result](qint64, qint64) { ++result.notifications; });
+			QObject::connect(reply, &QNetworkReply::finished, [reply, &onFinished]() {
+				reply->readAll();
+				reply->deleteLater();
+				onFinished(reply->error() == QNetworkReply::NoError);
+			});
+		}
+	};
+
+	const qint64 start = PromiseLatency::now();
+	for (int i = 0; i < qMin(concurrency, requestCount); ++i)
+		startNext();
+	if (requestCount > 0)
+		loop.exec();
+	result.elapsedNs = PromiseLatency::now() - start;
+
+	// Let the sitter release the settled promises
+	processEventsFor(10);
+	return result;
+}
+
+/*! Measures the memory of \p replyCount requests which are in flight.
+ *
+ * \return The increase of the resident set size per request in bytes or \c -1 if unknown.
+ */
+qint64 measureInFlightMemory(QNetworkAccessManager& qnam, const QUrl& url, int replyCount, bool usePromises)
+{
+	processEventsFor(50);
+	const qint64 rssBefore = currentRssBytes();
+
+	QList<QNetworkReply*> replies;
+	QVector<NetworkPromise::Ptr> promises;
+	for (int i = 0; i < replyCount; ++i)
+	{
+		QNetworkReply* reply = qnam.get(QNetworkRequest(url));
+		replies.append(reply);
+		if (usePromises)
+			promises.append(NetworkPromise::create(reply));
+	}
+	processEventsFor(200);
+	const qint64 rssAfter = currentRssBytes();
+
+	for (QNetworkReply* reply : replies)
+		reply->abort();
+	processEventsFor(50);
+	// The NetworkDeferreds own their replies
+	if (usePromises)
+		promises.clear();
+	else
+		qDeleteAll(replies);
+	processEventsFor(50);
+
+	if (rssBefore < 0 || rssAfter < 0 || replyCount <= 0)
+		return -1;
+	return (rssAfter - rssBefore) / replyCount;
+}
+
+}  // namespace Benchmarks
+}  // namespace QtPromise
+
+
+int main(int argc, char* argv[])
+{
+	using namespace QtPromise;
+	using namespace QtPromise::Benchmarks;
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("benchmark_NetworkPromise");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Benchmark of concurrent NetworkPromise requests against a local HTTP server.");
+	parser.addHelpOption();
+	QCommandLineOption requestsOption("requests", "Number of requests of the throughput measurement.", "count", "2000");
+	QCommandLineOption concurrencyOption("concurrency", "Maximum number of requests in flight.", "count", "32");
+	QCommandLineOption bodySizeOption("body-size", "Size of the response bodies in bytes.", "bytes", "1024");
+	QCommandLineOption latencyOption("latency", "Latency of the server in milliseconds.", "ms", "0");
+	QCommandLineOption chunkedOption("chunked", "Send the responses using chunked transfer encoding.");
+	QCommandLineOption inFlightOption("in-flight", "Number of requests of the memory measurement.", "count", "1000");
+	QCommandLineOption progressSizeOption("progress-size", "Size of the download of the progress measurement in bytes.", "bytes", "16777216");
+	parser.addOptions({requestsOption, concurrencyOption, bodySizeOption, latencyOption, chunkedOption, inFlightOption, progressSizeOption});
+	parser.process(app);
+
+	const int requestCount = qMax(0, parser.value(requestsOption).toInt());
+	const int concurrency = qMax(1, parser.value(concurrencyOption).toInt());
+	const int inFlightCount = qMax(0, parser.value(inFlightOption).toInt());
+
+	LocalHttpServer server;
+	if (!server.isListening())
+	{
+		qCritical("Could not start the local HTTP server: %s", qPrintable(server.errorString()));
+		return 1;
+	}
+
+	LocalHttpServer::Response response;
+	response.bodySize = qMax(Q_INT64_C(0), parser.value(bodySizeOption).toLongLong());
+	response.latency = qMax(0, parser.value(latencyOption).toInt());
+	response.chunked = parser.isSet(chunkedOption);
+	server.setResponse("/data", response);
+
+	LocalHttpServer::Response slowResponse;
+	slowResponse.latency = 60 * 60 * 1000;
+	server.setResponse("/slow", slowResponse);
+
+	LocalHttpServer::Response largeResponse;
+	largeResponse.bodySize = qMax(Q_INT64_C(0), parser.value(progressSizeOption).toLongLong());
+	server.setResponse("/large", largeResponse);
+
+	QTextStream out(stdout);
+	QNetworkAccessManager qnam;
+	bool success = true;
+
+	// Warm up the connections
+	runRequests(qnam, server.url("/data"), qMin(requestCount, concurrency), concurrency, false);
+
+	out << "Throughput (" << requestCount << " requests, " << concurrency << " concurrent, "
+	    << response.bodySize << " bytes per response)\n";
+	const RequestRunResult rawResult = runRequests(qnam, server.url("/data"), requestCount, concurrency, false);
+	const RequestRunResult promiseResult = runRequests(qnam, server.url("/data"), requestCount, concurrency, true);
+	out << QString("  QNetworkReply:  %1 requests/s, %2 us/request\n")
+	       .arg(rawResult.requestsPerSecond(), 0, 'f', 0).arg(rawResult.microsecondsPerRequest(), 0, 'f', 1);
+	out << QString("  NetworkPromise: %1 requests/s, %2 us/request\n")
+	       .arg(promiseResult.requestsPerSecond(), 0, 'f', 0).arg(promiseResult.microsecondsPerRequest(), 0, 'f', 1);
+	out << QString("  Overhead of NetworkPromise: %1 us/request\n")
+	       .arg(promiseResult.microsecondsPerRequest() - rawResult.microsecondsPerRequest(), 0, 'f', 1);
+	if (rawResult.failed > 0 || promiseResult.failed > 0)
+	{
+		out << "  Failed requests: " << rawResult.failed << " (QNetworkReply), " << promiseResult.failed << " (NetworkPromise)\n";
+		success = false;
+	}
+	out.flush();
+
+	out << "Memory per in-flight request (" << inFlightCount << " requests)\n";
+	const qint64 rawMemory = measureInFlightMemory(qnam, server.url("/slow"), inFlightCount, false);
+	const qint64 promiseMemory = measureInFlightMemory(qnam, server.url("/slow"), inFlightCount, true);
+	if (rawMemory < 0 || promiseMemory < 0)
+		out << "  not available on this platform\n";
+	else
+	{
+		out << "  QNetworkReply:  " << rawMemory << " bytes\n";
+		out << "  NetworkPromise: " << promiseMemory << " bytes\n";
+	}
+	out.flush();
+
+	out << "Progress notifications (" << largeResponse.bodySize << " bytes)\n";
+	const RequestRunResult progressResult = runRequests(qnam, server.url("/large"), 1, 1, true);
+	const double seconds = static_cast<double>(progressResult.elapsedNs) / 1e9;
+	out << QString("  %1 notifications in %2 ms, %3 notifications/s, %4 bytes/notification\n")
+	       .arg(progressResult.notifications)
+	       .arg(seconds * 1000.0, 0, 'f', 1)
+	       .arg(seconds > 0 ? static_cast<double>(progressResult.notifications) / seconds : 0.0, 0, 'f', 0)
+	       .arg(progressResult.notifications > 0 ? largeResponse.bodySize / static_cast<qint64>(progressResult.notifications) : 0);
+	success = success && progressResult.failed == 0;
+	out.flush();
+
+	return success ? 0 : 1;
+}
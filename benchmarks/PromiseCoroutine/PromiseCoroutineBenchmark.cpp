@@ -0,0 +1,116 @@
+/*! \file
+ *
+ * \brief Benchmark of coroutines awaiting promises compared to chains of Promise::then().
+ *
+ * Both variants wait for a number of delayed promises in sequence. Each sequence is executed
+ * a number of times and the average time per sequence and per step is reported. The event loop
+ * is left as soon as the sequence is settled, so no time is spent polling.
+ *
+ * When the compiler does not support C++20 coroutines, only the Promise::then() variant is measured.
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#include "PromiseCoroutine.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTextStream>
+
+#include <functional>
+
+namespace QtPromise
+{
+namespace Benchmarks
+{
+
+#ifdef QTPROMISE_HAS_COROUTINES
+/*! A coroutine awaiting \p steps delayed promises in sequence.
+ */
+Promise::Ptr awaitDelayed(int steps)
+{
+	for (int i = 0; i < steps; ++i)
+		co_await Promise::delayedResolve(i);
+	co_return steps;
+}
+#endif
+
+/*! The same sequence as awaitDelayed() using Promise::then().
+ */
+Promise::Ptr chainDelayed(int steps)
+{
+	Promise::Ptr promise = Promise::createResolved(0);
+	for (int i = 0; i < steps; ++i)
+		promise = promise->then([i](const QVariant&) { return Promise::delayedResolve(i); });
+	return promise;
+}
+
+/*! Runs an event loop until \p promise is settled.
+ */
+void waitForSettled(Promise::Ptr promise)
+{
+	if (promise->state() != Deferred::Pending)
+		return;
+	QEventLoop loop;
+	QObject::connect(promise.data(), &Promise::resolved, &loop, &QEventLoop::quit);
+	QObject::connect(promise.data(), &Promise::rejected, &loop, &QEventLoop::quit);
+	loop.exec();
+}
+
+/*! Executes the sequence created by \p start \p iterations times and prints the average
+ * time per sequence and per step.
+ */
+void measure(QTextStream& out, const QString& label, int iterations, int steps, const std::function<Promise::Ptr(int)>& start)
+{
+	waitForSettled(start(steps));
+
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < iterations; ++i)
+		waitForSettled(start(steps));
+	const double elapsedNs = static_cast<double>(timer.nsecsElapsed());
+
+	out << QString("%1 %2 %3\n").arg(label, -24)
+	       .arg(elapsedNs / iterations / 1000, 14, 'f', 1)
+	       .arg(elapsedNs / iterations / steps, 12, 'f', 1);
+	out.flush();
+}
+
+}  // namespace Benchmarks
+}  // namespace QtPromise
+
+
+int main(int argc, char* argv[])
+{
+	using namespace QtPromise;
+	using namespace QtPromise::Benchmarks;
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("benchmark_PromiseCoroutine");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Benchmark of coroutines awaiting promises compared to chains of Promise::then().");
+	parser.addHelpOption();
+	QCommandLineOption iterationsOption("iterations", "Number of executions of each sequence.", "count", "1000");
+	QCommandLineOption stepsOption("steps", "Number of awaited promises per sequence.", "count", "100");
+	parser.addOptions({iterationsOption, stepsOption});
+	parser.process(app);
+
+	const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+	const int steps = qMax(1, parser.value(stepsOption).toInt());
+
+	QTextStream out(stdout);
+	out << "Average per sequence of " << steps << " steps (" << iterations << " iterations)\n"
+	    << QString("%1 %2 %3\n").arg("variant", -24).arg("us/sequence", 14).arg("ns/step", 12);
+
+#ifdef QTPROMISE_HAS_COROUTINES
+	measure(out, "coroutine", iterations, steps, awaitDelayed);
+#else
+	out << "coroutine                (not supported by the compiler)\n";
+#endif
+	measure(out, "Promise::then()", iterations, steps, chainDelayed);
+	return 0;
+}
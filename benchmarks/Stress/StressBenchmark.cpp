@@ -0,0 +1,500 @@
+/*! \file
+ *
+ * \brief Multi-threaded stress and scaling benchmark of the QtPromise library.
+ *
+ * Drives 1..N threads which concurrently
+ * - resolve Deferreds with continuations,
+ * - build chains of continuations,
+ * - combine promises using Promise::all(),
+ * - register promises with a shared PromiseSitter and
+ * - hand Deferreds over to other threads which resolve them.
+ *
+ * For each thread count, the throughput and the latency percentiles of the operations are
+ * reported together with the peak resident set size of the process. The soak mode runs the
+ * workload for a longer time and compares the number of existing Deferreds before and after to
+ * detect leaks.
+ *
+ * Build with the CMake options `QTPROMISE_BUILD_BENCHMARKS` and optionally
+ * `QTPROMISE_SANITIZE_THREAD` to run the harness under ThreadSanitizer.
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#include "Promise.h"
+#include "PromiseSitter.h"
+#include "PromiseMetrics.h"
+#include "PromiseLatency.h"
+#include "DeferredRegistry.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+
+#if defined(Q_OS_UNIX)
+#	include <sys/resource.h>
+#endif
+
+namespace QtPromise
+{
+namespace Benchmarks
+{
+
+/*! The settings of a benchmark run.
+ */
+struct StressOptions
+{
+	QVector<int> threadCounts;
+	int durationMs = 1000;
+	int soakSeconds = 0;
+	bool csv = false;
+};
+
+/*! The measurements of one thread.
+ */
+struct WorkerResult
+{
+	quint64 operations = 0;
+	quint64 incompleteOperations = 0;
+	LatencyHistogram latency;
+};
+
+/*! Deferreds waiting to be resolved by another thread.
+ */
+class HandoffQueue
+{
+public:
+	void push(const Deferred::Ptr& deferred)
+	{
+		QMutexLocker locker(&m_lock);
+		m_queue.enqueue(deferred);
+	}
+
+	Deferred::Ptr pop()
+	{
+		QMutexLocker locker(&m_lock);
+		return m_queue.isEmpty() ? Deferred::Ptr() : m_queue.dequeue();
+	}
+
+private:
+	QMutex m_lock;
+	QQueue<Deferred::Ptr> m_queue;
+};
+
+/*! \return The peak resident set size of the process in KiB or \c -1 if unknown.
+ */
+qint64 peakRssKiB()
+{
+#if defined(Q_OS_UNIX)
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+#	if defined(Q_OS_MACOS)
+	return static_cast<qint64>(usage.ru_maxrss) / 1024;
+#	else
+	return static_cast<qint64>(usage.ru_maxrss);
+#	endif
+#else
+	return -1;
+#endif
+}
+
+/*! \return The number of existing Deferreds according to the PromiseMetrics.
+ */
+qint64 liveDeferreds()
+{
+	return PromiseMetrics::snapshot().total().live;
+}
+
+/*! Processes the events of the current thread for \p milliseconds.
+ */
+void processEventsFor(int milliseconds)
+{
+	QEventLoop loop;
+	QTimer::singleShot(milliseconds, &loop, &QEventLoop::quit);
+	loop.exec();
+}
+
+/*! Executes the operations in a separate thread until the deadline.
+ */
+class StressWorker : public QThread
+{
+public:
+	enum Scenario
+	{
+		ResolveScenario,
+		ChainScenario,
+		AllScenario,
+		SitterScenario,
+		HandoffScenario,
+		ScenarioCount
+	};
+
+	StressWorker(PromiseSitter* sitter, HandoffQueue* handoffQueue, qint64 deadline)
+		: m_sitter(sitter), m_handoffQueue(handoffQueue), m_deadline(deadline)
+	{}
+
+	WorkerResult result;
+
+protected:
+	void run() override
+	{
+		for (quint64 iteration = 0; PromiseLatency::now() < m_deadline; ++iteration)
+		{
+			runScenario(static_cast<Scenario>(iteration % ScenarioCount));
+			if (iteration % 64 == 0)
+			{
+				QCoreApplication::processEvents();
+				collectRemoteCompletions();
+				releaseSettledPromises();
+			}
+		}
+
+		// Wait for the continuations of the handed over Deferreds
+		const qint64 drainDeadline = PromiseLatency::now() + Q_INT64_C(10000) * 1000000;
+		while (m_pendingOperations > 0 && PromiseLatency::now() < drainDeadline)
+		{
+			resolveHandedOver();
+			QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+			collectRemoteCompletions();
+		}
+		resolveHandedOver();
+		QCoreApplication::processEvents();
+		collectRemoteCompletions();
+		result.incompleteOperations = static_cast<quint64>(m_pendingOperations);
+		m_heldPromises.clear();
+	}
+
+private:
+	/*! \return A continuation recording the latency of the operation started at \p start.
+	 *
+	 * The continuation runs in the thread which resolves the Deferred. Continuations running in
+	 * other threads hand the latency over to this worker instead of touching its measurements.
+	 */
+	std::function<void(const QVariant&)> completion(qint64 start)
+	{
+		m_pendingOperations += 1;
+		return [this, start](const QVariant&) {
+			const qint64 latency = PromiseLatency::now() - start;
+			if (QThread::currentThread() == this)
+				recordCompletion(latency);
+			else
+			{
+				QMutexLocker locker(&m_remoteCompletionsLock);
+				m_remoteCompletions.append(latency);
+			}
+		};
+	}
+
+	void recordCompletion(qint64 latency)
+	{
+		result.latency.record(latency);
+		result.operations += 1;
+		m_pendingOperations -= 1;
+	}
+
+	/*! Records the completions of operations whose continuations ran in other threads. */
+	void collectRemoteCompletions()
+	{
+		QVector<qint64> completions;
+		{
+			QMutexLocker locker(&m_remoteCompletionsLock);
+			completions.swap(m_remoteCompletions);
+		}
+		for (qint64 latency : completions)
+			recordCompletion(latency);
+	}
+
+	void runScenario(Scenario scenario)
+	{
+		const qint64 start = PromiseLatency::now();
+		switch (scenario)
+		{
+		case ResolveScenario:
+		{
+			Deferred::Ptr deferred = Deferred::create();
+			Promise::Ptr promise = Promise::create(deferred)->then(completion(start));
+			deferred->resolve(42);
+			break;
+		}
+		case ChainScenario:
+		{
+			Deferred::Ptr deferred = Deferred::create();
+			Promise::Ptr promise = Promise::create(deferred)
+			->then([](const QVariant& value) { return QVariant(value.toInt() + 1); })
+			->then([](const QVariant& value) { return Promise::createResolved(value); })
+			->then(completion(start));
+			deferred->resolve(1);
+			break;
+		}
+		case AllScenario:
+		{
+			QVector<Deferred::Ptr> deferreds;
+			QVector<Promise::Ptr> promises;
+			for (int i = 0; i < 4; ++i)
+			{
+				deferreds.append(Deferred::create());
+				promises.append(Promise::create(deferreds.last()));
+			}
+			Promise::Ptr combined = Promise::all(promises)->then(completion(start));
+			for (const Deferred::Ptr& deferred : deferreds)
+				deferred->resolve(1);
+			break;
+		}
+		case SitterScenario:
+		{
+			Deferred::Ptr deferred = Deferred::create();
+			Promise::Ptr promise = Promise::create(deferred)->then(completion(start));
+			m_sitter->add(promise);
+			deferred->resolve(42);
+			break;
+		}
+		case HandoffScenario:
+		default:
+		{
+			Deferred::Ptr deferred = Deferred::create();
+			Promise::Ptr promise = Promise::create(deferred)->then(completion(start));
+			/* The continuation is only executed as long as its promise exists and the Deferred
+			 * is resolved later by another thread, so the promise is held until then.
+			 */
+			m_heldPromises.append(promise);
+			m_handoffQueue->push(deferred);
+			// Resolve a Deferred of another thread (or our own if we are the only thread)
+			Deferred::Ptr handedOver = m_handoffQueue->pop();
+			if (handedOver)
+				handedOver->resolve(42);
+			break;
+		}
+		}
+	}
+
+	void releaseSettledPromises()
+	{
+		auto settled = std::remove_if(m_heldPromises.begin(), m_heldPromises.end(), [](const Promise::Ptr& promise) {
+			return promise->state() != Deferred::Pending;
+		});
+		m_heldPromises.erase(settled, m_heldPromises.end());
+	}
+
+	void resolveHandedOver()
+	{
+		while (Deferred::Ptr deferred = m_handoffQueue->pop())
+			deferred->resolve(42);
+	}
+
+	PromiseSitter* m_sitter;
+	HandoffQueue* m_handoffQueue;
+	qint64 m_deadline;
+	qint64 m_pendingOperations = 0;
+	QVector<Promise::Ptr> m_heldPromises;
+	QMutex m_remoteCompletionsLock;
+	QVector<qint64> m_remoteCompletions;
+};
+
+/*! The aggregated measurements of one thread count.
+ */
+struct RunResult
+{
+	int threadCount = 0;
+	qint64 durationNs = 0;
+	WorkerResult total;
+	qint64 peakRssKiB = -1;
+};
+
+/*! Runs the workload with \p threadCount threads for \p durationMs.
+ */
+RunResult runWorkload(int threadCount, int durationMs, PromiseSitter* sitter)
+{
+	HandoffQueue handoffQueue;
+	const qint64 start = PromiseLatency::now();
+	const qint64 deadline = start + static_cast<qint64>(durationMs) * 1000000;
+
+	QVector<StressWorker*> workers;
+	QEventLoop loop;
+	int runningWorkers = threadCount;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		StressWorker* worker = new StressWorker(sitter, &handoffQueue, deadline);
+		QObject::connect(worker, &QThread::finished, &loop, [&runningWorkers, &loop]() {
+			if (--runningWorkers == 0)
+				loop.quit();
+		});
+		workers.append(worker);
+	}
+	for (StressWorker* worker : workers)
+		worker->start();
+	// The PromiseSitter lives in this thread
+	loop.exec();
+
+	RunResult result;
+	result.threadCount = threadCount;
+	result.durationNs = PromiseLatency::now() - start;
+	// Continuations of a worker can run in other threads so no worker is deleted before all have finished
+	for (StressWorker* worker : workers)
+		worker->wait();
+	for (StressWorker* worker : workers)
+	{
+		result.total.operations += worker->result.operations;
+		result.total.incompleteOperations += worker->result.incompleteOperations;
+		result.total.latency.merge(worker->result.latency);
+		delete worker;
+	}
+	result.peakRssKiB = peakRssKiB();
+	return result;
+}
+
+void printHeader(QTextStream& out, bool csv)
+{
+	if (csv)
+		out << "threads,ops_per_sec,p50_us,p90_us,p99_us,p999_us,max_us,peak_rss_kib,incomplete\n";
+	else
+		out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+		       .arg("threads", 7).arg("ops/s", 12).arg("p50 [us]", 10).arg("p90 [us]", 10)
+		       .arg("p99 [us]", 10).arg("p99.9 [us]", 10).arg("max [us]", 10).arg("peak RSS [MiB]", 14);
+}
+
+void printResult(QTextStream& out, const RunResult& result, bool csv)
+{
+	const double seconds = static_cast<double>(result.durationNs) / 1e9;
+	const double throughput = seconds > 0 ? static_cast<double>(result.total.operations) / seconds : 0.0;
+	const LatencyHistogram& latency = result.total.latency;
+	auto micros = [](qint64 nanoseconds) { return QString::number(static_cast<double>(nanoseconds) / 1000.0, 'f', 1); };
+
+	if (csv)
+	{
+		out << result.threadCount << ',' << QString::number(throughput, 'f', 0) << ','
+		    << micros(latency.valueAtPercentile(50)) << ',' << micros(latency.valueAtPercentile(90)) << ','
+		    << micros(latency.valueAtPercentile(99)) << ',' << micros(latency.valueAtPercentile(99.9)) << ','
+		    << micros(latency.max()) << ',' << result.peakRssKiB << ',' << result.total.incompleteOperations << '\n';
+	}
+	else
+	{
+		const QString rss = result.peakRssKiB < 0 ? QStringLiteral("n/a") : QString::number(static_cast<double>(result.peakRssKiB) / 1024.0, 'f', 1);
+		out << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+		       .arg(result.threadCount, 7).arg(QString::number(throughput, 'f', 0), 12)
+		       .arg(micros(latency.valueAtPercentile(50)), 10).arg(micros(latency.valueAtPercentile(90)), 10)
+		       .arg(micros(latency.valueAtPercentile(99)), 10).arg(micros(latency.valueAtPercentile(99.9)), 10)
+		       .arg(micros(latency.max()), 10).arg(rss, 14);
+		if (result.total.incompleteOperations > 0)
+			out << "        " << result.total.incompleteOperations << " operations did not complete\n";
+	}
+	out.flush();
+}
+
+/*! Runs the soak mode.
+ *
+ * \return \c true if no Deferreds have been leaked and all operations completed.
+ */
+bool runSoak(QTextStream& out, int threadCount, int soakSeconds, int roundMs, PromiseSitter* sitter)
+{
+	// Let the asynchronous cleanup of earlier runs finish
+	processEventsFor(100);
+	const qint64 liveBefore = liveDeferreds();
+	DeferredRegistry::setEnabled(true);
+
+	out << "Soak: " << threadCount << " threads for " << soakSeconds << " s\n";
+	out.flush();
+	bool complete = true;
+	const qint64 soakDeadline = PromiseLatency::now() + static_cast<qint64>(soakSeconds) * 1000000000;
+	quint64 operations = 0;
+	while (PromiseLatency::now() < soakDeadline)
+	{
+		const RunResult result = runWorkload(threadCount, roundMs, sitter);
+		operations += result.total.operations;
+		complete = complete && result.total.incompleteOperations == 0;
+	}
+	DeferredRegistry::setEnabled(false);
+
+	// Give the PromiseSitter and deferred deletions the chance to finish
+	qint64 liveAfter = liveDeferreds();
+	for (int attempt = 0; attempt < 20 && liveAfter > liveBefore; ++attempt)
+	{
+		processEventsFor(100);
+		liveAfter = liveDeferreds();
+	}
+
+	out << "Soak: " << operations << " operations, live Deferreds before: " << liveBefore
+	    << ", after: " << liveAfter << ", peak RSS: " << peakRssKiB() << " KiB\n";
+	const bool leaked = liveAfter > liveBefore;
+	if (leaked)
+		out << "Soak: leaked Deferreds detected\n" << DeferredRegistry::snapshot().toString();
+	if (!complete)
+		out << "Soak: some operations did not complete\n";
+	out.flush();
+	return !leaked && complete;
+}
+
+QVector<int> defaultThreadCounts(int maxThreads)
+{
+	QVector<int> result;
+	for (int count = 1; count < maxThreads; count *= 2)
+		result.append(count);
+	result.append(maxThreads);
+	return result;
+}
+
+}  // namespace Benchmarks
+}  // namespace QtPromise
+
+
+int main(int argc, char* argv[])
+{
+	using namespace QtPromise;
+	using namespace QtPromise::Benchmarks;
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("benchmark_Stress");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Multi-threaded stress and scaling benchmark of QtPromise.");
+	parser.addHelpOption();
+	QCommandLineOption maxThreadsOption("max-threads", "Maximum number of threads. The thread count is doubled from 1 up to this number.",
+	                                    "count", QString::number(QThread::idealThreadCount()));
+	QCommandLineOption threadsOption("threads", "Comma separated list of thread counts. Overrides --max-threads.", "counts");
+	QCommandLineOption durationOption("duration", "Duration of the run per thread count in milliseconds.", "ms", "1000");
+	QCommandLineOption soakOption("soak", "Duration of the soak phase in seconds. 0 disables the soak phase.", "seconds", "0");
+	QCommandLineOption csvOption("csv", "Print the results as comma separated values.");
+	parser.addOptions({maxThreadsOption, threadsOption, durationOption, soakOption, csvOption});
+	parser.process(app);
+
+	StressOptions options;
+	if (parser.isSet(threadsOption))
+	{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+		const auto skipEmptyParts = Qt::SkipEmptyParts;
+#else
+		const auto skipEmptyParts = QString::SkipEmptyParts;
+#endif
+		for (const QString& count : parser.value(threadsOption).split(',', skipEmptyParts))
+			options.threadCounts.append(qMax(1, count.toInt()));
+	}
+	else
+		options.threadCounts = defaultThreadCounts(qMax(1, parser.value(maxThreadsOption).toInt()));
+	options.durationMs = qMax(1, parser.value(durationOption).toInt());
+	options.soakSeconds = qMax(0, parser.value(soakOption).toInt());
+	options.csv = parser.isSet(csvOption);
+
+	QTextStream out(stdout);
+	PromiseSitter sitter;
+
+	bool success = true;
+	printHeader(out, options.csv);
+	for (int threadCount : options.threadCounts)
+	{
+		const RunResult result = runWorkload(threadCount, options.durationMs, &sitter);
+		printResult(out, result, options.csv);
+		success = success && result.total.incompleteOperations == 0;
+	}
+
+	if (options.soakSeconds > 0)
+		success = runSoak(out, options.threadCounts.last(), options.soakSeconds, options.durationMs, &sitter) && success;
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+#include "AsyncLazy.h"
+
+#include <QTimer>
+
+namespace QtPromise {
+
+AsyncLazyBase::AsyncLazyBase(Factory factory, Options options)
+	: QObject()
+	, m_options(options)
+	, m_scheduler(Scheduler::instance())
+	, m_factory(std::move(factory))
+	, m_generation(0)
+	, m_refreshInterval(0)
+	, m_refreshTask(0)
+	, m_settled(nullptr)
+	, m_readers(0)
+{
+}
+
+AsyncLazyBase::~AsyncLazyBase()
+{
+	cancelRefresh();
+	delete m_settled.load();
+	qDeleteAll(m_retired);
+}
+
+Promise::Ptr AsyncLazyBase::current() const
+{
+	m_readers.fetch_add(1);
+	const Entry* entry = m_settled.load();
+	Promise::Ptr promise = entry ? entry->promise : Promise::Ptr();
+	m_readers.fetch_sub(1);
+	return promise;
+}
+
+bool AsyncLazyBase::resolvedValue(QVariant* value) const
+{
+	m_readers.fetch_add(1);
+	const Entry* entry = m_settled.load();
+	const bool resolved = entry && entry->state == Deferred::Resolved;
+	if (resolved && value)
+		*value = entry->data;
+	m_readers.fetch_sub(1);
+	return resolved;
+}
+
+Promise::Ptr AsyncLazyBase::get()
+{
+	Promise::Ptr promise = current();
+	if (promise)
+		return promise;
+
+	QMutexLocker locker(&m_lock);
+	if (const Entry* entry = m_settled.load())
+		return entry->promise;
+	if (!m_pending)
+		start();
+	return m_pending;
+}
+
+bool AsyncLazyBase::isStarted() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_pending || m_settled.load();
+}
+
+void AsyncLazyBase::reset()
+{
+	QMutexLocker locker(&m_lock);
+	++m_generation;
+	m_pending.reset();
+	cancelRefresh();
+	publish(nullptr);
+}
+
+void AsyncLazyBase::refresh()
+{
+	QMutexLocker locker(&m_lock);
+	if (!m_pending)
+		start();
+}
+
+void AsyncLazyBase::setRefreshInterval(int intervalInMillisec)
+{
+	QMutexLocker locker(&m_lock);
+	m_refreshInterval = qMax(0, intervalInMillisec);
+	cancelRefresh();
+	if (!m_pending && m_settled.load())
+		scheduleRefresh();
+}
+
+int AsyncLazyBase::refreshInterval() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_refreshInterval;
+}
+
+void AsyncLazyBase::start()
+{
+	cancelRefresh();
+	const quint64 generation = ++m_generation;
+
+	Promise::Ptr promise = m_factory ? m_factory() : Promise::Ptr();
+	if (!promise)
+		promise = Promise::createRejected();
+	m_pending = promise;
+
+	connect(promise.data(), &Promise::resolved, this, [this, generation]() {
+		this->computationSettled(generation, Deferred::Resolved);
+	});
+	connect(promise.data(), &Promise::rejected, this, [this, generation]() {
+		this->computationSettled(generation, Deferred::Rejected);
+	});
+	/* The factory might have settled the Deferred before the connections were made.
+	 * computationSettled() ignores the second call if the signal is emitted as well.
+	 */
+	const Deferred::State state = promise->state();
+	if (state != Deferred::Pending)
+	{
+		QTimer::singleShot(0, this, [this, generation, state]() {
+			this->computationSettled(generation, state);
+		});
+	}
+}
+
+void AsyncLazyBase::computationSettled(quint64 generation, Deferred::State state)
+{
+	QMutexLocker locker(&m_lock);
+	if (generation != m_generation || !m_pending)
+		return;
+
+	Promise::Ptr promise;
+	promise.swap(m_pending);
+
+	if (state == Deferred::Rejected && (m_settled.load() || m_options.testFlag(ResetOnRejection)))
+	{
+		/* The Promise is released from the event loop since this is called from its signal. */
+		QTimer::singleShot(0, this, [promise]() {});
+		// A rejected refresh keeps the current value
+		if (m_settled.load())
+			scheduleRefresh();
+		return;
+	}
+
+	publish(new Entry{promise, state, promise->data()});
+	scheduleRefresh();
+}
+
+void AsyncLazyBase::publish(Entry* entry)
+{
+	Entry* previous = m_settled.exchange(entry);
+	if (previous)
+		m_retired.append(previous);
+	/* Readers which start after the exchange cannot see the retired entries anymore.
+	 * So when there is no active reader, nobody can access them.
+	 */
+	if (!m_retired.isEmpty() && m_readers.load() == 0)
+	{
+		qDeleteAll(m_retired);
+		m_retired.clear();
+	}
+}
+
+void AsyncLazyBase::scheduleRefresh()
+{
+	if (m_refreshInterval <= 0)
+		return;
+	m_refreshTask = m_scheduler->schedule(m_refreshInterval, this, [this]() {
+		{
+			QMutexLocker locker(&m_lock);
+			m_refreshTask = 0;
+		}
+		this->refresh();
+	});
+}
+
+void AsyncLazyBase::cancelRefresh()
+{
+	if (m_refreshTask != 0)
+	{
+		m_scheduler->cancel(m_refreshTask);
+		m_refreshTask = 0;
+	}
+}
+
+}  // namespace QtPromise
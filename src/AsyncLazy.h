@@ -0,0 +1,244 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_ASYNCLAZY_H_
+#define QTPROMISE_ASYNCLAZY_H_
+
+#include "Promise.h"
+#include "Scheduler.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+
+namespace QtPromise {
+
+/*! \brief Shared asynchronous value which is computed once on first use.
+ *
+ * AsyncLazyBase implements AsyncLazy independent of the type of the value.
+ * Use AsyncLazy instead of using this class directly.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class AsyncLazyBase : public QObject
+{
+	Q_OBJECT
+
+public:
+	/*! The type of the function starting the computation of the value. */
+	typedef std::function<Promise::Ptr()> Factory;
+
+	/*! Options controlling the behavior of an AsyncLazy.
+	 *
+	 * \sa Options
+	 */
+	enum Option
+	{
+		NoOptions = 0,               //!< The value is computed once, even if the computation is rejected.
+		ResetOnRejection = 1 << 0    /*!< When the computation is rejected, the callers waiting for it
+		                              * receive the rejection but the next call to get() starts a new
+		                              * computation.
+		                              */
+	};
+	/*! QFlags type for Option values */
+	Q_DECLARE_FLAGS(Options, Option)
+
+	/*! Destroys the AsyncLazy.
+	 *
+	 * A pending computation is not affected but its result is not stored anymore.
+	 */
+	~AsyncLazyBase() override;
+
+	/*! Provides the value.
+	 *
+	 * The first call starts the computation by calling the factory. Concurrent and later calls
+	 * return the same Promise until the AsyncLazy is reset(). Once the Promise is settled,
+	 * this method does not lock.
+	 *
+	 * \return The Promise of the value.
+	 */
+	Promise::Ptr get();
+
+	/*! \return The settled Promise of the value or a null pointer if no computation
+	 * has been settled yet. This method never starts a computation and does not lock.
+	 */
+	Promise::Ptr current() const;
+
+	/*! \return \c true if a computation has been started and not been reset. */
+	bool isStarted() const;
+
+	/*! Forgets the value and a pending computation.
+	 *
+	 * The next call to get() starts a new computation. Promises which have been returned
+	 * before are not affected.
+	 */
+	void reset();
+
+	/*! Starts a new computation while get() keeps providing the current value.
+	 *
+	 * When the new computation is resolved, it replaces the current value. When it is rejected,
+	 * the current value is kept. Does nothing if a computation is already pending. If no
+	 * computation has been started yet, this is equivalent to get().
+	 */
+	void refresh();
+
+	/*! Sets the interval for periodic refreshes.
+	 *
+	 * When an interval is set, refresh() is called \p intervalInMillisec milliseconds after each
+	 * settlement of a computation. The time is provided by the Scheduler::instance() at the time
+	 * the AsyncLazy was created.
+	 *
+	 * \param intervalInMillisec The interval in milliseconds. \c 0 or a negative value disables
+	 * the periodic refresh, which is the default.
+	 */
+	void setRefreshInterval(int intervalInMillisec);
+
+	/*! \return The interval for periodic refreshes in milliseconds or \c 0 if disabled.
+	 * \sa setRefreshInterval()
+	 */
+	int refreshInterval() const;
+
+	/*! \return The options of this AsyncLazy. */
+	Options options() const { return m_options; }
+
+protected:
+	/*! Creates an AsyncLazy which calls \p factory to compute the value. */
+	AsyncLazyBase(Factory factory, Options options);
+
+	/*! Provides the value of the resolved computation without locking.
+	 *
+	 * \param[out] value Receives the value if a computation has been resolved.
+	 * Can be \c nullptr.
+	 * \return \c true if a computation has been resolved.
+	 */
+	bool resolvedValue(QVariant* value) const;
+
+private:
+	/*! A settled computation published for lock-free reading.
+	 *
+	 * The state and the data are copied from the Promise when publishing since reading them
+	 * from the Promise would lock its Deferred.
+	 */
+	struct Entry
+	{
+		Promise::Ptr promise;
+		Deferred::State state;
+		QVariant data;
+	};
+
+	void start();
+	void computationSettled(quint64 generation, Deferred::State state);
+	void publish(Entry* entry);
+	void scheduleRefresh();
+	void cancelRefresh();
+
+	const Options m_options;
+	Scheduler* m_scheduler;
+	mutable QMutex m_lock;
+	Factory m_factory;
+	Promise::Ptr m_pending;
+	quint64 m_generation;
+	int m_refreshInterval;
+	Scheduler::TaskId m_refreshTask;
+
+	/* The settled computation is read without locking. Replaced entries are retired and only
+	 * deleted when no reader is active. Since this requires the increment of m_readers and the
+	 * load of m_settled to be ordered against the exchange of m_settled and the load of
+	 * m_readers, sequentially consistent atomics are used.
+	 */
+	std::atomic<Entry*> m_settled;
+	mutable std::atomic<int> m_readers;
+	QVector<Entry*> m_retired;
+};
+
+/*! \brief Shared asynchronous value of type \p T which is computed once on first use.
+ *
+ * An AsyncLazy is meant for shared resources like configurations, authentication tokens
+ * or caches which are requested by many callers. The first call to get() starts the
+ * computation and all callers share its Promise:
+ * \code
+ * AsyncLazy<QString>::Ptr token = AsyncLazy<QString>::create([qnam]() {
+ *     return NetworkPromise::create(qnam->post(tokenRequest, credentials))->then([](const QVariant& data) {
+ *         return parseToken(data.value<NetworkDeferred::ReplyData>().data);
+ *     });
+ * }, AsyncLazy<QString>::ResetOnRejection);
+ *
+ * token->get()->then([](const QVariant& value) { ... });  // starts the request
+ * token->get()->then([](const QVariant& value) { ... });  // shares the request
+ * \endcode
+ *
+ * With the AsyncLazy::ResetOnRejection option, a rejected computation is not kept and the next
+ * call to get() tries again. With setRefreshInterval(), the value is recomputed periodically while
+ * get() keeps providing the previous value.
+ *
+ * The factory is called while the AsyncLazy is locked, so it must not call get() itself.
+ * The settlement of the computation is processed in the thread of the AsyncLazy, which requires
+ * a running event loop. An AsyncLazy must be destroyed in its thread.
+ *
+ * \tparam T The type of the value. The Promise of the factory must be resolved with
+ * a QVariant containing a \p T.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+template<typename T>
+class AsyncLazy : public AsyncLazyBase
+{
+public:
+	/*! Smart pointer to an AsyncLazy. */
+	typedef QSharedPointer<AsyncLazy<T>> Ptr;
+
+	/*! Creates an AsyncLazy.
+	 *
+	 * \param factory The function starting the computation of the value. If it returns a null
+	 * pointer, the computation is rejected.
+	 * \param options The Options of the AsyncLazy.
+	 * \return QSharedPointer to a new AsyncLazy.
+	 */
+	static Ptr create(Factory factory, Options options = NoOptions)
+	{
+		return Ptr(new AsyncLazy<T>(std::move(factory), options));
+	}
+
+	/*! \return \c true if a computation has been resolved. This method does not lock.
+	 * \sa value()
+	 */
+	bool hasValue() const
+	{
+		return resolvedValue(nullptr);
+	}
+
+	/*! \return The value of the resolved computation or \p defaultValue if there is none.
+	 * This method never starts a computation and does not lock.
+	 */
+	T value(const T& defaultValue = T()) const
+	{
+		QVariant data;
+		if (!resolvedValue(&data))
+			return defaultValue;
+		return data.template value<T>();
+	}
+
+protected:
+	/*! Creates an AsyncLazy which calls \p factory to compute the value. */
+	AsyncLazy(Factory factory, Options options)
+		: AsyncLazyBase(std::move(factory), options)
+	{
+	}
+};
+
+}  // namespace QtPromise
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(QtPromise::AsyncLazyBase::Options)
+
+#endif /* QTPROMISE_ASYNCLAZY_H_ */
@@ -0,0 +1,105 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_CALLSITE_H_
+#define QTPROMISE_CALLSITE_H_
+
+#include <QtGlobal>
+
+#include <type_traits>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#	if __has_include(<source_location>)
+#		include <source_location>
+#		if defined(__cpp_lib_source_location)
+#			define QTPROMISE_HAS_SOURCE_LOCATION
+#		endif
+#	endif
+#endif
+
+
+namespace QtPromise {
+
+/*! \brief Identifies a location in the source code.
+ *
+ * A CallSite can be passed to Promise::then(), Promise::always(), Promise::all() and
+ * Promise::create() to attribute the continuations and the pending time of the created
+ * promises to the calling code. See CallSiteProfiler.
+ *
+ * Use the #QTPROMISE_HERE macro to create a CallSite for the current location.
+ * When the standard library provides `std::source_location` (C++20), the location of the caller
+ * is captured automatically when no CallSite is passed.
+ *
+ * The strings are not copied. So they need to have static storage duration like string literals.
+ *
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+struct CallSite
+{
+	/*! Creates an invalid CallSite. */
+	constexpr CallSite() = default;
+	/*! Creates a CallSite.
+	 *
+	 * \param file The path of the source file. See `__FILE__`.
+	 * \param line The line in the source file. See `__LINE__`.
+	 * \param function The name of the function. See `Q_FUNC_INFO`.
+	 */
+	constexpr CallSite(const char* file, int line, const char* function)
+		: file(file), line(line), function(function)
+	{}
+#ifdef QTPROMISE_HAS_SOURCE_LOCATION
+	/*! Creates a CallSite from a `std::source_location`.
+	 *
+	 * \param location The source location.
+	 */
+	constexpr CallSite(const std::source_location& location)
+		: file(location.file_name()), line(static_cast<int>(location.line())), function(location.function_name())
+	{}
+#endif
+
+	/*! \return \c true if the CallSite identifies a location. */
+	constexpr bool isValid() const { return file != nullptr; }
+
+	/*! The path of the source file or \c nullptr if the CallSite is invalid. */
+	const char* file = nullptr;
+	/*! The line in the source file. */
+	int line = 0;
+	/*! The name of the function or \c nullptr if unknown. */
+	const char* function = nullptr;
+};
+
+/*!
+ * \cond INTERNAL
+ */
+
+/*! Detects if \p T is a CallSite to disambiguate the overloads taking a trailing CallSite. */
+template<typename T>
+struct IsCallSite : std::is_same<typename std::decay<T>::type, CallSite> {};
+
+/*!
+ * \endcond
+ */
+
+}  // namespace QtPromise
+
+/*! \def QTPROMISE_HERE
+ * Creates a QtPromise::CallSite for the location where the macro is used.
+ */
+/*! \def QTPROMISE_DEFAULT_CALL_SITE
+ * The default value of the CallSite parameters.
+ * Captures the location of the caller when `std::source_location` is available
+ * and is an invalid CallSite otherwise.
+ */
+#ifdef QTPROMISE_HAS_SOURCE_LOCATION
+#	define QTPROMISE_HERE ::QtPromise::CallSite(std::source_location::current())
+#	define QTPROMISE_DEFAULT_CALL_SITE std::source_location::current()
+#else
+#	define QTPROMISE_HERE ::QtPromise::CallSite(__FILE__, __LINE__, Q_FUNC_INFO)
+#	define QTPROMISE_DEFAULT_CALL_SITE ::QtPromise::CallSite()
+#endif
+
+#endif /* QTPROMISE_CALLSITE_H_ */
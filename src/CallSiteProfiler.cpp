@@ -0,0 +1,289 @@
+#include "CallSiteProfiler.h"
+#include "Deferred.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QtAlgorithms>
+
+#include <algorithm>
+
+namespace QtPromise {
+
+QBasicAtomicInt CallSiteProfiler::s_enabled = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+/*!
+ * \cond INTERNAL
+ */
+
+namespace {
+
+/* Identifies a call site by the addresses of its strings which is cheap to hash.
+ * The same location might have different addresses in different translation units.
+ * Such entries are combined by content in CallSiteProfiler::statistics().
+ */
+struct CallSiteKey
+{
+	const char* file;
+	int line;
+	const char* function;
+
+	bool operator==(const CallSiteKey& other) const
+	{
+		return file == other.file && line == other.line && function == other.function;
+	}
+};
+
+uint qHash(const CallSiteKey& key, uint seed)
+{
+	return ::qHash(key.file, seed) ^ ::qHash(key.line, seed) ^ ::qHash(key.function, seed);
+}
+
+typedef QHash<CallSiteKey, CallSiteProfiler::Statistics> StatisticsHash;
+
+/* The statistics are only written by the owning thread. The lock is
+ * therefore uncontended except while reading the statistics.
+ */
+struct ThreadRecorder
+{
+	QMutex lock;
+	StatisticsHash statistics;
+};
+
+struct Registry
+{
+	QMutex lock;
+	QVector<ThreadRecorder*> threads;
+	StatisticsHash finishedThreads;
+};
+
+Registry& registry()
+{
+	/* Intentionally leaked since thread local recorders of other threads
+	 * can be destroyed after the static objects.
+	 */
+	static Registry* instance = new Registry;
+	return *instance;
+}
+
+void mergeStatistics(CallSiteProfiler::Statistics& target, const CallSiteProfiler::Statistics& source)
+{
+	target.callbackCount += source.callbackCount;
+	target.callbackTotalTime += source.callbackTotalTime;
+	target.callbackMaxTime = qMax(target.callbackMaxTime, source.callbackMaxTime);
+	target.pendingCount += source.pendingCount;
+	target.pendingTotalTime += source.pendingTotalTime;
+	target.pendingMaxTime = qMax(target.pendingMaxTime, source.pendingMaxTime);
+}
+
+void mergeStatistics(StatisticsHash& target, const StatisticsHash& source)
+{
+	for (auto iter = source.constBegin(); iter != source.constEnd(); ++iter)
+	{
+		auto targetIter = target.find(iter.key());
+		if (targetIter == target.end())
+			target.insert(iter.key(), iter.value());
+		else
+			mergeStatistics(targetIter.value(), iter.value());
+	}
+}
+
+struct ThreadRecorderHolder
+{
+	ThreadRecorderHolder()
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		reg.threads.append(&recorder);
+	}
+
+	~ThreadRecorderHolder()
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		mergeStatistics(reg.finishedThreads, recorder.statistics);
+		reg.threads.removeOne(&recorder);
+	}
+
+	ThreadRecorder recorder;
+};
+
+ThreadRecorder& localRecorder()
+{
+	thread_local ThreadRecorderHolder holder;
+	return holder.recorder;
+}
+
+CallSiteProfiler::Statistics& localStatistics(ThreadRecorder& recorder, const CallSite& callSite)
+{
+	const CallSiteKey key = { callSite.file, callSite.line, callSite.function };
+	auto iter = recorder.statistics.find(key);
+	if (iter == recorder.statistics.end())
+	{
+		iter = recorder.statistics.insert(key, CallSiteProfiler::Statistics());
+		iter.value().callSite = callSite;
+	}
+	return iter.value();
+}
+
+qint64 sortValue(const CallSiteProfiler::Statistics& statistics, CallSiteProfiler::SortKey sortKey)
+{
+	switch (sortKey)
+	{
+	case CallSiteProfiler::CallbackMaxTime:
+		return statistics.callbackMaxTime;
+	case CallSiteProfiler::CallbackCount:
+		return static_cast<qint64>(statistics.callbackCount);
+	case CallSiteProfiler::PendingTotalTime:
+		return statistics.pendingTotalTime;
+	case CallSiteProfiler::PendingMaxTime:
+		return statistics.pendingMaxTime;
+	case CallSiteProfiler::CallbackTotalTime:
+	default:
+		return statistics.callbackTotalTime;
+	}
+}
+
+QString formatMilliseconds(qint64 nanoseconds)
+{
+	return QString::number(static_cast<double>(nanoseconds) / 1000000.0, 'f', 3);
+}
+
+} // namespace
+
+/*!
+ * \endcond
+ */
+
+
+void CallSiteProfiler::start()
+{
+	s_enabled.store(1);
+}
+
+void CallSiteProfiler::stop()
+{
+	s_enabled.store(0);
+}
+
+void CallSiteProfiler::clear()
+{
+	Registry& reg = registry();
+	QMutexLocker locker(&reg.lock);
+	for (ThreadRecorder* recorder : const_cast<const QVector<ThreadRecorder*>&>(reg.threads))
+	{
+		QMutexLocker recorderLocker(&recorder->lock);
+		recorder->statistics.clear();
+	}
+	reg.finishedThreads.clear();
+}
+
+QVector<CallSiteProfiler::Statistics> CallSiteProfiler::statistics()
+{
+	StatisticsHash combinedByAddress;
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		for (ThreadRecorder* recorder : const_cast<const QVector<ThreadRecorder*>&>(reg.threads))
+		{
+			QMutexLocker recorderLocker(&recorder->lock);
+			mergeStatistics(combinedByAddress, recorder->statistics);
+		}
+		mergeStatistics(combinedByAddress, reg.finishedThreads);
+	}
+
+	QVector<Statistics> result;
+	QHash<QByteArray, int> indexByLocation;
+	for (const Statistics& statistics : const_cast<const StatisticsHash&>(combinedByAddress))
+	{
+		const QByteArray location = QByteArray(statistics.callSite.file) + ':' + QByteArray::number(statistics.callSite.line)
+		                            + ':' + QByteArray(statistics.callSite.function);
+		auto iter = indexByLocation.constFind(location);
+		if (iter == indexByLocation.constEnd())
+		{
+			indexByLocation.insert(location, result.size());
+			result.append(statistics);
+		}
+		else
+			mergeStatistics(result[iter.value()], statistics);
+	}
+	return result;
+}
+
+QVector<CallSiteProfiler::Statistics> CallSiteProfiler::topCallSites(int count, SortKey sortKey)
+{
+	QVector<Statistics> result = statistics();
+	std::stable_sort(result.begin(), result.end(), [sortKey](const Statistics& left, const Statistics& right) {
+		return sortValue(left, sortKey) > sortValue(right, sortKey);
+	});
+	if (count >= 0 && result.size() > count)
+		result.resize(count);
+	return result;
+}
+
+QString CallSiteProfiler::report(int count, SortKey sortKey)
+{
+	const QVector<Statistics> callSites = topCallSites(count, sortKey);
+
+	QString result = QString("%1 %2 %3 %4 %5 %6  %7\n")
+	                 .arg("callbacks", 10).arg("total [ms]", 12).arg("max [ms]", 10)
+	                 .arg("settled", 10).arg("pending [ms]", 12).arg("max [ms]", 10)
+	                 .arg("call site");
+	for (const Statistics& statistics : callSites)
+	{
+		QString location = QString("%1:%2").arg(QString::fromUtf8(statistics.callSite.file)).arg(statistics.callSite.line);
+		if (statistics.callSite.function)
+			location += QString(" (%1)").arg(QString::fromUtf8(statistics.callSite.function));
+		result += QString("%1 %2 %3 %4 %5 %6  %7\n")
+		          .arg(statistics.callbackCount, 10).arg(formatMilliseconds(statistics.callbackTotalTime), 12)
+		          .arg(formatMilliseconds(statistics.callbackMaxTime), 10)
+		          .arg(statistics.pendingCount, 10).arg(formatMilliseconds(statistics.pendingTotalTime), 12)
+		          .arg(formatMilliseconds(statistics.pendingMaxTime), 10)
+		          .arg(location);
+	}
+	return result;
+}
+
+
+/*!
+ * \cond INTERNAL
+ */
+
+void CallSiteProfiler::deferredCreated(Deferred* deferred, const CallSite& callSite)
+{
+	if (!isEnabled() || !callSite.isValid())
+		return;
+
+	QMutexLocker locker(&deferred->m_lock);
+	// The first call site wins, for example when a Promise created by then() is passed to create()
+	if (deferred->m_state == Deferred::Pending && deferred->m_callSiteTimestamp == 0)
+	{
+		deferred->m_callSite = callSite;
+		deferred->m_callSiteTimestamp = PromiseLatency::now();
+	}
+}
+
+void CallSiteProfiler::deferredSettled(const CallSite& callSite, qint64 pendingTime)
+{
+	ThreadRecorder& recorder = localRecorder();
+	QMutexLocker locker(&recorder.lock);
+	Statistics& statistics = localStatistics(recorder, callSite);
+	statistics.pendingCount += 1;
+	statistics.pendingTotalTime += pendingTime;
+	statistics.pendingMaxTime = qMax(statistics.pendingMaxTime, pendingTime);
+}
+
+void CallSiteProfiler::callbackExecuted(const CallSite& callSite, qint64 executionTime)
+{
+	ThreadRecorder& recorder = localRecorder();
+	QMutexLocker locker(&recorder.lock);
+	Statistics& statistics = localStatistics(recorder, callSite);
+	statistics.callbackCount += 1;
+	statistics.callbackTotalTime += executionTime;
+	statistics.callbackMaxTime = qMax(statistics.callbackMaxTime, executionTime);
+}
+
+/*!
+ * \endcond
+ */
+
+}  // namespace QtPromise
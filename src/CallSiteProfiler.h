@@ -0,0 +1,141 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_CALLSITEPROFILER_H_
+#define QTPROMISE_CALLSITEPROFILER_H_
+
+#include "CallSite.h"
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QString>
+#include <QVector>
+
+
+namespace QtPromise {
+
+class Deferred;
+
+/*! \brief Aggregates the cost of promise continuations per call site.
+ *
+ * When started, the CallSiteProfiler records for each CallSite passed to Promise::then(),
+ * Promise::always(), Promise::all() and Promise::create():
+ * - The number, total duration and maximum duration of the executions of the callbacks
+ * registered with Promise::then() and Promise::always().
+ * - The number, total duration and maximum duration of the pending time of the created promises,
+ * that means the time from the call until the Promise is resolved or rejected.
+ *
+ * Calls without a valid CallSite are not recorded. On C++11, the CallSite has to be passed
+ * explicitly using #QTPROMISE_HERE:
+ * \code
+ * promise->then([](const QVariant& data) {
+ *     // do something expensive
+ * }, QTPROMISE_HERE);
+ * \endcode
+ * When `std::source_location` is available, the location of the caller is captured automatically.
+ *
+ * The statistics are recorded per thread and combined when they are read. The call sites are
+ * identified by their file, line and function, so the same location compiled into different
+ * translation units is combined into one entry.
+ *
+ * ## Overhead ##
+ * While the profiler is stopped, the instrumentation points only check a flag.
+ * While it is running, each profiled callback and settlement reads a monotonic clock twice and
+ * updates a hash table of the current thread.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class CallSiteProfiler
+{
+public:
+	/*! The statistics of one call site.
+	 *
+	 * The durations are in nanoseconds.
+	 */
+	struct Statistics
+	{
+		/*! The call site. */
+		CallSite callSite;
+		/*! The number of executed callbacks. */
+		quint64 callbackCount = 0;
+		/*! The total execution time of the callbacks. */
+		qint64 callbackTotalTime = 0;
+		/*! The longest execution time of a callback. */
+		qint64 callbackMaxTime = 0;
+		/*! The number of promises which have been resolved or rejected. */
+		quint64 pendingCount = 0;
+		/*! The total pending time of the promises. */
+		qint64 pendingTotalTime = 0;
+		/*! The longest pending time of a promise. */
+		qint64 pendingMaxTime = 0;
+	};
+
+	/*! The criterion used to rank the call sites.
+	 */
+	enum SortKey
+	{
+		CallbackTotalTime, /*!< Sort by Statistics::callbackTotalTime. */
+		CallbackMaxTime,   /*!< Sort by Statistics::callbackMaxTime. */
+		CallbackCount,     /*!< Sort by Statistics::callbackCount. */
+		PendingTotalTime,  /*!< Sort by Statistics::pendingTotalTime. */
+		PendingMaxTime     /*!< Sort by Statistics::pendingMaxTime. */
+	};
+
+	/*! Starts recording.
+	 */
+	static void start();
+	/*! Stops recording.
+	 *
+	 * The statistics recorded so far are kept until clear() is called.
+	 * Promises created while the profiler was running are still recorded when they are
+	 * resolved or rejected.
+	 */
+	static void stop();
+	/*! \return \c true if the profiler is recording. */
+	static bool isEnabled() { return s_enabled.load() != 0; }
+	/*! Discards all recorded statistics.
+	 */
+	static void clear();
+
+	/*! \return The statistics of all recorded call sites in no particular order.
+	 */
+	static QVector<Statistics> statistics();
+	/*! Ranks the recorded call sites.
+	 *
+	 * \param count The maximum number of call sites to be returned.
+	 * A negative value returns all call sites.
+	 * \param sortKey The criterion used to rank the call sites.
+	 * \return The \p count most expensive call sites according to \p sortKey
+	 * in descending order.
+	 */
+	static QVector<Statistics> topCallSites(int count = 10, SortKey sortKey = CallbackTotalTime);
+	/*! Creates a human readable report of the most expensive call sites.
+	 *
+	 * \param count The maximum number of call sites in the report.
+	 * \param sortKey The criterion used to rank the call sites.
+	 * \return A table with one line per call site and the durations in milliseconds.
+	 *
+	 * \sa topCallSites()
+	 */
+	static QString report(int count = 10, SortKey sortKey = CallbackTotalTime);
+
+	/*! \cond INTERNAL */
+	static void deferredCreated(Deferred* deferred, const CallSite& callSite);
+	static void deferredSettled(const CallSite& callSite, qint64 pendingTime);
+	static void callbackExecuted(const CallSite& callSite, qint64 executionTime);
+	/*! \endcond */
+
+private:
+	CallSiteProfiler() = delete;
+
+	static QBasicAtomicInt s_enabled;
+};
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_CALLSITEPROFILER_H_ */
@@ -1,5 +1,7 @@
 #include "ChildDeferred.h"
+#include "PromiseLogging.h"
 #include <QTimer>
+#include <type_traits>
 
 namespace QtPromise
 {
@@ -9,7 +11,7 @@ namespace QtPromise
  */
 
 ChildDeferred::ChildDeferred(const QVector<Deferred::Ptr>& parents, bool trackResults)
-	: Deferred(), m_lock(QMutex::Recursive), m_resolvedCount(0), m_rejectedCount(0), m_trackParentResults(trackResults)
+	: Deferred(PromiseMetrics::ChildDeferredType), m_lock(QMutex::Recursive), m_resolvedCount(0), m_rejectedCount(0), m_trackParentResults(trackResults)
 {
 	setLogInvalidActionMessage(false);
 	setParents(parents);
@@ -52,8 +54,13 @@ void ChildDeferred::setParents(const QVector<Deferred::Ptr>& parents)
 
 	disconnectParents();
 
+	const bool traced = PromiseTracer::isEnabled();
 	for (Deferred::Ptr parent : parents)
+	{
 		QObject::connect(parent.data(), &QObject::destroyed, this, &ChildDeferred::onParentDestroyed);
+		if (traced)
+			PromiseTracer::linked(parent.data(), this);
+	}
 
 	m_parents = parents;
 
@@ -67,6 +74,8 @@ void ChildDeferred::addParent(Deferred::Ptr parent)
 	QMutexLocker locker(&m_lock);
 
 	QObject::connect(parent.data(), &QObject::destroyed, this, &ChildDeferred::onParentDestroyed, Qt::UniqueConnection);
+	if (PromiseTracer::isEnabled())
+		PromiseTracer::linked(parent.data(), this);
 
 	m_parents.append(parent);
 
@@ -83,10 +92,12 @@ void ChildDeferred::removeParents(bool delayed)
 	if (delayed)
 	{
 		auto oldParents = m_parents;
-		QTimer::singleShot(0, [oldParents]() mutable {
+		PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::AsyncAction);
+		QTimer::singleShot(0, [oldParents, action]() mutable {
 			/* No need to do anything in here.
 			 * We just need to hold the parent pointers until the event loop.
 			 */
+			action.release();
 			oldParents.clear();
 		});
 	}
@@ -146,7 +157,12 @@ void ChildDeferred::callTrackParentResultMethodAsync(CallbackType&& callback)
 	auto timer = new QTimer(this);
 	m_trackParentResultAsyncTimers.add(timer);
 	timer->setSingleShot(true);
-	QObject::connect(timer, &QTimer::timeout, this, std::forward<CallbackType>(callback));
+	typename std::decay<CallbackType>::type callbackCopy(std::forward<CallbackType>(callback));
+	PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::AsyncAction);
+	QObject::connect(timer, &QTimer::timeout, this, [callbackCopy, action]() mutable {
+		action.release();
+		callbackCopy();
+	});
 	timer->start(0);
 }
 
@@ -168,7 +184,7 @@ void ChildDeferred::disconnectParent(Deferred* parent)
 void ChildDeferred::onParentDestroyed(QObject* parent)
 {
 	QMutexLocker locker(&m_lock);
-	qCritical("Parent deferred %s is destroyed while child %s is still holding a reference", qUtf8Printable(pointerToQString(parent)), qUtf8Printable(pointerToQString(this)));
+	qCCritical(lcDeferred, "Parent deferred %s is destroyed while child %s is still holding a reference", qUtf8Printable(pointerToQString(parent)), qUtf8Printable(pointerToQString(this)));
 	auto deferredParent = static_cast<Deferred*>(parent);
 	disconnectParent(deferredParent);
 	QVector<int> removeIndices;
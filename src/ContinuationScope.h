@@ -0,0 +1,108 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_CONTINUATIONSCOPE_H_
+#define QTPROMISE_CONTINUATIONSCOPE_H_
+
+#include "PromiseLatency.h"
+#include "PromiseTracer.h"
+#include "CallSiteProfiler.h"
+#include "ContinuationWatchdog.h"
+
+
+namespace QtPromise {
+
+class Deferred;
+
+/*!
+ * \cond INTERNAL
+ */
+
+/*! \brief Marks the execution of a continuation for the instrumentation of the library.
+ *
+ * A ContinuationScope is created around the invocation of the callbacks passed to
+ * Promise::then(). It records the latency histograms (see PromiseLatency), the
+ * trace events (see PromiseTracer) and the call site statistics (see CallSiteProfiler)
+ * of the continuation and reports slow continuations (see ContinuationWatchdog).
+ *
+ * \author jochen.ulrich
+ */
+class ContinuationScope
+{
+public:
+	/*! Marks a continuation triggered by the Deferred whose signals are currently emitted.
+	 * The continuation has been registered at \p callSite.
+	 */
+	explicit ContinuationScope(const CallSite& callSite = CallSite())
+		: m_traced(PromiseTracer::isEnabled())
+		, m_profiled(callSite.isValid() && CallSiteProfiler::isEnabled())
+		, m_watched(ContinuationWatchdog::isEnabled())
+		, m_callSite(callSite)
+		, m_deferred(m_watched ? ContinuationWatchdog::currentDeferred() : nullptr)
+		, m_deferredLabel(m_watched ? ContinuationWatchdog::deferredLabel(m_deferred) : QString())
+		, m_begin((m_profiled || m_watched) ? PromiseLatency::now() : 0)
+	{
+		if (m_traced)
+			PromiseTracer::continuationBegin();
+	}
+	/*! Marks a continuation of \p deferred which has been registered at \p callSite.
+	 * If \p queued is \c false, the continuation is executed directly and there is
+	 * no queueing delay.
+	 */
+	ContinuationScope(const Deferred* deferred, bool queued, const CallSite& callSite = CallSite())
+		: m_traced(PromiseTracer::isEnabled())
+		, m_profiled(callSite.isValid() && CallSiteProfiler::isEnabled())
+		, m_watched(ContinuationWatchdog::isEnabled())
+		, m_callSite(callSite)
+		, m_deferred(deferred)
+		, m_deferredLabel(m_watched ? ContinuationWatchdog::deferredLabel(m_deferred) : QString())
+		, m_begin((m_profiled || m_watched) ? PromiseLatency::now() : 0)
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+		, m_latencyScope(queued ? deferred : nullptr)
+#endif
+	{
+		Q_UNUSED(queued)
+		if (m_traced)
+			PromiseTracer::continuationBegin();
+	}
+	~ContinuationScope()
+	{
+		if (m_traced)
+			PromiseTracer::continuationEnd();
+		if (m_begin == 0)
+			return;
+		const qint64 duration = PromiseLatency::now() - m_begin;
+		if (m_profiled)
+			CallSiteProfiler::callbackExecuted(m_callSite, duration);
+		if (m_watched && duration >= ContinuationWatchdog::thresholdNanoseconds())
+			ContinuationWatchdog::slowContinuation(duration, m_callSite, m_deferred, m_deferredLabel);
+	}
+
+private:
+	Q_DISABLE_COPY(ContinuationScope)
+
+	bool m_traced;
+	bool m_profiled;
+	bool m_watched;
+	CallSite m_callSite;
+	/* Only used for identification after the continuation
+	 * since the continuation can destroy the Deferred.
+	 */
+	const Deferred* m_deferred;
+	QString m_deferredLabel;
+	qint64 m_begin;
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+	PromiseLatency::ContinuationScope m_latencyScope;
+#endif
+};
+
+/*!
+ * \endcond
+ */
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_CONTINUATIONSCOPE_H_ */
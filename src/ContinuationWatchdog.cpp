@@ -0,0 +1,153 @@
+#include "ContinuationWatchdog.h"
+#include "Deferred.h"
+#include "PromiseLogging.h"
+
+#include <QMutex>
+#include <QThread>
+
+namespace QtPromise {
+
+QBasicAtomicInt ContinuationWatchdog::s_enabled = Q_BASIC_ATOMIC_INITIALIZER(0);
+QBasicAtomicInteger<qint64> ContinuationWatchdog::s_thresholdNanoseconds = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+/*!
+ * \cond INTERNAL
+ */
+
+namespace {
+
+const qint64 nanosecondsPerMillisecond = 1000000;
+
+QBasicAtomicInteger<quint64> slowCount = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+struct HandlerHolder
+{
+	QMutex lock;
+	ContinuationWatchdog::Handler handler;
+};
+
+HandlerHolder& handlerHolder()
+{
+	/* Intentionally leaked since continuations of other threads
+	 * can finish after the static objects have been destroyed.
+	 */
+	static HandlerHolder* instance = new HandlerHolder;
+	return *instance;
+}
+
+thread_local const Deferred* currentDeferredValue = nullptr;
+
+} // namespace
+
+/*!
+ * \endcond
+ */
+
+
+QString ContinuationWatchdog::SlowContinuation::toString() const
+{
+	QString result = QString("Slow continuation took %1 ms")
+	                 .arg(static_cast<double>(duration) / nanosecondsPerMillisecond, 0, 'f', 3);
+	if (callSite.isValid())
+	{
+		result += QString(" at %1:%2").arg(QString::fromUtf8(callSite.file)).arg(callSite.line);
+		if (callSite.function)
+			result += QString(" (%1)").arg(QString::fromUtf8(callSite.function));
+	}
+	if (deferred)
+	{
+		result += QString(" for Deferred %1").arg(pointerToQString(deferred));
+		if (!deferredLabel.isEmpty())
+			result += QString(" \"%1\"").arg(deferredLabel);
+	}
+	return result;
+}
+
+void ContinuationWatchdog::start(int thresholdInMillisec)
+{
+	s_thresholdNanoseconds.store(qMax(0, thresholdInMillisec) * nanosecondsPerMillisecond);
+	s_enabled.store(1);
+}
+
+void ContinuationWatchdog::stop()
+{
+	s_enabled.store(0);
+}
+
+int ContinuationWatchdog::threshold()
+{
+	return static_cast<int>(s_thresholdNanoseconds.load() / nanosecondsPerMillisecond);
+}
+
+void ContinuationWatchdog::setHandler(const Handler& handler)
+{
+	HandlerHolder& holder = handlerHolder();
+	QMutexLocker locker(&holder.lock);
+	holder.handler = handler;
+}
+
+quint64 ContinuationWatchdog::slowContinuationCount()
+{
+	return slowCount.load();
+}
+
+void ContinuationWatchdog::resetSlowContinuationCount()
+{
+	slowCount.store(0);
+}
+
+
+/*!
+ * \cond INTERNAL
+ */
+
+const Deferred* ContinuationWatchdog::currentDeferred()
+{
+	return currentDeferredValue;
+}
+
+QString ContinuationWatchdog::deferredLabel(const Deferred* deferred)
+{
+	return deferred ? deferred->label() : QString();
+}
+
+void ContinuationWatchdog::slowContinuation(qint64 duration, const CallSite& callSite, const void* deferred,
+                                            const QString& deferredLabel)
+{
+	slowCount.fetchAndAddRelaxed(1);
+
+	SlowContinuation report;
+	report.duration = duration;
+	report.callSite = callSite;
+	report.deferred = deferred;
+	report.deferredLabel = deferredLabel;
+	report.threadId = QThread::currentThreadId();
+
+	Handler handler;
+	{
+		HandlerHolder& holder = handlerHolder();
+		QMutexLocker locker(&holder.lock);
+		handler = holder.handler;
+	}
+	if (handler)
+		handler(report);
+	else
+		qCWarning(lcWatchdog, "%s", qUtf8Printable(report.toString()));
+}
+
+ContinuationWatchdog::SettleScope::SettleScope(const Deferred* deferred)
+	: m_previousDeferred(currentDeferredValue)
+{
+	currentDeferredValue = deferred;
+}
+
+ContinuationWatchdog::SettleScope::~SettleScope()
+{
+	currentDeferredValue = m_previousDeferred;
+}
+
+/*!
+ * \endcond
+ */
+
+}  // namespace QtPromise
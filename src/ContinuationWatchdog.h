@@ -0,0 +1,150 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_CONTINUATIONWATCHDOG_H_
+#define QTPROMISE_CONTINUATIONWATCHDOG_H_
+
+#include "CallSite.h"
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QString>
+
+#include <functional>
+
+
+namespace QtPromise {
+
+class Deferred;
+
+/*! \brief Detects continuations which block the event loop.
+ *
+ * Continuations registered with Promise::then() are executed synchronously in the thread
+ * of the Deferred. A continuation doing blocking I/O or an expensive computation therefore
+ * stalls the event loop of that thread.
+ *
+ * When started, the ContinuationWatchdog times each continuation. When a continuation takes
+ * at least the threshold, the watchdog
+ * - increments slowContinuationCount(),
+ * - creates a SlowContinuation report including the CallSite of the continuation (see
+ * Promise::then()) and the identity of the Deferred which triggered it and
+ * - passes the report to the handler (see setHandler()) or logs it as a warning
+ * if there is no handler.
+ *
+ * Since slow continuations are only detected once they have finished, the report does not
+ * contain a stack trace. The call site is the starting point to find the blocking code.
+ *
+ * ## Overhead ##
+ * While the watchdog is stopped, the instrumentation points only check a flag.
+ * While it is running, each continuation reads a monotonic clock twice and copies the label of its
+ * Deferred. Only slow continuations allocate memory. So the watchdog can be left running in production.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class ContinuationWatchdog
+{
+public:
+	/*! The default threshold in milliseconds. */
+	static const int DefaultThreshold = 100;
+
+	/*! Describes a slow continuation.
+	 */
+	struct SlowContinuation
+	{
+		/*! The execution time of the continuation in nanoseconds. */
+		qint64 duration = 0;
+		/*! The location where the continuation has been registered.
+		 * Invalid if no CallSite has been passed to Promise::then().
+		 */
+		CallSite callSite;
+		/*! The address of the Deferred which triggered the continuation or \c nullptr if unknown.
+		 * Only to be used for identification since the Deferred might have been destroyed already.
+		 */
+		const void* deferred = nullptr;
+		/*! The label of the Deferred when the continuation started. See Deferred::setLabel(). */
+		QString deferredLabel;
+		/*! The ID of the thread which executed the continuation. */
+		Qt::HANDLE threadId = nullptr;
+
+		/*! \return A human readable description of the slow continuation. */
+		QString toString() const;
+	};
+
+	/*! A function which is called for each slow continuation.
+	 *
+	 * The handler is called in the thread which executed the continuation.
+	 */
+	typedef std::function<void(const SlowContinuation&)> Handler;
+
+	/*! Starts timing the continuations.
+	 *
+	 * \param thresholdInMillisec The minimum execution time of a continuation to be
+	 * considered slow.
+	 */
+	static void start(int thresholdInMillisec = DefaultThreshold);
+	/*! Stops timing the continuations.
+	 */
+	static void stop();
+	/*! \return \c true if the watchdog is running. */
+	static bool isEnabled() { return s_enabled.load() != 0; }
+	/*! \return The current threshold in milliseconds. */
+	static int threshold();
+
+	/*! Sets a function which is called for each slow continuation instead of logging a warning.
+	 *
+	 * \param handler The handler. A null function restores the logging.
+	 */
+	static void setHandler(const Handler& handler);
+
+	/*! \return The number of slow continuations detected since the start of the process
+	 * or since the last call to resetSlowContinuationCount().
+	 */
+	static quint64 slowContinuationCount();
+	/*! Resets the slowContinuationCount() to \c 0.
+	 */
+	static void resetSlowContinuationCount();
+
+	/*! \cond INTERNAL */
+
+	/*! \return The threshold in nanoseconds. */
+	static qint64 thresholdNanoseconds() { return s_thresholdNanoseconds.load(); }
+	/*! \return The Deferred whose signals are currently emitted in the current thread
+	 * or \c nullptr if there is none.
+	 */
+	static const Deferred* currentDeferred();
+	/*! \return The label of \p deferred or a null QString if \p deferred is \c nullptr.
+	 * Captured when a continuation starts since the Deferred can be destroyed by the continuation.
+	 */
+	static QString deferredLabel(const Deferred* deferred);
+	static void slowContinuation(qint64 duration, const CallSite& callSite, const void* deferred,
+	                             const QString& deferredLabel);
+
+	/*! Marks the emission of the signals of a resolved/rejected Deferred.
+	 */
+	class SettleScope
+	{
+	public:
+		explicit SettleScope(const Deferred* deferred);
+		~SettleScope();
+	private:
+		Q_DISABLE_COPY(SettleScope)
+		const Deferred* m_previousDeferred;
+	};
+
+	/*! \endcond */
+
+private:
+	ContinuationWatchdog() = delete;
+
+	static QBasicAtomicInt s_enabled;
+	static QBasicAtomicInteger<qint64> s_thresholdNanoseconds;
+};
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_CONTINUATIONWATCHDOG_H_ */
@@ -1,4 +1,5 @@
 #include "Deferred.h"
+#include "PromiseLogging.h"
 
 #include <QHash>
 
@@ -6,28 +7,37 @@ namespace QtPromise {
 
 
 Deferred::Deferred()
+	: Deferred(PromiseMetrics::BaseDeferredType)
+{
+}
+
+Deferred::Deferred(PromiseMetrics::DeferredType metricsType)
 	: QObject(nullptr)
 	, m_state(Pending)
 	, m_lock(QMutex::Recursive)
 	, m_isInSignalHandler{0}
+	, m_metricsType(metricsType)
+	, m_traceId(0)
 {
 	registerMetaTypes();
+	PromiseMetrics::deferredCreated(m_metricsType);
+	if (PromiseTracer::isEnabled())
+		PromiseTracer::deferredCreated(this);
+	if (DeferredRegistry::isEnabled())
+		DeferredRegistry::add(&m_registryNode, m_metricsType);
 }
 
 void Deferred::registerMetaTypes()
 {
-	static QMutex metaTypesLock;
-	static bool registered = false;
-
-	QMutexLocker locker(&metaTypesLock);
-	if (!registered)
-	{
+	// Thread safe one-time initialization without taking a lock on subsequent calls
+	static const bool registered = []() {
 		qRegisterMetaType<State>();
 		QMetaType::registerEqualsComparator<State>();
 		qRegisterMetaType<State>("Deferred::State");
 		qRegisterMetaType<State>("QtPromise::Deferred::State");
-		registered = true;
-	}
+		return true;
+	}();
+	Q_UNUSED(registered)
 }
 
 Deferred::Ptr Deferred::create()
@@ -54,11 +64,13 @@ Deferred::Ptr Deferred::create(State state, const QVariant& data)
 
 Deferred::~Deferred()
 {
+	DeferredRegistry::remove(&m_registryNode);
 	checkDestructionInSignalHandler();
 
 	QMutexLocker locker(&m_lock);
 	if (m_state == Pending)
-		qDebug("Deferred %s destroyed while still pending", qUtf8Printable(pointerToQString(this)));
+		qCDebug(lcDeferred, "Deferred %s destroyed while still pending", qUtf8Printable(pointerToQString(this)));
+	PromiseMetrics::deferredDestroyed(m_metricsType, m_state == Pending);
 }
 
 void Deferred::setLogInvalidActionMessage(bool logInvalidActionMessage)
@@ -69,13 +81,68 @@ void Deferred::setLogInvalidActionMessage(bool logInvalidActionMessage)
 void Deferred::logInvalidActionMessage(const char* action) const
 {
 	if (m_logInvalidActionMessage)
-		qDebug("Cannot %s Deferred %s which is already %s", action, qUtf8Printable(pointerToQString(this)), m_state==Resolved?"resolved":"rejected");
+		qCDebug(lcDeferred, "Cannot %s Deferred %s which is already %s", action, qUtf8Printable(pointerToQString(this)), m_state==Resolved?"resolved":"rejected");
+}
+
+int Deferred::addSettleHook(SettleHook hook)
+{
+	QMutexLocker locker(&m_lock);
+
+	if (m_state != Pending)
+		return 0;
+
+	const int hookId = m_nextSettleHookId++;
+	m_settleHooks.append(qMakePair(hookId, std::move(hook)));
+	return hookId;
+}
+
+bool Deferred::removeSettleHook(int hookId)
+{
+	QMutexLocker locker(&m_lock);
+
+	for (auto iter = m_settleHooks.begin(); iter != m_settleHooks.end(); ++iter)
+	{
+		if (iter->first == hookId)
+		{
+			m_settleHooks.erase(iter);
+			return true;
+		}
+	}
+	return false;
+}
+
+void Deferred::callSettleHooks()
+{
+	// Must be called with m_lock being locked
+	if (m_settleHooks.isEmpty())
+		return;
+
+	/* Take the hooks out before calling them so a hook can call
+	 * removeSettleHook() without invalidating the iteration.
+	 */
+	QVector<QPair<int, SettleHook>> hooks;
+	hooks.swap(m_settleHooks);
+	for (const auto& hook : const_cast<const QVector<QPair<int, SettleHook>>&>(hooks))
+		hook.second(m_state);
+}
+
+void Deferred::setLabel(const QString& label)
+{
+	{
+		QMutexLocker locker(&m_lock);
+		m_label = label;
+	}
+	if (PromiseTracer::isEnabled())
+		PromiseTracer::labelSet(this, label);
+	DeferredRegistry::labelChanged(&m_registryNode, label);
 }
 
 void Deferred::checkDestructionInSignalHandler()
 {
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 	if (m_isInSignalHandler.fetchAndStoreOrdered(0) > 0)
-		qCritical("Deferred %s destroyed as reaction to its own signal", qUtf8Printable(pointerToQString(this)));
+		qCCritical(lcDeferred, "Deferred %s destroyed as reaction to its own signal", qUtf8Printable(pointerToQString(this)));
+#endif
 }
 
 bool Deferred::resolve(const QVariant& value)
@@ -86,9 +153,26 @@ bool Deferred::resolve(const QVariant& value)
 	{
 		m_data = value;
 		m_state = Resolved;
+		PromiseMetrics::deferredSettled(m_metricsType, false);
+		DeferredRegistry::settled(&m_registryNode);
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+		m_settleTimestamp = PromiseLatency::now();
+		PromiseLatency::SettleScope settleScope(m_settleTimestamp);
+#endif
+		if (m_callSiteTimestamp != 0)
+			CallSiteProfiler::deferredSettled(m_callSite, PromiseLatency::now() - m_callSiteTimestamp);
+		const quint64 traceId = PromiseTracer::isEnabled() ? PromiseTracer::settleBegin(this, false) : 0;
+		ContinuationWatchdog::SettleScope watchdogScope(this);
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 		m_isInSignalHandler.fetchAndAddAcquire(1);
+#endif
 		Q_EMIT resolved(m_data);
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 		m_isInSignalHandler.fetchAndSubRelease(1);
+#endif
+		callSettleHooks();
+		if (traceId != 0)
+			PromiseTracer::settleEnd(traceId);
 		return true;
 	}
 	else
@@ -106,9 +190,26 @@ bool Deferred::reject(const QVariant& reason)
 	{
 		m_data = reason;
 		m_state = Rejected;
+		PromiseMetrics::deferredSettled(m_metricsType, true);
+		DeferredRegistry::settled(&m_registryNode);
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+		m_settleTimestamp = PromiseLatency::now();
+		PromiseLatency::SettleScope settleScope(m_settleTimestamp);
+#endif
+		if (m_callSiteTimestamp != 0)
+			CallSiteProfiler::deferredSettled(m_callSite, PromiseLatency::now() - m_callSiteTimestamp);
+		const quint64 traceId = PromiseTracer::isEnabled() ? PromiseTracer::settleBegin(this, true) : 0;
+		ContinuationWatchdog::SettleScope watchdogScope(this);
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 		m_isInSignalHandler.fetchAndAddAcquire(1);
+#endif
 		Q_EMIT rejected(m_data);
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 		m_isInSignalHandler.fetchAndSubRelease(1);
+#endif
+		callSettleHooks();
+		if (traceId != 0)
+			PromiseTracer::settleEnd(traceId);
 		return true;
 	}
 	else
@@ -124,9 +225,15 @@ bool Deferred::notify(const QVariant& progress)
 
 	if (m_state == Pending)
 	{
+		if (PromiseTracer::isEnabled())
+			PromiseTracer::notified(this);
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 		m_isInSignalHandler.fetchAndAddAcquire(1);
+#endif
 		Q_EMIT notified(progress);
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 		m_isInSignalHandler.fetchAndSubRelease(1);
+#endif
 		return true;
 	}
 	else
@@ -13,6 +13,17 @@
 #include <QException>
 #include <QSharedPointer>
 #include <QAtomicInt>
+#include <QVector>
+#include <QPair>
+
+#include <functional>
+
+#include "PromiseMetrics.h"
+#include "PromiseLatency.h"
+#include "PromiseTracer.h"
+#include "CallSiteProfiler.h"
+#include "ContinuationWatchdog.h"
+#include "DeferredRegistry.h"
 
 
 namespace QtPromise {
@@ -111,7 +122,8 @@ public:
 	/*! Checks for usage errors and rejects the Deferred when necessary.
 	 *
 	 * When the Deferred is still pending when being destroyed,
-	 * it logs a warning using qDebug().
+	 * it logs a debug message in the `qtpromise.deferred` logging category.
+	 * See \ref page_logMessages_categories.
 	 *
 	 * \sa checkDestructionInSignalHandler()
 	 */
@@ -125,6 +137,61 @@ public:
 	 */
 	QVariant data() const { QMutexLocker locker(&m_lock); return m_data; }
 
+	/*! Defines the type of functions which can be registered using addSettleHook().
+	 *
+	 * The function receives the new state of the Deferred (either \ref Resolved or \ref Rejected).
+	 */
+	typedef std::function<void(Deferred::State)> SettleHook;
+
+	/*! Registers a function which is called when this Deferred is resolved or rejected.
+	 *
+	 * Settle hooks are a lightweight alternative to connecting to the resolved() and
+	 * rejected() signals: they do not involve Qt's signal & slot mechanism and they are
+	 * called exactly once, directly after the corresponding signal has been emitted,
+	 * in the thread which resolved or rejected this Deferred.
+	 * After being called, the hooks are discarded automatically.
+	 *
+	 * \warning The hook is called while this Deferred is locked. So it must neither block
+	 * nor lead to the destruction of this Deferred. Defer such actions to the event loop.
+	 *
+	 * \param hook The function to be called.
+	 * \return An ID which can be used to unregister the hook using removeSettleHook().
+	 * If this Deferred is not \ref Pending anymore, the hook is not registered and \c 0
+	 * is returned.
+	 *
+	 * \since 2.2.0
+	 */
+	int addSettleHook(SettleHook hook);
+	/*! Unregisters a settle hook.
+	 *
+	 * \param hookId The ID of the hook as returned by addSettleHook().
+	 * \return \c true if the hook was registered and has been removed.
+	 * \c false if there is no hook with the given \p hookId (for example because it
+	 * has already been called).
+	 *
+	 * \since 2.2.0
+	 */
+	bool removeSettleHook(int hookId);
+
+	/*! Sets a label describing this Deferred.
+	 *
+	 * The label is used to identify the Deferred in diagnostics like the traces
+	 * recorded by the PromiseTracer.
+	 *
+	 * \param label A short, human readable description of the asynchronous operation.
+	 * For example \c "fetchUserProfile". The number of distinct labels should be limited since
+	 * the PromiseTracer keeps each distinct label.
+	 *
+	 * \since 2.2.0
+	 */
+	void setLabel(const QString& label);
+	/*! \return The label of this Deferred or a null QString if no label has been set.
+	 *
+	 * \sa setLabel()
+	 * \since 2.2.0
+	 */
+	QString label() const { QMutexLocker locker(&m_lock); return m_label; }
+
 Q_SIGNALS:
 	/*! Emitted when the asynchronous operation was successful.
 	 *
@@ -190,6 +257,13 @@ protected:
 	/*! Creates a pending Deferred object.
 	 */
 	Deferred();
+	/*! Creates a pending Deferred object which is accounted as \p metricsType in the PromiseMetrics.
+	 *
+	 * \param metricsType The type of the Deferred as reported by the PromiseMetrics.
+	 *
+	 * \since 2.2.0
+	 */
+	explicit Deferred(PromiseMetrics::DeferredType metricsType);
 	/*! Defines whether the Deferred logs a debug message when resolve() or
 	 * reject() is called when the Deferred is already resolved/rejected.
 	 *
@@ -211,6 +285,13 @@ protected:
 	 * of the Deferred (that is the deletion of the last QSharedPointer) must
 	 * be done asynchronously, for example using QTimer::singleShot().
 	 *
+	 * The check costs atomic operations in every resolve(), reject() and notify().
+	 * When the preprocessor macro `QTPROMISE_NO_SIGNAL_HANDLER_CHECKS` is defined, the check
+	 * and the bookkeeping are compiled out and this method does nothing. The CMake option
+	 * `QTPROMISE_NO_RELEASE_SIGNAL_HANDLER_CHECKS` defines the macro for all non-debug builds
+	 * as a public compile definition of the `qt5promise` target, so targets linking it inherit it.
+	 * The macro must be defined consistently for the library and the code using it.
+	 *
 	 * \since 2.0.0
 	 */
 	void checkDestructionInSignalHandler();
@@ -257,6 +338,35 @@ protected:
 	template<typename ReasonType, typename Signal>
 	void rejectAndEmit(const ReasonType& reason, Signal&& signal);
 
+	/*! Resolves this Deferred and emits a signal with a different value.
+	 *
+	 * Works like resolveAndEmit(const ValueType&, Signal&&) but resolves this Deferred with \p data
+	 * and emits the \p signal with \p signalValue. This allows derived classes to resolve with
+	 * a cheap representation of the value while the specialized signal provides the full value.
+	 *
+	 * \param data The data used to resolve this Deferred.
+	 * \param signalValue The value which is emitted with \p signal.
+	 * \param signal The signal which is emitted with \p signalValue.
+	 *
+	 * \since 2.2.0
+	 */
+	template<typename ValueType, typename Signal>
+	void resolveAndEmit(const QVariant& data, const ValueType& signalValue, Signal&& signal);
+
+	/*! Rejects this Deferred and emits a signal with a different value.
+	 *
+	 * Works like rejectAndEmit(const ReasonType&, Signal&&) but rejects this Deferred with \p data
+	 * and emits the \p signal with \p signalValue.
+	 *
+	 * \param data The data used to reject this Deferred.
+	 * \param signalValue The value which is emitted with \p signal.
+	 * \param signal The signal which is emitted with \p signalValue.
+	 *
+	 * \since 2.2.0
+	 */
+	template<typename ReasonType, typename Signal>
+	void rejectAndEmit(const QVariant& data, const ReasonType& signalValue, Signal&& signal);
+
 	/*! Notifies this Deferred and emits a signal.
 	 *
 	 * This is a convenience method which notifies this Deferred with \p progress and if it was notified,
@@ -280,13 +390,29 @@ protected:
 
 
 private:
+	friend class PromiseLatency;
+	friend class PromiseTracer;
+	friend class CallSiteProfiler;
+
 	void logInvalidActionMessage(const char* action) const;
+	void callSettleHooks();
 
 	mutable QMutex m_lock;
 	State m_state;
 	QVariant m_data;
 	bool m_logInvalidActionMessage = true;
 	QAtomicInt m_isInSignalHandler;
+	QVector<QPair<int, SettleHook>> m_settleHooks;
+	int m_nextSettleHookId = 1;
+	PromiseMetrics::DeferredType m_metricsType;
+	QString m_label;
+	mutable QAtomicInteger<quint64> m_traceId;
+	CallSite m_callSite;
+	qint64 m_callSiteTimestamp = 0;
+	DeferredRegistry::Node m_registryNode;
+	/* Only written when the library is built with QTPROMISE_LATENCY_HISTOGRAMS. The member stays
+	 * so the class layout does not depend on the macro. */
+	qint64 m_settleTimestamp = 0;
 
 	static void registerMetaTypes();
 };
@@ -0,0 +1,271 @@
+#include "DeferredRegistry.h"
+#include "PromiseLatency.h"
+
+#include <QAtomicPointer>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+
+#include <algorithm>
+
+namespace QtPromise {
+
+QBasicAtomicInt DeferredRegistry::s_enabled = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+/*!
+ * \cond INTERNAL
+ */
+
+/* A circular doubly linked list with a sentinel node.
+ * The lists are never destroyed since Deferreds can outlive the thread which created them.
+ *
+ * The owning thread does not lock the list when adding a node. Instead, it pushes the node onto
+ * the lock-free stack \c incoming using the \c next pointer of the node. Whoever locks the list
+ * to remove nodes or to read them first moves the whole stack into the list. Since the stack is
+ * always taken as a whole, there is no ABA problem.
+ */
+struct DeferredRegistry::ThreadList
+{
+	ThreadList()
+	{
+		sentinel.previous = &sentinel;
+		sentinel.next = &sentinel;
+	}
+
+	void push(Node* node)
+	{
+		Node* head = incoming.load();
+		do
+			node->next = head;
+		while (!incoming.testAndSetRelease(head, node, head));
+	}
+
+	/* Moves the incoming nodes into the list. Must be called with the lock held.
+	 */
+	void linkIncoming()
+	{
+		Node* node = incoming.fetchAndStoreAcquire(nullptr);
+		while (node)
+		{
+			Node* const nextIncoming = node->next;
+			node->previous = sentinel.previous;
+			node->next = &sentinel;
+			sentinel.previous->next = node;
+			sentinel.previous = node;
+			node = nextIncoming;
+		}
+	}
+
+	QMutex lock;
+	Node sentinel;
+	QAtomicPointer<Node> incoming;
+};
+
+namespace {
+
+const qint64 nanosecondsPerMillisecond = 1000000;
+
+struct Registry
+{
+	QMutex lock;
+	QVector<DeferredRegistry::ThreadList*> lists;
+	QVector<DeferredRegistry::ThreadList*> unusedLists;
+};
+
+Registry& registry()
+{
+	/* Intentionally leaked since Deferreds can be destroyed after the static objects.
+	 */
+	static Registry* instance = new Registry;
+	return *instance;
+}
+
+struct ThreadListHolder
+{
+	ThreadListHolder()
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		if (reg.unusedLists.isEmpty())
+		{
+			list = new DeferredRegistry::ThreadList;
+			reg.lists.append(list);
+		}
+		else
+			list = reg.unusedLists.takeLast();
+	}
+
+	~ThreadListHolder()
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		reg.unusedLists.append(list);
+	}
+
+	DeferredRegistry::ThreadList* list;
+};
+
+DeferredRegistry::ThreadList* localList()
+{
+	thread_local ThreadListHolder holder;
+	return holder.list;
+}
+
+QString formatAge(qint64 milliseconds)
+{
+	if (milliseconds < 0)
+		return QStringLiteral("inf");
+	if (milliseconds % (60 * 60 * 1000) == 0 && milliseconds > 0)
+		return QString("%1 h").arg(milliseconds / (60 * 60 * 1000));
+	if (milliseconds % (60 * 1000) == 0 && milliseconds > 0)
+		return QString("%1 min").arg(milliseconds / (60 * 1000));
+	if (milliseconds % 1000 == 0 && milliseconds > 0)
+		return QString("%1 s").arg(milliseconds / 1000);
+	return QString("%1 ms").arg(milliseconds);
+}
+
+} // namespace
+
+/*!
+ * \endcond
+ */
+
+
+QString DeferredRegistry::Snapshot::toString() const
+{
+	QString result = QString("%1 registered Deferreds, %2 pending\n").arg(count).arg(pendingCount);
+	result += QStringLiteral("By age:\n");
+	for (const AgeBucket& bucket : ageBuckets)
+	{
+		result += QString("  [%1, %2): %3 (%4 pending)\n")
+		          .arg(formatAge(bucket.minAge), formatAge(bucket.maxAge))
+		          .arg(bucket.count).arg(bucket.pendingCount);
+	}
+	result += QStringLiteral("By label:\n");
+	for (const LabelGroup& group : labelGroups)
+	{
+		result += QString("  %1 (%2): %3 (%4 pending), oldest %5 ms\n")
+		          .arg(group.label.isEmpty() ? QStringLiteral("<no label>") : group.label)
+		          .arg(PromiseMetrics::typeName(group.type))
+		          .arg(group.count).arg(group.pendingCount).arg(group.maxAge);
+	}
+	return result;
+}
+
+void DeferredRegistry::setEnabled(bool enabled)
+{
+	s_enabled.store(enabled ? 1 : 0);
+}
+
+QVector<qint64> DeferredRegistry::defaultAgeBounds()
+{
+	return QVector<qint64>() << 1000 << 10 * 1000 << 60 * 1000 << 10 * 60 * 1000 << 60 * 60 * 1000;
+}
+
+DeferredRegistry::Snapshot DeferredRegistry::snapshot(const QVector<qint64>& ageBounds)
+{
+	Snapshot result;
+	qint64 minAge = 0;
+	for (qint64 bound : ageBounds)
+	{
+		AgeBucket bucket;
+		bucket.minAge = minAge;
+		bucket.maxAge = bound;
+		result.ageBuckets.append(bucket);
+		minAge = bound;
+	}
+	AgeBucket lastBucket;
+	lastBucket.minAge = minAge;
+	result.ageBuckets.append(lastBucket);
+
+	typedef QPair<QString, int> GroupKey;
+	QHash<GroupKey, int> groupIndexes;
+
+	const qint64 now = PromiseLatency::now();
+	Registry& reg = registry();
+	QMutexLocker locker(&reg.lock);
+	for (ThreadList* list : const_cast<const QVector<ThreadList*>&>(reg.lists))
+	{
+		QMutexLocker listLocker(&list->lock);
+		list->linkIncoming();
+		for (const Node* node = list->sentinel.next; node != &list->sentinel; node = node->next)
+		{
+			const qint64 age = qMax(Q_INT64_C(0), now - node->createdAt) / nanosecondsPerMillisecond;
+			const bool pending = node->settled.load() == 0;
+
+			result.count += 1;
+			result.pendingCount += pending ? 1 : 0;
+
+			const int bucketIndex = static_cast<int>(std::upper_bound(ageBounds.constBegin(), ageBounds.constEnd(), age) - ageBounds.constBegin());
+			AgeBucket& bucket = result.ageBuckets[bucketIndex];
+			bucket.count += 1;
+			bucket.pendingCount += pending ? 1 : 0;
+
+			const GroupKey key(node->label, node->type);
+			auto indexIter = groupIndexes.constFind(key);
+			if (indexIter == groupIndexes.constEnd())
+			{
+				LabelGroup group;
+				group.label = node->label;
+				group.type = node->type;
+				indexIter = groupIndexes.insert(key, result.labelGroups.size());
+				result.labelGroups.append(group);
+			}
+			LabelGroup& group = result.labelGroups[indexIter.value()];
+			group.count += 1;
+			group.pendingCount += pending ? 1 : 0;
+			group.maxAge = qMax(group.maxAge, age);
+		}
+	}
+	locker.unlock();
+
+	std::stable_sort(result.labelGroups.begin(), result.labelGroups.end(), [](const LabelGroup& left, const LabelGroup& right) {
+		return left.count > right.count;
+	});
+	return result;
+}
+
+
+/*!
+ * \cond INTERNAL
+ */
+
+void DeferredRegistry::add(Node* node, PromiseMetrics::DeferredType type)
+{
+	ThreadList* list = localList();
+	node->createdAt = PromiseLatency::now();
+	node->type = type;
+	node->list = list;
+	list->push(node);
+}
+
+void DeferredRegistry::remove(Node* node)
+{
+	ThreadList* list = node->list;
+	if (!list)
+		return;
+
+	QMutexLocker locker(&list->lock);
+	// The node might still be on the incoming stack
+	list->linkIncoming();
+	node->previous->next = node->next;
+	node->next->previous = node->previous;
+	node->previous = nullptr;
+	node->next = nullptr;
+}
+
+void DeferredRegistry::labelChanged(Node* node, const QString& label)
+{
+	ThreadList* list = node->list;
+	if (!list)
+		return;
+
+	QMutexLocker locker(&list->lock);
+	node->label = label;
+}
+
+/*!
+ * \endcond
+ */
+
+}  // namespace QtPromise
@@ -0,0 +1,155 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_DEFERREDREGISTRY_H_
+#define QTPROMISE_DEFERREDREGISTRY_H_
+
+#include "PromiseMetrics.h"
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QString>
+#include <QVector>
+
+
+namespace QtPromise {
+
+/*! \brief Keeps track of the existing Deferreds to find leaks.
+ *
+ * Deferred::~Deferred() logs a message when a Deferred is destroyed while pending but that
+ * happens after the fact and not at all for Deferreds which are never destroyed. When enabled,
+ * the DeferredRegistry keeps a list of the existing Deferreds together with their creation time,
+ * their type and their label (see Deferred::setLabel()). A snapshot() of the registry shows which
+ * Deferreds are accumulating in a long running process:
+ * - The number of Deferreds grouped by their age.
+ * - The number of Deferreds grouped by their label and type together with the age of the oldest
+ * Deferred of the group.
+ *
+ * Only Deferreds which are created while the registry is enabled are tracked. They stay in the
+ * registry until they are destroyed even if the registry is disabled in the meantime.
+ *
+ * ## Overhead ##
+ * While the registry is disabled, the construction of a Deferred only checks a flag.
+ * The registry is intrusive: the list nodes are part of the Deferreds so registering a
+ * Deferred does not allocate memory. Each thread has its own list and registering a Deferred
+ * does not lock: it pushes the Deferred onto a lock-free stack of the list of the current thread
+ * with a single compare-and-swap. The stack is moved into the list by the next removal or
+ * snapshot(), which lock the list. Deferreds are removed in constant time (plus the moving of
+ * the stack) from the list of the thread which created them.
+ * When a thread finishes, its list including the Deferreds which are still alive is reused by
+ * the next thread.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class DeferredRegistry
+{
+public:
+	/*! The number of Deferreds in an age range.
+	 */
+	struct AgeBucket
+	{
+		/*! The minimum age in milliseconds (inclusive). */
+		qint64 minAge = 0;
+		/*! The maximum age in milliseconds (exclusive) or \c -1 if the range is unbounded. */
+		qint64 maxAge = -1;
+		/*! The number of Deferreds in the age range. */
+		int count = 0;
+		/*! The number of pending Deferreds in the age range. */
+		int pendingCount = 0;
+	};
+
+	/*! The number of Deferreds with the same label and type.
+	 */
+	struct LabelGroup
+	{
+		/*! The label of the Deferreds. Empty for Deferreds without label. */
+		QString label;
+		/*! The type of the Deferreds. */
+		PromiseMetrics::DeferredType type = PromiseMetrics::BaseDeferredType;
+		/*! The number of Deferreds. */
+		int count = 0;
+		/*! The number of pending Deferreds. */
+		int pendingCount = 0;
+		/*! The age of the oldest Deferred in milliseconds. */
+		qint64 maxAge = 0;
+	};
+
+	/*! The state of the registry at a point in time.
+	 */
+	struct Snapshot
+	{
+		/*! The number of registered Deferreds. */
+		int count = 0;
+		/*! The number of registered Deferreds which are pending. */
+		int pendingCount = 0;
+		/*! The Deferreds grouped by their age in ascending order of the age. */
+		QVector<AgeBucket> ageBuckets;
+		/*! The Deferreds grouped by their label and type in descending order of the count. */
+		QVector<LabelGroup> labelGroups;
+
+		/*! \return A human readable description of the snapshot. */
+		QString toString() const;
+	};
+
+	/*! Enables or disables the registration of new Deferreds.
+	 *
+	 * \param enabled If \c true, Deferreds created from now on are registered.
+	 */
+	static void setEnabled(bool enabled);
+	/*! \return \c true if new Deferreds are registered. */
+	static bool isEnabled() { return s_enabled.load() != 0; }
+
+	/*! \return The default upper bounds of the age buckets in milliseconds:
+	 * 1 second, 10 seconds, 1 minute, 10 minutes and 1 hour.
+	 */
+	static QVector<qint64> defaultAgeBounds();
+	/*! Collects the current state of the registry.
+	 *
+	 * \param ageBounds The ascending upper bounds of the age buckets in milliseconds.
+	 * An additional unbounded bucket is appended.
+	 * \return A snapshot of the registry.
+	 */
+	static Snapshot snapshot(const QVector<qint64>& ageBounds = defaultAgeBounds());
+
+	/*! \cond INTERNAL */
+
+	struct ThreadList;
+
+	/*! The list node embedded in each Deferred.
+	 *
+	 * The node is only linked while \c list is not \c nullptr. \c list never changes
+	 * once the node is linked. The other members are protected by the lock of the list
+	 * once the node has been moved from the incoming stack into the list.
+	 */
+	struct Node
+	{
+		ThreadList* list = nullptr;
+		Node* previous = nullptr;
+		Node* next = nullptr;
+		qint64 createdAt = 0;
+		PromiseMetrics::DeferredType type = PromiseMetrics::BaseDeferredType;
+		QString label;
+		QAtomicInt settled;
+	};
+
+	static void add(Node* node, PromiseMetrics::DeferredType type);
+	static void remove(Node* node);
+	static void labelChanged(Node* node, const QString& label);
+	static void settled(Node* node) { if (node->list) node->settled.store(1); }
+
+	/*! \endcond */
+
+private:
+	DeferredRegistry() = delete;
+
+	static QBasicAtomicInt s_enabled;
+};
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_DEFERREDREGISTRY_H_ */
@@ -15,28 +15,66 @@ namespace QtPromise {
 template<typename ValueType, typename Signal>
 void Deferred::resolveAndEmit(const ValueType& value, Signal&& signal)
 {
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 	m_isInSignalHandler.fetchAndAddAcquire(1);
+#endif
 	if (this->resolve(QVariant::fromValue(value)))
 		QMetaMethod::fromSignal(std::forward<Signal>(signal)).invoke(this, Q_ARG(ValueType, value));
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 	m_isInSignalHandler.fetchAndSubRelease(1);
+#endif
 }
 
 template<typename ReasonType, typename Signal>
 void Deferred::rejectAndEmit(const ReasonType& reason, Signal&& signal)
 {
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 	m_isInSignalHandler.fetchAndAddAcquire(1);
+#endif
 	if (this->reject(QVariant::fromValue(reason)))
 		QMetaMethod::fromSignal(std::forward<Signal>(signal)).invoke(this, Q_ARG(ReasonType, reason));
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 	m_isInSignalHandler.fetchAndSubRelease(1);
+#endif
+}
+
+template<typename ValueType, typename Signal>
+void Deferred::resolveAndEmit(const QVariant& data, const ValueType& signalValue, Signal&& signal)
+{
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
+	m_isInSignalHandler.fetchAndAddAcquire(1);
+#endif
+	if (this->resolve(data))
+		QMetaMethod::fromSignal(std::forward<Signal>(signal)).invoke(this, Q_ARG(ValueType, signalValue));
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
+	m_isInSignalHandler.fetchAndSubRelease(1);
+#endif
+}
+
+template<typename ReasonType, typename Signal>
+void Deferred::rejectAndEmit(const QVariant& data, const ReasonType& signalValue, Signal&& signal)
+{
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
+	m_isInSignalHandler.fetchAndAddAcquire(1);
+#endif
+	if (this->reject(data))
+		QMetaMethod::fromSignal(std::forward<Signal>(signal)).invoke(this, Q_ARG(ReasonType, signalValue));
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
+	m_isInSignalHandler.fetchAndSubRelease(1);
+#endif
 }
 
 template<typename ProgressType, typename Signal>
 void Deferred::notifyAndEmit(const ProgressType& progress, Signal&& signal)
 {
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 	m_isInSignalHandler.fetchAndAddAcquire(1);
+#endif
 	if (this->notify(QVariant::fromValue(progress)))
 		QMetaMethod::fromSignal(std::forward<Signal>(signal)).invoke(this, Q_ARG(ProgressType, progress));
+#ifndef QTPROMISE_NO_SIGNAL_HANDLER_CHECKS
 	m_isInSignalHandler.fetchAndSubRelease(1);
+#endif
 }
 
 }  // namespace QtPromise
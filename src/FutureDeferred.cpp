@@ -1,5 +1,9 @@
 #include "FutureDeferred.h"
 
+#include "Scheduler.h"
+
+#include <QMetaMethod>
+
 #ifndef QT_NO_QFUTURE
 
 namespace QtPromise
@@ -12,32 +16,107 @@ FutureDeferred::~FutureDeferred()
 
 void FutureDeferred::registerMetaTypes()
 {
-	static QMutex metaTypesLock;
-	static bool registered = false;
-
-	QMutexLocker locker(&metaTypesLock);
-	if (!registered)
-	{
+	// Thread safe one-time initialization without taking a lock on subsequent calls
+	static const bool registered = []() {
 		qRegisterMetaType<Progress>();
 		QMetaType::registerEqualsComparator<Progress>();
 		qRegisterMetaType<Progress>("FutureDeferred::Progress");
 		qRegisterMetaType<Progress>("QtPromise::FutureDeferred::Progress");
-		registered = true;
-	}
+		qRegisterMetaType<ResultBatch>();
+		qRegisterMetaType<ResultBatch>("FutureDeferred::ResultBatch");
+		qRegisterMetaType<ResultBatch>("QtPromise::FutureDeferred::ResultBatch");
+		return true;
+	}();
+	Q_UNUSED(registered)
 }
 
-void FutureDeferred::futureFinished(const QVariantList& results)
+QVariantList FutureDeferred::results() const
 {
+	if (m_options.testFlag(OmitFinalResults))
+		return QVariantList();
 	QMutexLocker locker(&m_lock);
-	m_results = results;
-	this->resolveAndEmit(m_results, &FutureDeferred::resolved);
+	if (!m_resultsMaterialized && m_options.testFlag(LazyResults) && this->state() != Pending)
+		return materializeResults();
+	return m_results;
 }
 
-void FutureDeferred::futureCanceled(const QVariantList& results)
+QVariantList FutureDeferred::materializeResults() const
 {
+	// Must be called with m_lock locked
+	if (!m_resultsMaterialized)
+	{
+		m_results = m_future->results(0, m_future->resultCount());
+		m_resultsMaterialized = true;
+	}
+	return m_results;
+}
+
+QVariantList FutureDeferred::finalResults(const QMetaMethod& signal) const
+{
+	if (m_options.testFlag(OmitFinalResults))
+		return QVariantList();
+	if (m_options.testFlag(LazyResults) && !this->isSignalConnected(signal))
+		return QVariantList();
 	QMutexLocker locker(&m_lock);
-	m_results = results;
-	this->rejectAndEmit(m_results, &FutureDeferred::rejected);
+	return materializeResults();
+}
+
+void FutureDeferred::futureFinished()
+{
+	if (m_options.testFlag(StreamResults))
+		deliverResultBatch();
+
+	/* The lock is released before resolving to allow calling results()
+	 * from slots connected to the signals.
+	 */
+	const QVariantList results = finalResults(QMetaMethod::fromSignal(&FutureDeferred::resolved));
+	if (m_options & (LazyResults | OmitFinalResults))
+		this->resolveAndEmit(QVariant(m_future->resultCount()), results, &FutureDeferred::resolved);
+	else
+		this->resolveAndEmit(results, &FutureDeferred::resolved);
+}
+
+void FutureDeferred::futureCanceled()
+{
+	if (m_options.testFlag(StreamResults))
+		deliverResultBatch();
+
+	const QVariantList results = finalResults(QMetaMethod::fromSignal(&FutureDeferred::rejected));
+	if (m_options & (LazyResults | OmitFinalResults))
+		this->rejectAndEmit(QVariant(m_future->resultCount()), results, &FutureDeferred::rejected);
+	else
+		this->rejectAndEmit(results, &FutureDeferred::rejected);
+}
+
+void FutureDeferred::futureResultsReady()
+{
+	// Coalesce the results which become ready until the batch is delivered
+	if (m_batchScheduled)
+		return;
+	m_batchScheduled = true;
+	Scheduler::instance()->schedule(m_batchInterval.load(), this, [this]() {
+		this->deliverResultBatch();
+	});
+}
+
+void FutureDeferred::deliverResultBatch()
+{
+	m_batchScheduled = false;
+	if (this->state() != Pending)
+		return;
+
+	/* Only the continuous results are delivered to keep the batches in order.
+	 * Results which are ready out of order are delivered with a later batch.
+	 */
+	ResultBatch batch;
+	batch.beginIndex = m_streamedResultCount;
+	batch.endIndex = m_future->resultCount();
+	if (batch.endIndex <= batch.beginIndex)
+		return;
+	m_streamedResultCount = batch.endIndex;
+	if (!m_options.testFlag(LazyResults))
+		batch.results = m_future->results(batch.beginIndex, batch.endIndex);
+	this->notifyAndEmit(batch, &FutureDeferred::resultsReady);
 }
 
 void FutureDeferred::futureProgressRangeChanged(int min, int max)
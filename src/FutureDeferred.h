@@ -14,6 +14,8 @@
 #include <QAtomicInt>
 #include "Deferred.h"
 
+#include <memory>
+
 namespace QtPromise
 {
 
@@ -40,6 +42,42 @@ namespace QtPromise
  * resolved/rejected/notified independently of the QFuture, which should be
  * a very rare use case.
  *
+ * \par Lazy Results
+ * Converting the results into a QVariantList boxes every result into a QVariant. For
+ * QFutures with many results, this doubles the memory and takes considerable time.
+ * When the FutureDeferred is created with the option LazyResults, the results are not converted
+ * when the QFuture finishes. Instead, the data of the Deferred is the number of results and the
+ * results are accessed using future() without copying them:
+ * \code
+ * FuturePromise::Ptr promise = FuturePromise::create(QtConcurrent::mapped(input, func),
+ *                                                    FutureDeferred::LazyResults);
+ * promise->then([promise](const QVariant&) {
+ *     const QFuture<int> future = promise->future<int>();
+ *     for (int i = 0; i < future.resultCount(); ++i)
+ *         process(future.resultAt(i));
+ * });
+ * \endcode
+ * The QVariantList is only created when results() is called or when something is connected to the
+ * resolved(const QVariantList&) or rejected(const QVariantList&) signals.
+ *
+ * \par Streaming Results
+ * With the option StreamResults, the FutureDeferred delivers the results while the QFuture is still
+ * running. The results which became ready are coalesced into a ResultBatch which is emitted with the
+ * resultsReady() signal and passed to the notify callbacks of the promises. The batches are in order
+ * and contain every result exactly once. All batches are delivered before the FutureDeferred is
+ * resolved or rejected. Combined with OmitFinalResults, the results are not passed again on
+ * resolution:
+ * \code
+ * FuturePromise::Ptr promise = FuturePromise::create(QtConcurrent::mapped(input, func),
+ *     FutureDeferred::StreamResults | FutureDeferred::OmitFinalResults);
+ * promise->then([](const QVariant& resultCount) {
+ *     finish(resultCount.toInt());
+ * }, nullptr, [](const QVariant& data) {
+ *     if (data.canConvert<FutureDeferred::ResultBatch>())
+ *         forward(data.value<FutureDeferred::ResultBatch>().results);
+ * });
+ * \endcode
+ *
  * \threadsafeClass
  * \author jochen.ulrich
  * \since 1.1.0
@@ -61,14 +99,35 @@ public:
 	 */
 	virtual ~FutureDeferred();
 
+	/*! Options controlling how the results of the QFuture are provided.
+	 *
+	 * \since 2.2.0
+	 */
+	enum Option
+	{
+		NoOptions = 0,             //!< The results are converted into a QVariantList when the QFuture finishes.
+		LazyResults = 1 << 0,      /*!< The results are only converted into a QVariantList when needed.
+		                            * The FutureDeferred is resolved or rejected with the number of results.
+		                            * The results of a ResultBatch are not converted either.
+		                            */
+		StreamResults = 1 << 1,    //!< The results are delivered in batches as they become ready. See resultsReady().
+		OmitFinalResults = 1 << 2  /*!< The FutureDeferred is resolved or rejected with the number of results
+		                            * and the results are neither converted nor provided by results() or
+		                            * the specialized signals. Typically combined with StreamResults.
+		                            */
+	};
+	/*! Combination of Option values. */
+	Q_DECLARE_FLAGS(Options, Option)
+
 	/*! Creates a FutureDeferred for a QFuture.
 	 *
 	 * \tparam T The result type of the \p future.
 	 * \param future The QFuture representing the asynchronous operation.
+	 * \param options Options controlling how the results are provided. Since 2.2.0.
 	 * \return QSharedPointer to a new, pending FutureDeferred.
 	 */
 	template<typename T>
-	static Ptr create(const QFuture<T>& future);
+	static Ptr create(const QFuture<T>& future, Options options = NoOptions);
 
 	/*! Represents the progress of a download or upload.
 	 *
@@ -99,6 +158,40 @@ public:
 		}
 	};
 
+	/*! A batch of results which became ready while the QFuture is running.
+	 *
+	 * \note This type is registered in Qt's meta type system using
+	 * Q_DECLARE_METATYPE() and using qRegisterMetaType() in FutureDeferred().
+	 *
+	 * \since 2.2.0
+	 * \sa StreamResults
+	 */
+	struct ResultBatch
+	{
+		/*! Index of the first result of the batch in the QFuture. */
+		int beginIndex = 0;
+		/*! Index after the last result of the batch in the QFuture. */
+		int endIndex = 0;
+		/*! The results with the indexes from \p beginIndex to \p endIndex - 1.
+		 * Empty when the option LazyResults is set. Then, the results are accessed using future().
+		 */
+		QVariantList results;
+
+		/*! \return The number of results in the batch. */
+		int size() const { return endIndex - beginIndex; }
+	};
+
+	/*! Sets the minimum interval between two result batches.
+	 *
+	 * By default, the results which became ready during one event loop iteration are coalesced
+	 * into one batch. A larger interval creates fewer but larger batches.
+	 *
+	 * \param intervalInMillisec The minimum interval in milliseconds.
+	 * \since 2.2.0
+	 * \sa StreamResults
+	 */
+	void setResultBatchInterval(int intervalInMillisec) { m_batchInterval.store(qMax(0, intervalInMillisec)); }
+
 	/*! \return The list of results in case this NetworkDeferred is resolved.
 	 * If this NetworkDeferred is rejected, returns the results that have been produced
 	 * up to the time when the QFuture was cancelled.
@@ -106,7 +199,25 @@ public:
 	 *
 	 * \sa rejected()
 	 */
-	QVariantList results() const { QMutexLocker locker(&m_lock); return m_results; }
+	QVariantList results() const;
+
+	/*! \return The options of this FutureDeferred.
+	 *
+	 * \since 2.2.0
+	 */
+	Options options() const { return m_options; }
+
+	/*! Provides typed access to the results without converting them.
+	 *
+	 * \tparam T The result type of the QFuture this FutureDeferred was created for.
+	 * \return The QFuture this FutureDeferred was created for. If \p T does not match the
+	 * result type of the QFuture, returns a default constructed QFuture<T> which is canceled and
+	 * has no results.
+	 *
+	 * \since 2.2.0
+	 */
+	template<typename T>
+	QFuture<T> future() const;
 
 Q_SIGNALS:
 	/*! Emitted when the QFuture finishes successfully.
@@ -135,6 +246,14 @@ Q_SIGNALS:
 	 * \param progress A FutureDeferred::Progress object.
 	 */
 	void notified(const QtPromise::FutureDeferred::Progress& progress) const;
+	/*! Emitted when results of the QFuture became ready and the option StreamResults is set.
+	 *
+	 * The batch is also passed to the notify callbacks of the promises.
+	 *
+	 * \param batch The results which became ready since the previous batch.
+	 * \since 2.2.0
+	 */
+	void resultsReady(const QtPromise::FutureDeferred::ResultBatch& batch) const;
 
 protected:
 	/*! Creates a FutureDeferred for a given QFuture.
@@ -143,22 +262,53 @@ protected:
 	 * \param future The QFuture which is represented by the created FutureDeferred.
 	 */
 	template<typename T>
-	FutureDeferred(const QFuture<T>& future);
+	FutureDeferred(const QFuture<T>& future, Options options = NoOptions);
 
 private Q_SLOTS:
-	void futureFinished(const QVariantList& results);
-	void futureCanceled(const QVariantList& results);
+	void futureFinished();
+	void futureCanceled();
 	void futureProgressRangeChanged(int min, int max);
 	void futureProgressTextChanged(const QString& text);
 	void futureProgressValueChanged(int value);
+	void futureResultsReady();
 
 private:
+	/*! Type erasure for the QFuture. */
+	class FutureHolder
+	{
+	public:
+		virtual ~FutureHolder() = default;
+		virtual int resultCount() const = 0;
+		virtual QVariantList results(int beginIndex, int endIndex) const = 0;
+	};
+
 	template<typename T>
-	static QVariantList resultsFromFuture(const QFuture<T>& future);
+	class TypedFutureHolder : public FutureHolder
+	{
+	public:
+		explicit TypedFutureHolder(const QFuture<T>& future) : future(future) {}
+		int resultCount() const override { return future.resultCount(); }
+		QVariantList results(int beginIndex, int endIndex) const override { return resultsFromFuture(future, beginIndex, endIndex); }
 
+		const QFuture<T> future;
+	};
+
+	template<typename T>
+	static QVariantList resultsFromFuture(const QFuture<T>& future, int beginIndex, int endIndex);
+
+	QVariantList materializeResults() const;
+	QVariantList finalResults(const QMetaMethod& signal) const;
+	void deliverResultBatch();
+
+	const std::unique_ptr<FutureHolder> m_future;
+	const Options m_options;
 	mutable QMutex m_lock;
-	QVariantList m_results;
+	mutable QVariantList m_results;
+	mutable bool m_resultsMaterialized = false;
 	Progress m_progress;
+	int m_streamedResultCount = 0;
+	bool m_batchScheduled = false;
+	QAtomicInt m_batchInterval;
 
 	static void registerMetaTypes();
 };
@@ -167,20 +317,27 @@ private:
 
 //####### Template Method Implementation #######
 template<typename T>
-FutureDeferred::FutureDeferred(const QFuture<T>& future)
+FutureDeferred::FutureDeferred(const QFuture<T>& future, Options options)
+	: Deferred(PromiseMetrics::FutureDeferredType)
+	, m_future(new TypedFutureHolder<T>(future))
+	, m_options(options)
 {
 	registerMetaTypes();
 
 	if (future.isCanceled())
 	{
-		QTimer::singleShot(0, this, [this, future] {
-			this->futureCanceled(resultsFromFuture(future));
+		PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::AsyncAction);
+		QTimer::singleShot(0, this, [this, action]() mutable {
+			action.release();
+			this->futureCanceled();
 		});
 	}
 	else if (future.isFinished())
 	{
-		QTimer::singleShot(0, this, [this, future] {
-			this->futureFinished(resultsFromFuture(future));
+		PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::AsyncAction);
+		QTimer::singleShot(0, this, [this, action]() mutable {
+			action.release();
+			this->futureFinished();
 		});
 	}
 	else
@@ -189,10 +346,10 @@ FutureDeferred::FutureDeferred(const QFuture<T>& future)
 
 		connect(futureWatcher, &QFutureWatcher<T>::finished, [this, future] {
 			if (!future.isCanceled())
-				this->futureFinished(resultsFromFuture(future));
+				this->futureFinished();
 		});
-		connect(futureWatcher, &QFutureWatcher<T>::canceled, [this, future] {
-			this->futureCanceled(resultsFromFuture(future));
+		connect(futureWatcher, &QFutureWatcher<T>::canceled, [this] {
+			this->futureCanceled();
 		});
 		connect(futureWatcher, &QFutureWatcher<T>::progressRangeChanged,
 		        this, &FutureDeferred::futureProgressRangeChanged);
@@ -200,6 +357,11 @@ FutureDeferred::FutureDeferred(const QFuture<T>& future)
 		        this, &FutureDeferred::futureProgressTextChanged);
 		connect(futureWatcher, &QFutureWatcher<T>::progressValueChanged,
 		        this, &FutureDeferred::futureProgressValueChanged);
+		if (m_options.testFlag(StreamResults))
+		{
+			connect(futureWatcher, &QFutureWatcher<T>::resultsReadyAt,
+			        this, &FutureDeferred::futureResultsReady);
+		}
 
 		futureWatcher->setFuture(future);
 	}
@@ -207,21 +369,28 @@ FutureDeferred::FutureDeferred(const QFuture<T>& future)
 }
 
 template<typename T>
-FutureDeferred::Ptr FutureDeferred::create(const QFuture<T>& future)
+FutureDeferred::Ptr FutureDeferred::create(const QFuture<T>& future, Options options)
+{
+	return Ptr(new FutureDeferred(future, options));
+}
+
+template<typename T>
+QFuture<T> FutureDeferred::future() const
 {
-	return Ptr(new FutureDeferred(future));
+	const TypedFutureHolder<T>* holder = dynamic_cast<const TypedFutureHolder<T>*>(m_future.get());
+	return holder ? holder->future : QFuture<T>();
 }
 
 template<typename T>
-QVariantList FutureDeferred::resultsFromFuture(const QFuture<T>& future)
+QVariantList FutureDeferred::resultsFromFuture(const QFuture<T>& future, int beginIndex, int endIndex)
 {
 	/* future.results() does *NOT* return the achieved results
 	 * after the future has been cancelled.
 	 * So we get the results "manually" .
 	 */
 	QVariantList results;
-	const int resultCount = future.resultCount();
-	for (int i=0; i < resultCount; ++i)
+	results.reserve(qMax(0, endIndex - beginIndex));
+	for (int i=beginIndex; i < endIndex; ++i)
 		results << future.resultAt(i);
 	return results;
 }
@@ -229,6 +398,8 @@ QVariantList FutureDeferred::resultsFromFuture(const QFuture<T>& future)
 } /* namespace QtPromise */
 
 Q_DECLARE_METATYPE(QtPromise::FutureDeferred::Progress)
+Q_DECLARE_METATYPE(QtPromise::FutureDeferred::ResultBatch)
+Q_DECLARE_OPERATORS_FOR_FLAGS(QtPromise::FutureDeferred::Options)
 
 
 #endif /* QT_NO_QTFUTURE */
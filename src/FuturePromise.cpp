@@ -1,5 +1,7 @@
 #include "FuturePromise.h"
 
+#include <QMetaMethod>
+
 namespace QtPromise
 {
 
@@ -21,9 +23,27 @@ FuturePromise::FuturePromise(FutureDeferred::Ptr deferred)
 		break;
 	case Deferred::Pending:
 	default:
-		connect(deferred.data(), &FutureDeferred::resolved, this, &FuturePromise::resolved);
-		connect(deferred.data(), &FutureDeferred::rejected, this, &FuturePromise::rejected);
+		if (deferred->options().testFlag(FutureDeferred::LazyResults))
+		{
+			/* Connecting to the signals of the deferred would make it convert the results.
+			 * So we only convert them when something is connected to our signals.
+			 */
+			connect(this, &Promise::resolved, [this, deferred]() {
+				if (this->isSignalConnected(QMetaMethod::fromSignal(&FuturePromise::resolved)))
+					Q_EMIT this->resolved(deferred->results());
+			});
+			connect(this, &Promise::rejected, [this, deferred]() {
+				if (this->isSignalConnected(QMetaMethod::fromSignal(&FuturePromise::rejected)))
+					Q_EMIT this->rejected(deferred->results());
+			});
+		}
+		else
+		{
+			connect(deferred.data(), &FutureDeferred::resolved, this, &FuturePromise::resolved);
+			connect(deferred.data(), &FutureDeferred::rejected, this, &FuturePromise::rejected);
+		}
 		connect(deferred.data(), &FutureDeferred::notified, this, &FuturePromise::notified);
+		connect(deferred.data(), &FutureDeferred::resultsReady, this, &FuturePromise::resultsReady);
 		break;
 	}
 }
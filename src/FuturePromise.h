@@ -29,11 +29,14 @@ public:
 	/*! Creates a FuturePromise for a QFuture.
 	 *
 	 * \param future The QFuture representing the asynchronous operation.
+	 * \param options Options controlling how the results are provided. Since 2.2.0.
 	 * \return A FuturePromise to a new, pending FutureDeferred for the given
 	 * \p future.
+	 *
+	 * \sa FutureDeferred::Option
 	 */
 	template<typename T>
-	static Ptr create(QFuture<T> future);
+	static Ptr create(QFuture<T> future, FutureDeferred::Options options = FutureDeferred::NoOptions);
 	/*! Creates a FuturePromise for a FutureDeferred.
 	 *
 	 * \param deferred The FutureDeferred which should be represented by a FuturePromise.
@@ -52,6 +55,12 @@ public:
 	 */
 	QVariantList results() const;
 
+	/*! \copydoc FutureDeferred::future()
+	 * \sa FutureDeferred::future()
+	 */
+	template<typename T>
+	QFuture<T> future() const;
+
 Q_SIGNALS:
 	/*! \copydoc FutureDeferred::resolved()
 	 * \sa FutureDeferred::resolved()
@@ -65,6 +74,10 @@ Q_SIGNALS:
 	 * \sa FutureDeferred::notified()
 	 */
 	void notified(const QtPromise::FutureDeferred::Progress& progress) const;
+	/*! \copydoc FutureDeferred::resultsReady()
+	 * \sa FutureDeferred::resultsReady()
+	 */
+	void resultsReady(const QtPromise::FutureDeferred::ResultBatch& batch) const;
 
 protected:
 	/*! Creates a FutureDeferred for a QFuture and then creates
@@ -75,7 +88,7 @@ protected:
 	 * \sa NetworkDeferred(QNetworkReply*)
 	 */
 	template<typename T>
-	FuturePromise(QFuture<T> future);
+	FuturePromise(QFuture<T> future, FutureDeferred::Options options);
 	/*! Creates a FuturePromise for a FutureDeferred.
 	 *
 	 * \param deferred The FutureDeferred which should be represented by a FuturePromise.
@@ -86,15 +99,21 @@ protected:
 
 //####### Template Method Implementation #######
 template<typename T>
-FuturePromise::FuturePromise(QFuture<T> future)
-	: FuturePromise(FutureDeferred::create(future))
+FuturePromise::FuturePromise(QFuture<T> future, FutureDeferred::Options options)
+	: FuturePromise(FutureDeferred::create(future, options))
+{
+}
+
+template<typename T>
+FuturePromise::Ptr FuturePromise::create(QFuture<T> future, FutureDeferred::Options options)
 {
+	return Ptr(new FuturePromise(future, options));
 }
 
 template<typename T>
-FuturePromise::Ptr FuturePromise::create(QFuture<T> future)
+QFuture<T> FuturePromise::future() const
 {
-	return Ptr(new FuturePromise(future));
+	return m_deferred.staticCast<FutureDeferred>()->future<T>();
 }
 
 
@@ -1,10 +1,11 @@
 #include "NetworkDeferred.h"
+#include "PromiseLogging.h"
 #include <QTimer>
 
 namespace QtPromise {
 
 NetworkDeferred::NetworkDeferred(QNetworkReply* reply)
-	: Deferred(), m_reply(reply), m_lock(QMutex::Recursive)
+	: Deferred(PromiseMetrics::NetworkDeferredType), m_reply(reply), m_lock(QMutex::Recursive)
 {
 	registerMetaTypes();
 
@@ -17,7 +18,13 @@ NetworkDeferred::NetworkDeferred(QNetworkReply* reply)
 	 * will be resolved/rejected when control returns to the event loop.
 	 */
 	if (reply->isFinished())
-		QTimer::singleShot(0, this, &NetworkDeferred::replyFinished);
+	{
+		PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::AsyncAction);
+		QTimer::singleShot(0, this, [this, action]() mutable {
+			action.release();
+			this->replyFinished();
+		});
+	}
 	else
 		connect(m_reply, &QNetworkReply::finished, this, &NetworkDeferred::replyFinished);
 
@@ -47,12 +54,8 @@ NetworkDeferred::Ptr NetworkDeferred::create(QNetworkReply* reply)
 
 void NetworkDeferred::registerMetaTypes()
 {
-	static QMutex metaTypesLock;
-	static bool registered = false;
-
-	QMutexLocker locker(&metaTypesLock);
-	if (!registered)
-	{
+	// Thread safe one-time initialization without taking a lock on subsequent calls
+	static const bool registered = []() {
 		qRegisterMetaType<ReplyData>();
 		QMetaType::registerEqualsComparator<ReplyData>();
 		qRegisterMetaType<ReplyData>("NetworkDeferred::ReplyData");
@@ -69,8 +72,9 @@ void NetworkDeferred::registerMetaTypes()
 		QMetaType::registerEqualsComparator<ReplyProgress>();
 		qRegisterMetaType<ReplyProgress>("NetworkDeferred::ReplyProgress");
 		qRegisterMetaType<ReplyProgress>("QtPromise::NetworkDeferred::ReplyProgress");
-		registered = true;
-	}
+		return true;
+	}();
+	Q_UNUSED(registered)
 }
 
 void NetworkDeferred::replyFinished()
@@ -136,7 +140,7 @@ void NetworkDeferred::replyDestroyed(QObject* reply)
 		QString errorMessage = QString("QNetworkReply %1 destroyed while owning NetworkDeferred %2 still pending")
 		.arg(pointerToQString(reply))
 		.arg(pointerToQString(this));
-		qDebug("%s", qUtf8Printable(errorMessage));
+		qCDebug(lcNetwork, "%s", qUtf8Printable(errorMessage));
 
 		m_error.code = static_cast<QNetworkReply::NetworkError>(-1);
 		m_error.message = errorMessage;
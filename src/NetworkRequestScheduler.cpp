@@ -0,0 +1,312 @@
+#include "NetworkRequestScheduler.h"
+#include "PromiseLogging.h"
+
+#include <QBuffer>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace QtPromise {
+
+NetworkRequestScheduler::NetworkRequestScheduler(QNetworkAccessManager* qnam, QObject* parent)
+	: QObject(parent)
+	, m_qnam(qnam)
+	, m_scheduler(Scheduler::instance())
+	, m_perHostLimit(DefaultPerHostLimit)
+	, m_globalLimit(DefaultGlobalLimit)
+	, m_lastId(0)
+	, m_lastSequence(0)
+	, m_serveCounter(0)
+	, m_dispatching(false)
+{
+	// Thread safe one-time initialization without taking a lock on subsequent calls
+	static const bool registered = []() {
+		qRegisterMetaType<Timing>();
+		qRegisterMetaType<Timing>("QtPromise::NetworkRequestScheduler::Timing");
+		qRegisterMetaType<RequestId>("QtPromise::NetworkRequestScheduler::RequestId");
+		return true;
+	}();
+	Q_UNUSED(registered)
+}
+
+NetworkRequestScheduler::~NetworkRequestScheduler()
+{
+	const QList<RequestId> queued = m_queued.keys();
+	for (RequestId id : queued)
+		cancel(id);
+
+	const QList<RunningRequest> running = m_running.values();
+	for (const RunningRequest& request : running)
+	{
+		if (request.reply)
+			request.reply->abort();
+	}
+}
+
+NetworkRequestScheduler::ScheduledRequest NetworkRequestScheduler::get(const QNetworkRequest& request, int priority)
+{
+	return send(request, "GET", QByteArray(), priority);
+}
+
+NetworkRequestScheduler::ScheduledRequest NetworkRequestScheduler::post(const QNetworkRequest& request, const QByteArray& data,
+                                                                        int priority)
+{
+	return send(request, "POST", data, priority);
+}
+
+NetworkRequestScheduler::ScheduledRequest NetworkRequestScheduler::put(const QNetworkRequest& request, const QByteArray& data,
+                                                                       int priority)
+{
+	return send(request, "PUT", data, priority);
+}
+
+NetworkRequestScheduler::ScheduledRequest NetworkRequestScheduler::deleteResource(const QNetworkRequest& request, int priority)
+{
+	return send(request, "DELETE", QByteArray(), priority);
+}
+
+NetworkRequestScheduler::ScheduledRequest NetworkRequestScheduler::send(const QNetworkRequest& request, const QByteArray& verb,
+                                                                        const QByteArray& data, int priority)
+{
+	QueuedRequest queuedRequest;
+	queuedRequest.request = request;
+	queuedRequest.verb = verb;
+	queuedRequest.data = data;
+	queuedRequest.priority = priority;
+	queuedRequest.sequence = ++m_lastSequence;
+	queuedRequest.host = hostKey(request.url());
+	queuedRequest.deferred = Deferred::create();
+	queuedRequest.queuedAt = m_scheduler->now();
+
+	ScheduledRequest result;
+	result.id = ++m_lastId;
+	result.promise = Promise::create(queuedRequest.deferred);
+
+	m_queued.insert(result.id, queuedRequest);
+	enqueue(result.id);
+	dispatch();
+	return result;
+}
+
+bool NetworkRequestScheduler::setPriority(RequestId id, int priority)
+{
+	auto iter = m_queued.find(id);
+	if (iter == m_queued.end())
+		return false;
+	if (iter->priority == priority)
+		return true;
+
+	dequeue(id);
+	iter->priority = priority;
+	enqueue(id);
+	dispatch();
+	return true;
+}
+
+bool NetworkRequestScheduler::cancel(RequestId id)
+{
+	if (!m_queued.contains(id))
+		return false;
+
+	dequeue(id);
+	const QueuedRequest request = m_queued.take(id);
+
+	Timing timing;
+	timing.queueTime = m_scheduler->now() - request.queuedAt;
+
+	NetworkDeferred::Error error;
+	error.code = QNetworkReply::OperationCanceledError;
+	error.message = QStringLiteral("Request cancelled before it was started");
+	qCDebug(lcNetwork, "Cancelled queued request %llu to %s", id, qUtf8Printable(request.request.url().toDisplayString()));
+	request.deferred->reject(QVariant::fromValue(error));
+	Q_EMIT requestFinished(id, timing);
+	return true;
+}
+
+void NetworkRequestScheduler::setPerHostLimit(int limit)
+{
+	m_perHostLimit = qMax(1, limit);
+	dispatch();
+}
+
+void NetworkRequestScheduler::setGlobalLimit(int limit)
+{
+	m_globalLimit = qMax(1, limit);
+	dispatch();
+}
+
+QString NetworkRequestScheduler::hostKey(const QUrl& url)
+{
+	return url.scheme() + QStringLiteral("://") + url.host() + QLatin1Char(':') + QString::number(url.port());
+}
+
+void NetworkRequestScheduler::enqueue(RequestId id)
+{
+	const QueuedRequest& request = m_queued[id];
+	QList<RequestId>& queue = m_hosts[request.host].queue;
+	auto position = std::upper_bound(queue.begin(), queue.end(), id, [this, &request](RequestId, RequestId other) {
+		const QueuedRequest& otherRequest = m_queued[other];
+		if (request.priority != otherRequest.priority)
+			return request.priority > otherRequest.priority;
+		return request.sequence < otherRequest.sequence;
+	});
+	queue.insert(position, id);
+}
+
+void NetworkRequestScheduler::dequeue(RequestId id)
+{
+	const QString host = m_queued[id].host;
+	auto hostIter = m_hosts.find(host);
+	if (hostIter == m_hosts.end())
+		return;
+	hostIter->queue.removeOne(id);
+	if (hostIter->queue.isEmpty() && hostIter->running == 0)
+		m_hosts.erase(hostIter);
+}
+
+void NetworkRequestScheduler::dispatch()
+{
+	// Requests scheduled from the signals emitted while dispatching are picked up by the running loop
+	if (m_dispatching)
+		return;
+	m_dispatching = true;
+
+	while (m_running.size() < m_globalLimit)
+	{
+		/* Take the first request of the host with the highest priority. Among hosts with the same
+		 * priority, the host which was served longest ago is chosen.
+		 */
+		RequestId next = 0;
+		int nextPriority = 0;
+		quint64 nextLastServed = 0;
+		for (auto hostIter = m_hosts.cbegin(); hostIter != m_hosts.cend(); ++hostIter)
+		{
+			const Host& host = hostIter.value();
+			if (host.queue.isEmpty() || host.running >= m_perHostLimit)
+				continue;
+			const RequestId candidate = host.queue.first();
+			const int priority = m_queued[candidate].priority;
+			if (next == 0 || priority > nextPriority || (priority == nextPriority && host.lastServed < nextLastServed))
+			{
+				next = candidate;
+				nextPriority = priority;
+				nextLastServed = host.lastServed;
+			}
+		}
+		if (next == 0)
+			break;
+		start(next);
+	}
+
+	m_dispatching = false;
+}
+
+void NetworkRequestScheduler::start(RequestId id)
+{
+	const QueuedRequest queuedRequest = m_queued.take(id);
+	Host& host = m_hosts[queuedRequest.host];
+	host.queue.removeOne(id);
+	host.running += 1;
+	host.lastServed = ++m_serveCounter;
+
+	RunningRequest& running = m_running[id];
+	running.host = queuedRequest.host;
+	running.deferred = queuedRequest.deferred;
+	running.startedAt = m_scheduler->now();
+	running.queueTime = running.startedAt - queuedRequest.queuedAt;
+
+	QNetworkReply* reply = sendRequest(queuedRequest);
+	if (!reply)
+	{
+		NetworkDeferred::Error error;
+		error.code = QNetworkReply::UnknownNetworkError;
+		error.message = QStringLiteral("QNetworkAccessManager of the NetworkRequestScheduler has been destroyed");
+		QTimer::singleShot(0, this, [this, id, error]() {
+			this->finish(id, Deferred::Rejected, QVariant::fromValue(error));
+		});
+		return;
+	}
+	running.reply = reply;
+	running.networkPromise = NetworkPromise::create(reply);
+
+	/* The signals of the Promise base class provide the values as QVariant,
+	 * so they can be forwarded without conversion.
+	 */
+	const Promise* promise = running.networkPromise.data();
+	Deferred* deferred = running.deferred.data();
+	connect(promise, &Promise::resolved, this, [this, id](const QVariant& data) {
+		this->finish(id, Deferred::Resolved, data);
+	});
+	connect(promise, &Promise::rejected, this, [this, id](const QVariant& reason) {
+		this->finish(id, Deferred::Rejected, reason);
+	});
+	connect(promise, &Promise::notified, deferred, [deferred](const QVariant& progress) {
+		deferred->notify(progress);
+	});
+
+	Q_EMIT requestStarted(id, running.queueTime);
+}
+
+QNetworkReply* NetworkRequestScheduler::sendRequest(const QueuedRequest& request)
+{
+	if (!m_qnam)
+		return nullptr;
+	if (request.verb == "GET")
+		return m_qnam->get(request.request);
+	if (request.verb == "HEAD")
+		return m_qnam->head(request.request);
+	if (request.verb == "DELETE")
+		return m_qnam->deleteResource(request.request);
+	if (request.verb == "POST")
+		return m_qnam->post(request.request, request.data);
+	if (request.verb == "PUT")
+		return m_qnam->put(request.request, request.data);
+	if (request.data.isEmpty())
+		return m_qnam->sendCustomRequest(request.request, request.verb);
+
+	QBuffer* buffer = new QBuffer;
+	buffer->setData(request.data);
+	QNetworkReply* reply = m_qnam->sendCustomRequest(request.request, request.verb, buffer);
+	buffer->setParent(reply);
+	return reply;
+}
+
+void NetworkRequestScheduler::finish(RequestId id, Deferred::State state, const QVariant& data)
+{
+	auto iter = m_running.find(id);
+	if (iter == m_running.end())
+		return;
+	const RunningRequest running = iter.value();
+	m_running.erase(iter);
+
+	auto hostIter = m_hosts.find(running.host);
+	if (hostIter != m_hosts.end())
+	{
+		hostIter->running -= 1;
+		if (hostIter->queue.isEmpty() && hostIter->running == 0)
+			m_hosts.erase(hostIter);
+	}
+
+	/* The NetworkDeferred owns the QNetworkReply. Since the ReplyData references the reply,
+	 * the ownership is handed over to the Deferred of the returned Promise.
+	 */
+	if (running.reply)
+		running.reply->setParent(running.deferred.data());
+	/* The NetworkPromise is released from the event loop since this is called from its signal. */
+	NetworkPromise::Ptr networkPromise = running.networkPromise;
+	QTimer::singleShot(0, this, [networkPromise]() {});
+
+	Timing timing;
+	timing.queueTime = running.queueTime;
+	timing.networkTime = m_scheduler->now() - running.startedAt;
+
+	if (state == Deferred::Resolved)
+		running.deferred->resolve(data);
+	else
+		running.deferred->reject(data);
+	Q_EMIT requestFinished(id, timing);
+
+	dispatch();
+}
+
+}  // namespace QtPromise
@@ -0,0 +1,250 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_NETWORKREQUESTSCHEDULER_H_
+#define QTPROMISE_NETWORKREQUESTSCHEDULER_H_
+
+#include "NetworkPromise.h"
+#include "Scheduler.h"
+
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QHash>
+#include <QList>
+
+namespace QtPromise {
+
+/*! \brief Prioritized queue for network requests with per host and global concurrency limits.
+ *
+ * QNetworkAccessManager opens a limited number of connections per host and queues further requests
+ * internally without a way to prioritize them or to see what is queued. A NetworkRequestScheduler
+ * queues the requests before they are passed to the QNetworkAccessManager instead:
+ * - Requests with a higher priority are started first. Requests with the same priority are
+ *   started in the order they were scheduled.
+ * - At most perHostLimit() requests per host and globalLimit() requests in total are running.
+ * - When multiple hosts have queued requests of the same priority, the hosts are served in turns
+ *   so that a host with many requests cannot starve the others.
+ * - The priority of a queued request can be changed using setPriority().
+ * - A queued request can be cancelled using cancel() without ever being sent.
+ *
+ * \code
+ * NetworkRequestScheduler scheduler(qnam);
+ * NetworkRequestScheduler::ScheduledRequest thumbnail = scheduler.get(thumbnailRequest, NetworkRequestScheduler::LowPriority);
+ * NetworkRequestScheduler::ScheduledRequest document = scheduler.get(documentRequest, NetworkRequestScheduler::HighPriority);
+ * document.promise->then([](const QVariant& data) {
+ *     QByteArray body = data.value<NetworkDeferred::ReplyData>().data;
+ * });
+ * \endcode
+ *
+ * Since a NetworkPromise requires a QNetworkReply, a queued request is represented by a Promise.
+ * It is resolved, rejected and notified with the same NetworkDeferred::ReplyData,
+ * NetworkDeferred::Error and NetworkDeferred::ReplyProgress values as the NetworkPromise of the
+ * request once it has been started. The QNetworkReply is kept alive as long as that Promise's
+ * Deferred exists.
+ *
+ * The time a request waited in the queue and the time it was running are reported separately
+ * by the requestFinished() signal. The times are provided by the Scheduler::instance() at the
+ * time the NetworkRequestScheduler was created.
+ *
+ * \note Like the QNetworkAccessManager, the NetworkRequestScheduler must only be used from its thread.
+ *
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class NetworkRequestScheduler : public QObject
+{
+	Q_OBJECT
+
+public:
+	/*! Identifies a scheduled request. \c 0 is never used as identifier. */
+	typedef quint64 RequestId;
+
+	/*! Predefined priorities. Any other integer can be used as priority as well.
+	 * Higher values are started first.
+	 */
+	enum Priority
+	{
+		LowPriority = -10,
+		NormalPriority = 0,
+		HighPriority = 10
+	};
+
+	/*! The result of scheduling a request. */
+	struct ScheduledRequest
+	{
+		/*! The identifier of the request which can be passed to setPriority() and cancel(). */
+		RequestId id;
+		/*! The Promise of the request. */
+		Promise::Ptr promise;
+	};
+
+	/*! The times of a finished request.
+	 *
+	 * \note This type is registered in Qt's meta type system using Q_DECLARE_METATYPE()
+	 * and using qRegisterMetaType() in NetworkRequestScheduler().
+	 */
+	struct Timing
+	{
+		/*! The time in milliseconds the request waited in the queue. */
+		qint64 queueTime = -1;
+		/*! The time in milliseconds from starting the request until it finished or \c -1 if
+		 * the request was cancelled before it was started.
+		 */
+		qint64 networkTime = -1;
+	};
+
+	/*! The default value of perHostLimit(). */
+	static const int DefaultPerHostLimit = 6;
+	/*! The default value of globalLimit(). */
+	static const int DefaultGlobalLimit = 24;
+
+	/*! Creates a NetworkRequestScheduler.
+	 *
+	 * \param qnam The QNetworkAccessManager used to send the requests. The caller keeps the ownership.
+	 * \param parent The QObject parent.
+	 */
+	explicit NetworkRequestScheduler(QNetworkAccessManager* qnam, QObject* parent = nullptr);
+
+	/*! Cancels the queued requests and aborts the running requests.
+	 */
+	~NetworkRequestScheduler() override;
+
+	/*! Schedules a GET request. \sa send() */
+	ScheduledRequest get(const QNetworkRequest& request, int priority = NormalPriority);
+	/*! Schedules a POST request. \sa send() */
+	ScheduledRequest post(const QNetworkRequest& request, const QByteArray& data, int priority = NormalPriority);
+	/*! Schedules a PUT request. \sa send() */
+	ScheduledRequest put(const QNetworkRequest& request, const QByteArray& data, int priority = NormalPriority);
+	/*! Schedules a DELETE request. \sa send() */
+	ScheduledRequest deleteResource(const QNetworkRequest& request, int priority = NormalPriority);
+
+	/*! Schedules a request.
+	 *
+	 * The request is started immediately if the limits allow it.
+	 *
+	 * \param request The request.
+	 * \param verb The HTTP method of the request.
+	 * \param data The body of the request.
+	 * \param priority The priority of the request. Higher values are started first.
+	 * \return The identifier and the Promise of the request.
+	 */
+	ScheduledRequest send(const QNetworkRequest& request, const QByteArray& verb, const QByteArray& data = QByteArray(),
+	                      int priority = NormalPriority);
+
+	/*! Changes the priority of a queued request.
+	 *
+	 * \return \c true if the request was queued. \c false if it has already been started,
+	 * finished or cancelled.
+	 */
+	bool setPriority(RequestId id, int priority);
+
+	/*! Cancels a queued request.
+	 *
+	 * The Promise of the request is rejected with a NetworkDeferred::Error with the code
+	 * QNetworkReply::OperationCanceledError. Running requests are not cancelled since the caller
+	 * can abort their QNetworkReply.
+	 *
+	 * \return \c true if the request was queued. \c false if it has already been started,
+	 * finished or cancelled.
+	 */
+	bool cancel(RequestId id);
+
+	/*! \return \c true if the request is queued. */
+	bool isQueued(RequestId id) const { return m_queued.contains(id); }
+
+	/*! \return The maximum number of running requests per host. */
+	int perHostLimit() const { return m_perHostLimit; }
+	/*! Sets the maximum number of running requests per host.
+	 *
+	 * Since the QNetworkAccessManager opens at most 6 connections per host, higher limits
+	 * just move the queuing into the QNetworkAccessManager.
+	 */
+	void setPerHostLimit(int limit);
+
+	/*! \return The maximum number of running requests in total. */
+	int globalLimit() const { return m_globalLimit; }
+	/*! Sets the maximum number of running requests in total. */
+	void setGlobalLimit(int limit);
+
+	/*! \return The number of queued requests. */
+	int queuedCount() const { return m_queued.size(); }
+	/*! \return The number of running requests. */
+	int runningCount() const { return m_running.size(); }
+
+Q_SIGNALS:
+	/*! Emitted when a request is passed to the QNetworkAccessManager.
+	 *
+	 * \param id The identifier of the request.
+	 * \param queueTime The time in milliseconds the request waited in the queue.
+	 */
+	void requestStarted(QtPromise::NetworkRequestScheduler::RequestId id, qint64 queueTime);
+
+	/*! Emitted when a request is finished or cancelled.
+	 *
+	 * \param id The identifier of the request.
+	 * \param timing The time the request waited in the queue and the time it was running.
+	 */
+	void requestFinished(QtPromise::NetworkRequestScheduler::RequestId id, const QtPromise::NetworkRequestScheduler::Timing& timing);
+
+private:
+	struct QueuedRequest
+	{
+		QNetworkRequest request;
+		QByteArray verb;
+		QByteArray data;
+		int priority;
+		quint64 sequence;
+		QString host;
+		Deferred::Ptr deferred;
+		qint64 queuedAt;
+	};
+
+	struct RunningRequest
+	{
+		QString host;
+		Deferred::Ptr deferred;
+		NetworkPromise::Ptr networkPromise;
+		QPointer<QNetworkReply> reply;
+		qint64 queueTime;
+		qint64 startedAt;
+	};
+
+	struct Host
+	{
+		/* Queued requests ordered by descending priority and ascending sequence. */
+		QList<RequestId> queue;
+		int running = 0;
+		quint64 lastServed = 0;
+	};
+
+	static QString hostKey(const QUrl& url);
+	void enqueue(RequestId id);
+	void dequeue(RequestId id);
+	void dispatch();
+	void start(RequestId id);
+	void finish(RequestId id, Deferred::State state, const QVariant& data);
+	QNetworkReply* sendRequest(const QueuedRequest& request);
+
+	QPointer<QNetworkAccessManager> m_qnam;
+	Scheduler* m_scheduler;
+	int m_perHostLimit;
+	int m_globalLimit;
+	RequestId m_lastId;
+	quint64 m_lastSequence;
+	quint64 m_serveCounter;
+	QHash<RequestId, QueuedRequest> m_queued;
+	QHash<RequestId, RunningRequest> m_running;
+	QHash<QString, Host> m_hosts;
+	bool m_dispatching;
+};
+
+}  // namespace QtPromise
+
+Q_DECLARE_METATYPE(QtPromise::NetworkRequestScheduler::Timing)
+
+#endif /* QTPROMISE_NETWORKREQUESTSCHEDULER_H_ */
@@ -0,0 +1,347 @@
+#include "ObjectPool.h"
+
+#include <QTimer>
+
+#include <algorithm>
+
+namespace QtPromise {
+
+ObjectLease::ObjectLease(const QSharedPointer<ObjectPoolBase>& pool, const QVariant& object)
+	: m_pool(pool), m_object(object), m_invalidated(0)
+{
+}
+
+ObjectLease::~ObjectLease()
+{
+	QSharedPointer<ObjectPoolBase> pool = m_pool.toStrongRef();
+	if (pool)
+		pool->release(m_object, isInvalidated());
+}
+
+ObjectLease::Ptr ObjectLease::take(const QVariant& data)
+{
+	const Handle handle = data.value<Handle>();
+	if (!handle.m_slot)
+		return Ptr();
+
+	Ptr lease;
+	QMutexLocker locker(&handle.m_slot->lock);
+	lease.swap(handle.m_slot->lease);
+	return lease;
+}
+
+
+ObjectPoolBase::ObjectPoolBase(Factory factory, int maximumSize)
+	: QObject()
+	, m_scheduler(Scheduler::instance())
+	, m_factory(std::move(factory))
+	, m_maximumSize(qMax(1, maximumSize))
+	, m_minimumSize(0)
+	, m_idleTimeout(0)
+	, m_size(0)
+	, m_evictionTask(0)
+{
+	qRegisterMetaType<ObjectLease::Ptr>();
+	qRegisterMetaType<ObjectLease::Handle>();
+}
+
+ObjectPoolBase::~ObjectPoolBase()
+{
+	if (m_evictionTask != 0)
+		m_scheduler->cancel(m_evictionTask);
+
+	QQueue<Deferred::Ptr> waiters;
+	{
+		QMutexLocker locker(&m_lock);
+		waiters.swap(m_waiters);
+	}
+	for (const Deferred::Ptr& waiter : waiters)
+		waiter->reject(QVariant());
+}
+
+Promise::Ptr ObjectPoolBase::acquire()
+{
+	ObjectLease::Ptr lease;
+	Deferred::Ptr waiter;
+	bool create = false;
+	QVector<QVariant> dropped;
+	{
+		QMutexLocker locker(&m_lock);
+		while (!m_idle.isEmpty())
+		{
+			const QVariant object = m_idle.takeLast().object;
+			if (!isHealthy(object))
+			{
+				--m_size;
+				dropped.append(object);
+				continue;
+			}
+			lease = createLease(object);
+			break;
+		}
+		if (!lease)
+		{
+			waiter = Deferred::create();
+			m_waiters.enqueue(waiter);
+			if (m_size < m_maximumSize)
+			{
+				++m_size;
+				create = true;
+			}
+		}
+	}
+
+	if (lease)
+		return Promise::createResolved(leaseValue(lease));
+	if (create)
+		createObject();
+	return Promise::create(waiter);
+}
+
+void ObjectPoolBase::prefill()
+{
+	int missing = 0;
+	{
+		QMutexLocker locker(&m_lock);
+		missing = qMax(0, qMin(m_minimumSize, m_maximumSize) - m_size);
+		m_size += missing;
+	}
+	for (int i = 0; i < missing; ++i)
+		createObject();
+}
+
+int ObjectPoolBase::maximumSize() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_maximumSize;
+}
+
+void ObjectPoolBase::setMaximumSize(int maximumSize)
+{
+	int missing = 0;
+	{
+		QMutexLocker locker(&m_lock);
+		m_maximumSize = qMax(1, maximumSize);
+		missing = qMax(0, qMin(m_waiters.size(), m_maximumSize - m_size) - m_creations.size());
+		m_size += missing;
+	}
+	for (int i = 0; i < missing; ++i)
+		createObject();
+}
+
+int ObjectPoolBase::minimumSize() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_minimumSize;
+}
+
+void ObjectPoolBase::setMinimumSize(int minimumSize)
+{
+	QMutexLocker locker(&m_lock);
+	m_minimumSize = qMax(0, minimumSize);
+}
+
+int ObjectPoolBase::idleTimeout() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_idleTimeout;
+}
+
+void ObjectPoolBase::setIdleTimeout(int idleTimeoutInMillisec)
+{
+	QMutexLocker locker(&m_lock);
+	m_idleTimeout = qMax(0, idleTimeoutInMillisec);
+	if (m_evictionTask != 0)
+	{
+		m_scheduler->cancel(m_evictionTask);
+		m_evictionTask = 0;
+	}
+	armEviction();
+}
+
+void ObjectPoolBase::setHealthCheck(ObjectCheck healthCheck)
+{
+	QMutexLocker locker(&m_lock);
+	m_healthCheck = std::move(healthCheck);
+}
+
+int ObjectPoolBase::size() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_size;
+}
+
+int ObjectPoolBase::idleCount() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_idle.size();
+}
+
+int ObjectPoolBase::waitingCount() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_waiters.size();
+}
+
+ObjectLease::Ptr ObjectPoolBase::createLease(const QVariant& object)
+{
+	return ObjectLease::Ptr(new ObjectLease(sharedFromThis(), object));
+}
+
+QVariant ObjectPoolBase::leaseValue(const ObjectLease::Ptr& lease)
+{
+	return QVariant::fromValue(ObjectLease::Handle(lease));
+}
+
+void ObjectPoolBase::createObject()
+{
+	Promise::Ptr promise = m_factory ? m_factory() : Promise::Ptr();
+	if (!promise)
+		promise = Promise::createRejected();
+	const Promise* rawPromise = promise.data();
+	{
+		QMutexLocker locker(&m_lock);
+		m_creations.append(promise);
+	}
+
+	connect(rawPromise, &Promise::resolved, this, [this, rawPromise](const QVariant& value) {
+		this->creationSettled(rawPromise, Deferred::Resolved, value);
+	});
+	connect(rawPromise, &Promise::rejected, this, [this, rawPromise](const QVariant& reason) {
+		this->creationSettled(rawPromise, Deferred::Rejected, reason);
+	});
+	/* The factory might have settled the Deferred before the connections were made.
+	 * creationSettled() ignores the second call if the signal is emitted as well.
+	 */
+	const Deferred::State state = promise->state();
+	if (state != Deferred::Pending)
+	{
+		const QVariant data = promise->data();
+		QTimer::singleShot(0, this, [this, rawPromise, state, data]() {
+			this->creationSettled(rawPromise, state, data);
+		});
+	}
+}
+
+void ObjectPoolBase::creationSettled(const Promise* promise, Deferred::State state, const QVariant& data)
+{
+	Promise::Ptr creation;
+	Deferred::Ptr waiter;
+	ObjectLease::Ptr lease;
+	bool create = false;
+	{
+		QMutexLocker locker(&m_lock);
+		auto iter = std::find_if(m_creations.begin(), m_creations.end(), [promise](const Promise::Ptr& candidate) {
+			return candidate.data() == promise;
+		});
+		if (iter == m_creations.end())
+			return;
+		creation = *iter;
+		m_creations.erase(iter);
+
+		if (state == Deferred::Resolved)
+		{
+			if (m_waiters.isEmpty())
+				addIdle(data);
+			else
+			{
+				waiter = m_waiters.dequeue();
+				lease = createLease(data);
+			}
+		}
+		else
+		{
+			--m_size;
+			if (!m_waiters.isEmpty())
+				waiter = m_waiters.dequeue();
+			if (m_waiters.size() > m_creations.size() && m_size < m_maximumSize)
+			{
+				++m_size;
+				create = true;
+			}
+		}
+	}
+	/* The Promise is released from the event loop since this is called from its signal. */
+	QTimer::singleShot(0, this, [creation]() {});
+
+	if (create)
+		createObject();
+	if (lease)
+		waiter->resolve(leaseValue(lease));
+	else if (waiter)
+		waiter->reject(data);
+}
+
+void ObjectPoolBase::release(const QVariant& object, bool invalidated)
+{
+	Deferred::Ptr waiter;
+	ObjectLease::Ptr lease;
+	bool create = false;
+	{
+		QMutexLocker locker(&m_lock);
+		if (invalidated || !isHealthy(object))
+		{
+			--m_size;
+			if (m_waiters.size() > m_creations.size() && m_size < m_maximumSize)
+			{
+				++m_size;
+				create = true;
+			}
+		}
+		else if (!m_waiters.isEmpty())
+		{
+			waiter = m_waiters.dequeue();
+			lease = createLease(object);
+		}
+		else
+			addIdle(object);
+	}
+
+	if (waiter)
+		waiter->resolve(leaseValue(lease));
+	if (create)
+		createObject();
+}
+
+bool ObjectPoolBase::isHealthy(const QVariant& object) const
+{
+	return !m_healthCheck || m_healthCheck(object);
+}
+
+void ObjectPoolBase::addIdle(const QVariant& object)
+{
+	IdleObject idleObject;
+	idleObject.object = object;
+	idleObject.since = m_scheduler->now();
+	m_idle.append(idleObject);
+	armEviction();
+}
+
+void ObjectPoolBase::armEviction()
+{
+	if (m_evictionTask != 0 || m_idleTimeout <= 0 || m_idle.isEmpty() || m_size <= m_minimumSize)
+		return;
+
+	const qint64 delay = m_idle.first().since + m_idleTimeout - m_scheduler->now();
+	m_evictionTask = m_scheduler->schedule(static_cast<int>(qMax(Q_INT64_C(0), delay)), this, [this]() {
+		this->evictIdleObjects();
+	});
+}
+
+void ObjectPoolBase::evictIdleObjects()
+{
+	QVector<QVariant> evicted;
+	{
+		QMutexLocker locker(&m_lock);
+		m_evictionTask = 0;
+		const qint64 now = m_scheduler->now();
+		while (!m_idle.isEmpty() && m_size > m_minimumSize && now - m_idle.first().since >= m_idleTimeout)
+		{
+			evicted.append(m_idle.takeFirst().object);
+			--m_size;
+		}
+		armEviction();
+	}
+}
+
+}  // namespace QtPromise
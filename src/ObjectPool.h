@@ -0,0 +1,318 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_OBJECTPOOL_H_
+#define QTPROMISE_OBJECTPOOL_H_
+
+#include "Promise.h"
+#include "Scheduler.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <functional>
+
+namespace QtPromise {
+
+class ObjectPoolBase;
+
+/*! \brief Lease of an object of an ObjectPool.
+ *
+ * The object is returned to its pool when the last ObjectLease::Ptr referencing the lease
+ * is destroyed. If the pool has been destroyed in the meantime, the object is just released.
+ *
+ * The Promise returned by ObjectPoolBase::acquire() is resolved with a Handle and not with the
+ * lease itself. Since the Deferreds of a Promise chain share the data (for example, a then()
+ * with a callback returning \c void resolves its Promise with the same data), the Deferreds
+ * would otherwise keep the object leased as long as any of them exists. Use take() to get the
+ * lease out of the Handle:
+ * \code
+ * pool->acquire()->then([](const QVariant& data) {
+ *     ObjectLease::Ptr lease = ObjectLease::take(data);
+ *     // ...
+ * });  // The object is returned to the pool when lease is destroyed
+ * \endcode
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class ObjectLease
+{
+public:
+	/*! Smart pointer to an ObjectLease. */
+	typedef QSharedPointer<ObjectLease> Ptr;
+
+	/*! \brief Transfers an ObjectLease from the Promise returned by ObjectPoolBase::acquire()
+	 * to its user.
+	 *
+	 * All copies of a Handle share the lease until it is taken using ObjectLease::take().
+	 * A lease which is never taken is returned to its pool when the last copy of the Handle
+	 * is destroyed.
+	 */
+	class Handle
+	{
+	public:
+		/*! Creates a Handle without lease. */
+		Handle() = default;
+
+	private:
+		friend class ObjectLease;
+		friend class ObjectPoolBase;
+
+		struct Slot
+		{
+			QMutex lock;
+			Ptr lease;
+		};
+
+		explicit Handle(const Ptr& lease) : m_slot(new Slot) { m_slot->lease = lease; }
+
+		QSharedPointer<Slot> m_slot;
+	};
+
+	/*! Takes the lease out of the value of a Promise returned by ObjectPoolBase::acquire().
+	 *
+	 * \param data The value of the Promise. It contains a Handle.
+	 * \return The lease or a null pointer if \p data does not contain a Handle or the lease
+	 * has been taken already.
+	 */
+	static Ptr take(const QVariant& data);
+
+	/*! Returns the object to its pool. */
+	~ObjectLease();
+
+	/*! \return The leased object as provided by the factory of the pool. */
+	QVariant value() const { return m_object; }
+
+	/*! \return The leased object.
+	 *
+	 * \tparam T The type of the objects of the pool.
+	 */
+	template<typename T>
+	QSharedPointer<T> object() const { return m_object.value<QSharedPointer<T>>(); }
+
+	/*! Marks the object as broken.
+	 *
+	 * An invalidated object is dropped instead of being returned to the pool.
+	 */
+	void invalidate() { m_invalidated.storeRelease(1); }
+
+	/*! \return \c true if invalidate() has been called. */
+	bool isInvalidated() const { return m_invalidated.loadAcquire() != 0; }
+
+private:
+	friend class ObjectPoolBase;
+
+	ObjectLease(const QSharedPointer<ObjectPoolBase>& pool, const QVariant& object);
+
+	QWeakPointer<ObjectPoolBase> m_pool;
+	QVariant m_object;
+	QAtomicInt m_invalidated;
+};
+
+/*! \brief Asynchronous pool of expensive objects.
+ *
+ * ObjectPoolBase implements ObjectPool independent of the type of the objects.
+ * Use ObjectPool instead of using this class directly.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class ObjectPoolBase : public QObject, public QEnableSharedFromThis<ObjectPoolBase>
+{
+	Q_OBJECT
+
+public:
+	/*! The type of the function creating an object. The returned Promise must be resolved
+	 * with the new object.
+	 */
+	typedef std::function<Promise::Ptr()> Factory;
+	/*! The type of the function checking whether an object can be used. */
+	typedef std::function<bool(const QVariant&)> ObjectCheck;
+
+	/*! Destroys the pool and rejects the promises of pending acquire() calls.
+	 *
+	 * Leased objects are released when their leases are destroyed.
+	 */
+	~ObjectPoolBase() override;
+
+	/*! Acquires an object from the pool.
+	 *
+	 * If an idle object is available, the returned Promise is resolved with a lease of it.
+	 * Otherwise, a new object is created if the maximum size has not been reached yet and the
+	 * request is queued. Queued requests are served in FIFO order whenever an object is created
+	 * or returned to the pool. If the creation of an object is rejected, the oldest queued request
+	 * is rejected with the same reason.
+	 *
+	 * \return A Promise which is resolved with an ObjectLease::Handle.
+	 * Use ObjectLease::take() to get the lease.
+	 */
+	Promise::Ptr acquire();
+
+	/*! Creates objects until the pool contains minimumSize() objects. */
+	void prefill();
+
+	/*! \return The maximum number of objects of the pool. */
+	int maximumSize() const;
+	/*! Sets the maximum number of objects of the pool.
+	 *
+	 * Reducing the maximum size does not drop existing objects.
+	 */
+	void setMaximumSize(int maximumSize);
+
+	/*! \return The minimum number of objects kept by the idle eviction. */
+	int minimumSize() const;
+	/*! Sets the number of objects which are not evicted when they are idle.
+	 *
+	 * \sa prefill()
+	 */
+	void setMinimumSize(int minimumSize);
+
+	/*! \return The time in milliseconds after which idle objects are dropped or \c 0 if disabled. */
+	int idleTimeout() const;
+	/*! Sets the time in milliseconds after which idle objects are dropped.
+	 *
+	 * The time is provided by the Scheduler::instance() at the time the pool was created.
+	 * \c 0 or a negative value disables the idle eviction, which is the default.
+	 */
+	void setIdleTimeout(int idleTimeoutInMillisec);
+
+	/*! Sets a function checking idle objects before they are leased and returned objects
+	 * before they become idle. Objects which fail the check are dropped.
+	 *
+	 * The check is called while the pool is locked, so it must not access the pool.
+	 */
+	void setHealthCheck(ObjectCheck healthCheck);
+
+	/*! \return The number of objects which exist or are being created. */
+	int size() const;
+	/*! \return The number of objects which are neither leased nor being created. */
+	int idleCount() const;
+	/*! \return The number of acquire() calls waiting for an object. */
+	int waitingCount() const;
+
+protected:
+	/*! Creates a pool which calls \p factory to create objects. */
+	ObjectPoolBase(Factory factory, int maximumSize);
+
+private:
+	friend class ObjectLease;
+
+	struct IdleObject
+	{
+		QVariant object;
+		qint64 since;
+	};
+
+	ObjectLease::Ptr createLease(const QVariant& object);
+	static QVariant leaseValue(const ObjectLease::Ptr& lease);
+	void createObject();
+	void creationSettled(const Promise* promise, Deferred::State state, const QVariant& data);
+	void release(const QVariant& object, bool invalidated);
+	bool isHealthy(const QVariant& object) const;
+	void addIdle(const QVariant& object);
+	void armEviction();
+	void evictIdleObjects();
+
+	Scheduler* m_scheduler;
+	mutable QMutex m_lock;
+	Factory m_factory;
+	ObjectCheck m_healthCheck;
+	int m_maximumSize;
+	int m_minimumSize;
+	int m_idleTimeout;
+	int m_size;
+	/* Oldest idle object first. Objects are leased from the back so that
+	 * rarely used objects age at the front. */
+	QVector<IdleObject> m_idle;
+	QQueue<Deferred::Ptr> m_waiters;
+	QVector<Promise::Ptr> m_creations;
+	Scheduler::TaskId m_evictionTask;
+};
+
+/*! \brief Asynchronous pool of expensive objects of type \p T.
+ *
+ * An ObjectPool is meant for objects which are expensive to create and should be reused like
+ * QNetworkAccessManagers, database connections or parser contexts. The objects are created on
+ * demand by an asynchronous factory up to a maximum size. acquire() returns a Promise of an
+ * ObjectLease, which returns the object to the pool when it is destroyed (see ObjectLease::take()):
+ * \code
+ * ObjectPool<QNetworkAccessManager>::Ptr pool = ObjectPool<QNetworkAccessManager>::create([]() {
+ *     return Promise::createResolved(QVariant::fromValue(QSharedPointer<QNetworkAccessManager>::create()));
+ * }, 4);
+ *
+ * pool->acquire()->then([request](const QVariant& data) {
+ *     ObjectLease::Ptr lease = ObjectLease::take(data);
+ *     QNetworkReply* reply = lease->object<QNetworkAccessManager>()->get(request);
+ *     return NetworkPromise::create(reply)->always([lease](const QVariant&) {});  // keeps the lease
+ * });
+ * \endcode
+ *
+ * The settlement of the factory's Promises and the idle eviction are processed in the thread
+ * of the ObjectPool, which requires a running event loop. An ObjectPool must be destroyed in its thread.
+ *
+ * \tparam T The type of the objects. The Promises of the factory must be resolved with
+ * a QVariant containing a QSharedPointer<T>. For types which are not derived from QObject,
+ * QSharedPointer<T> needs to be registered using Q_DECLARE_METATYPE().
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+template<typename T>
+class ObjectPool : public ObjectPoolBase
+{
+public:
+	/*! Smart pointer to an ObjectPool. */
+	typedef QSharedPointer<ObjectPool<T>> Ptr;
+
+	/*! Creates an ObjectPool.
+	 *
+	 * \param factory The function creating an object. If it returns a null pointer,
+	 * the creation is rejected.
+	 * \param maximumSize The maximum number of objects of the pool.
+	 * \return QSharedPointer to a new ObjectPool.
+	 */
+	static Ptr create(Factory factory, int maximumSize)
+	{
+		return Ptr(new ObjectPool<T>(std::move(factory), maximumSize));
+	}
+
+	/*! Sets a health check using the typed objects.
+	 *
+	 * \sa ObjectPoolBase::setHealthCheck()
+	 */
+	void setHealthCheck(std::function<bool(const QSharedPointer<T>&)> healthCheck)
+	{
+		if (!healthCheck)
+		{
+			ObjectPoolBase::setHealthCheck(ObjectCheck());
+			return;
+		}
+		ObjectPoolBase::setHealthCheck([healthCheck](const QVariant& object) {
+			return healthCheck(object.value<QSharedPointer<T>>());
+		});
+	}
+
+protected:
+	/*! Creates a pool which calls \p factory to create objects. */
+	ObjectPool(Factory factory, int maximumSize)
+		: ObjectPoolBase(std::move(factory), maximumSize)
+	{
+	}
+};
+
+}  // namespace QtPromise
+
+Q_DECLARE_METATYPE(QtPromise::ObjectLease::Ptr)
+Q_DECLARE_METATYPE(QtPromise::ObjectLease::Handle)
+
+#endif /* QTPROMISE_OBJECTPOOL_H_ */
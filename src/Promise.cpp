@@ -1,7 +1,13 @@
 #include "Promise.h"
 #include "ChildDeferred.h"
+#include "Scheduler.h"
 #include <QTimer>
 #include <QHash>
+#ifndef QT_NO_QFUTURE
+#	include <QFutureWatcher>
+#endif
+
+#include <memory>
 
 namespace QtPromise {
 
@@ -11,15 +17,25 @@ Promise::Promise(Deferred::Ptr deferred)
 	switch (m_deferred->state())
 	{
 	case Deferred::Resolved:
-		QTimer::singleShot(0, this, [this]() {
+	{
+		PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::AsyncAction);
+		QTimer::singleShot(0, this, [this, action]() mutable {
+			action.release();
+			ContinuationScope continuationScope(this->m_deferred.data(), true);
 			Q_EMIT resolved(this->m_deferred->data());
 		});
 		break;
+	}
 	case Deferred::Rejected:
-		QTimer::singleShot(0, this, [this]() {
+	{
+		PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::AsyncAction);
+		QTimer::singleShot(0, this, [this, action]() mutable {
+			action.release();
+			ContinuationScope continuationScope(this->m_deferred.data(), true);
 			Q_EMIT rejected(this->m_deferred->data());
 		});
 		break;
+	}
 	case Deferred::Pending:
 	default:
 		connect(m_deferred.data(), &Deferred::resolved, this, &Promise::resolved);
@@ -39,6 +55,13 @@ Promise::Ptr Promise::create(Deferred::Ptr deferred)
 	return Ptr(new Promise(deferred));
 }
 
+Promise::Ptr Promise::create(Deferred::Ptr deferred, const CallSite& callSite)
+{
+	if (CallSiteProfiler::isEnabled())
+		CallSiteProfiler::deferredCreated(deferred.data(), callSite);
+	return create(deferred);
+}
+
 Promise::Ptr Promise::createResolved(const QVariant& value)
 {
 	return Ptr(new Promise(Deferred::Resolved, value));
@@ -53,7 +76,9 @@ Promise::Ptr Promise::delayedResolve(const QVariant& value, int delayInMillisec)
 {
 	Deferred::Ptr deferred = Deferred::create();
 	Deferred* rawDeferred = deferred.data();
-	QTimer::singleShot(delayInMillisec, rawDeferred, [rawDeferred, value]() {
+	PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::TimerAction);
+	Scheduler::instance()->schedule(delayInMillisec, rawDeferred, [rawDeferred, value, action]() mutable {
+		action.release();
 		rawDeferred->resolve(value);
 	});
 	return Promise::create(deferred);
@@ -63,7 +88,9 @@ Promise::Ptr Promise::delayedReject(const QVariant& reason, int delayInMillisec)
 {
 	Deferred::Ptr deferred = Deferred::create();
 	Deferred* rawDeferred = deferred.data();
-	QTimer::singleShot(delayInMillisec, rawDeferred, [rawDeferred, reason]() {
+	PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::TimerAction);
+	Scheduler::instance()->schedule(delayInMillisec, rawDeferred, [rawDeferred, reason, action]() mutable {
+		action.release();
 		rawDeferred->reject(reason);
 	});
 	return Promise::create(deferred);
@@ -80,6 +107,70 @@ QVariant Promise::data() const
 	return m_deferred->data();
 }
 
+#ifndef QT_NO_QFUTURE
+void Promise::bindFutureInterface(QFutureInterfaceBase futureInterface, const QFuture<void>& future,
+                                  const std::function<void(const QVariant&)>& reportResults, const QVariant& cancelReason) const
+{
+	Deferred* deferred = m_deferred.data();
+	const QWeakPointer<Deferred> weakDeferred = m_deferred;
+
+	/* The watcher propagates the cancellation of the QFuture to the Deferred.
+	 * It is deleted when the Deferred is settled or destroyed.
+	 */
+	QFutureWatcher<void>* watcher = new QFutureWatcher<void>();
+	QObject::connect(watcher, &QFutureWatcher<void>::canceled, watcher, [weakDeferred, cancelReason]() {
+		const Deferred::Ptr deferred = weakDeferred.toStrongRef();
+		if (deferred && deferred->state() == Deferred::Pending)
+			deferred->reject(cancelReason);
+	});
+	auto watcherHolder = std::make_shared<QAtomicPointer<QFutureWatcher<void>>>(watcher);
+	auto settled = std::make_shared<QAtomicInt>(0);
+
+	auto finish = [futureInterface, watcherHolder, settled, reportResults](Deferred::State state, const QVariant& data) mutable {
+		// The Deferred can be settled concurrently to the binding
+		if (!settled->testAndSetOrdered(0, 1))
+			return;
+		if (QFutureWatcher<void>* watcher = watcherHolder->fetchAndStoreOrdered(nullptr))
+		{
+			QObject::disconnect(watcher, nullptr, nullptr, nullptr);
+			watcher->deleteLater();
+		}
+		if (state == Deferred::Resolved)
+			reportResults(data);
+		else
+			futureInterface.reportCanceled();
+		futureInterface.reportFinished();
+	};
+
+	QObject::connect(deferred, &Deferred::resolved, deferred, [finish](const QVariant& value) mutable {
+		finish(Deferred::Resolved, value);
+	}, Qt::DirectConnection);
+	QObject::connect(deferred, &Deferred::rejected, deferred, [finish](const QVariant& reason) mutable {
+		finish(Deferred::Rejected, reason);
+	}, Qt::DirectConnection);
+	QObject::connect(deferred, &QObject::destroyed, deferred, [finish]() mutable {
+		finish(Deferred::Rejected, QVariant());
+	}, Qt::DirectConnection);
+	QObject::connect(deferred, &Deferred::notified, deferred, [futureInterface](const QVariant& progress) mutable {
+		bool isNumber = false;
+		const int progressValue = progress.toInt(&isNumber);
+		if (isNumber)
+			futureInterface.setProgressValue(progressValue);
+	}, Qt::DirectConnection);
+
+	watcher->setFuture(future);
+
+	// The Deferred might have been settled before the connections were established
+	const Deferred::State state = m_deferred->state();
+	if (state != Deferred::Pending)
+		finish(state, m_deferred->data());
+}
+
+void Promise::reportFutureResults(QFutureInterface<void>&, const QVariant&)
+{
+}
+#endif
+
 
 
 }  // namespace QtPromise
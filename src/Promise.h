@@ -9,11 +9,17 @@
 
 #include "Deferred.h"
 #include "ChildDeferred.h"
+#include "ContinuationScope.h"
+#include "CallSite.h"
 
 #include <QObject>
 #include <QVariant>
 #include <QSharedPointer>
 #include <QVector>
+#ifndef QT_NO_QFUTURE
+#	include <QFuture>
+#	include <QFutureInterface>
+#endif
 
 #include <cstddef>
 #include <functional>
@@ -61,6 +67,16 @@ public:
 	 * \return QSharedPointer to a new Promise for the given \p deferred.
 	 */
 	static Ptr create(Deferred::Ptr deferred);
+	/*! \overload
+	 * Additionally records the pending time of the \p deferred for the \p callSite.
+	 *
+	 * \param deferred The Deferred whose state is communicated
+	 * by the created Promise.
+	 * \param callSite The location of the caller. See CallSiteProfiler.
+	 * \return QSharedPointer to a new Promise for the given \p deferred.
+	 * \since 2.2.0
+	 */
+	static Ptr create(Deferred::Ptr deferred, const CallSite& callSite);
 	/*! Creates a resolved Promise.
 	 *
 	 * Creates a Deferred, resolves it with the given \p value and returns
@@ -103,6 +119,8 @@ public:
 	 * \return QSharedPointer to a new Promise which will be resolved
 	 * with \p value after the given \p delayInMillisec.
 	 *
+	 * Since 2.2.0, the delay is measured by the Scheduler::instance().
+	 *
 	 * \sa delayedReject()
 	 * \since 2.0.0
 	 */
@@ -117,6 +135,8 @@ public:
 	 * \return QSharedPointer to a new Promise which will be rejected
 	 * with \p reason after the given \p delayInMillisec.
 	 *
+	 * Since 2.2.0, the delay is measured by the Scheduler::instance().
+	 *
 	 * \sa delayedResolve()
 	 * \since 2.0.0
 	 */
@@ -135,17 +155,21 @@ public:
 	 * The container type must be iterable using a range-based \c for loop.
 	 * \param promises A \p PromiseContainer of the promises which should
 	 * be combined.
+	 * \param callSite The location of the caller. See CallSiteProfiler.
+	 * Since 2.2.0.
 	 * \return A QSharedPointer to a new Promise which is resolved when all
 	 * \p promises are resolved and rejected when any of the \p promises is rejected.
 	 * The returned Promise is *not* notified.
 	 */
 	template<typename PromiseContainer>
-	static Ptr all(PromiseContainer&& promises) { return Promise::all_impl(std::forward<PromiseContainer>(promises)); }
+	static Ptr all(PromiseContainer&& promises, const CallSite& callSite = QTPROMISE_DEFAULT_CALL_SITE)
+	{ return Promise::all_impl(std::forward<PromiseContainer>(promises), callSite); }
 	/*! \overload
 	 * Overload for initializer lists.
 	 */
 	template<typename ListType>
-	static Ptr all(const std::initializer_list<ListType>& promises) { return Promise::all_impl(promises); }
+	static Ptr all(const std::initializer_list<ListType>& promises, const CallSite& callSite = QTPROMISE_DEFAULT_CALL_SITE)
+	{ return Promise::all_impl(promises, callSite); }
 
 	/*! Combines multiple Promises using "or" semantics.
 	 *
@@ -210,6 +234,37 @@ public:
 	 */
 	QVariant data() const;
 
+#ifndef QT_NO_QFUTURE
+	/*! Creates a QFuture representing this Promise.
+	 *
+	 * The QFuture is reported through a QFutureInterface directly when the Deferred of this
+	 * Promise is settled. No thread of a QThreadPool is involved.
+	 * - When the Deferred is resolved, its value is reported as result of the QFuture and
+	 * the QFuture is finished. If the value is a QVariantList and \p T is not QVariantList,
+	 * every element of the list is reported as a separate result.
+	 * - When the Deferred is rejected or destroyed while pending, the QFuture is canceled.
+	 * - When the Deferred is notified with a value convertible to \c int, the value is reported
+	 * as progress value of the QFuture.
+	 *
+	 * Canceling the QFuture rejects the Deferred of this Promise with \p cancelReason
+	 * if it is still pending. This requires an event loop in the thread calling toFuture().
+	 *
+	 * \code
+	 * QFutureSynchronizer<int> synchronizer;
+	 * synchronizer.addFuture(promise->toFuture<int>());
+	 * \endcode
+	 *
+	 * \tparam T The result type of the QFuture. Must be registered in Qt's meta type system
+	 * unless it is \c void. For \c void, the value of the Deferred is ignored.
+	 * \param cancelReason The reason used to reject the Deferred when the QFuture is canceled.
+	 * \return A QFuture which is finished or canceled when this Promise is resolved or rejected.
+	 *
+	 * \since 2.2.0
+	 */
+	template<typename T>
+	QFuture<T> toFuture(const QVariant& cancelReason = QVariant()) const;
+#endif
+
 	/*! Attaches actions to be executed when the Promise is resolved, rejected
 	 * or notified (promise chaining).
 	 *
@@ -270,13 +325,32 @@ public:
 	 * \param notifiedCallback A callback which is executed when the Promise's Deferred is notified.
 	 * The callback will receive the data passed to Deferred::notify() as parameter.
 	 * If `nullptr`, the notified signals are just passed through to the returned Promise.
+	 * \param callSite The location of the caller. The execution time of the callbacks and the
+	 * pending time of the returned Promise are recorded for this location. See CallSiteProfiler.
+	 * Since 2.2.0.
 	 * \return A new Promise which is resolved/rejected/notified depending on the type and return
 	 * value of the \p resolvedCallback/\p rejectedCallback/\p notifiedCallback callback. See above for details.
 	 *
 	 * \sa \ref page_promiseChaining
 	 */
-	template<typename ResolvedFunc, typename RejectedFunc = std::nullptr_t, typename NotifiedFunc = std::nullptr_t>
-	Ptr then(ResolvedFunc&& resolvedCallback, RejectedFunc&& rejectedCallback = nullptr, NotifiedFunc&& notifiedCallback = nullptr ) const;
+	template<typename ResolvedFunc, typename RejectedFunc = std::nullptr_t, typename NotifiedFunc = std::nullptr_t,
+	         typename std::enable_if<!IsCallSite<RejectedFunc>::value && !IsCallSite<NotifiedFunc>::value>::type* = nullptr>
+	Ptr then(ResolvedFunc&& resolvedCallback, RejectedFunc&& rejectedCallback = nullptr, NotifiedFunc&& notifiedCallback = nullptr,
+	         const CallSite& callSite = QTPROMISE_DEFAULT_CALL_SITE) const;
+	/*! \overload
+	 * Allows passing a \p callSite without the other callbacks.
+	 * \since 2.2.0
+	 */
+	template<typename ResolvedFunc>
+	Ptr then(ResolvedFunc&& resolvedCallback, const CallSite& callSite) const
+	{ return this->then(std::forward<ResolvedFunc>(resolvedCallback), nullptr, nullptr, callSite); }
+	/*! \overload
+	 * Allows passing a \p callSite without a notified callback.
+	 * \since 2.2.0
+	 */
+	template<typename ResolvedFunc, typename RejectedFunc, typename std::enable_if<!IsCallSite<RejectedFunc>::value>::type* = nullptr>
+	Ptr then(ResolvedFunc&& resolvedCallback, RejectedFunc&& rejectedCallback, const CallSite& callSite) const
+	{ return this->then(std::forward<ResolvedFunc>(resolvedCallback), std::forward<RejectedFunc>(rejectedCallback), nullptr, callSite); }
 
 	/*! Attaches an action to be executed when the Promise is either resolved or rejected.
 	 *
@@ -287,13 +361,16 @@ public:
 	 * \param alwaysCallback A callback which is executed when the Promise's Deferred is resolved
 	 * or rejected. The callback will receive the data passed to Deferred::resolve() or
 	 * Deferred::reject() as parameter.
+	 * \param callSite The location of the caller. See CallSiteProfiler.
+	 * Since 2.2.0.
 	 * \return A new Promise which is resolved/rejected depending on the type and return
 	 * value of the \p alwaysCallback callback. See above for details.
 	 *
 	 * \sa then()
 	 */
 	template <typename AlwaysFunc>
-	Ptr always(AlwaysFunc&& alwaysCallback) const { return this->then(alwaysCallback, alwaysCallback); }
+	Ptr always(AlwaysFunc&& alwaysCallback, const CallSite& callSite = QTPROMISE_DEFAULT_CALL_SITE) const
+	{ return this->then(alwaysCallback, alwaysCallback, nullptr, callSite); }
 
 
 Q_SIGNALS:
@@ -352,24 +429,26 @@ protected:
 
 
 private:
+	friend class PromiseSitter;
+	friend class PromiseAwaiter;
 
 	template<typename NullCallbackFunc, typename std::enable_if<std::is_same<NullCallbackFunc, std::nullptr_t>::value>::type* = nullptr>
-	Ptr callCallback(NullCallbackFunc&&) const;
+	Ptr callCallback(NullCallbackFunc&&, const CallSite&) const;
 	template<typename VoidCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<VoidCallbackFunc(const QVariant&)>::type, void>::value>::type* = nullptr>
-	Ptr callCallback(VoidCallbackFunc&& func) const;
+	Ptr callCallback(VoidCallbackFunc&& func, const CallSite& callSite) const;
 	template<typename VariantCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<VariantCallbackFunc(const QVariant&)>::type, QVariant>::value>::type* = nullptr>
-	Ptr callCallback(VariantCallbackFunc&& func) const;
+	Ptr callCallback(VariantCallbackFunc&& func, const CallSite& callSite) const;
 	template<typename PromiseCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<PromiseCallbackFunc(const QVariant&)>::type, Promise::Ptr>::value>::type* = nullptr>
-	Ptr callCallback(PromiseCallbackFunc&& func) const;
+	Ptr callCallback(PromiseCallbackFunc&& func, const CallSite& callSite) const;
 
 	template <typename NullCallbackFunc, typename std::enable_if<std::is_same<NullCallbackFunc, std::nullptr_t>::value>::type* = nullptr>
-	static ChildDeferred::WrappedCallbackFunc createCallbackWrapper(ChildDeferred* newDeferred, NullCallbackFunc func, Deferred::State state);
+	static ChildDeferred::WrappedCallbackFunc createCallbackWrapper(ChildDeferred* newDeferred, NullCallbackFunc func, Deferred::State state, const CallSite& callSite);
 	template <typename VoidCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<VoidCallbackFunc(const QVariant&)>::type, void>::value>::type* = nullptr>
-	static ChildDeferred::WrappedCallbackFunc createCallbackWrapper(ChildDeferred* newDeferred, VoidCallbackFunc func, Deferred::State state);
+	static ChildDeferred::WrappedCallbackFunc createCallbackWrapper(ChildDeferred* newDeferred, VoidCallbackFunc func, Deferred::State state, const CallSite& callSite);
 	template<typename VariantCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<VariantCallbackFunc(const QVariant&)>::type, QVariant>::value>::type* = nullptr>
-	static ChildDeferred::WrappedCallbackFunc createCallbackWrapper(ChildDeferred* newDeferred, VariantCallbackFunc func, Deferred::State state);
+	static ChildDeferred::WrappedCallbackFunc createCallbackWrapper(ChildDeferred* newDeferred, VariantCallbackFunc func, Deferred::State state, const CallSite& callSite);
 	template<typename PromiseCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<PromiseCallbackFunc(const QVariant&)>::type, Promise::Ptr>::value>::type* = nullptr>
-	static ChildDeferred::WrappedCallbackFunc createCallbackWrapper(ChildDeferred* newDeferred, PromiseCallbackFunc func, Deferred::State state);
+	static ChildDeferred::WrappedCallbackFunc createCallbackWrapper(ChildDeferred* newDeferred, PromiseCallbackFunc func, Deferred::State state, const CallSite& callSite);
 
 	template <typename NullCallbackFunc, typename std::enable_if<std::is_same<NullCallbackFunc, std::nullptr_t>::value>::type* = nullptr>
 	static ChildDeferred::WrappedCallbackFunc createNotifyCallbackWrapper(ChildDeferred* newDeferred, NullCallbackFunc func);
@@ -382,7 +461,7 @@ private:
 
 
 	template<typename PromiseContainer>
-	static Ptr all_impl(const PromiseContainer& promises);
+	static Ptr all_impl(const PromiseContainer& promises, const CallSite& callSite);
 	template<typename PromiseContainer>
 	static Ptr any_impl(const PromiseContainer& promises);
 	template<typename PromiseContainer>
@@ -391,6 +470,14 @@ private:
 	template<typename PromiseContainer>
 	static QVector<Deferred::Ptr> deferredsOfPromises(const PromiseContainer& promises);
 
+#ifndef QT_NO_QFUTURE
+	void bindFutureInterface(QFutureInterfaceBase futureInterface, const QFuture<void>& future,
+	                         const std::function<void(const QVariant&)>& reportResults, const QVariant& cancelReason) const;
+	template<typename T>
+	static void reportFutureResults(QFutureInterface<T>& futureInterface, const QVariant& value);
+	static void reportFutureResults(QFutureInterface<void>& futureInterface, const QVariant& value);
+#endif
+
 
 };
 
@@ -0,0 +1,271 @@
+/*! \file
+ *
+ * \brief C++20 coroutine support for promises.
+ *
+ * The coroutine support is only available when the compiler supports C++20 coroutines.
+ * In that case, the macro `QTPROMISE_HAS_COROUTINES` is defined.
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_PROMISECOROUTINE_H_
+#define QTPROMISE_PROMISECOROUTINE_H_
+
+#include "Promise.h"
+#include "Task.h"
+#include "PromiseLogging.h"
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#	if __has_include(<coroutine>)
+#		include <coroutine>
+#		if defined(__cpp_impl_coroutine) && defined(__cpp_lib_coroutine)
+#			define QTPROMISE_HAS_COROUTINES
+#		endif
+#	endif
+#endif
+
+#ifdef QTPROMISE_HAS_COROUTINES
+
+#include <QCoreApplication>
+#include <QEvent>
+
+#include <memory>
+
+namespace QtPromise
+{
+
+/*! \brief The outcome of awaiting a Promise in a coroutine.
+ *
+ * Since QtPromise does not use exceptions, awaiting a Promise does not throw when the Promise
+ * is rejected. Instead, the result of `co_await` provides the state and the data of the Promise.
+ * Returning a PromiseResult using `co_return` resolves or rejects the Promise of the coroutine
+ * accordingly. So a rejection can be forwarded like this:
+ * \code
+ * PromiseResult result = co_await promise;
+ * if (result.isRejected())
+ *     co_return result;
+ * \endcode
+ *
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+struct PromiseResult
+{
+	/*! The state of the awaited Promise. Either Deferred::Resolved or Deferred::Rejected. */
+	Deferred::State state = Deferred::Pending;
+	/*! The value or the rejection reason of the awaited Promise. */
+	QVariant data;
+
+	/*! \return \c true if the awaited Promise was resolved. */
+	bool isResolved() const { return state == Deferred::Resolved; }
+	/*! \return \c true if the awaited Promise was rejected. */
+	bool isRejected() const { return state == Deferred::Rejected; }
+
+	/*! \return A PromiseResult which resolves the Promise of a coroutine with \p value. */
+	static PromiseResult resolved(const QVariant& value = QVariant()) { return PromiseResult{Deferred::Resolved, value}; }
+	/*! \return A PromiseResult which rejects the Promise of a coroutine with \p reason. */
+	static PromiseResult rejected(const QVariant& reason = QVariant()) { return PromiseResult{Deferred::Rejected, reason}; }
+};
+
+/*! \brief Resumes coroutines in the event loop of a thread.
+ *
+ * \internal
+ */
+class CoroutineResumer : public QObject
+{
+public:
+	/*! \return The CoroutineResumer of the current thread. */
+	static CoroutineResumer* forCurrentThread()
+	{
+		static thread_local std::unique_ptr<CoroutineResumer> resumer;
+		if (!resumer)
+			resumer.reset(new CoroutineResumer);
+		return resumer.get();
+	}
+
+	/*! Resumes \p handle when the control returns to the event loop of the thread
+	 * of this CoroutineResumer.
+	 *
+	 * This method is thread-safe.
+	 */
+	void postResume(std::coroutine_handle<> handle)
+	{
+		QCoreApplication::postEvent(this, new ResumeEvent(handle));
+	}
+
+protected:
+	bool event(QEvent* event) override
+	{
+		if (event->type() == resumeEventType())
+		{
+			static_cast<ResumeEvent*>(event)->handle.resume();
+			return true;
+		}
+		return QObject::event(event);
+	}
+
+private:
+	class ResumeEvent : public QEvent
+	{
+	public:
+		explicit ResumeEvent(std::coroutine_handle<> handle) : QEvent(resumeEventType()), handle(handle) {}
+		const std::coroutine_handle<> handle;
+	};
+
+	static QEvent::Type resumeEventType()
+	{
+		static const int type = QEvent::registerEventType();
+		return static_cast<QEvent::Type>(type);
+	}
+};
+
+/*! \brief Awaiter to `co_await` a Promise::Ptr in a coroutine.
+ *
+ * When the Promise is pending, the coroutine is suspended and a settle hook is registered on the
+ * Deferred of the Promise. When the Deferred is settled, the coroutine is resumed when the control
+ * returns to the event loop of the thread which awaited the Promise. No ChildDeferred, Promise or
+ * signal connection is created. When the Promise is already settled, the coroutine continues
+ * without suspension and awaiting does not allocate memory.
+ *
+ * A suspension allocates the storage of the settle hook on the awaited Deferred and the
+ * event which resumes the coroutine.
+ *
+ * The result of `co_await` is a PromiseResult.
+ *
+ * \warning When the Deferred is destroyed while pending, the coroutine is never resumed and its frame is leaked.
+ *
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class PromiseAwaiter
+{
+public:
+	/*! Creates an awaiter for \p promise. */
+	explicit PromiseAwaiter(Promise::Ptr promise) : m_promise(std::move(promise)) {}
+
+	/*! \return \c true if the Promise is already settled. */
+	bool await_ready() const { return m_promise->state() != Deferred::Pending; }
+
+	/*! Registers the resumption of the coroutine \p handle on the Deferred.
+	 *
+	 * \return \c false if the Deferred has been settled in the meantime and the
+	 * coroutine should continue immediately.
+	 */
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		CoroutineResumer* resumer = CoroutineResumer::forCurrentThread();
+		// The hook is called while the Deferred is locked, so the resumption is posted
+		return m_promise->m_deferred->addSettleHook([resumer, handle](Deferred::State) {
+			resumer->postResume(handle);
+		}) != 0;
+	}
+
+	/*! \return The state and the data of the settled Promise. */
+	PromiseResult await_resume() const
+	{
+		return PromiseResult{m_promise->state(), m_promise->data()};
+	}
+
+private:
+	Promise::Ptr m_promise;
+};
+
+/*! Makes a Promise::Ptr awaitable in coroutines.
+ *
+ * \sa PromiseAwaiter
+ * \since 2.2.0
+ */
+inline PromiseAwaiter operator co_await(Promise::Ptr promise)
+{
+	return PromiseAwaiter(std::move(promise));
+}
+
+/*! Makes a Task::Ptr awaitable in coroutines.
+ *
+ * Awaiting a Task starts it.
+ *
+ * \sa Task::start()
+ * \since 2.2.0
+ */
+inline PromiseAwaiter operator co_await(Task::Ptr task)
+{
+	return PromiseAwaiter(task->start());
+}
+
+/*! \brief The promise type of coroutines returning a Promise::Ptr.
+ *
+ * A function returning Promise::Ptr becomes a coroutine when it uses `co_await` or `co_return`.
+ * The returned Promise is resolved with the value passed to `co_return` or resolved or rejected
+ * according to a PromiseResult passed to `co_return`:
+ * \code
+ * Promise::Ptr loadAndParse(QUrl url)
+ * {
+ *     PromiseResult reply = co_await download(url);
+ *     if (reply.isRejected())
+ *         co_return reply;
+ *     co_return parse(reply.data);
+ * }
+ * \endcode
+ *
+ * The coroutine runs synchronously until the first `co_await` of a pending Promise.
+ * The state of all steps of a coroutine is kept in its coroutine frame, which is allocated once
+ * per call. Each suspension on a pending Promise additionally allocates a settle hook and an
+ * event (see PromiseAwaiter), but unlike a chain of Promise::then() no Deferred or Promise.
+ *
+ * \note C++ requires the promise type of coroutines to be named `promise_type`. This is not
+ * to be confused with QtPromise::Promise.
+ *
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class CoroutinePromise
+{
+public:
+	/*! Creates the Deferred of the coroutine. */
+	CoroutinePromise() : m_deferred(Deferred::create()) {}
+
+	/*! \return The Promise returned to the caller of the coroutine. */
+	Promise::Ptr get_return_object() { return Promise::create(m_deferred); }
+	/*! The coroutine starts immediately. */
+	std::suspend_never initial_suspend() noexcept { return {}; }
+	/*! The coroutine frame is destroyed when the coroutine completes. */
+	std::suspend_never final_suspend() noexcept { return {}; }
+
+	/*! Resolves the Promise of the coroutine with \p value. */
+	void return_value(const QVariant& value) { m_deferred->resolve(value); }
+	/*! Resolves or rejects the Promise of the coroutine according to \p result. */
+	void return_value(const PromiseResult& result)
+	{
+		if (result.isRejected())
+			m_deferred->reject(result.data);
+		else
+			m_deferred->resolve(result.data);
+	}
+
+	/*! Rejects the Promise of the coroutine when an exception escapes the coroutine. */
+	void unhandled_exception()
+	{
+		qCCritical(lcDeferred, "Unhandled exception in coroutine returning a promise");
+		m_deferred->reject(QVariant());
+	}
+
+private:
+	Deferred::Ptr m_deferred;
+};
+
+}  // namespace QtPromise
+
+/*! Makes functions returning a Promise::Ptr coroutines.
+ *
+ * \sa QtPromise::CoroutinePromise
+ */
+template<typename... Args>
+struct std::coroutine_traits<QtPromise::Promise::Ptr, Args...>
+{
+	using promise_type = QtPromise::CoroutinePromise;
+};
+
+#endif /* QTPROMISE_HAS_COROUTINES */
+
+#endif /* QTPROMISE_PROMISECOROUTINE_H_ */
@@ -0,0 +1,267 @@
+#include "PromiseLatency.h"
+#include "Deferred.h"
+
+#include <QMutex>
+#include <QThread>
+#include <QtAlgorithms>
+
+#include <chrono>
+#include <limits>
+
+namespace QtPromise {
+
+void LatencyHistogram::record(qint64 value)
+{
+	value = qMax(Q_INT64_C(0), value);
+	if (m_buckets.isEmpty())
+		m_buckets.fill(0, BucketCount);
+	m_buckets[bucketIndex(value)] += 1;
+	m_min = (m_count == 0) ? value : qMin(m_min, value);
+	m_max = qMax(m_max, value);
+	m_sum += value;
+	m_count += 1;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	if (other.m_count == 0)
+		return;
+	if (m_buckets.isEmpty())
+		m_buckets.fill(0, BucketCount);
+	for (int index = 0; index < BucketCount; ++index)
+		m_buckets[index] += other.m_buckets.at(index);
+	m_min = (m_count == 0) ? other.m_min : qMin(m_min, other.m_min);
+	m_max = qMax(m_max, other.m_max);
+	m_sum += other.m_sum;
+	m_count += other.m_count;
+}
+
+qint64 LatencyHistogram::valueAtPercentile(double percentile) const
+{
+	if (m_count == 0)
+		return 0;
+
+	percentile = qBound(0.0, percentile, 100.0);
+	const quint64 targetCount = qMax(Q_UINT64_C(1), static_cast<quint64>(percentile / 100.0 * static_cast<double>(m_count) + 0.5));
+	quint64 cumulativeCount = 0;
+	for (int index = 0; index < BucketCount; ++index)
+	{
+		cumulativeCount += m_buckets.at(index);
+		if (cumulativeCount >= targetCount)
+			return qMin(bucketUpperBound(index), m_max);
+	}
+	return m_max;
+}
+
+int LatencyHistogram::bucketIndex(qint64 value)
+{
+	if (value < SubBucketCount)
+		return static_cast<int>(qMax(Q_INT64_C(0), value));
+
+	// Position of the highest set bit. Is at least 4 since value >= SubBucketCount.
+	const int exponent = 63 - static_cast<int>(qCountLeadingZeroBits(static_cast<quint64>(value)));
+	if (exponent > MaxExponent)
+		return BucketCount - 1;
+	const int subBucket = static_cast<int>((value >> (exponent - 4)) & (SubBucketCount - 1));
+	return SubBucketCount + (exponent - 4) * SubBucketCount + subBucket;
+}
+
+qint64 LatencyHistogram::bucketLowerBound(int index)
+{
+	if (index < SubBucketCount)
+		return index;
+	const int exponent = (index - SubBucketCount) / SubBucketCount + 4;
+	const int subBucket = (index - SubBucketCount) % SubBucketCount;
+	return static_cast<qint64>(SubBucketCount + subBucket) << (exponent - 4);
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int index)
+{
+	if (index >= BucketCount - 1)
+		return std::numeric_limits<qint64>::max();
+	return bucketLowerBound(index + 1) - 1;
+}
+
+
+/*!
+ * \cond INTERNAL
+ */
+
+namespace {
+
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+
+/* The histograms are only written by the owning thread. The lock is
+ * therefore uncontended except while reading the histograms.
+ */
+struct ThreadRecorder
+{
+	QMutex lock;
+	PromiseLatency::ThreadHistograms histograms;
+};
+
+struct Registry
+{
+	QMutex lock;
+	QVector<ThreadRecorder*> threads;
+	PromiseLatency::ThreadHistograms finishedThreads;
+};
+
+Registry& registry()
+{
+	/* Intentionally leaked since thread local recorders of other threads
+	 * can be destroyed after the static objects.
+	 */
+	static Registry* instance = new Registry;
+	return *instance;
+}
+
+struct ThreadRecorderHolder
+{
+	ThreadRecorderHolder()
+	{
+		recorder.histograms.threadId = QThread::currentThreadId();
+		recorder.histograms.threadName = QThread::currentThread()->objectName();
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		reg.threads.append(&recorder);
+	}
+
+	~ThreadRecorderHolder()
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		reg.finishedThreads.queueDelay.merge(recorder.histograms.queueDelay);
+		reg.finishedThreads.executionTime.merge(recorder.histograms.executionTime);
+		reg.threads.removeOne(&recorder);
+	}
+
+	ThreadRecorder recorder;
+};
+
+ThreadRecorder& localRecorder()
+{
+	thread_local ThreadRecorderHolder holder;
+	return holder.recorder;
+}
+
+thread_local qint64 currentSettleTimestampValue = 0;
+
+#endif /* QTPROMISE_LATENCY_HISTOGRAMS */
+
+} // namespace
+
+/*!
+ * \endcond
+ */
+
+
+bool PromiseLatency::isEnabled()
+{
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+	return true;
+#else
+	return false;
+#endif
+}
+
+QVector<PromiseLatency::ThreadHistograms> PromiseLatency::threadHistograms()
+{
+	QVector<ThreadHistograms> result;
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+	Registry& reg = registry();
+	QMutexLocker locker(&reg.lock);
+	for (ThreadRecorder* recorder : const_cast<const QVector<ThreadRecorder*>&>(reg.threads))
+	{
+		QMutexLocker recorderLocker(&recorder->lock);
+		result.append(recorder->histograms);
+	}
+	if (reg.finishedThreads.queueDelay.count() > 0 || reg.finishedThreads.executionTime.count() > 0)
+		result.append(reg.finishedThreads);
+#endif
+	return result;
+}
+
+PromiseLatency::ThreadHistograms PromiseLatency::total()
+{
+	ThreadHistograms result;
+	for (const ThreadHistograms& histograms : threadHistograms())
+	{
+		result.queueDelay.merge(histograms.queueDelay);
+		result.executionTime.merge(histograms.executionTime);
+	}
+	return result;
+}
+
+
+/*!
+ * \cond INTERNAL
+ */
+
+qint64 PromiseLatency::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+qint64 PromiseLatency::settleTimestamp(const Deferred* deferred)
+{
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+	QMutexLocker locker(&deferred->m_lock);
+	return deferred->m_settleTimestamp;
+#else
+	Q_UNUSED(deferred)
+	return 0;
+#endif
+}
+
+qint64 PromiseLatency::currentSettleTimestamp()
+{
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+	return currentSettleTimestampValue;
+#else
+	return 0;
+#endif
+}
+
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+
+PromiseLatency::SettleScope::SettleScope(qint64 settleTimestamp)
+	: m_previousSettleTimestamp(currentSettleTimestampValue)
+{
+	currentSettleTimestampValue = settleTimestamp;
+}
+
+PromiseLatency::SettleScope::~SettleScope()
+{
+	currentSettleTimestampValue = m_previousSettleTimestamp;
+}
+
+PromiseLatency::ContinuationScope::ContinuationScope()
+	: m_begin(now())
+	, m_settleTimestamp(currentSettleTimestampValue)
+{
+}
+
+PromiseLatency::ContinuationScope::ContinuationScope(const Deferred* settledDeferred)
+	: m_begin(now())
+	, m_settleTimestamp(settledDeferred ? settleTimestamp(settledDeferred) : 0)
+{
+}
+
+PromiseLatency::ContinuationScope::~ContinuationScope()
+{
+	const qint64 end = now();
+	ThreadRecorder& recorder = localRecorder();
+	QMutexLocker locker(&recorder.lock);
+	if (m_settleTimestamp > 0)
+		recorder.histograms.queueDelay.record(m_begin - m_settleTimestamp);
+	recorder.histograms.executionTime.record(end - m_begin);
+}
+
+#endif /* QTPROMISE_LATENCY_HISTOGRAMS */
+
+/*!
+ * \endcond
+ */
+
+}  // namespace QtPromise
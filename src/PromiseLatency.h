@@ -0,0 +1,199 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_PROMISELATENCY_H_
+#define QTPROMISE_PROMISELATENCY_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+
+
+namespace QtPromise {
+
+class Deferred;
+
+/*! \brief A histogram of durations with logarithmic buckets.
+ *
+ * The histogram follows the idea of the HDR histogram: the buckets are grouped by
+ * powers of two and each power of two is divided into #SubBucketCount linear sub-buckets.
+ * So the relative error of a recorded value is at most `1/SubBucketCount` regardless
+ * of the magnitude of the value while the number of buckets stays fixed.
+ *
+ * The values are durations in nanoseconds.
+ * Values larger than `2^(MaxExponent+1)` nanoseconds are recorded in the last bucket.
+ *
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class LatencyHistogram
+{
+public:
+	/*! The number of linear sub-buckets per power of two. */
+	static const int SubBucketCount = 16;
+	/*! The exponent of the largest power of two covered by the buckets. */
+	static const int MaxExponent = 45;
+	/*! The total number of buckets. */
+	static const int BucketCount = SubBucketCount + (MaxExponent - 3) * SubBucketCount;
+
+	/*! Records a value.
+	 *
+	 * \param value The duration in nanoseconds. Negative values are recorded as \c 0.
+	 */
+	void record(qint64 value);
+	/*! Adds the values recorded in another histogram to this histogram.
+	 *
+	 * \param other The histogram whose values are added.
+	 */
+	void merge(const LatencyHistogram& other);
+
+	/*! \return The number of recorded values. */
+	quint64 count() const { return m_count; }
+	/*! \return The smallest recorded value or \c 0 if the histogram is empty. */
+	qint64 min() const { return m_count > 0 ? m_min : 0; }
+	/*! \return The largest recorded value or \c 0 if the histogram is empty. */
+	qint64 max() const { return m_max; }
+	/*! \return The arithmetic mean of the recorded values or \c 0 if the histogram is empty. */
+	double mean() const { return m_count > 0 ? static_cast<double>(m_sum) / static_cast<double>(m_count) : 0.0; }
+	/*! Calculates a percentile of the recorded values.
+	 *
+	 * \param percentile The percentile between \c 0 and \c 100.
+	 * \return The largest value which is equivalent to the value at the \p percentile
+	 * within the precision of the histogram. \c 0 if the histogram is empty.
+	 */
+	qint64 valueAtPercentile(double percentile) const;
+	/*! \param index The index of a bucket.
+	 * \return The number of values recorded in the bucket.
+	 */
+	quint64 countAtBucket(int index) const { return m_buckets.isEmpty() ? 0 : m_buckets.at(index); }
+
+	/*! \param value A duration in nanoseconds.
+	 * \return The index of the bucket which records the \p value.
+	 */
+	static int bucketIndex(qint64 value);
+	/*! \param index The index of a bucket.
+	 * \return The smallest value recorded in the bucket.
+	 */
+	static qint64 bucketLowerBound(int index);
+	/*! \param index The index of a bucket.
+	 * \return The largest value recorded in the bucket.
+	 */
+	static qint64 bucketUpperBound(int index);
+
+private:
+	QVector<quint64> m_buckets;
+	quint64 m_count = 0;
+	qint64 m_sum = 0;
+	qint64 m_min = 0;
+	qint64 m_max = 0;
+};
+
+/*! \brief Latency instrumentation of promise continuations.
+ *
+ * When the library is built with the CMake option `QTPROMISE_LATENCY_HISTOGRAMS` (which defines
+ * the preprocessor macro of the same name), the continuations registered with Promise::then()
+ * and the asynchronous signal emissions of a Promise are timed. Two histograms are recorded:
+ * - The *queueing delay*: the time between the resolution/rejection of a Deferred and the
+ * start of the continuation. This includes the time spent in other slots and continuations of
+ * the Deferred which run before and the time spent waiting in the event queue.
+ * - The *execution time*: the time spent in the continuation itself.
+ *
+ * Continuations which are registered on an already resolved/rejected Deferred are executed
+ * directly by Promise::then(). They only contribute to the execution time.
+ *
+ * The histograms are recorded per thread. Threads which have finished are combined into one
+ * entry with a \c nullptr threadId.
+ *
+ * When the option is disabled, the instrumentation is compiled out completely, isEnabled()
+ * returns \c false and the histograms stay empty. The macro is a public compile definition of the
+ * library target, so code linking against it is compiled with the same setting.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class PromiseLatency
+{
+public:
+	/*! The histograms of one thread.
+	 */
+	struct ThreadHistograms
+	{
+		/*! The ID of the thread. See QThread::currentThreadId(). */
+		Qt::HANDLE threadId = nullptr;
+		/*! The QObject::objectName() of the QThread when the first value was recorded. */
+		QString threadName;
+		/*! The queueing delays of the continuations executed in the thread. */
+		LatencyHistogram queueDelay;
+		/*! The execution times of the continuations executed in the thread. */
+		LatencyHistogram executionTime;
+	};
+
+	/*! \return \c true if the library has been built with latency instrumentation.
+	 */
+	static bool isEnabled();
+
+	/*! \return The histograms of each thread which executed continuations.
+	 */
+	static QVector<ThreadHistograms> threadHistograms();
+	/*! \return The histograms of all threads merged.
+	 */
+	static ThreadHistograms total();
+
+	/*! \cond INTERNAL */
+
+	/*! \return The current time of a monotonic clock in nanoseconds. */
+	static qint64 now();
+	/*! \return The time when \p deferred was resolved or rejected as returned by now()
+	 * or \c 0 if it is still pending or if the instrumentation is disabled.
+	 */
+	static qint64 settleTimestamp(const Deferred* deferred);
+	/*! \return The settle timestamp of the Deferred whose signals are currently emitted
+	 * in the current thread or \c 0 if there is none.
+	 */
+	static qint64 currentSettleTimestamp();
+
+#ifdef QTPROMISE_LATENCY_HISTOGRAMS
+	/*! Marks the emission of the signals of a resolved/rejected Deferred.
+	 */
+	class SettleScope
+	{
+	public:
+		explicit SettleScope(qint64 settleTimestamp);
+		~SettleScope();
+	private:
+		Q_DISABLE_COPY(SettleScope)
+		qint64 m_previousSettleTimestamp;
+	};
+
+	/*! Times the execution of a continuation.
+	 */
+	class ContinuationScope
+	{
+	public:
+		/*! Times a continuation triggered by the Deferred whose signals are currently emitted. */
+		ContinuationScope();
+		/*! Times a continuation of \p settledDeferred.
+		 * If \p settledDeferred is \c nullptr, only the execution time is recorded.
+		 */
+		explicit ContinuationScope(const Deferred* settledDeferred);
+		~ContinuationScope();
+	private:
+		Q_DISABLE_COPY(ContinuationScope)
+		qint64 m_begin;
+		qint64 m_settleTimestamp;
+	};
+#endif
+
+	/*! \endcond */
+
+private:
+	PromiseLatency() = delete;
+};
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_PROMISELATENCY_H_ */
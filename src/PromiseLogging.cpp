@@ -0,0 +1,9 @@
+#include "PromiseLogging.h"
+
+namespace QtPromise {
+
+Q_LOGGING_CATEGORY(lcDeferred, "qtpromise.deferred")
+Q_LOGGING_CATEGORY(lcNetwork, "qtpromise.network")
+Q_LOGGING_CATEGORY(lcWatchdog, "qtpromise.watchdog")
+
+}  // namespace QtPromise
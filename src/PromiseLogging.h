@@ -0,0 +1,28 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_PROMISELOGGING_H_
+#define QTPROMISE_PROMISELOGGING_H_
+
+#include <QLoggingCategory>
+
+namespace QtPromise {
+
+/*!
+ * \cond INTERNAL
+ */
+
+Q_DECLARE_LOGGING_CATEGORY(lcDeferred)
+Q_DECLARE_LOGGING_CATEGORY(lcNetwork)
+Q_DECLARE_LOGGING_CATEGORY(lcWatchdog)
+
+/*!
+ * \endcond
+ */
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_PROMISELOGGING_H_ */
@@ -0,0 +1,348 @@
+#include "PromiseMetrics.h"
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVector>
+
+namespace QtPromise {
+
+/*!
+ * \cond INTERNAL
+ */
+
+namespace {
+
+/* The counters are only written by the thread owning them.
+ * So a plain load and store is sufficient to increment them. They are atomic
+ * nevertheless to allow reading them from other threads.
+ */
+struct ThreadCounters
+{
+	QAtomicInteger<qint64> created[PromiseMetrics::DeferredTypeCount];
+	QAtomicInteger<qint64> resolved[PromiseMetrics::DeferredTypeCount];
+	QAtomicInteger<qint64> rejected[PromiseMetrics::DeferredTypeCount];
+	QAtomicInteger<qint64> destroyed[PromiseMetrics::DeferredTypeCount];
+	QAtomicInteger<qint64> destroyedPending[PromiseMetrics::DeferredTypeCount];
+	QAtomicInteger<qint64> sitterPromises;
+	QAtomicInteger<qint64> asyncActionsStarted;
+	QAtomicInteger<qint64> asyncActionsFinished;
+	QAtomicInteger<qint64> timerActionsStarted;
+	QAtomicInteger<qint64> timerActionsFinished;
+};
+
+/* Set when the counters of the current thread have been merged into the finished threads.
+ * Thread local objects are destroyed before the static objects, so Deferreds and PromiseSitters
+ * destroyed during the static destruction update the finished threads directly.
+ * The flag is trivially destructible and can therefore be read after the thread locals
+ * of the thread have been destroyed.
+ */
+thread_local bool localCountersDestroyed = false;
+
+inline void add(QAtomicInteger<qint64>& counter, qint64 delta = 1)
+{
+	if (Q_UNLIKELY(localCountersDestroyed))
+		counter.fetchAndAddRelaxed(delta);
+	else
+		counter.store(counter.load() + delta);
+}
+
+/* Merges the counters of a finished thread. Uses atomic additions since
+ * multiple threads can finish concurrently.
+ */
+inline void merge(QAtomicInteger<qint64>& target, const QAtomicInteger<qint64>& source)
+{
+	target.fetchAndAddRelaxed(source.load());
+}
+
+struct Registry
+{
+	QMutex lock;
+	QVector<ThreadCounters*> threads;
+	ThreadCounters finishedThreads;
+};
+
+Registry& registry()
+{
+	/* Intentionally leaked since thread local counters of other threads
+	 * can be destroyed after the static objects.
+	 */
+	static Registry* instance = new Registry;
+	return *instance;
+}
+
+struct ThreadCountersHolder
+{
+	ThreadCountersHolder()
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		reg.threads.append(&counters);
+	}
+
+	~ThreadCountersHolder()
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		ThreadCounters& target = reg.finishedThreads;
+		for (int type = 0; type < PromiseMetrics::DeferredTypeCount; ++type)
+		{
+			merge(target.created[type], counters.created[type]);
+			merge(target.resolved[type], counters.resolved[type]);
+			merge(target.rejected[type], counters.rejected[type]);
+			merge(target.destroyed[type], counters.destroyed[type]);
+			merge(target.destroyedPending[type], counters.destroyedPending[type]);
+		}
+		merge(target.sitterPromises, counters.sitterPromises);
+		merge(target.asyncActionsStarted, counters.asyncActionsStarted);
+		merge(target.asyncActionsFinished, counters.asyncActionsFinished);
+		merge(target.timerActionsStarted, counters.timerActionsStarted);
+		merge(target.timerActionsFinished, counters.timerActionsFinished);
+		reg.threads.removeOne(&counters);
+		localCountersDestroyed = true;
+	}
+
+	ThreadCounters counters;
+};
+
+ThreadCounters& localCounters()
+{
+	if (Q_UNLIKELY(localCountersDestroyed))
+		return registry().finishedThreads;
+	thread_local ThreadCountersHolder holder;
+	return holder.counters;
+}
+
+void accumulate(PromiseMetrics::Snapshot& snapshot, const ThreadCounters& counters)
+{
+	for (int type = 0; type < PromiseMetrics::DeferredTypeCount; ++type)
+	{
+		PromiseMetrics::DeferredCounters& deferreds = snapshot.deferreds[type];
+		const qint64 created = counters.created[type].load();
+		const qint64 resolved = counters.resolved[type].load();
+		const qint64 rejected = counters.rejected[type].load();
+		deferreds.created += created;
+		deferreds.resolved += resolved;
+		deferreds.rejected += rejected;
+		deferreds.live += created - counters.destroyed[type].load();
+		deferreds.pending += created - resolved - rejected - counters.destroyedPending[type].load();
+	}
+	snapshot.sitterPromises += counters.sitterPromises.load();
+	snapshot.asyncQueueDepth += counters.asyncActionsStarted.load() - counters.asyncActionsFinished.load();
+	snapshot.pendingTimers += counters.timerActionsStarted.load() - counters.timerActionsFinished.load();
+}
+
+void appendHeader(QByteArray& text, const char* name, const char* type, const char* help)
+{
+	text += "# HELP ";
+	text += name;
+	text += ' ';
+	text += help;
+	text += "\n# TYPE ";
+	text += name;
+	text += ' ';
+	text += type;
+	text += '\n';
+}
+
+void appendSample(QByteArray& text, const char* name, const QByteArray& labels, qint64 value)
+{
+	text += name;
+	if (!labels.isEmpty())
+	{
+		text += '{';
+		text += labels;
+		text += '}';
+	}
+	text += ' ';
+	text += QByteArray::number(value);
+	text += '\n';
+}
+
+QByteArray typeLabel(int type)
+{
+	return "type=\"" + PromiseMetrics::typeName(static_cast<PromiseMetrics::DeferredType>(type)).toUtf8() + '"';
+}
+
+} // namespace
+
+/*!
+ * \endcond
+ */
+
+
+PromiseMetrics::DeferredCounters PromiseMetrics::Snapshot::total() const
+{
+	DeferredCounters result;
+	for (const DeferredCounters& counters : deferreds)
+	{
+		result.live += counters.live;
+		result.pending += counters.pending;
+		result.created += counters.created;
+		result.resolved += counters.resolved;
+		result.rejected += counters.rejected;
+	}
+	return result;
+}
+
+double PromiseMetrics::Snapshot::settlesPerSecond(const Snapshot& earlier) const
+{
+	const qint64 elapsed = timestamp - earlier.timestamp;
+	if (elapsed <= 0)
+		return 0.0;
+	return static_cast<double>(total().settled() - earlier.total().settled()) * 1000.0 / static_cast<double>(elapsed);
+}
+
+double PromiseMetrics::Snapshot::rejectionRate(const Snapshot& earlier) const
+{
+	const DeferredCounters current = total();
+	const DeferredCounters previous = earlier.total();
+	const qint64 settled = current.settled() - previous.settled();
+	if (settled <= 0)
+		return 0.0;
+	return static_cast<double>(current.rejected - previous.rejected) / static_cast<double>(settled);
+}
+
+PromiseMetrics::Snapshot PromiseMetrics::snapshot()
+{
+	Snapshot result;
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		accumulate(result, reg.finishedThreads);
+		for (const ThreadCounters* counters : const_cast<const QVector<ThreadCounters*>&>(reg.threads))
+			accumulate(result, *counters);
+	}
+	result.timestamp = QElapsedTimer::msecsSinceReference();
+
+	/* The counters of different threads are not read at exactly the same time.
+	 * So the gauges can be slightly off while other threads are working.
+	 */
+	for (DeferredCounters& counters : result.deferreds)
+	{
+		counters.live = qMax(Q_INT64_C(0), counters.live);
+		counters.pending = qMax(Q_INT64_C(0), counters.pending);
+	}
+	result.sitterPromises = qMax(Q_INT64_C(0), result.sitterPromises);
+	result.asyncQueueDepth = qMax(Q_INT64_C(0), result.asyncQueueDepth);
+	result.pendingTimers = qMax(Q_INT64_C(0), result.pendingTimers);
+	return result;
+}
+
+QByteArray PromiseMetrics::toPrometheusText()
+{
+	return toPrometheusText(snapshot());
+}
+
+QByteArray PromiseMetrics::toPrometheusText(const Snapshot& snapshot)
+{
+	QByteArray text;
+
+	appendHeader(text, "qtpromise_deferreds", "gauge", "Number of existing Deferreds.");
+	for (int type = 0; type < DeferredTypeCount; ++type)
+		appendSample(text, "qtpromise_deferreds", typeLabel(type), snapshot.deferreds[type].live);
+
+	appendHeader(text, "qtpromise_deferreds_pending", "gauge", "Number of existing Deferreds which are pending.");
+	for (int type = 0; type < DeferredTypeCount; ++type)
+		appendSample(text, "qtpromise_deferreds_pending", typeLabel(type), snapshot.deferreds[type].pending);
+
+	appendHeader(text, "qtpromise_deferreds_created_total", "counter", "Number of created Deferreds.");
+	for (int type = 0; type < DeferredTypeCount; ++type)
+		appendSample(text, "qtpromise_deferreds_created_total", typeLabel(type), snapshot.deferreds[type].created);
+
+	appendHeader(text, "qtpromise_deferreds_settled_total", "counter", "Number of resolved or rejected Deferreds.");
+	for (int type = 0; type < DeferredTypeCount; ++type)
+	{
+		appendSample(text, "qtpromise_deferreds_settled_total", typeLabel(type) + ",state=\"resolved\"", snapshot.deferreds[type].resolved);
+		appendSample(text, "qtpromise_deferreds_settled_total", typeLabel(type) + ",state=\"rejected\"", snapshot.deferreds[type].rejected);
+	}
+
+	appendHeader(text, "qtpromise_sitter_promises", "gauge", "Number of promises held by PromiseSitters.");
+	appendSample(text, "qtpromise_sitter_promises", QByteArray(), snapshot.sitterPromises);
+
+	appendHeader(text, "qtpromise_async_queue_depth", "gauge", "Number of asynchronous actions waiting for the event loop.");
+	appendSample(text, "qtpromise_async_queue_depth", QByteArray(), snapshot.asyncQueueDepth);
+
+	appendHeader(text, "qtpromise_pending_timers", "gauge", "Number of pending timer based actions.");
+	appendSample(text, "qtpromise_pending_timers", QByteArray(), snapshot.pendingTimers);
+
+	return text;
+}
+
+QString PromiseMetrics::typeName(DeferredType type)
+{
+	switch (type)
+	{
+	case ChildDeferredType:
+		return QStringLiteral("ChildDeferred");
+	case NetworkDeferredType:
+		return QStringLiteral("NetworkDeferred");
+	case FutureDeferredType:
+		return QStringLiteral("FutureDeferred");
+	case BaseDeferredType:
+	default:
+		return QStringLiteral("Deferred");
+	}
+}
+
+
+/*!
+ * \cond INTERNAL
+ */
+
+PromiseMetrics::PendingAction::PendingAction(Kind kind)
+	: m_kind(kind)
+{
+	add(kind == AsyncAction ? localCounters().asyncActionsStarted : localCounters().timerActionsStarted);
+}
+
+PromiseMetrics::PendingAction::PendingAction(const PendingAction& other)
+	: m_kind(other.m_kind)
+{
+	if (m_kind != Released)
+		add(m_kind == AsyncAction ? localCounters().asyncActionsStarted : localCounters().timerActionsStarted);
+}
+
+PromiseMetrics::PendingAction::PendingAction(PendingAction&& other)
+	: m_kind(other.m_kind)
+{
+	other.m_kind = Released;
+}
+
+void PromiseMetrics::PendingAction::release()
+{
+	if (m_kind == Released)
+		return;
+	add(m_kind == AsyncAction ? localCounters().asyncActionsFinished : localCounters().timerActionsFinished);
+	m_kind = Released;
+}
+
+void PromiseMetrics::deferredCreated(DeferredType type)
+{
+	add(localCounters().created[type]);
+}
+
+void PromiseMetrics::deferredSettled(DeferredType type, bool rejected)
+{
+	ThreadCounters& counters = localCounters();
+	add(rejected ? counters.rejected[type] : counters.resolved[type]);
+}
+
+void PromiseMetrics::deferredDestroyed(DeferredType type, bool pending)
+{
+	ThreadCounters& counters = localCounters();
+	add(counters.destroyed[type]);
+	if (pending)
+		add(counters.destroyedPending[type]);
+}
+
+void PromiseMetrics::sitterPromisesChanged(int delta)
+{
+	add(localCounters().sitterPromises, delta);
+}
+
+/*!
+ * \endcond
+ */
+
+}  // namespace QtPromise
@@ -0,0 +1,194 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_PROMISEMETRICS_H_
+#define QTPROMISE_PROMISEMETRICS_H_
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QString>
+
+
+namespace QtPromise {
+
+/*! \brief Runtime metrics about the usage of the QtPromise library.
+ *
+ * PromiseMetrics collects counters and gauges about the Deferreds, the PromiseSitters and
+ * the asynchronous actions of the library in the whole process. The metrics can be
+ * queried as a Snapshot or rendered in the [Prometheus text format](https://prometheus.io/docs/instrumenting/exposition_formats/)
+ * using toPrometheusText(), for example to expose them from an HTTP endpoint of the
+ * application.
+ *
+ * The following metrics are collected:
+ * - The number of existing and pending Deferreds per DeferredType.
+ * - The number of created, resolved and rejected Deferreds per DeferredType.
+ * - The number of promises held by all PromiseSitters.
+ * - The number of asynchronous actions which are waiting in the event queue to be executed
+ * when the control returns to the event loop (for example the emission of the signals of
+ * a Promise which is created for an already resolved Deferred).
+ * - The number of pending timer based actions (for example Promise::delayedResolve()).
+ *
+ * Rates like the number of settled Deferreds per second or the rejection rate can be
+ * calculated from two snapshots using Snapshot::settlesPerSecond() and Snapshot::rejectionRate().
+ * When using Prometheus, the `rate()` function should be applied to the exported counters instead.
+ *
+ * ## Overhead ##
+ * The metrics are recorded in counters which are local to the thread doing the recording.
+ * So recording a metric does not need any locking or atomic read-modify-write operations.
+ * The thread local counters are aggregated when reading the metrics using snapshot().
+ * When a thread finishes, its counters are merged into process wide counters.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class PromiseMetrics
+{
+public:
+	/*! The types of Deferreds which are distinguished by the metrics.
+	 */
+	enum DeferredType
+	{
+		BaseDeferredType = 0,    //!< A Deferred or a class derived from Deferred outside of the library.
+		ChildDeferredType = 1,   //!< A ChildDeferred as used internally by Promise::then() and Promise::all().
+		NetworkDeferredType = 2, //!< A NetworkDeferred.
+		FutureDeferredType = 3   //!< A FutureDeferred.
+	};
+	/*! The number of values of the DeferredType enum. */
+	static const int DeferredTypeCount = 4;
+
+	/*! Metrics about the Deferreds of one DeferredType.
+	 */
+	struct DeferredCounters
+	{
+		/*! The number of existing Deferreds (gauge). */
+		qint64 live = 0;
+		/*! The number of existing Deferreds which are \ref Deferred::Pending (gauge). */
+		qint64 pending = 0;
+		/*! The total number of created Deferreds (counter). */
+		qint64 created = 0;
+		/*! The total number of resolved Deferreds (counter). */
+		qint64 resolved = 0;
+		/*! The total number of rejected Deferreds (counter). */
+		qint64 rejected = 0;
+
+		/*! \return The total number of resolved or rejected Deferreds. */
+		qint64 settled() const { return resolved + rejected; }
+	};
+
+	/*! The state of the metrics at a point in time.
+	 */
+	struct Snapshot
+	{
+		/*! The time when the snapshot was taken in milliseconds.
+		 * The value is based on a monotonic clock and can only be compared to the timestamps
+		 * of other snapshots. See QElapsedTimer::msecsSinceReference().
+		 */
+		qint64 timestamp = 0;
+		/*! The metrics of the Deferreds, indexed by DeferredType. */
+		DeferredCounters deferreds[DeferredTypeCount];
+		/*! The number of promises held by all PromiseSitters (gauge). */
+		qint64 sitterPromises = 0;
+		/*! The number of asynchronous actions waiting in the event queues (gauge). */
+		qint64 asyncQueueDepth = 0;
+		/*! The number of pending timer based actions (gauge). */
+		qint64 pendingTimers = 0;
+
+		/*! \return The metrics of all types of Deferreds summed up. */
+		DeferredCounters total() const;
+		/*! Calculates the number of Deferreds settled per second.
+		 *
+		 * \param earlier A snapshot taken before this snapshot.
+		 * \return The number of Deferreds which have been resolved or rejected per second
+		 * between \p earlier and this snapshot. \c 0 if the snapshots have the same timestamp.
+		 */
+		double settlesPerSecond(const Snapshot& earlier) const;
+		/*! Calculates the rejection rate.
+		 *
+		 * \param earlier A snapshot taken before this snapshot.
+		 * \return The fraction of the Deferreds settled between \p earlier and this snapshot
+		 * which have been rejected. A value between \c 0 and \c 1. \c 0 if no Deferreds have
+		 * been settled in between.
+		 */
+		double rejectionRate(const Snapshot& earlier) const;
+	};
+
+	/*! Collects the current metrics.
+	 *
+	 * \return A snapshot of the metrics.
+	 */
+	static Snapshot snapshot();
+
+	/*! Renders the current metrics in the Prometheus text format.
+	 *
+	 * \return The UTF-8 encoded metrics. Suitable as body of an HTTP response
+	 * with the content type `text/plain; version=0.0.4`.
+	 */
+	static QByteArray toPrometheusText();
+	/*! Renders metrics in the Prometheus text format.
+	 *
+	 * \param snapshot The metrics to be rendered.
+	 * \return The UTF-8 encoded metrics.
+	 */
+	static QByteArray toPrometheusText(const Snapshot& snapshot);
+
+	/*! \return The name of a DeferredType as used in the label of the Prometheus metrics.
+	 * For example `"NetworkDeferred"` for NetworkDeferredType.
+	 */
+	static QString typeName(DeferredType type);
+
+private:
+	friend class Deferred;
+	friend class ChildDeferred;
+	friend class NetworkDeferred;
+	friend class FutureDeferred;
+	friend class Promise;
+	friend class PromiseSitter;
+
+	PromiseMetrics() = delete;
+
+	/*! \cond INTERNAL */
+
+	/*! Tracks an asynchronous action while it is waiting to be executed.
+	 *
+	 * The action counts as pending from the construction of the PendingAction until
+	 * release() is called or the PendingAction is destroyed. Copying a PendingAction
+	 * tracks an additional action so a PendingAction can be captured by value
+	 * in the functor of the action.
+	 */
+	class PendingAction
+	{
+	public:
+		enum Kind
+		{
+			AsyncAction, //!< Executed when the control returns to the event loop.
+			TimerAction  //!< Executed when a timer with a non-zero timeout fires.
+		};
+
+		explicit PendingAction(Kind kind);
+		PendingAction(const PendingAction& other);
+		PendingAction(PendingAction&& other);
+		~PendingAction() { release(); }
+		PendingAction& operator=(const PendingAction& other) = delete;
+
+		void release();
+
+	private:
+		static const int Released = -1;
+		int m_kind;
+	};
+
+	static void deferredCreated(DeferredType type);
+	static void deferredSettled(DeferredType type, bool rejected);
+	static void deferredDestroyed(DeferredType type, bool pending);
+	static void sitterPromisesChanged(int delta);
+
+	/*! \endcond */
+};
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_PROMISEMETRICS_H_ */
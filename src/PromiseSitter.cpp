@@ -1,5 +1,7 @@
 #include "PromiseSitter.h"
 
+#include <algorithm>
+
 namespace QtPromise {
 
 Q_GLOBAL_STATIC(PromiseSitter, promiseSitterGlobalInstance)
@@ -9,78 +11,610 @@ PromiseSitter* PromiseSitter::instance()
 	return promiseSitterGlobalInstance;
 }
 
-PromiseSitter::~PromiseSitter()
+PromiseSitter::PromiseSitter(QObject* parent)
+	: QObject(parent)
+	, m_count(0)
+	, m_nextEntryId(1)
+	, m_scheduler(Scheduler::instance())
+	, m_clockStart(m_scheduler->now())
+	, m_capacity(0)
+	, m_overflowPolicy(RejectNew)
+	, m_lowWatermark(0)
+	, m_highWatermark(0)
+	, m_aboveHighWatermark(0)
+	, m_spaceWaiterCount(0)
+	, m_drainWaiterCount(0)
+	, m_maxAge(0)
+	, m_expiryAction(RemoveExpired)
+	, m_expiredCount(0)
+	, m_wheelTick(0)
+	, m_wheelItemCount(0)
+	, m_expiryTimerRequested(false)
+	, m_expiryTask(0)
+	, m_removalPosted(false)
 {
-	for (auto iter = m_sitterConnections.cbegin(); iter != m_sitterConnections.cend(); ++iter)
-		QObject::disconnect(iter.value());
-	for (auto iter = m_contextConnections.cbegin(); iter != m_contextConnections.cend(); ++iter)
-		QObject::disconnect(iter.value());
 }
 
-void PromiseSitter::add(Promise::Ptr promise, const QVector<const QObject*>& contextObjs)
+PromiseSitter::~PromiseSitter()
 {
-	if (promise->state() == Deferred::Pending)
+	if (m_expiryTask != 0)
+		m_scheduler->cancel(m_expiryTask);
+
+	for (Shard& shard : m_shards)
 	{
-		QWriteLocker locker{&m_lock};
-		Promise* rawPromise = promise.data();
-		if (!m_promises.contains(rawPromise))
+		QHash<const Promise*, Entry> entries;
 		{
-			/* Need to use QueuedConnection since we may not delete the promise
-			 * in a slot connected to its signal.
-			 */
-			auto resolveConnection = QObject::connect(rawPromise, &Promise::resolved, this, [this, rawPromise](const QVariant&) {
-				this->remove(rawPromise);
-			}, Qt::QueuedConnection);
-			m_sitterConnections.insert(rawPromise, resolveConnection);
-			auto rejectConnection = QObject::connect(rawPromise, &Promise::rejected, this, [this, rawPromise](const QVariant&) {
-				this->remove(rawPromise);
-			}, Qt::QueuedConnection);
-			m_sitterConnections.insert(rawPromise, rejectConnection);
-			m_promises.insert(rawPromise, promise);
+			QWriteLocker locker{&shard.lock};
+			entries.swap(shard.entries);
 		}
-		// Connect context objects
-		for (auto contextObj : contextObjs)
+		PromiseMetrics::sitterPromisesChanged(-entries.size());
+		for (auto iter = entries.cbegin(); iter != entries.cend(); ++iter)
+			releaseEntry(iter.value());
+	}
+
+	QList<Deferred::Ptr> spaceWaiters;
+	{
+		QMutexLocker locker{&m_spaceWaitersLock};
+		spaceWaiters.swap(m_spaceWaiters);
+	}
+	for (Deferred::Ptr waiter : const_cast<const QList<Deferred::Ptr>&>(spaceWaiters))
+		waiter->reject();
+
+	QList<Deferred::Ptr> drainWaiters;
+	{
+		QMutexLocker locker{&m_drainLock};
+		drainWaiters.swap(m_drainWaiters);
+	}
+	for (Deferred::Ptr waiter : const_cast<const QList<Deferred::Ptr>&>(drainWaiters))
+		waiter->reject(QVariant::fromValue(QList<Straggler>()));
+}
+
+int PromiseSitter::shardIndex(const Promise* promise)
+{
+	/* The lower bits of the address are always zero due to the alignment of
+	 * the allocation. So we drop them before hashing to spread the promises
+	 * evenly across the shards.
+	 */
+	return static_cast<int>(qHash(reinterpret_cast<quintptr>(promise) >> 4) & (ShardCount - 1));
+}
+
+PromiseSitter::Shard& PromiseSitter::shardFor(const Promise* promise)
+{
+	return m_shards[shardIndex(promise)];
+}
+
+const PromiseSitter::Shard& PromiseSitter::shardFor(const Promise* promise) const
+{
+	return m_shards[shardIndex(promise)];
+}
+
+bool PromiseSitter::add(Promise::Ptr promise, const QVector<const QObject*>& contextObjs, int maxAgeMs)
+{
+	if (promise->state() != Deferred::Pending)
+		return false;
+
+	Promise* rawPromise = promise.data();
+	Deferred* deferred = promise->m_deferred.data();
+
+	/* The settle hook is registered before locking the shard since the Deferred
+	 * calls its hooks while being locked. Registering it while holding the shard lock
+	 * could therefore dead lock with a hook that adds another promise.
+	 */
+	const quint64 entryId = m_nextEntryId.fetchAndAddRelaxed(1);
+	const int settleHookId = deferred->addSettleHook([this, rawPromise, entryId](Deferred::State) {
+		/* We may not delete the promise in a slot connected to its signal.
+		 * So we remove it when the control returns to the event loop.
+		 */
+		this->scheduleRemoval(rawPromise, entryId);
+	});
+	if (settleHookId == 0)
+		return false; // Settled in the meantime
+
+	if (maxAgeMs < 0)
+		maxAgeMs = m_maxAge.load();
+
+	bool alreadyContained = false;
+	bool added = false;
+	int newCount = 0;
+	qint64 expiresAt = 0;
+	Shard& shard = shardFor(rawPromise);
+	Q_FOREVER
+	{
 		{
-			if (contextObj)
+			QWriteLocker locker{&shard.lock};
+			auto iter = shard.entries.find(rawPromise);
+			alreadyContained = (iter != shard.entries.end());
+			if (!alreadyContained)
 			{
-				auto contextConnection = QObject::connect(contextObj, &QObject::destroyed, rawPromise, [this, rawPromise](QObject*) {
-					this->remove(rawPromise);
-				});
-				m_contextConnections.insert(rawPromise, contextConnection);
+				/* The count is incremented while holding the shard lock
+				 * to keep promises() and count() consistent.
+				 */
+				newCount = tryReserve();
+				if (newCount > 0)
+				{
+					Entry entry;
+					entry.promise = promise;
+					entry.id = entryId;
+					entry.addedAt = elapsed();
+					if (maxAgeMs > 0)
+						entry.expiresAt = expiresAt = entry.addedAt + maxAgeMs;
+					entry.settleHookId = settleHookId;
+					iter = shard.entries.insert(rawPromise, entry);
+					shard.order.insert(entryId, rawPromise);
+					added = true;
+				}
 			}
+			if (alreadyContained || added)
+			{
+				// Connect context objects
+				for (auto contextObj : contextObjs)
+				{
+					if (contextObj)
+					{
+						iter->contextConnections.append(QObject::connect(contextObj, &QObject::destroyed, rawPromise, [this, rawPromise](QObject*) {
+							this->remove(rawPromise);
+						}));
+					}
+				}
+				break;
+			}
+			if (overflowPolicy() == RejectNew)
+				break;
+		}
+
+		/* Evicting needs to lock other shards, so we do it without holding
+		 * the lock of this shard and then try again.
+		 */
+		evictOldest();
+	}
+
+	if (!added)
+	{
+		deferred->removeSettleHook(settleHookId);
+		return alreadyContained;
+	}
+
+	if (deferred->state() != Deferred::Pending)
+		/* The hook might have been called before the entry was inserted.
+		 * Removing twice is harmless since the removal checks the entry ID.
+		 */
+		scheduleRemoval(rawPromise, entryId);
+
+	if (expiresAt > 0)
+		scheduleExpiry(rawPromise, entryId, expiresAt);
+
+	countIncreased(newCount);
+	return true;
+}
+
+int PromiseSitter::tryReserve()
+{
+	Q_FOREVER
+	{
+		const int currentCount = m_count.load();
+		const int capacity = m_capacity.load();
+		if (capacity > 0 && currentCount >= capacity)
+			return 0;
+		if (m_count.testAndSetOrdered(currentCount, currentCount + 1))
+		{
+			PromiseMetrics::sitterPromisesChanged(1);
+			return currentCount + 1;
 		}
 	}
 }
 
+bool PromiseSitter::evictOldest()
+{
+	const Promise* oldestPromise = nullptr;
+	quint64 oldestEntryId = 0;
+	for (const Shard& shard : m_shards)
+	{
+		QReadLocker locker{&shard.lock};
+		if (!shard.order.isEmpty() && (oldestPromise == nullptr || shard.order.firstKey() < oldestEntryId))
+		{
+			oldestEntryId = shard.order.firstKey();
+			oldestPromise = shard.order.first();
+		}
+	}
+
+	if (!oldestPromise)
+		return false;
+	/* The entry might have been removed concurrently. In that case,
+	 * there is space now anyway.
+	 */
+	removeEntry(oldestPromise, oldestEntryId);
+	return true;
+}
+
+void PromiseSitter::countIncreased(int newCount)
+{
+	const int highWatermark = m_highWatermark.load();
+	if (highWatermark > 0 && newCount >= highWatermark && m_aboveHighWatermark.testAndSetOrdered(0, 1))
+		Q_EMIT highWatermarkReached(newCount);
+}
+
+void PromiseSitter::countDecreased(int newCount)
+{
+	if (newCount == 0 && m_drainWaiterCount.load() > 0)
+		resolveDrainWaiters();
+
+	if (newCount <= m_lowWatermark.load() && m_aboveHighWatermark.testAndSetOrdered(1, 0))
+		Q_EMIT lowWatermarkReached(newCount);
+
+	if (m_spaceWaiterCount.load() > 0)
+		releaseSpaceWaiters();
+}
+
+void PromiseSitter::releaseSpaceWaiters()
+{
+	QList<Deferred::Ptr> waiters;
+	{
+		QMutexLocker locker{&m_spaceWaitersLock};
+		const int capacity = m_capacity.load();
+		// One waiter is served per free slot
+		int freeSlots = capacity <= 0 ? m_spaceWaiters.size() : capacity - m_count.load();
+		while (!m_spaceWaiters.isEmpty() && freeSlots > 0)
+		{
+			waiters.append(m_spaceWaiters.takeFirst());
+			m_spaceWaiterCount.deref();
+			--freeSlots;
+		}
+	}
+	for (const Deferred::Ptr& waiter : const_cast<const QList<Deferred::Ptr>&>(waiters))
+		waiter->resolve();
+}
+
+void PromiseSitter::setCapacity(int capacity, OverflowPolicy policy)
+{
+	m_overflowPolicy.store(policy);
+	m_capacity.store(qMax(0, capacity));
+	// Increasing the capacity might allow waiters to continue
+	if (m_spaceWaiterCount.load() > 0)
+		releaseSpaceWaiters();
+}
+
+void PromiseSitter::setWatermarks(int lowWatermark, int highWatermark)
+{
+	m_lowWatermark.store(lowWatermark);
+	m_highWatermark.store(highWatermark);
+}
+
+Promise::Ptr PromiseSitter::whenSpaceAvailable()
+{
+	QMutexLocker locker{&m_spaceWaitersLock};
+	const int capacity = m_capacity.load();
+	if (m_spaceWaiters.isEmpty() && (capacity <= 0 || m_count.load() < capacity))
+		return Promise::createResolved();
+
+	Deferred::Ptr waiter = Deferred::create();
+	m_spaceWaiters.append(waiter);
+	m_spaceWaiterCount.ref();
+	return Promise::create(waiter);
+}
+
+void PromiseSitter::setMaxAge(int maxAgeMs, ExpiryAction action)
+{
+	m_expiryAction.store(action);
+	m_maxAge.store(qMax(0, maxAgeMs));
+}
+
+void PromiseSitter::scheduleExpiry(const Promise* promise, quint64 entryId, qint64 expiresAt)
+{
+	bool startTimer = false;
+	{
+		QMutexLocker locker{&m_wheelLock};
+		/* Entries which would fall into an already processed tick are put into the next one.
+		 * Entries which expire more than one wheel revolution in the future are put into a slot
+		 * which is processed earlier. They are rescheduled when their slot is processed.
+		 */
+		const qint64 tick = qMax(expiresAt / ExpiryResolution, m_wheelTick + 1);
+		m_wheel[tick % WheelSize].append(qMakePair(promise, entryId));
+		m_wheelItemCount += 1;
+		if (!m_expiryTimerRequested)
+		{
+			m_expiryTimerRequested = true;
+			startTimer = true;
+		}
+	}
+
+	if (startTimer)
+		// The timer can only be started from the thread of the PromiseSitter
+		QMetaObject::invokeMethod(this, "startExpiryTimer", Qt::AutoConnection);
+}
+
+void PromiseSitter::startExpiryTimer()
+{
+	{
+		QMutexLocker locker{&m_wheelLock};
+		if (m_wheelItemCount == 0)
+		{
+			m_expiryTimerRequested = false;
+			return;
+		}
+	}
+	if (m_expiryTask == 0)
+		armExpiryTimer();
+}
+
+void PromiseSitter::armExpiryTimer()
+{
+	m_expiryTask = m_scheduler->schedule(ExpiryResolution, this, [this]() {
+		m_expiryTask = 0;
+		this->expireEntries();
+	});
+}
+
+void PromiseSitter::expireEntries()
+{
+	const qint64 now = elapsed();
+	const qint64 currentTick = now / ExpiryResolution;
+
+	WheelSlot candidates;
+	{
+		QMutexLocker locker{&m_wheelLock};
+		// If we are late by more than one revolution, each slot is processed only once
+		const qint64 firstTick = qMax(m_wheelTick + 1, currentTick - WheelSize + 1);
+		for (qint64 tick = firstTick; tick <= currentTick; ++tick)
+		{
+			WheelSlot& slot = m_wheel[tick % WheelSize];
+			candidates += slot;
+			m_wheelItemCount -= slot.size();
+			slot.clear();
+		}
+		m_wheelTick = qMax(m_wheelTick, currentTick);
+	}
+
+	QList<Straggler> expiredEntries;
+	QVector<QPair<QPair<const Promise*, quint64>, qint64>> notYetExpired;
+	for (const auto& candidate : const_cast<const WheelSlot&>(candidates))
+	{
+		const Shard& shard = shardFor(candidate.first);
+		QReadLocker locker{&shard.lock};
+		auto iter = shard.entries.constFind(candidate.first);
+		if (iter == shard.entries.cend() || iter->id != candidate.second)
+			continue; // Removed in the meantime
+
+		if (iter->expiresAt <= now)
+		{
+			Straggler expiredEntry;
+			expiredEntry.promise = iter->promise;
+			expiredEntry.age = now - iter->addedAt;
+			expiredEntries.append(expiredEntry);
+		}
+		else
+			notYetExpired.append(qMakePair(candidate, iter->expiresAt));
+	}
+
+	for (const auto& entry : const_cast<const QVector<QPair<QPair<const Promise*, quint64>, qint64>>&>(notYetExpired))
+		scheduleExpiry(entry.first.first, entry.first.second, entry.second);
+
+	bool rearm = false;
+	{
+		QMutexLocker locker{&m_wheelLock};
+		if (m_wheelItemCount == 0)
+			m_expiryTimerRequested = false;
+		else
+			rearm = true;
+	}
+	if (rearm && m_expiryTask == 0)
+		armExpiryTimer();
+
+	if (expiredEntries.isEmpty())
+		return;
+
+	const bool reject = (expiryAction() == RejectExpired);
+	for (const Straggler& expiredEntry : const_cast<const QList<Straggler>&>(expiredEntries))
+	{
+		if (reject)
+			rejectWithTimeout(expiredEntry.promise, expiredEntry.age);
+		else
+			remove(expiredEntry.promise.data());
+	}
+
+	m_expiredCount.fetchAndAddRelaxed(static_cast<quint64>(expiredEntries.size()));
+	Q_EMIT expired(expiredEntries.size());
+}
+
+Promise::Ptr PromiseSitter::drain(int timeoutMs, DrainMode mode)
+{
+	Deferred::Ptr drainDeferred = Deferred::create();
+	{
+		QMutexLocker locker{&m_drainLock};
+		m_drainWaiters.append(drainDeferred);
+		m_drainWaiterCount.ref();
+	}
+	/* The count could have dropped to 0 before we registered the waiter.
+	 * In that case, countDecreased() did not see the waiter.
+	 */
+	if (m_count.load() == 0)
+		resolveDrainWaiters();
+
+	if (timeoutMs >= 0 && drainDeferred->state() == Deferred::Pending)
+	{
+		QWeakPointer<Deferred> weakDrainDeferred = drainDeferred;
+		PromiseMetrics::PendingAction action(PromiseMetrics::PendingAction::TimerAction);
+		m_scheduler->schedule(timeoutMs, this, [this, weakDrainDeferred, mode, action]() mutable {
+			action.release();
+			Deferred::Ptr drainDeferred = weakDrainDeferred.toStrongRef();
+			if (drainDeferred)
+				this->drainTimedOut(drainDeferred, mode);
+		});
+	}
+
+	return Promise::create(drainDeferred);
+}
+
+void PromiseSitter::resolveDrainWaiters()
+{
+	QList<Deferred::Ptr> drainWaiters;
+	{
+		QMutexLocker locker{&m_drainLock};
+		drainWaiters.swap(m_drainWaiters);
+		m_drainWaiterCount.store(0);
+	}
+	for (Deferred::Ptr waiter : const_cast<const QList<Deferred::Ptr>&>(drainWaiters))
+		waiter->resolve();
+}
+
+void PromiseSitter::drainTimedOut(Deferred::Ptr drainDeferred, DrainMode mode)
+{
+	{
+		QMutexLocker locker{&m_drainLock};
+		if (!m_drainWaiters.removeOne(drainDeferred))
+			return; // Already resolved
+		m_drainWaiterCount.deref();
+	}
+
+	const QList<Straggler> currentStragglers = stragglers();
+	switch (mode)
+	{
+	case RemoveStragglers:
+		for (const Straggler& straggler : currentStragglers)
+			remove(straggler.promise.data());
+		break;
+	case RejectStragglers:
+		for (const Straggler& straggler : currentStragglers)
+			rejectWithTimeout(straggler.promise, straggler.age);
+		break;
+	case KeepStragglers:
+	default:
+		break;
+	}
+
+	drainDeferred->reject(QVariant::fromValue(currentStragglers));
+}
+
+QList<PromiseSitter::Straggler> PromiseSitter::stragglers() const
+{
+	for (const Shard& shard : m_shards)
+		shard.lock.lockForRead();
+
+	const qint64 now = elapsed();
+	QList<Straggler> result;
+	result.reserve(m_count.load());
+	for (const Shard& shard : m_shards)
+	{
+		for (auto iter = shard.entries.cbegin(); iter != shard.entries.cend(); ++iter)
+		{
+			Straggler straggler;
+			straggler.promise = iter->promise;
+			straggler.age = now - iter->addedAt;
+			result.append(straggler);
+		}
+	}
+
+	for (const Shard& shard : m_shards)
+		shard.lock.unlock();
+
+	// Oldest first
+	std::sort(result.begin(), result.end(), [](const Straggler& left, const Straggler& right) {
+		return left.age > right.age;
+	});
+	return result;
+}
+
+void PromiseSitter::rejectWithTimeout(const Promise::Ptr& promise, qint64 age)
+{
+	/* Only the Deferred of the held promise is rejected. Rejecting the root Deferreds of a
+	 * chain would also settle the promises of other consumers of the same operation.
+	 */
+	Deferred::Ptr deferred = promise->m_deferred;
+	if (deferred->state() != Deferred::Pending)
+		return;
+
+	Timeout timeout;
+	timeout.age = age;
+	deferred->reject(QVariant::fromValue(timeout));
+}
+
 bool PromiseSitter::remove(const Promise* promise)
 {
-	QWriteLocker locker{&m_lock};
-	bool removed = (m_promises.remove(promise) > 0);
+	return removeEntry(promise, 0);
+}
+
+bool PromiseSitter::removeEntry(const Promise* promise, quint64 entryId)
+{
+	Entry entry;
+	int newCount = 0;
+	{
+		Shard& shard = shardFor(promise);
+		QWriteLocker locker{&shard.lock};
+		auto iter = shard.entries.find(promise);
+		if (iter == shard.entries.end() || (entryId != 0 && iter->id != entryId))
+			return false;
+		entry = iter.value();
+		shard.entries.erase(iter);
+		shard.order.remove(entry.id);
+		newCount = m_count.fetchAndSubOrdered(1) - 1;
+	}
+	PromiseMetrics::sitterPromisesChanged(-1);
+
+	/* Release the entry outside of the lock since this can trigger the destruction
+	 * of the promise and unregistering the settle hook needs to lock the Deferred.
+	 */
+	releaseEntry(entry);
+	countDecreased(newCount);
+	return true;
+}
+
+void PromiseSitter::releaseEntry(const Entry& entry)
+{
+	entry.promise->m_deferred->removeSettleHook(entry.settleHookId);
+	for (auto connection : entry.contextConnections)
+		QObject::disconnect(connection);
+}
 
-	if (removed)
+void PromiseSitter::scheduleRemoval(const Promise* promise, quint64 entryId)
+{
+	QMutexLocker locker{&m_settledLock};
+	m_settledPromises.append(qMakePair(promise, entryId));
+	if (!m_removalPosted)
 	{
-		for (auto connection : m_sitterConnections.values(promise))
-			QObject::disconnect(connection);
-		m_sitterConnections.remove(promise);
+		m_removalPosted = true;
+		QMetaObject::invokeMethod(this, "removeSettledPromises", Qt::QueuedConnection);
+	}
+}
 
-		for (auto connection : m_contextConnections.values(promise))
-			QObject::disconnect(connection);
-		m_contextConnections.remove(promise);
+void PromiseSitter::removeSettledPromises()
+{
+	QVector<QPair<const Promise*, quint64>> settledPromises;
+	{
+		QMutexLocker locker{&m_settledLock};
+		settledPromises.swap(m_settledPromises);
+		m_removalPosted = false;
 	}
 
-	return removed;
+	for (const auto& settledPromise : const_cast<const QVector<QPair<const Promise*, quint64>>&>(settledPromises))
+		removeEntry(settledPromise.first, settledPromise.second);
 }
 
 bool PromiseSitter::contains(Promise::Ptr promise) const
 {
-	QReadLocker locker{&m_lock};
-	return m_promises.contains(promise.data());
+	const Shard& shard = shardFor(promise.data());
+	QReadLocker locker{&shard.lock};
+	return shard.entries.contains(promise.data());
 }
 
 QList<Promise::Ptr> PromiseSitter::promises() const
 {
-	QReadLocker locker{&m_lock};
-	return m_promises.values();
+	/* To provide a consistent snapshot, we lock all shards before collecting
+	 * the promises. The shards are always locked in the same order and add() and
+	 * remove() lock only a single shard, so this cannot dead lock.
+	 */
+	for (const Shard& shard : m_shards)
+		shard.lock.lockForRead();
+
+	QList<Promise::Ptr> result;
+	result.reserve(m_count.load());
+	for (const Shard& shard : m_shards)
+	{
+		for (auto iter = shard.entries.cbegin(); iter != shard.entries.cend(); ++iter)
+			result.append(iter->promise);
+	}
+
+	for (const Shard& shard : m_shards)
+		shard.lock.unlock();
+	return result;
 }
 
 } // namespace QtPromise
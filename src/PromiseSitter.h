@@ -8,11 +8,16 @@
 #define QTPROMISE_PROMISESITTER_H_
 
 #include <QObject>
-#include <QMultiHash>
+#include <QHash>
+#include <QMap>
 #include <QSharedPointer>
 #include <QReadWriteLock>
 #include <QVector>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QPair>
 #include "Promise.h"
+#include "Scheduler.h"
 
 namespace QtPromise {
 
@@ -26,7 +31,36 @@ namespace QtPromise {
  * \note Since the Promise will typically be destroyed after removing from the PromiseSitter,
  * it is not removed immediately after it has been resolved or rejected but when the control
  * returns to the event loop. This is necessary to prevent that the Promise is deleted in
- * a handler connected to its own signal.
+ * a handler connected to its own signal. Promises which are resolved or rejected in the
+ * same event loop iteration are removed together.
+ *
+ * ### Thread Safety and Sharding ###
+ * Internally, the promises are distributed over a fixed number of shards based on the
+ * address of the Promise. Each shard has its own lock. So add() and remove() calls for
+ * different promises from different threads typically do not block each other.
+ * Methods providing information about the PromiseSitter as a whole (promises() and count())
+ * still return consistent snapshots.
+ *
+ * ### Capacity Limit ###
+ * By default, a PromiseSitter holds an unlimited number of promises. To prevent unbounded
+ * growth when promises are added faster than they settle, a capacity limit can be set using
+ * setCapacity(). The OverflowPolicy defines what happens when adding a promise to a full
+ * PromiseSitter. Producers can throttle themselves by waiting for whenSpaceAvailable() or by
+ * reacting to the highWatermarkReached() and lowWatermarkReached() signals.
+ *
+ * ### Expiry ###
+ * Promises which never settle, for example due to a bug, would be held forever.
+ * To prevent this, a maximum age can be defined per PromiseSitter using setMaxAge() or per
+ * promise when calling add(). Expired promises are removed or rejected depending on the
+ * expiryAction(). The expiry is checked by a single timer per PromiseSitter with a granularity
+ * of #ExpiryResolution milliseconds. So the thread of the PromiseSitter needs to run an event loop.
+ * The clock and the timer are provided by the Scheduler::instance() at the time the PromiseSitter
+ * is created. So the expiry can be tested using a VirtualTimeScheduler.
+ *
+ * ### Shutdown ###
+ * To wait until the promises held by a PromiseSitter have settled, for example when shutting down
+ * the application, use drain(). It resolves once the PromiseSitter is empty and allows to
+ * handle the promises which did not settle within a deadline.
  *
  * ### Global Instance ###
  * For convenience, there is a global instance of a PromiseSitter which can be retrieved
@@ -52,11 +86,112 @@ class PromiseSitter : public QObject
 	Q_OBJECT
 
 public:
+	/*! Defines the behavior of add() when the capacity of the PromiseSitter is reached.
+	 *
+	 * \sa setCapacity()
+	 * \since 2.2.0
+	 */
+	enum OverflowPolicy
+	{
+		RejectNew,  //!< The new promise is not added and add() returns \c false.
+		EvictOldest //!< The oldest promises are removed to make space for the new promise.
+	};
+
+	/*! Defines what drain() does with the promises which are still held when the deadline is reached.
+	 *
+	 * \sa drain()
+	 * \since 2.2.0
+	 */
+	enum DrainMode
+	{
+		KeepStragglers,   //!< The promises stay in the PromiseSitter.
+		RemoveStragglers, //!< The promises are removed from the PromiseSitter without settling them.
+		RejectStragglers  /*!< The Deferreds of the promises are rejected with a Timeout object.
+		                   * The promises are then removed as usual.
+		                   * Only the Deferred of the held promise itself is rejected. When the
+		                   * promise was created by Promise::then() or similar, the Deferreds
+		                   * it depends on stay pending and their operations are not aborted.
+		                   */
+	};
+
+	/*! The reason used to reject promises which have been held by a PromiseSitter for too long.
+	 *
+	 * \note This type is registered in Qt's meta type system using Q_DECLARE_METATYPE().
+	 *
+	 * \sa RejectStragglers
+	 * \since 2.2.0
+	 */
+	struct Timeout
+	{
+		/*! The time in milliseconds the promise has been held by the PromiseSitter. */
+		qint64 age = -1;
+
+		/*! Compares two Timeout objects for equality.
+		 *
+		 * \param other The Timeout object to compare to.
+		 * \return \c true if the \p age is equal for \c this and \p other. \c false otherwise.
+		 */
+		bool operator==(const Timeout& other) const { return age == other.age; }
+	};
+
+	/*! Defines what happens with promises which exceed their maximum age.
+	 *
+	 * \sa setMaxAge()
+	 * \since 2.2.0
+	 */
+	enum ExpiryAction
+	{
+		RemoveExpired, //!< The promises are removed from the PromiseSitter without settling them.
+		RejectExpired  /*!< The Deferreds of the promises are rejected with a Timeout object.
+		                * The promises are then removed as usual.
+		                * Only the Deferred of the held promise itself is rejected. When the
+		                * promise was created by Promise::then() or similar, the Deferreds
+		                * it depends on stay pending and their operations are not aborted.
+		                */
+	};
+
+	/*! Value for the \p maxAgeMs parameter of add() to use the maxAge() of the PromiseSitter.
+	 * \since 2.2.0
+	 */
+	static const int DefaultMaxAge = -1;
+	/*! The granularity of the expiry in milliseconds.
+	 *
+	 * Promises are expired up to this amount of time after they exceeded their maximum age.
+	 * \since 2.2.0
+	 */
+	static const int ExpiryResolution = 50;
+
+	/*! Describes a promise which was still held by a PromiseSitter when a drain() timed out.
+	 *
+	 * \note This type and QList<Straggler> are registered in Qt's meta type system using
+	 * Q_DECLARE_METATYPE().
+	 *
+	 * \sa drain()
+	 * \since 2.2.0
+	 */
+	struct Straggler
+	{
+		/*! The promise which did not settle in time. */
+		Promise::Ptr promise;
+		/*! The time in milliseconds the promise had been held by the PromiseSitter
+		 * when the drain() timed out.
+		 */
+		qint64 age = -1;
+
+		/*! Compares two Straggler objects for equality.
+		 *
+		 * \param other The Straggler object to compare to.
+		 * \return \c true if \p promise and \p age are equal for \c this and \p other.
+		 * \c false otherwise.
+		 */
+		bool operator==(const Straggler& other) const { return promise == other.promise && age == other.age; }
+	};
+
 	/*! Creates a new PromiseSitter.
 	 *
 	 * \param parent The parent QObject.
 	 */
-	PromiseSitter(QObject* parent = nullptr) : QObject(parent) {}
+	PromiseSitter(QObject* parent = nullptr);
 	/*! Releases all Promise::Ptr and disconnects the context objects.
 	 */
 	virtual ~PromiseSitter();
@@ -85,10 +220,19 @@ public:
 	 * the \p promise is removed from the PromiseSitter. If the \p promise has already been added
 	 * to the PromiseSitter, the \p contextObj is added to the existing context objects.
 	 * This parameter was added in 1.2.0.
+	 * \param maxAgeMs The time in milliseconds after which the \p promise expires. \c 0 means
+	 * the \p promise never expires. #DefaultMaxAge means the maxAge() of this PromiseSitter is used.
+	 * If the \p promise has already been added to the PromiseSitter, this parameter is ignored.
+	 * This parameter was added in 2.2.0.
+	 * \return \c true if the \p promise is held by this PromiseSitter after the call.
+	 * \c false if the \p promise is not pending or if the capacity is reached and the
+	 * overflowPolicy() is \ref RejectNew. The return value was added in 2.2.0.
 	 *
 	 * \sa remove()
+	 * \sa setCapacity()
+	 * \sa setMaxAge()
 	 */
-	void add(Promise::Ptr promise, const QObject* contextObj) { add(promise, QVector<const QObject*>{contextObj}); }
+	bool add(Promise::Ptr promise, const QObject* contextObj, int maxAgeMs = DefaultMaxAge) { return add(promise, QVector<const QObject*>{contextObj}, maxAgeMs); }
 
 	/*! \overload
 	 *
@@ -100,10 +244,19 @@ public:
 	 * If the \p promise has already been added to the PromiseSitter, the \p contextObjs
 	 * are added to the existing context objects.
 	 * This parameter was added in 1.2.0.
+	 * \param maxAgeMs The time in milliseconds after which the \p promise expires. \c 0 means
+	 * the \p promise never expires. #DefaultMaxAge means the maxAge() of this PromiseSitter is used.
+	 * If the \p promise has already been added to the PromiseSitter, this parameter is ignored.
+	 * This parameter was added in 2.2.0.
+	 * \return \c true if the \p promise is held by this PromiseSitter after the call.
+	 * \c false if the \p promise is not pending or if the capacity is reached and the
+	 * overflowPolicy() is \ref RejectNew. The return value was added in 2.2.0.
 	 *
 	 * \sa remove()
+	 * \sa setCapacity()
+	 * \sa setMaxAge()
 	 */
-	void add(Promise::Ptr promise, const QVector<const QObject*>& contextObjs = {});
+	bool add(Promise::Ptr promise, const QVector<const QObject*>& contextObjs = {}, int maxAgeMs = DefaultMaxAge);
 
 	/*! Explicitly removes a Promise from this PromiseSitter.
 	 *
@@ -133,13 +286,244 @@ public:
 	 */
 	QList<Promise::Ptr> promises() const;
 
+	/*! \return The number of promises currently hold by this PromiseSitter.
+	 *
+	 * This is cheaper than `promises().size()` since it does not need to lock the
+	 * PromiseSitter.
+	 *
+	 * \sa promises()
+	 */
+	int count() const { return m_count.load(); }
+
+	/*! Limits the number of promises held by this PromiseSitter.
+	 *
+	 * Reducing the capacity below the current count() does not remove any promises.
+	 * The limit is only applied when adding new promises.
+	 *
+	 * \param capacity The maximum number of promises. \c 0 means unlimited, which is
+	 * the default.
+	 * \param policy Defines what happens when a promise is added while the capacity is reached.
+	 *
+	 * \sa add()
+	 * \since 2.2.0
+	 */
+	void setCapacity(int capacity, OverflowPolicy policy = RejectNew);
+	/*! \return The maximum number of promises held by this PromiseSitter or \c 0 if unlimited.
+	 * \sa setCapacity()
+	 * \since 2.2.0
+	 */
+	int capacity() const { return m_capacity.load(); }
+	/*! \return The behavior of add() when the capacity is reached.
+	 * \sa setCapacity()
+	 * \since 2.2.0
+	 */
+	OverflowPolicy overflowPolicy() const { return static_cast<OverflowPolicy>(m_overflowPolicy.load()); }
+
+	/*! Defines the thresholds for the highWatermarkReached() and lowWatermarkReached() signals.
+	 *
+	 * \param lowWatermark When the count() drops to or below this value after the high watermark
+	 * has been reached, lowWatermarkReached() is emitted.
+	 * \param highWatermark When the count() rises to or above this value, highWatermarkReached()
+	 * is emitted. \c 0 disables the signals, which is the default.
+	 *
+	 * \since 2.2.0
+	 */
+	void setWatermarks(int lowWatermark, int highWatermark);
+	/*! \return The low watermark. \sa setWatermarks() \since 2.2.0 */
+	int lowWatermark() const { return m_lowWatermark.load(); }
+	/*! \return The high watermark. \sa setWatermarks() \since 2.2.0 */
+	int highWatermark() const { return m_highWatermark.load(); }
+
+	/*! Defines the maximum time promises are held by this PromiseSitter.
+	 *
+	 * The maximum age applies to promises added afterwards with \p maxAgeMs set to
+	 * #DefaultMaxAge.
+	 *
+	 * \param maxAgeMs The maximum age in milliseconds. \c 0 means promises never expire,
+	 * which is the default.
+	 * \param action Defines what happens with expired promises.
+	 *
+	 * \sa expired()
+	 * \since 2.2.0
+	 */
+	void setMaxAge(int maxAgeMs, ExpiryAction action = RemoveExpired);
+	/*! \return The default maximum age in milliseconds or \c 0 if promises do not expire by default.
+	 * \sa setMaxAge()
+	 * \since 2.2.0
+	 */
+	int maxAge() const { return m_maxAge.load(); }
+	/*! \return What happens with expired promises.
+	 * \sa setMaxAge()
+	 * \since 2.2.0
+	 */
+	ExpiryAction expiryAction() const { return static_cast<ExpiryAction>(m_expiryAction.load()); }
+	/*! \return The total number of promises which expired in this PromiseSitter.
+	 * \sa expired()
+	 * \since 2.2.0
+	 */
+	quint64 expiredCount() const { return m_expiredCount.load(); }
+
+	/*! Creates a Promise which is resolved when this PromiseSitter can accept a new promise.
+	 *
+	 * If there is no capacity limit or the count() is below the capacity(), the returned Promise is
+	 * resolved immediately. Else, it is resolved when a promise is removed from this PromiseSitter.
+	 * When multiple callers are waiting, they are served in FIFO order with one caller per removed
+	 * promise.
+	 *
+	 * \note There is no reservation. Other producers can fill the freed space before the
+	 * returned Promise's actions are executed.
+	 *
+	 * \return A Promise which is resolved when space is available. The Promise is rejected if
+	 * this PromiseSitter is destroyed before.
+	 *
+	 * \since 2.2.0
+	 */
+	Promise::Ptr whenSpaceAvailable();
+
+	/*! Waits until this PromiseSitter is empty.
+	 *
+	 * This is typically used on shutdown to wait for outstanding operations.
+	 * The returned Promise is resolved as soon as the count() drops to \c 0.
+	 * No polling is involved.
+	 *
+	 * If the PromiseSitter is not empty when the \p timeoutMs elapsed, the returned Promise
+	 * is rejected with a QList<Straggler> describing the promises which were still held at that
+	 * time. Before, the stragglers are handled as defined by \p mode.
+	 *
+	 * \note The deadline is measured using a timer of this PromiseSitter. So the thread of
+	 * this PromiseSitter needs to run an event loop.
+	 *
+	 * \param timeoutMs The deadline in milliseconds. A negative value means no deadline.
+	 * \param mode Defines what is done with the stragglers when the deadline is reached.
+	 * \return A Promise which is resolved when this PromiseSitter is empty and rejected with
+	 * a QList<Straggler> if this does not happen within \p timeoutMs.
+	 * The Promise is rejected with an empty QList<Straggler> if this PromiseSitter is destroyed
+	 * before.
+	 *
+	 * \since 2.2.0
+	 */
+	Promise::Ptr drain(int timeoutMs = -1, DrainMode mode = KeepStragglers);
+
+Q_SIGNALS:
+	/*! Emitted when the count() rises to the highWatermark().
+	 *
+	 * \note This signal can be emitted from any thread which adds promises.
+	 *
+	 * \param count The count() at the time the watermark was reached.
+	 * \sa setWatermarks()
+	 * \since 2.2.0
+	 */
+	void highWatermarkReached(int count);
+	/*! Emitted when the count() drops to the lowWatermark() after the highWatermark() has been reached.
+	 *
+	 * \note This signal can be emitted from any thread which removes promises.
+	 *
+	 * \param count The count() at the time the watermark was reached.
+	 * \sa setWatermarks()
+	 * \since 2.2.0
+	 */
+	void lowWatermarkReached(int count);
+	/*! Emitted when promises expired.
+	 *
+	 * \param count The number of promises which expired at once.
+	 * \sa setMaxAge()
+	 * \sa expiredCount()
+	 * \since 2.2.0
+	 */
+	void expired(int count);
+
+private Q_SLOTS:
+	void removeSettledPromises();
+	void startExpiryTimer();
+	void expireEntries();
+
 private:
-	mutable QReadWriteLock m_lock;
-	QHash<const Promise*, Promise::Ptr> m_promises;
-	QMultiHash<const Promise*, QMetaObject::Connection> m_sitterConnections;
-	QMultiHash<const Promise*, QMetaObject::Connection> m_contextConnections;
+	struct Entry
+	{
+		Promise::Ptr promise;
+		quint64 id = 0;
+		qint64 addedAt = 0;
+		qint64 expiresAt = 0;
+		int settleHookId = 0;
+		QVector<QMetaObject::Connection> contextConnections;
+	};
+
+	struct Shard
+	{
+		mutable QReadWriteLock lock;
+		QHash<const Promise*, Entry> entries;
+		/*! The entries in the order they have been added.
+		 * The entry IDs are strictly increasing.
+		 */
+		QMap<quint64, const Promise*> order;
+	};
+
+	/*! The number of shards. Must be a power of two. */
+	static const int ShardCount = 16;
+
+	Shard& shardFor(const Promise* promise);
+	const Shard& shardFor(const Promise* promise) const;
+	static int shardIndex(const Promise* promise);
+
+	bool removeEntry(const Promise* promise, quint64 entryId);
+	void releaseEntry(const Entry& entry);
+	void scheduleRemoval(const Promise* promise, quint64 entryId);
+	int tryReserve();
+	bool evictOldest();
+	void countIncreased(int newCount);
+	void countDecreased(int newCount);
+	void releaseSpaceWaiters();
+	void resolveDrainWaiters();
+	void drainTimedOut(Deferred::Ptr drainDeferred, DrainMode mode);
+	QList<Straggler> stragglers() const;
+	qint64 elapsed() const { return m_scheduler->now() - m_clockStart; }
+	static void rejectWithTimeout(const Promise::Ptr& promise, qint64 age);
+	void scheduleExpiry(const Promise* promise, quint64 entryId, qint64 expiresAt);
+	void armExpiryTimer();
+
+	/*! The number of slots of the expiry timer wheel. */
+	static const int WheelSize = 64;
+	typedef QVector<QPair<const Promise*, quint64>> WheelSlot;
+
+	Shard m_shards[ShardCount];
+	QAtomicInt m_count;
+	QAtomicInteger<quint64> m_nextEntryId;
+	Scheduler* m_scheduler;
+	qint64 m_clockStart;
+
+	QAtomicInt m_capacity;
+	QAtomicInt m_overflowPolicy;
+	QAtomicInt m_lowWatermark;
+	QAtomicInt m_highWatermark;
+	QAtomicInt m_aboveHighWatermark;
+
+	QMutex m_spaceWaitersLock;
+	QList<Deferred::Ptr> m_spaceWaiters;
+	QAtomicInt m_spaceWaiterCount;
+
+	QMutex m_drainLock;
+	QList<Deferred::Ptr> m_drainWaiters;
+	QAtomicInt m_drainWaiterCount;
+
+	QAtomicInt m_maxAge;
+	QAtomicInt m_expiryAction;
+	QAtomicInteger<quint64> m_expiredCount;
+	QMutex m_wheelLock;
+	WheelSlot m_wheel[WheelSize];
+	qint64 m_wheelTick;
+	int m_wheelItemCount;
+	bool m_expiryTimerRequested;
+	Scheduler::TaskId m_expiryTask;
+
+	QMutex m_settledLock;
+	QVector<QPair<const Promise*, quint64>> m_settledPromises;
+	bool m_removalPosted;
 };
 
 }  // namespace QtPromise
 
+Q_DECLARE_METATYPE(QtPromise::PromiseSitter::Timeout)
+Q_DECLARE_METATYPE(QtPromise::PromiseSitter::Straggler)
+Q_DECLARE_METATYPE(QList<QtPromise::PromiseSitter::Straggler>)
+
 #endif /* QTPROMISE_PROMISESITTER_H_ */
@@ -0,0 +1,512 @@
+#include "PromiseTracer.h"
+#include "Deferred.h"
+
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+
+namespace QtPromise {
+
+QBasicAtomicInt PromiseTracer::s_enabled = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+/*!
+ * \cond INTERNAL
+ */
+
+namespace {
+
+enum EventType
+{
+	DeferredCreatedEvent,
+	LabelSetEvent,
+	ThenAttachedEvent,
+	SettleBeginEvent,
+	SettleEndEvent,
+	NotifiedEvent,
+	ContinuationBeginEvent,
+	ContinuationEndEvent,
+	LinkedEvent
+};
+
+struct TraceEvent
+{
+	qint64 timestamp;
+	quint64 id;
+	quint64 relatedId;
+	quint32 label;
+	quint8 type;
+	quint8 argument;
+};
+
+/* A slot of a TraceBuffer guarded by a sequence number.
+ * The fields are atomics so that a reader racing with the owning thread never reads torn values.
+ * The sequence is 0 while the slot is written and index + 1 once the event with that index is complete.
+ */
+struct TraceSlot
+{
+	std::atomic<quint64> sequence{0};
+	std::atomic<qint64> timestamp{0};
+	std::atomic<quint64> id{0};
+	std::atomic<quint64> relatedId{0};
+	std::atomic<quint64> labelTypeArgument{0};
+
+	void store(quint64 index, const TraceEvent& event)
+	{
+		sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		timestamp.store(event.timestamp, std::memory_order_relaxed);
+		id.store(event.id, std::memory_order_relaxed);
+		relatedId.store(event.relatedId, std::memory_order_relaxed);
+		labelTypeArgument.store(static_cast<quint64>(event.label) << 16 | static_cast<quint64>(event.type) << 8 | event.argument,
+		                        std::memory_order_relaxed);
+		sequence.store(index + 1, std::memory_order_release);
+	}
+
+	/* \return \c true if the slot contained the event with \p index for the whole read. */
+	bool load(quint64 index, TraceEvent& event) const
+	{
+		if (sequence.load(std::memory_order_acquire) != index + 1)
+			return false;
+		event.timestamp = timestamp.load(std::memory_order_relaxed);
+		event.id = id.load(std::memory_order_relaxed);
+		event.relatedId = relatedId.load(std::memory_order_relaxed);
+		const quint64 packed = labelTypeArgument.load(std::memory_order_relaxed);
+		event.label = static_cast<quint32>(packed >> 16);
+		event.type = static_cast<quint8>(packed >> 8);
+		event.argument = static_cast<quint8>(packed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return sequence.load(std::memory_order_relaxed) == index + 1;
+	}
+};
+
+/* A ring buffer which is only written by the owning thread.
+ * Readers skip events which are overwritten while they are copied using the sequence numbers of the slots.
+ */
+struct TraceBuffer
+{
+	TraceBuffer(int capacity, int index)
+		: events(new TraceSlot[capacity]), capacity(static_cast<quint64>(capacity)), threadIndex(index),
+		  head(0), clearedUpTo(0), finished(false)
+	{
+	}
+
+	void append(const TraceEvent& event)
+	{
+		const quint64 currentHead = head.load();
+		events[currentHead % capacity].store(currentHead, event);
+		head.storeRelease(currentHead + 1);
+	}
+
+	QVector<TraceEvent> copyEvents() const
+	{
+		QVector<TraceEvent> result;
+		const quint64 currentHead = head.loadAcquire();
+		/* The slot of the oldest event (currentHead - capacity) is the one the owning thread writes next,
+		 * so the first event which is safe to read is one slot later.
+		 */
+		const quint64 oldest = currentHead >= capacity ? currentHead + 1 - capacity : 0;
+		const quint64 first = qMax(oldest, clearedUpTo.load());
+		if (first >= currentHead)
+			return result;
+		result.reserve(static_cast<int>(currentHead - first));
+		TraceEvent event;
+		for (quint64 index = first; index < currentHead; ++index)
+		{
+			// Events which have been overwritten while copying are dropped
+			if (events[index % capacity].load(index, event))
+				result.append(event);
+		}
+		return result;
+	}
+
+	std::unique_ptr<TraceSlot[]> events;
+	const quint64 capacity;
+	const int threadIndex;
+	QString threadName;
+	QAtomicInteger<quint64> head;
+	QAtomicInteger<quint64> clearedUpTo;
+	bool finished;
+};
+
+struct Registry
+{
+	QMutex lock;
+	QList<TraceBuffer*> buffers;
+	int nextThreadIndex = 1;
+	int bufferCapacity = PromiseTracer::DefaultBufferCapacity;
+	QHash<QString, quint32> labelIds;
+	QVector<QString> labels{QString()};
+};
+
+Registry& registry()
+{
+	/* Intentionally leaked since thread local buffers of other threads
+	 * can be released after the static objects.
+	 */
+	static Registry* instance = new Registry;
+	return *instance;
+}
+
+struct TraceBufferHolder
+{
+	TraceBufferHolder()
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		buffer = new TraceBuffer(reg.bufferCapacity, reg.nextThreadIndex++);
+		buffer->threadName = QThread::currentThread()->objectName();
+		reg.buffers.append(buffer);
+	}
+
+	~TraceBufferHolder()
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		buffer->finished = true;
+
+		int finishedCount = 0;
+		for (const TraceBuffer* existingBuffer : const_cast<const QList<TraceBuffer*>&>(reg.buffers))
+			finishedCount += existingBuffer->finished ? 1 : 0;
+		for (auto iter = reg.buffers.begin(); iter != reg.buffers.end() && finishedCount > PromiseTracer::MaxFinishedThreads;)
+		{
+			if ((*iter)->finished)
+			{
+				delete *iter;
+				iter = reg.buffers.erase(iter);
+				--finishedCount;
+			}
+			else
+				++iter;
+		}
+	}
+
+	TraceBuffer* buffer;
+};
+
+TraceBuffer& localBuffer()
+{
+	thread_local TraceBufferHolder holder;
+	return *holder.buffer;
+}
+
+thread_local quint64 localIdCounter = 0;
+
+void record(EventType type, quint64 id, quint64 relatedId = 0, quint8 argument = 0, quint32 label = 0)
+{
+	TraceEvent event;
+	event.timestamp = PromiseLatency::now();
+	event.id = id;
+	event.relatedId = relatedId;
+	event.label = label;
+	event.type = static_cast<quint8>(type);
+	event.argument = argument;
+	localBuffer().append(event);
+}
+
+QString idString(quint64 id)
+{
+	return QStringLiteral("0x") + QString::number(id, 16);
+}
+
+struct CollectedBuffer
+{
+	int threadIndex;
+	QString threadName;
+	QVector<TraceEvent> events;
+};
+
+struct SettleInfo
+{
+	qint64 timestamp;
+	int threadIndex;
+};
+
+} // namespace
+
+/*!
+ * \endcond
+ */
+
+
+void PromiseTracer::start(int bufferCapacity)
+{
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		reg.bufferCapacity = qMax(2, bufferCapacity);
+	}
+	s_enabled.store(1);
+}
+
+void PromiseTracer::stop()
+{
+	s_enabled.store(0);
+}
+
+void PromiseTracer::clear()
+{
+	Registry& reg = registry();
+	QMutexLocker locker(&reg.lock);
+	for (TraceBuffer* buffer : const_cast<const QList<TraceBuffer*>&>(reg.buffers))
+		buffer->clearedUpTo.store(buffer->head.loadAcquire());
+}
+
+QByteArray PromiseTracer::toChromeTraceJson()
+{
+	QVector<CollectedBuffer> collectedBuffers;
+	QVector<QString> labels;
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		for (const TraceBuffer* buffer : const_cast<const QList<TraceBuffer*>&>(reg.buffers))
+			collectedBuffers.append(CollectedBuffer{buffer->threadIndex, buffer->threadName, buffer->copyEvents()});
+		labels = reg.labels;
+	}
+
+	// First pass: collect the information which is referenced by other events
+	QHash<quint64, PromiseMetrics::DeferredType> types;
+	QHash<quint64, quint32> deferredLabels;
+	QHash<quint64, SettleInfo> settles;
+	for (const CollectedBuffer& buffer : const_cast<const QVector<CollectedBuffer>&>(collectedBuffers))
+	{
+		for (const TraceEvent& event : buffer.events)
+		{
+			switch (event.type)
+			{
+			case DeferredCreatedEvent:
+				types.insert(event.id, static_cast<PromiseMetrics::DeferredType>(event.argument));
+				break;
+			case LabelSetEvent:
+				deferredLabels.insert(event.id, event.label);
+				break;
+			case SettleBeginEvent:
+				settles.insert(event.id, SettleInfo{event.timestamp, buffer.threadIndex});
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	auto deferredName = [&types, &deferredLabels, &labels](quint64 id) -> QString {
+		const quint32 label = deferredLabels.value(id, 0);
+		if (label > 0 && static_cast<int>(label) < labels.size())
+			return labels.at(static_cast<int>(label));
+		return PromiseMetrics::typeName(types.value(id, PromiseMetrics::BaseDeferredType));
+	};
+
+	const qint64 pid = QCoreApplication::applicationPid();
+	QJsonArray traceEvents;
+	int flowId = 0;
+	for (const CollectedBuffer& buffer : const_cast<const QVector<CollectedBuffer>&>(collectedBuffers))
+	{
+		QJsonObject threadNameEvent;
+		threadNameEvent.insert("name", QStringLiteral("thread_name"));
+		threadNameEvent.insert("ph", QStringLiteral("M"));
+		threadNameEvent.insert("pid", pid);
+		threadNameEvent.insert("tid", buffer.threadIndex);
+		const QString threadName = buffer.threadName.isEmpty() ? QStringLiteral("Thread %1").arg(buffer.threadIndex) : buffer.threadName;
+		threadNameEvent.insert("args", QJsonObject{{"name", threadName}});
+		traceEvents.append(threadNameEvent);
+
+		for (const TraceEvent& event : buffer.events)
+		{
+			QJsonObject traceEvent;
+			traceEvent.insert("pid", pid);
+			traceEvent.insert("tid", buffer.threadIndex);
+			traceEvent.insert("ts", static_cast<double>(event.timestamp) / 1000.0);
+
+			switch (event.type)
+			{
+			case DeferredCreatedEvent:
+				traceEvent.insert("ph", QStringLiteral("b"));
+				traceEvent.insert("cat", QStringLiteral("deferred"));
+				traceEvent.insert("name", deferredName(event.id));
+				traceEvent.insert("id", idString(event.id));
+				traceEvent.insert("args", QJsonObject{{"type", PromiseMetrics::typeName(static_cast<PromiseMetrics::DeferredType>(event.argument))}});
+				break;
+			case ThenAttachedEvent:
+				traceEvent.insert("ph", QStringLiteral("n"));
+				traceEvent.insert("cat", QStringLiteral("deferred"));
+				traceEvent.insert("name", QStringLiteral("then"));
+				traceEvent.insert("id", idString(event.id));
+				break;
+			case SettleBeginEvent:
+			{
+				const QString name = event.argument ? QStringLiteral("reject") : QStringLiteral("resolve");
+				traceEvent.insert("ph", QStringLiteral("B"));
+				traceEvent.insert("name", name);
+				traceEvent.insert("args", QJsonObject{{"deferred", idString(event.id)}, {"name", deferredName(event.id)}});
+
+				// End of the asynchronous lifetime slice
+				QJsonObject lifetimeEnd;
+				lifetimeEnd.insert("pid", pid);
+				lifetimeEnd.insert("tid", buffer.threadIndex);
+				lifetimeEnd.insert("ts", static_cast<double>(event.timestamp) / 1000.0);
+				lifetimeEnd.insert("ph", QStringLiteral("e"));
+				lifetimeEnd.insert("cat", QStringLiteral("deferred"));
+				lifetimeEnd.insert("name", deferredName(event.id));
+				lifetimeEnd.insert("id", idString(event.id));
+				lifetimeEnd.insert("args", QJsonObject{{"state", name == QLatin1String("reject") ? QStringLiteral("rejected") : QStringLiteral("resolved")}});
+				traceEvents.append(lifetimeEnd);
+				break;
+			}
+			case SettleEndEvent:
+			case ContinuationEndEvent:
+				traceEvent.insert("ph", QStringLiteral("E"));
+				break;
+			case NotifiedEvent:
+				traceEvent.insert("ph", QStringLiteral("i"));
+				traceEvent.insert("s", QStringLiteral("t"));
+				traceEvent.insert("name", QStringLiteral("notify"));
+				traceEvent.insert("args", QJsonObject{{"deferred", idString(event.id)}, {"name", deferredName(event.id)}});
+				break;
+			case ContinuationBeginEvent:
+				traceEvent.insert("ph", QStringLiteral("B"));
+				traceEvent.insert("name", QStringLiteral("continuation"));
+				break;
+			case LinkedEvent:
+			{
+				// Flow from the settlement of the parent to the settlement of the child
+				const auto parentSettle = settles.constFind(event.id);
+				const auto childSettle = settles.constFind(event.relatedId);
+				if (parentSettle == settles.cend() || childSettle == settles.cend())
+					continue;
+				++flowId;
+				QJsonObject flowStart;
+				flowStart.insert("pid", pid);
+				flowStart.insert("tid", parentSettle->threadIndex);
+				flowStart.insert("ts", static_cast<double>(parentSettle->timestamp) / 1000.0);
+				flowStart.insert("ph", QStringLiteral("s"));
+				flowStart.insert("cat", QStringLiteral("link"));
+				flowStart.insert("name", QStringLiteral("link"));
+				flowStart.insert("id", flowId);
+				traceEvents.append(flowStart);
+
+				traceEvent.insert("tid", childSettle->threadIndex);
+				traceEvent.insert("ts", static_cast<double>(childSettle->timestamp) / 1000.0);
+				traceEvent.insert("ph", QStringLiteral("f"));
+				traceEvent.insert("bp", QStringLiteral("e"));
+				traceEvent.insert("cat", QStringLiteral("link"));
+				traceEvent.insert("name", QStringLiteral("link"));
+				traceEvent.insert("id", flowId);
+				break;
+			}
+			case LabelSetEvent:
+			default:
+				continue;
+			}
+			traceEvents.append(traceEvent);
+		}
+	}
+
+	QJsonObject document;
+	document.insert("traceEvents", traceEvents);
+	document.insert("displayTimeUnit", QStringLiteral("ms"));
+	return QJsonDocument(document).toJson(QJsonDocument::Compact);
+}
+
+bool PromiseTracer::writeChromeTrace(const QString& filePath)
+{
+	QFile file(filePath);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+	const QByteArray json = toChromeTraceJson();
+	return file.write(json) == json.size();
+}
+
+
+/*!
+ * \cond INTERNAL
+ */
+
+quint64 PromiseTracer::traceId(const Deferred* deferred)
+{
+	const quint64 currentId = deferred->m_traceId.load();
+	if (currentId != 0)
+		return currentId;
+
+	// The thread index makes the IDs unique without a shared counter
+	const quint64 newId = (static_cast<quint64>(localBuffer().threadIndex) << 40) | ++localIdCounter;
+	if (deferred->m_traceId.testAndSetOrdered(0, newId))
+		return newId;
+	return deferred->m_traceId.load();
+}
+
+void PromiseTracer::deferredCreated(const Deferred* deferred)
+{
+	record(DeferredCreatedEvent, traceId(deferred), 0, static_cast<quint8>(deferred->m_metricsType));
+}
+
+void PromiseTracer::labelSet(const Deferred* deferred, const QString& label)
+{
+	quint32 labelId = 0;
+	{
+		Registry& reg = registry();
+		QMutexLocker locker(&reg.lock);
+		auto iter = reg.labelIds.constFind(label);
+		if (iter != reg.labelIds.cend())
+			labelId = iter.value();
+		else
+		{
+			labelId = static_cast<quint32>(reg.labels.size());
+			reg.labels.append(label);
+			reg.labelIds.insert(label, labelId);
+		}
+	}
+	record(LabelSetEvent, traceId(deferred), 0, 0, labelId);
+}
+
+void PromiseTracer::thenAttached(const Deferred* deferred)
+{
+	record(ThenAttachedEvent, traceId(deferred));
+}
+
+quint64 PromiseTracer::settleBegin(const Deferred* deferred, bool rejected)
+{
+	const quint64 id = traceId(deferred);
+	record(SettleBeginEvent, id, 0, rejected ? 1 : 0);
+	return id;
+}
+
+void PromiseTracer::settleEnd(quint64 traceId)
+{
+	record(SettleEndEvent, traceId);
+}
+
+void PromiseTracer::notified(const Deferred* deferred)
+{
+	record(NotifiedEvent, traceId(deferred));
+}
+
+void PromiseTracer::continuationBegin()
+{
+	record(ContinuationBeginEvent, 0);
+}
+
+void PromiseTracer::continuationEnd()
+{
+	record(ContinuationEndEvent, 0);
+}
+
+void PromiseTracer::linked(const Deferred* parent, const Deferred* child)
+{
+	record(LinkedEvent, traceId(parent), traceId(child));
+}
+
+/*!
+ * \endcond
+ */
+
+}  // namespace QtPromise
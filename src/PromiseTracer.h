@@ -0,0 +1,116 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_PROMISETRACER_H_
+#define QTPROMISE_PROMISETRACER_H_
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QString>
+
+
+namespace QtPromise {
+
+class Deferred;
+
+/*! \brief Records the lifecycle of promises for a timeline view.
+ *
+ * When started, the PromiseTracer records the following events together with the
+ * thread and a monotonic timestamp:
+ * - The creation of Deferreds including their type and label (see Deferred::setLabel()).
+ * - The registration of continuations using Promise::then().
+ * - The resolution, rejection and notification of Deferreds.
+ * - The begin and end of the execution of continuations.
+ * - The links between ChildDeferreds and their parents.
+ *
+ * The recorded events can be exported in the [Chrome trace event format](https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU)
+ * using toChromeTraceJson() or writeChromeTrace(). The resulting file can be opened in
+ * `chrome://tracing` or in the [Perfetto UI](https://ui.perfetto.dev).
+ * - The lifetime of a Deferred from its creation until its resolution/rejection is shown as
+ * an asynchronous slice named after the label or the type of the Deferred.
+ * - The resolution/rejection of a Deferred and the execution of continuations are shown as
+ * slices on the thread. Since the continuations are executed synchronously when the Deferred
+ * is resolved/rejected, they are nested in the slice of the resolution/rejection.
+ * - The links between a ChildDeferred and its parents are shown as flow arrows from the
+ * resolution/rejection of the parent to the resolution/rejection of the child.
+ *
+ * ## Overhead ##
+ * While the tracer is stopped, the instrumentation points only check a flag.
+ * While it is running, each thread records into its own fixed size ring buffer without locking.
+ * When a ring buffer is full, the oldest events of that thread are overwritten. So the memory
+ * usage is bounded by the buffer capacity times the number of threads. The buffers of finished
+ * threads are kept for the export up to a limited number of threads.
+ *
+ * \note Exporting while the tracer is running is supported but the export might miss the
+ * events recorded during the export.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class PromiseTracer
+{
+public:
+	/*! The default number of events recorded per thread. */
+	static const int DefaultBufferCapacity = 16384;
+	/*! The maximum number of finished threads whose events are kept. */
+	static const int MaxFinishedThreads = 32;
+
+	/*! Starts recording events.
+	 *
+	 * \param bufferCapacity The number of events recorded per thread before the oldest
+	 * events are overwritten. Applies to threads which record their first event after this call.
+	 * Since the slot of the oldest event is the next one to be overwritten, exports contain at most
+	 * \p bufferCapacity - 1 events per thread.
+	 */
+	static void start(int bufferCapacity = DefaultBufferCapacity);
+	/*! Stops recording events.
+	 *
+	 * The events recorded so far are kept until clear() is called.
+	 */
+	static void stop();
+	/*! \return \c true if the tracer is recording events. */
+	static bool isEnabled() { return s_enabled.load() != 0; }
+	/*! Discards all recorded events.
+	 */
+	static void clear();
+
+	/*! Exports the recorded events.
+	 *
+	 * \return A UTF-8 encoded JSON document in the Chrome trace event format.
+	 */
+	static QByteArray toChromeTraceJson();
+	/*! Exports the recorded events into a file.
+	 *
+	 * \param filePath The path of the file to be written.
+	 * \return \c true if the file has been written successfully.
+	 */
+	static bool writeChromeTrace(const QString& filePath);
+
+	/*! \cond INTERNAL */
+	static void deferredCreated(const Deferred* deferred);
+	static void labelSet(const Deferred* deferred, const QString& label);
+	static void thenAttached(const Deferred* deferred);
+	static quint64 settleBegin(const Deferred* deferred, bool rejected);
+	static void settleEnd(quint64 traceId);
+	static void notified(const Deferred* deferred);
+	static void continuationBegin();
+	static void continuationEnd();
+	static void linked(const Deferred* parent, const Deferred* child);
+	/*! \endcond */
+
+private:
+	PromiseTracer() = delete;
+
+	static quint64 traceId(const Deferred* deferred);
+
+	static QBasicAtomicInt s_enabled;
+};
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_PROMISETRACER_H_ */
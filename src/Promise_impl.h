@@ -11,8 +11,10 @@
 
 namespace QtPromise {
 
-template<typename ResolvedFunc, typename RejectedFunc, typename NotifiedFunc>
-Promise::Ptr Promise::then(ResolvedFunc&& resolvedCallback, RejectedFunc&& rejectedCallback, NotifiedFunc&& notifiedCallback) const
+template<typename ResolvedFunc, typename RejectedFunc, typename NotifiedFunc,
+         typename std::enable_if<!IsCallSite<RejectedFunc>::value && !IsCallSite<NotifiedFunc>::value>::type*>
+Promise::Ptr Promise::then(ResolvedFunc&& resolvedCallback, RejectedFunc&& rejectedCallback, NotifiedFunc&& notifiedCallback,
+                           const CallSite& callSite) const
 {
 
 
@@ -37,18 +39,23 @@ Promise::Ptr Promise::then(ResolvedFunc&& resolvedCallback, RejectedFunc&& rejec
 		          "or it must be nullptr");
 #endif
 
+	if (PromiseTracer::isEnabled())
+		PromiseTracer::thenAttached(m_deferred.data());
+
 	switch(this->state())
 	{
 	case Deferred::Resolved:
-		return callCallback(std::forward<ResolvedFunc>(resolvedCallback));
+		return callCallback(std::forward<ResolvedFunc>(resolvedCallback), callSite);
 	case Deferred::Rejected:
-		return callCallback(std::forward<RejectedFunc>(rejectedCallback));
+		return callCallback(std::forward<RejectedFunc>(rejectedCallback), callSite);
 	case Deferred::Pending:
 	default:
 		ChildDeferred::Ptr newDeferred = ChildDeferred::create(m_deferred);
+		if (CallSiteProfiler::isEnabled())
+			CallSiteProfiler::deferredCreated(newDeferred.data(), callSite);
 
-		newDeferred->connectParent(m_deferred,       createCallbackWrapper(newDeferred.data(), std::forward<ResolvedFunc>(resolvedCallback), Deferred::Resolved),
-		                                             createCallbackWrapper(newDeferred.data(), std::forward<RejectedFunc>(rejectedCallback), Deferred::Rejected),
+		newDeferred->connectParent(m_deferred,       createCallbackWrapper(newDeferred.data(), std::forward<ResolvedFunc>(resolvedCallback), Deferred::Resolved, callSite),
+		                                             createCallbackWrapper(newDeferred.data(), std::forward<RejectedFunc>(rejectedCallback), Deferred::Rejected, callSite),
 		                                       createNotifyCallbackWrapper(newDeferred.data(), std::forward<NotifiedFunc>(notifiedCallback)));
 
 		return create(newDeferred.staticCast<Deferred>());
@@ -56,22 +63,31 @@ Promise::Ptr Promise::then(ResolvedFunc&& resolvedCallback, RejectedFunc&& rejec
 }
 
 template<typename NullCallbackFunc, typename std::enable_if<std::is_same<NullCallbackFunc, std::nullptr_t>::value>::type*>
-Promise::Ptr Promise::callCallback(NullCallbackFunc&&) const
+Promise::Ptr Promise::callCallback(NullCallbackFunc&&, const CallSite&) const
 {
 	return create(m_deferred);
 }
 
 template<typename VoidCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<VoidCallbackFunc(const QVariant&)>::type, void>::value>::type*>
-Promise::Ptr Promise::callCallback(VoidCallbackFunc&& func) const
+Promise::Ptr Promise::callCallback(VoidCallbackFunc&& func, const CallSite& callSite) const
 {
-	func(m_deferred->data());
+	{
+		// Executed directly, so there is no queueing delay
+		ContinuationScope continuationScope(m_deferred.data(), false, callSite);
+		func(m_deferred->data());
+	}
 	return create(m_deferred);
 }
 
 template<typename VariantCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<VariantCallbackFunc(const QVariant&)>::type, QVariant>::value>::type*>
-Promise::Ptr Promise::callCallback(VariantCallbackFunc&& func) const
+Promise::Ptr Promise::callCallback(VariantCallbackFunc&& func, const CallSite& callSite) const
 {
-	QVariant newValue(func(m_deferred->data()));
+	QVariant newValue;
+	{
+		// Executed directly, so there is no queueing delay
+		ContinuationScope continuationScope(m_deferred.data(), false, callSite);
+		newValue = func(m_deferred->data());
+	}
 	Deferred::Ptr newDeferred = Deferred::create();
 	/* We always resolve the new deferred since returning a value from a RejectedFunc means
 	 * "the problem has been resolved".
@@ -81,14 +97,16 @@ Promise::Ptr Promise::callCallback(VariantCallbackFunc&& func) const
 }
 
 template<typename PromiseCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<PromiseCallbackFunc(const QVariant&)>::type, Promise::Ptr>::value>::type*>
-Promise::Ptr Promise::callCallback(PromiseCallbackFunc&& func) const
+Promise::Ptr Promise::callCallback(PromiseCallbackFunc&& func, const CallSite& callSite) const
 {
+	// Executed directly, so there is no queueing delay
+	ContinuationScope continuationScope(m_deferred.data(), false, callSite);
 	return func(m_deferred->data());
 }
 
 
 template <typename NullCallbackFunc, typename std::enable_if<std::is_same<NullCallbackFunc, std::nullptr_t>::value>::type*>
-ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred* newDeferred, NullCallbackFunc, Deferred::State state)
+ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred* newDeferred, NullCallbackFunc, Deferred::State state, const CallSite&)
 {
 	Q_ASSERT_X(state != Deferred::Pending, "Promise::createCallbackWrapper()", "state must not be Pending (this is a bug in QtPromise)");
 	using namespace std::placeholders;
@@ -100,26 +118,36 @@ ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred*
 }
 
 template <typename VoidCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<VoidCallbackFunc(const QVariant&)>::type, void>::value>::type*>
-ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred* newDeferred, VoidCallbackFunc func, Deferred::State state)
+ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred* newDeferred, VoidCallbackFunc func, Deferred::State state, const CallSite& callSite)
 {
 	Q_ASSERT_X(state != Deferred::Pending, "Promise::createCallbackWrapper()", "state must not be Pending (this is a bug in QtPromise)");
 	if (state == Deferred::Resolved)
-		return [newDeferred, func](const QVariant& data) {
-		func(data);
+		return [newDeferred, func, callSite](const QVariant& data) {
+		{
+			ContinuationScope continuationScope(callSite);
+			func(data);
+		}
 		newDeferred->resolve(data);
 	};
 	else // state == Deferred::Rejected
-		return [newDeferred, func](const QVariant& data) {
-		func(data);
+		return [newDeferred, func, callSite](const QVariant& data) {
+		{
+			ContinuationScope continuationScope(callSite);
+			func(data);
+		}
 		newDeferred->reject(data);
 	};
 }
 
 template<typename VariantCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<VariantCallbackFunc(const QVariant&)>::type, QVariant>::value>::type*>
-ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred* newDeferred, VariantCallbackFunc func, Deferred::State)
+ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred* newDeferred, VariantCallbackFunc func, Deferred::State, const CallSite& callSite)
 {
-	return [newDeferred, func](const QVariant& data) {
-		QVariant newValue = QVariant::fromValue(func(data));
+	return [newDeferred, func, callSite](const QVariant& data) {
+		QVariant newValue;
+		{
+			ContinuationScope continuationScope(callSite);
+			newValue = QVariant::fromValue(func(data));
+		}
 		/* We always resolve the new deferred since returning a value from a RejectedFunc means
 		 * "the problem has been resolved".
 		 */
@@ -128,10 +156,14 @@ ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred*
 }
 
 template<typename PromiseCallbackFunc, typename std::enable_if<std::is_convertible<typename std::result_of<PromiseCallbackFunc(const QVariant&)>::type, Promise::Ptr>::value>::type*>
-ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred* newDeferred, PromiseCallbackFunc func, Deferred::State)
+ChildDeferred::WrappedCallbackFunc Promise::createCallbackWrapper(ChildDeferred* newDeferred, PromiseCallbackFunc func, Deferred::State, const CallSite& callSite)
 {
-	return [newDeferred, func](const QVariant& data) {
-		Deferred::Ptr intermedDeferred = func(data)->m_deferred;
+	return [newDeferred, func, callSite](const QVariant& data) {
+		Deferred::Ptr intermedDeferred;
+		{
+			ContinuationScope continuationScope(callSite);
+			intermedDeferred = func(data)->m_deferred;
+		}
 		switch (intermedDeferred->state())
 		{
 		case Deferred::Resolved:
@@ -204,10 +236,12 @@ ChildDeferred::WrappedCallbackFunc Promise::createNotifyCallbackWrapper(ChildDef
 }
 
 template<typename PromiseContainer>
-Promise::Ptr Promise::all_impl(const PromiseContainer& promises)
+Promise::Ptr Promise::all_impl(const PromiseContainer& promises, const CallSite& callSite)
 {
 	auto deferreds = deferredsOfPromises(promises);
 	ChildDeferred::Ptr combinedDeferred = ChildDeferred::create(deferreds, true);
+	if (CallSiteProfiler::isEnabled())
+		CallSiteProfiler::deferredCreated(combinedDeferred.data(), callSite);
 
 	QObject::connect(combinedDeferred.data(), &ChildDeferred::parentsResolved, combinedDeferred.data(), &Deferred::resolve);
 	QObject::connect(combinedDeferred.data(), &ChildDeferred::parentRejected, combinedDeferred.data(), &Deferred::reject);
@@ -252,6 +286,36 @@ QVector<Deferred::Ptr> Promise::deferredsOfPromises(const PromiseContainer& prom
 	return deferreds;
 }
 
+#ifndef QT_NO_QFUTURE
+template<typename T>
+QFuture<T> Promise::toFuture(const QVariant& cancelReason) const
+{
+	QFutureInterface<T> futureInterface;
+	futureInterface.reportStarted();
+	const QFuture<T> future = futureInterface.future();
+	bindFutureInterface(futureInterface, future, [futureInterface](const QVariant& value) mutable {
+		Promise::reportFutureResults(futureInterface, value);
+	}, cancelReason);
+	return future;
+}
+
+template<typename T>
+void Promise::reportFutureResults(QFutureInterface<T>& futureInterface, const QVariant& value)
+{
+	if (value.userType() == QMetaType::QVariantList && qMetaTypeId<T>() != QMetaType::QVariantList)
+	{
+		const QVariantList values = value.toList();
+		QVector<T> results;
+		results.reserve(values.size());
+		for (const QVariant& element : values)
+			results.append(element.value<T>());
+		futureInterface.reportResults(results);
+	}
+	else
+		futureInterface.reportResult(value.value<T>());
+}
+#endif
+
 } // namespace QtPromise
 
 #endif /* QTPROMISE_PROMISE_IMPL_H_ */
@@ -0,0 +1,98 @@
+#include "Scheduler.h"
+
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include <memory>
+
+namespace QtPromise {
+
+QBasicAtomicPointer<Scheduler> Scheduler::s_instance = Q_BASIC_ATOMIC_INITIALIZER(nullptr);
+
+/*!
+ * \cond INTERNAL
+ */
+
+namespace {
+
+QBasicAtomicInteger<quint64> lastTaskId = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+} // namespace
+
+/*!
+ * \endcond
+ */
+
+
+Scheduler::~Scheduler()
+{
+}
+
+Scheduler* Scheduler::instance()
+{
+	Scheduler* scheduler = s_instance.loadAcquire();
+	return scheduler ? scheduler : systemScheduler();
+}
+
+void Scheduler::setInstance(Scheduler* scheduler)
+{
+	s_instance.storeRelease(scheduler);
+}
+
+Scheduler* Scheduler::systemScheduler()
+{
+	/* Intentionally leaked since timers of other threads
+	 * can fire after the static objects have been destroyed.
+	 */
+	static Scheduler* instance = new SystemScheduler;
+	return instance;
+}
+
+Scheduler::TaskId Scheduler::nextTaskId()
+{
+	return lastTaskId.fetchAndAddRelaxed(1) + 1;
+}
+
+
+qint64 SystemScheduler::now() const
+{
+	return QElapsedTimer::msecsSinceReference();
+}
+
+Scheduler::TaskId SystemScheduler::schedule(int delayInMillisec, QObject* context, Task task)
+{
+	Q_ASSERT(context);
+
+	const TaskId taskId = nextTaskId();
+	/* QTimer::singleShot() cannot be stopped. Cancelled tasks are skipped when their timer fires.
+	 * The flag is removed from the hash when the timer's functor is destroyed, i.e. after the
+	 * execution or when the context object is destroyed.
+	 */
+	std::shared_ptr<QAtomicInt> cancelled(new QAtomicInt(0), [this, taskId](QAtomicInt* flag) {
+		{
+			QMutexLocker locker(&m_lock);
+			m_cancelFlags.remove(taskId);
+		}
+		delete flag;
+	});
+	{
+		QMutexLocker locker(&m_lock);
+		m_cancelFlags.insert(taskId, cancelled.get());
+	}
+
+	QTimer::singleShot(qMax(0, delayInMillisec), context, [cancelled, task]() {
+		if (cancelled->load() == 0)
+			task();
+	});
+	return taskId;
+}
+
+void SystemScheduler::cancel(TaskId taskId)
+{
+	QMutexLocker locker(&m_lock);
+	QAtomicInt* cancelled = m_cancelFlags.value(taskId);
+	if (cancelled)
+		cancelled->store(1);
+}
+
+}  // namespace QtPromise
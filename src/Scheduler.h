@@ -0,0 +1,129 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_SCHEDULER_H_
+#define QTPROMISE_SCHEDULER_H_
+
+#include <QtGlobal>
+#include <QAtomicPointer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <functional>
+
+
+namespace QtPromise {
+
+/*! \brief Provides the clock and the timers used by the QtPromise library.
+ *
+ * All timing dependent functionality of the library reads the time from and schedules delayed
+ * actions through the Scheduler::instance():
+ * - Promise::delayedResolve() and Promise::delayedReject()
+ * - The expiry of promises in a PromiseSitter (see PromiseSitter::setMaxAge())
+ * - The deadline of PromiseSitter::drain()
+ *
+ * By default, this is a SystemScheduler which uses the monotonic clock and QTimers.
+ * Tests and benchmarks can install a VirtualTimeScheduler using setInstance() to control the
+ * passing of time. This makes timing dependent tests fast and reproducible.
+ *
+ * \note Install the scheduler before creating the objects using it. PromiseSitters keep using
+ * the scheduler which was installed when they were created.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class Scheduler
+{
+public:
+	/*! Identifies a scheduled task. \c 0 is never used as identifier. */
+	typedef quint64 TaskId;
+	/*! A task executed by the scheduler. */
+	typedef std::function<void()> Task;
+
+	/*! Destroys the Scheduler.
+	 *
+	 * Tasks which have not been executed are discarded.
+	 */
+	virtual ~Scheduler();
+
+	/*! \return The current time of the scheduler's monotonic clock in milliseconds.
+	 * Only differences of the returned values are meaningful.
+	 */
+	virtual qint64 now() const = 0;
+
+	/*! Schedules a task for execution after a delay.
+	 *
+	 * The task is executed in the thread of the \p context object.
+	 * If the \p context object is destroyed before the task is due, the task is discarded.
+	 *
+	 * \param delayInMillisec The delay in milliseconds. A delay of \c 0 executes the task
+	 * asynchronously as soon as possible.
+	 * \param context The object defining the lifetime and the thread of the task.
+	 * Must not be \c nullptr.
+	 * \param task The function to execute.
+	 * \return The identifier of the task which can be passed to cancel().
+	 */
+	virtual TaskId schedule(int delayInMillisec, QObject* context, Task task) = 0;
+
+	/*! Cancels a scheduled task.
+	 *
+	 * Does nothing if the task has already been executed or cancelled.
+	 *
+	 * \param taskId The identifier returned by schedule().
+	 */
+	virtual void cancel(TaskId taskId) = 0;
+
+	/*! \return The Scheduler used by the library.
+	 * This is either the Scheduler installed with setInstance() or the systemScheduler().
+	 */
+	static Scheduler* instance();
+	/*! Installs the Scheduler used by the library.
+	 *
+	 * \param scheduler The Scheduler to be used. The caller keeps the ownership and has to ensure
+	 * that the Scheduler is uninstalled before it is destroyed. Passing \c nullptr restores the
+	 * systemScheduler().
+	 */
+	static void setInstance(Scheduler* scheduler);
+	/*! \return The default Scheduler based on the monotonic clock and QTimers. */
+	static Scheduler* systemScheduler();
+
+protected:
+	/*! \return A new, unique identifier for a task. */
+	static TaskId nextTaskId();
+
+private:
+	static QBasicAtomicPointer<Scheduler> s_instance;
+};
+
+/*! \brief The default Scheduler using the monotonic clock and QTimers.
+ *
+ * The tasks are executed by the event loop of the thread of their context object.
+ * A SystemScheduler must outlive the tasks scheduled with it.
+ *
+ * \sa Scheduler::systemScheduler()
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class SystemScheduler : public Scheduler
+{
+public:
+	/*! \return The time since the reference of QElapsedTimer in milliseconds.
+	 * See QElapsedTimer::msecsSinceReference().
+	 */
+	qint64 now() const override;
+	TaskId schedule(int delayInMillisec, QObject* context, Task task) override;
+	void cancel(TaskId taskId) override;
+
+private:
+	QMutex m_lock;
+	QHash<TaskId, QAtomicInt*> m_cancelFlags;
+};
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_SCHEDULER_H_ */
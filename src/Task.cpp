@@ -0,0 +1,39 @@
+#include "Task.h"
+
+namespace QtPromise {
+
+Task::Task(Work work)
+	: m_work(std::move(work))
+{
+}
+
+Task::Ptr Task::create(Work work)
+{
+	return Ptr(new Task(std::move(work)));
+}
+
+bool Task::isStarted() const
+{
+	QMutexLocker locker(&m_lock);
+	return !m_promise.isNull();
+}
+
+Promise::Ptr Task::start()
+{
+	QMutexLocker locker(&m_lock);
+	if (m_promise)
+		return m_promise;
+
+	/* The work is released after starting since the captured resources are not
+	 * needed anymore.
+	 */
+	Work work;
+	std::swap(work, m_work);
+	if (work)
+		m_promise = work();
+	if (!m_promise)
+		m_promise = Promise::createRejected();
+	return m_promise;
+}
+
+}  // namespace QtPromise
@@ -0,0 +1,110 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_TASK_H_
+#define QTPROMISE_TASK_H_
+
+#include "Promise.h"
+
+#include <QMutex>
+#include <QSharedPointer>
+
+#include <functional>
+
+namespace QtPromise {
+
+/*! \brief A lazy asynchronous operation which is only started when its result is requested.
+ *
+ * Promises are eager: when a Promise exists, the asynchronous operation has already been
+ * started. For example, a NetworkPromise requires a QNetworkReply, so the request has already
+ * been sent. A Task instead captures a function which starts the operation and calls it
+ * when the result is requested for the first time using start(), then(), always(),
+ * toPromise() or `co_await` (see PromiseCoroutine.h).
+ * A Task which is destroyed without being started never calls the function.
+ *
+ * \code
+ * Task::Ptr task = Task::create([qnam, request]() {
+ *     return NetworkPromise::create(qnam->get(request));
+ * });
+ * // No request has been sent yet
+ * if (needed)
+ *     task->then([](const QVariant& data) { ... });  // sends the request
+ * \endcode
+ *
+ * The function is called at most once. Subsequent requests return the same Promise.
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class Task
+{
+public:
+	/*! Smart pointer to a Task. */
+	typedef QSharedPointer<Task> Ptr;
+
+	/*! The type of the function starting the asynchronous operation. */
+	typedef std::function<Promise::Ptr()> Work;
+
+	/*! Creates a Task which is not started.
+	 *
+	 * \param work The function starting the asynchronous operation. It is called in the thread
+	 * which starts the Task while the Task is locked, so it must not access the Task itself.
+	 * If it returns a null pointer, the Task's Promise is rejected.
+	 * \return QSharedPointer to a new Task.
+	 */
+	static Ptr create(Work work);
+
+	/*! \return \c true if the Task has been started. */
+	bool isStarted() const;
+
+	/*! Starts the Task if it has not been started yet.
+	 *
+	 * \return The Promise of the asynchronous operation.
+	 */
+	Promise::Ptr start();
+
+	/*! Starts the Task and converts it to a Promise.
+	 *
+	 * Equivalent to start().
+	 */
+	Promise::Ptr toPromise() { return start(); }
+
+	/*! Starts the Task and attaches actions to its Promise.
+	 *
+	 * \sa Promise::then()
+	 */
+	template<typename ResolvedFunc, typename RejectedFunc = std::nullptr_t, typename NotifiedFunc = std::nullptr_t,
+	         typename std::enable_if<!IsCallSite<RejectedFunc>::value && !IsCallSite<NotifiedFunc>::value>::type* = nullptr>
+	Promise::Ptr then(ResolvedFunc&& resolvedCallback, RejectedFunc&& rejectedCallback = nullptr, NotifiedFunc&& notifiedCallback = nullptr,
+	                  const CallSite& callSite = QTPROMISE_DEFAULT_CALL_SITE)
+	{
+		return start()->then(std::forward<ResolvedFunc>(resolvedCallback), std::forward<RejectedFunc>(rejectedCallback),
+		                     std::forward<NotifiedFunc>(notifiedCallback), callSite);
+	}
+
+	/*! Starts the Task and attaches an action to be executed when its Promise is
+	 * either resolved or rejected.
+	 *
+	 * \sa Promise::always()
+	 */
+	template <typename AlwaysFunc>
+	Promise::Ptr always(AlwaysFunc&& alwaysCallback, const CallSite& callSite = QTPROMISE_DEFAULT_CALL_SITE)
+	{ return start()->always(std::forward<AlwaysFunc>(alwaysCallback), callSite); }
+
+protected:
+	/*! Creates a Task for the given \p work. */
+	explicit Task(Work work);
+
+private:
+	mutable QMutex m_lock;
+	Work m_work;
+	Promise::Ptr m_promise;
+};
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_TASK_H_ */
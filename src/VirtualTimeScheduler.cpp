@@ -0,0 +1,115 @@
+#include "VirtualTimeScheduler.h"
+
+#include <QThread>
+#include <QTimer>
+
+namespace QtPromise {
+
+VirtualTimeScheduler::VirtualTimeScheduler(qint64 startTime)
+	: m_now(startTime)
+{
+}
+
+qint64 VirtualTimeScheduler::now() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_now;
+}
+
+Scheduler::TaskId VirtualTimeScheduler::schedule(int delayInMillisec, QObject* context, Task task)
+{
+	Q_ASSERT(context);
+
+	const TaskId taskId = nextTaskId();
+	ScheduledTask scheduledTask;
+	scheduledTask.context = context;
+	scheduledTask.task = std::move(task);
+
+	QMutexLocker locker(&m_lock);
+	const qint64 dueTime = m_now + qMax(0, delayInMillisec);
+	m_tasks.emplace(TaskKey(dueTime, taskId), std::move(scheduledTask));
+	m_dueTimes.insert(taskId, dueTime);
+	return taskId;
+}
+
+void VirtualTimeScheduler::cancel(TaskId taskId)
+{
+	ScheduledTask cancelledTask;
+	{
+		QMutexLocker locker(&m_lock);
+		auto dueTimeIter = m_dueTimes.find(taskId);
+		if (dueTimeIter == m_dueTimes.end())
+			return;
+		auto taskIter = m_tasks.find(TaskKey(dueTimeIter.value(), taskId));
+		cancelledTask = std::move(taskIter->second);
+		m_tasks.erase(taskIter);
+		m_dueTimes.erase(dueTimeIter);
+	}
+	// The task is destroyed outside of the lock since its captures can call the scheduler
+}
+
+int VirtualTimeScheduler::advanceBy(qint64 milliseconds)
+{
+	return advanceTo(now() + qMax(Q_INT64_C(0), milliseconds));
+}
+
+int VirtualTimeScheduler::advanceTo(qint64 time)
+{
+	int executedTasks = 0;
+	ScheduledTask task;
+	while (takeDueTask(time, task))
+	{
+		QObject* context = task.context.data();
+		if (context)
+		{
+			if (context->thread() == QThread::currentThread())
+				task.task();
+			else
+				QTimer::singleShot(0, context, task.task);
+			++executedTasks;
+		}
+		task = ScheduledTask();
+	}
+
+	QMutexLocker locker(&m_lock);
+	m_now = qMax(m_now, time);
+	return executedTasks;
+}
+
+bool VirtualTimeScheduler::advanceToNextTask()
+{
+	const qint64 time = nextTaskTime();
+	if (time < 0)
+		return false;
+	advanceTo(time);
+	return true;
+}
+
+int VirtualTimeScheduler::pendingTaskCount() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_dueTimes.size();
+}
+
+qint64 VirtualTimeScheduler::nextTaskTime() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_tasks.empty() ? -1 : m_tasks.begin()->first.first;
+}
+
+bool VirtualTimeScheduler::takeDueTask(qint64 time, ScheduledTask& task)
+{
+	QMutexLocker locker(&m_lock);
+	auto taskIter = m_tasks.begin();
+	if (taskIter == m_tasks.end() || taskIter->first.first > time)
+		return false;
+
+	// The clock shows the due time while the task is executed
+	m_now = qMax(m_now, taskIter->first.first);
+	m_dueTimes.remove(taskIter->first.second);
+	task = std::move(taskIter->second);
+	m_tasks.erase(taskIter);
+	return true;
+}
+
+}  // namespace QtPromise
@@ -0,0 +1,108 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_VIRTUALTIMESCHEDULER_H_
+#define QTPROMISE_VIRTUALTIMESCHEDULER_H_
+
+#include "Scheduler.h"
+
+#include <QtGlobal>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QPointer>
+#include <map>
+
+
+namespace QtPromise {
+
+/*! \brief A Scheduler whose clock only advances when requested.
+ *
+ * The VirtualTimeScheduler allows testing timing dependent code without waiting:
+ * the scheduled tasks are only executed when the virtual time is advanced using advanceBy(),
+ * advanceTo() or advanceToNextTask(). Tasks are executed in the order of their due time.
+ * Tasks with the same due time are executed in the order they have been scheduled.
+ * Tasks scheduled by a task during an advance are executed in the same advance if they are due.
+ *
+ * \code
+ * VirtualTimeScheduler scheduler;
+ * Scheduler::setInstance(&scheduler);
+ *
+ * Promise::Ptr promise = Promise::delayedResolve(42, 60 * 1000);
+ * scheduler.advanceBy(60 * 1000);
+ * // promise is resolved now
+ *
+ * Scheduler::setInstance(nullptr);
+ * \endcode
+ *
+ * The tasks of context objects living in the thread calling advanceTo() are executed directly.
+ * Tasks of context objects living in other threads are posted to the event loop of that thread.
+ * Note that tasks with a delay of \c 0 are also only executed when the time is advanced
+ * (for example using `advanceBy(0)`).
+ *
+ * \threadsafeClass
+ * \author jochen.ulrich
+ * \since 2.2.0
+ */
+class VirtualTimeScheduler : public Scheduler
+{
+public:
+	/*! Creates a VirtualTimeScheduler.
+	 *
+	 * \param startTime The initial virtual time in milliseconds.
+	 */
+	explicit VirtualTimeScheduler(qint64 startTime = 0);
+
+	qint64 now() const override;
+	TaskId schedule(int delayInMillisec, QObject* context, Task task) override;
+	void cancel(TaskId taskId) override;
+
+	/*! Advances the virtual time and executes the tasks which become due.
+	 *
+	 * \param milliseconds The amount of milliseconds to advance the time by.
+	 * Negative values are treated as \c 0.
+	 * \return The number of executed tasks.
+	 */
+	int advanceBy(qint64 milliseconds);
+	/*! Advances the virtual time to a point in time and executes the tasks which become due.
+	 *
+	 * \param time The new virtual time in milliseconds. If \p time is in the past,
+	 * the time is not changed but the tasks which are due are executed.
+	 * \return The number of executed tasks.
+	 */
+	int advanceTo(qint64 time);
+	/*! Advances the virtual time to the due time of the next task and executes the tasks
+	 * which are due at that time.
+	 *
+	 * \return \c true if tasks have been executed. \c false if there is no scheduled task.
+	 */
+	bool advanceToNextTask();
+
+	/*! \return The number of scheduled tasks which have not been executed yet. */
+	int pendingTaskCount() const;
+	/*! \return The due time of the next task or \c -1 if there is no scheduled task. */
+	qint64 nextTaskTime() const;
+
+private:
+	typedef QPair<qint64, TaskId> TaskKey;
+
+	struct ScheduledTask
+	{
+		QPointer<QObject> context;
+		Task task;
+	};
+
+	bool takeDueTask(qint64 time, ScheduledTask& task);
+
+	mutable QMutex m_lock;
+	qint64 m_now;
+	std::map<TaskKey, ScheduledTask> m_tasks;
+	QHash<TaskId, qint64> m_dueTimes;
+};
+
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_VIRTUALTIMESCHEDULER_H_ */
@@ -0,0 +1,220 @@
+#include <QtTest>
+#include "AllocationCounter.h"
+#include "Promise.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the AllocationCounter class and the allocation budgets of
+ * the basic promise operations.
+ *
+ * \author jochen.ulrich
+ */
+class AllocationCounterTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void initTestCase();
+
+	void testCounting();
+	void testOtherThreads();
+	void testAllocationBudgets_data();
+	void testAllocationBudgets();
+};
+
+
+//####### Helper #######
+
+/*! Prevents the compiler from removing allocations. */
+void* volatile allocationSink = nullptr;
+
+/*! Allocates in a separate thread.
+ */
+class AllocatingThread : public QThread
+{
+protected:
+	void run() override
+	{
+		for (int i = 0; i < 100; ++i)
+		{
+			int* value = new int(i);
+			allocationSink = value;
+			delete value;
+		}
+	}
+};
+
+/*! The operations whose allocations are limited by testAllocationBudgets(). */
+enum Operation
+{
+	CreateDeferred,
+	CreatePromise,
+	ThenOnPending,
+	ThenOnResolved,
+	ResolveWithContinuation,
+	CreateResolved
+};
+
+/*! Executes an \p operation.
+ *
+ * The objects which are not part of the measured operation are created before \p counter is reset
+ * and destroyed after the counts have been taken.
+ *
+ * \return The counts of the operation.
+ */
+AllocationCounter::Counts measureOperation(Operation operation)
+{
+	AllocationCounter counter;
+	AllocationCounter::Counts result;
+	auto callback = [](const QVariant&) {};
+
+	switch (operation)
+	{
+	case CreateDeferred:
+	{
+		counter.reset();
+		Deferred::Ptr deferred = Deferred::create();
+		result = counter.counts();
+		break;
+	}
+	case CreatePromise:
+	{
+		Deferred::Ptr deferred = Deferred::create();
+		counter.reset();
+		Promise::Ptr promise = Promise::create(deferred);
+		result = counter.counts();
+		break;
+	}
+	case ThenOnPending:
+	{
+		Deferred::Ptr deferred = Deferred::create();
+		Promise::Ptr promise = Promise::create(deferred);
+		counter.reset();
+		Promise::Ptr chained = promise->then(callback);
+		result = counter.counts();
+		chained.reset();
+		deferred->resolve();
+		break;
+	}
+	case ThenOnResolved:
+	{
+		Deferred::Ptr deferred = Deferred::create();
+		deferred->resolve(1);
+		Promise::Ptr promise = Promise::create(deferred);
+		QCoreApplication::processEvents();
+		counter.reset();
+		Promise::Ptr chained = promise->then(callback);
+		result = counter.counts();
+		QCoreApplication::processEvents();
+		break;
+	}
+	case ResolveWithContinuation:
+	{
+		Deferred::Ptr deferred = Deferred::create();
+		Promise::Ptr chained = Promise::create(deferred)->then(callback);
+		counter.reset();
+		deferred->resolve(1);
+		result = counter.counts();
+		break;
+	}
+	case CreateResolved:
+	{
+		counter.reset();
+		Promise::Ptr promise = Promise::createResolved(1);
+		result = counter.counts();
+		QCoreApplication::processEvents();
+		break;
+	}
+	}
+	return result;
+}
+
+
+//####### Tests #######
+void AllocationCounterTest::initTestCase()
+{
+	if (!AllocationCounter::isSupported())
+		QSKIP("Allocations are not counted in this build");
+}
+
+/*! \test Tests counting allocations and deallocations.
+ */
+void AllocationCounterTest::testCounting()
+{
+	AllocationCounter counter;
+	int* value = new int(42);
+	allocationSink = value;
+	const AllocationCounter::Counts afterAllocation = counter.counts();
+	delete value;
+	const AllocationCounter::Counts afterDeallocation = counter.counts();
+
+	QCOMPARE(afterAllocation.allocations, static_cast<quint64>(1));
+	QCOMPARE(afterAllocation.deallocations, static_cast<quint64>(0));
+	QVERIFY(afterAllocation.bytes >= sizeof(int));
+	QCOMPARE(afterDeallocation.allocations, static_cast<quint64>(1));
+	QCOMPARE(afterDeallocation.deallocations, static_cast<quint64>(1));
+
+	counter.reset();
+	QCOMPARE(counter.allocations(), static_cast<quint64>(0));
+	QCOMPARE(counter.deallocations(), static_cast<quint64>(0));
+	QCOMPARE(counter.bytes(), static_cast<quint64>(0));
+}
+
+/*! \test Tests that only the allocations of the current thread are counted.
+ */
+void AllocationCounterTest::testOtherThreads()
+{
+	AllocatingThread thread;
+	AllocationCounter counter;
+	thread.start();
+	thread.wait();
+	const quint64 allocations = counter.allocations();
+
+	// Starting a thread allocates in the starting thread as well but less than the thread itself
+	QVERIFY(allocations < 100);
+}
+
+/*! Provides the data for the testAllocationBudgets() test.
+ *
+ * The budgets are upper bounds to detect regressions of the allocation behavior.
+ * When an optimization reduces the number of allocations, lower the budget accordingly.
+ */
+void AllocationCounterTest::testAllocationBudgets_data()
+{
+	QTest::addColumn<int>("operation");
+	QTest::addColumn<int>("budget");
+
+	QTest::newRow("Deferred::create()") << static_cast<int>(CreateDeferred) << 8;
+	QTest::newRow("Promise::create()") << static_cast<int>(CreatePromise) << 16;
+	QTest::newRow("then() on pending") << static_cast<int>(ThenOnPending) << 40;
+	QTest::newRow("then() on resolved") << static_cast<int>(ThenOnResolved) << 48;
+	QTest::newRow("resolve() with continuation") << static_cast<int>(ResolveWithContinuation) << 24;
+	QTest::newRow("Promise::createResolved()") << static_cast<int>(CreateResolved) << 24;
+}
+
+/*! \test Tests that the basic promise operations do not exceed their allocation budgets.
+ */
+void AllocationCounterTest::testAllocationBudgets()
+{
+	QFETCH(int, operation);
+	QFETCH(int, budget);
+
+	// Warm up meta type registrations, thread locals and the event dispatcher
+	measureOperation(static_cast<Operation>(operation));
+
+	const AllocationCounter::Counts counts = measureOperation(static_cast<Operation>(operation));
+	QVERIFY(counts.allocations > 0);
+	QVERIFY2(counts.allocations <= static_cast<quint64>(budget),
+	         qPrintable(QString("%1 allocations (%2 bytes) exceed the budget of %3")
+	                    .arg(counts.allocations).arg(counts.bytes).arg(budget)));
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::AllocationCounterTest)
+#include "AllocationCounterTest.moc"
@@ -0,0 +1,329 @@
+#include <QtTest>
+#include "AsyncLazy.h"
+#include "VirtualTimeScheduler.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the AsyncLazy class.
+ *
+ * \author jochen.ulrich
+ */
+class AsyncLazyTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void cleanup();
+
+	void testNotStartedUntilRequested();
+	void testSharedComputation();
+	void testValue();
+	void testSynchronousFactory();
+	void testRejection();
+	void testResetOnRejection();
+	void testReset();
+	void testRefresh();
+	void testRefreshRejected();
+	void testRefreshInterval();
+	void testConcurrentGet();
+};
+
+
+//####### Helper #######
+
+/*! Factory which counts its calls and provides the Deferreds of the computations.
+ */
+class CountingFactory
+{
+public:
+	AsyncLazyBase::Factory factory()
+	{
+		return [this]() {
+			Deferred::Ptr deferred = Deferred::create();
+			deferreds.append(deferred);
+			return Promise::create(deferred);
+		};
+	}
+
+	int calls() const { return deferreds.size(); }
+
+	QVector<Deferred::Ptr> deferreds;
+};
+
+/*! Waits until \p promise is settled. */
+void waitForSettled(Promise::Ptr promise)
+{
+	QTRY_VERIFY(promise->state() != Deferred::Pending);
+}
+
+
+//####### Tests #######
+void AsyncLazyTest::cleanup()
+{
+	Scheduler::setInstance(nullptr);
+}
+
+/*! \test Tests that the factory is not called before get().
+ */
+void AsyncLazyTest::testNotStartedUntilRequested()
+{
+	CountingFactory factory;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create(factory.factory());
+
+	QVERIFY(!lazy->isStarted());
+	QVERIFY(lazy->current().isNull());
+	QVERIFY(!lazy->hasValue());
+	QCOMPARE(factory.calls(), 0);
+}
+
+/*! \test Tests that concurrent and later callers share the computation.
+ */
+void AsyncLazyTest::testSharedComputation()
+{
+	CountingFactory factory;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create(factory.factory());
+
+	Promise::Ptr first = lazy->get();
+	Promise::Ptr second = lazy->get();
+	QVERIFY(lazy->isStarted());
+	QCOMPARE(factory.calls(), 1);
+	QCOMPARE(second, first);
+	QVERIFY(lazy->current().isNull());
+
+	factory.deferreds[0]->resolve(7);
+	QTRY_VERIFY(!lazy->current().isNull());
+
+	QCOMPARE(lazy->get(), first);
+	QCOMPARE(lazy->current(), first);
+	QCOMPARE(factory.calls(), 1);
+}
+
+/*! \test Tests AsyncLazy::hasValue() and AsyncLazy::value().
+ */
+void AsyncLazyTest::testValue()
+{
+	CountingFactory factory;
+	AsyncLazy<QString>::Ptr lazy = AsyncLazy<QString>::create(factory.factory());
+
+	QCOMPARE(lazy->value(QString("default")), QString("default"));
+	lazy->get();
+	factory.deferreds[0]->resolve(QString("token"));
+	QTRY_VERIFY(lazy->hasValue());
+	QCOMPARE(lazy->value(), QString("token"));
+}
+
+/*! \test Tests a factory which returns a settled Promise.
+ */
+void AsyncLazyTest::testSynchronousFactory()
+{
+	int calls = 0;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create([&calls]() {
+		++calls;
+		Deferred::Ptr deferred = Deferred::create();
+		Promise::Ptr promise = Promise::create(deferred);
+		deferred->resolve(3);
+		return promise;
+	});
+
+	Promise::Ptr promise = lazy->get();
+	QCOMPARE(promise->state(), Deferred::Resolved);
+	QTRY_VERIFY(lazy->hasValue());
+	QCOMPARE(lazy->value(), 3);
+	QCOMPARE(lazy->get(), promise);
+	QCOMPARE(calls, 1);
+}
+
+/*! \test Tests that a rejected computation is kept by default.
+ */
+void AsyncLazyTest::testRejection()
+{
+	CountingFactory factory;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create(factory.factory());
+
+	Promise::Ptr promise = lazy->get();
+	factory.deferreds[0]->reject(QString("error"));
+	QTRY_VERIFY(!lazy->current().isNull());
+
+	QCOMPARE(lazy->get(), promise);
+	QCOMPARE(lazy->get()->state(), Deferred::Rejected);
+	QVERIFY(!lazy->hasValue());
+	QCOMPARE(factory.calls(), 1);
+
+	AsyncLazy<int>::Ptr nullLazy = AsyncLazy<int>::create([]() { return Promise::Ptr(); });
+	QCOMPARE(nullLazy->get()->state(), Deferred::Rejected);
+}
+
+/*! \test Tests the AsyncLazyBase::ResetOnRejection option.
+ */
+void AsyncLazyTest::testResetOnRejection()
+{
+	CountingFactory factory;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create(factory.factory(), AsyncLazyBase::ResetOnRejection);
+	QCOMPARE(lazy->options(), AsyncLazyBase::Options(AsyncLazyBase::ResetOnRejection));
+
+	Promise::Ptr first = lazy->get();
+	Promise::Ptr waiting = lazy->get();
+	factory.deferreds[0]->reject(QString("error"));
+	waitForSettled(waiting);
+	QCOMPARE(waiting->state(), Deferred::Rejected);
+	QTRY_VERIFY(!lazy->isStarted());
+
+	Promise::Ptr second = lazy->get();
+	QVERIFY(second != first);
+	QCOMPARE(factory.calls(), 2);
+
+	factory.deferreds[1]->resolve(5);
+	QTRY_COMPARE(lazy->value(), 5);
+}
+
+/*! \test Tests AsyncLazy::reset().
+ */
+void AsyncLazyTest::testReset()
+{
+	CountingFactory factory;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create(factory.factory());
+
+	Promise::Ptr first = lazy->get();
+	factory.deferreds[0]->resolve(1);
+	QTRY_VERIFY(lazy->hasValue());
+
+	lazy->reset();
+	QVERIFY(!lazy->isStarted());
+	QVERIFY(!lazy->hasValue());
+	QCOMPARE(first->data(), QVariant(1));
+
+	// A pending computation is forgotten as well
+	Promise::Ptr second = lazy->get();
+	lazy->reset();
+	factory.deferreds[1]->resolve(2);
+	QCoreApplication::processEvents();
+	QCOMPARE(second->state(), Deferred::Resolved);
+	QVERIFY(!lazy->hasValue());
+
+	lazy->get();
+	QCOMPARE(factory.calls(), 3);
+}
+
+/*! \test Tests that AsyncLazy::refresh() keeps providing the current value until the refresh is resolved.
+ */
+void AsyncLazyTest::testRefresh()
+{
+	CountingFactory factory;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create(factory.factory());
+
+	Promise::Ptr first = lazy->get();
+	factory.deferreds[0]->resolve(1);
+	QTRY_VERIFY(lazy->hasValue());
+
+	lazy->refresh();
+	lazy->refresh();
+	QCOMPARE(factory.calls(), 2);
+	QCOMPARE(lazy->get(), first);
+
+	factory.deferreds[1]->resolve(2);
+	QTRY_COMPARE(lazy->value(), 2);
+	QVERIFY(lazy->get() != first);
+}
+
+/*! \test Tests that a rejected refresh keeps the current value.
+ */
+void AsyncLazyTest::testRefreshRejected()
+{
+	CountingFactory factory;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create(factory.factory(), AsyncLazyBase::ResetOnRejection);
+
+	Promise::Ptr first = lazy->get();
+	factory.deferreds[0]->resolve(1);
+	QTRY_VERIFY(lazy->hasValue());
+
+	lazy->refresh();
+	factory.deferreds[1]->reject(QString("error"));
+	QCoreApplication::processEvents();
+
+	QCOMPARE(lazy->get(), first);
+	QCOMPARE(lazy->value(), 1);
+	QCOMPARE(factory.calls(), 2);
+}
+
+/*! \test Tests the periodic refresh.
+ */
+void AsyncLazyTest::testRefreshInterval()
+{
+	VirtualTimeScheduler scheduler;
+	Scheduler::setInstance(&scheduler);
+
+	CountingFactory factory;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create(factory.factory());
+	lazy->setRefreshInterval(100);
+	QCOMPARE(lazy->refreshInterval(), 100);
+
+	// No refresh before the first computation
+	scheduler.advanceBy(200);
+	QCOMPARE(factory.calls(), 0);
+
+	lazy->get();
+	factory.deferreds[0]->resolve(1);
+	QTRY_VERIFY(lazy->hasValue());
+
+	scheduler.advanceBy(99);
+	QCOMPARE(factory.calls(), 1);
+	scheduler.advanceBy(1);
+	QCOMPARE(factory.calls(), 2);
+	QCOMPARE(lazy->value(), 1);
+
+	// The interval starts when the refresh is settled
+	scheduler.advanceBy(100);
+	QCOMPARE(factory.calls(), 2);
+	factory.deferreds[1]->resolve(2);
+	QTRY_COMPARE(lazy->value(), 2);
+	scheduler.advanceBy(100);
+	QCOMPARE(factory.calls(), 3);
+
+	lazy->setRefreshInterval(0);
+	factory.deferreds[2]->resolve(3);
+	QTRY_COMPARE(lazy->value(), 3);
+	scheduler.advanceBy(1000);
+	QCOMPARE(factory.calls(), 3);
+}
+
+/*! \test Tests calling AsyncLazy::get() from multiple threads.
+ */
+void AsyncLazyTest::testConcurrentGet()
+{
+	QAtomicInt calls;
+	AsyncLazy<int>::Ptr lazy = AsyncLazy<int>::create([&calls]() {
+		calls.ref();
+		return Promise::delayedResolve(4);
+	});
+
+	QVector<QThread*> threads;
+	QVector<Promise::Ptr> promises(8);
+	for (int i = 0; i < promises.size(); ++i)
+	{
+		QThread* thread = new QThread;
+		QObject::connect(thread, &QThread::started, [lazy, &promises, i]() { promises[i] = lazy->get(); });
+		threads.append(thread);
+	}
+	for (QThread* thread : threads)
+		thread->start();
+	for (QThread* thread : threads)
+	{
+		thread->quit();
+		thread->wait();
+	}
+	qDeleteAll(threads);
+
+	QCOMPARE(calls.load(), 1);
+	for (const Promise::Ptr& promise : promises)
+		QCOMPARE(promise, promises.first());
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::AsyncLazyTest)
+#include "AsyncLazyTest.moc"
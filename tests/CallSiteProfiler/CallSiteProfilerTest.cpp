@@ -0,0 +1,214 @@
+#include <QtTest>
+#include "CallSiteProfiler.h"
+#include "Promise.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the CallSiteProfiler class.
+ *
+ * \author jochen.ulrich
+ */
+class CallSiteProfilerTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void cleanup();
+
+	void testCallSite();
+	void testDisabled();
+	void testThen();
+	void testThenOnSettledPromise();
+	void testAlways();
+	void testAllAndCreate();
+	void testTopCallSites();
+	void testClear();
+};
+
+
+//####### Helper #######
+
+/*! \return The statistics of the call site at \p line or default constructed statistics
+ * if there are none.
+ */
+CallSiteProfiler::Statistics statisticsAtLine(int line)
+{
+	for (const CallSiteProfiler::Statistics& statistics : CallSiteProfiler::statistics())
+	{
+		if (statistics.callSite.line == line)
+			return statistics;
+	}
+	return CallSiteProfiler::Statistics();
+}
+
+const qint64 oneMillisecond = 1000000;
+
+
+//####### Tests #######
+void CallSiteProfilerTest::cleanup()
+{
+	CallSiteProfiler::stop();
+	CallSiteProfiler::clear();
+}
+
+/*! \test Tests the QTPROMISE_HERE macro.
+ */
+void CallSiteProfilerTest::testCallSite()
+{
+	QVERIFY(!CallSite().isValid());
+
+	const int line = __LINE__ + 1;
+	const CallSite callSite = QTPROMISE_HERE;
+	QVERIFY(callSite.isValid());
+	QCOMPARE(callSite.line, line);
+	QVERIFY(QByteArray(callSite.file).endsWith("CallSiteProfilerTest.cpp"));
+	QVERIFY(QByteArray(callSite.function).contains("testCallSite"));
+}
+
+/*! \test Tests that nothing is recorded while the profiler is stopped.
+ */
+void CallSiteProfilerTest::testDisabled()
+{
+	QVERIFY(!CallSiteProfiler::isEnabled());
+
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred, QTPROMISE_HERE)->then([](const QVariant&) {}, QTPROMISE_HERE);
+	deferred->resolve();
+
+	QVERIFY(CallSiteProfiler::statistics().isEmpty());
+}
+
+/*! \test Tests the recording of a continuation registered on a pending Promise.
+ */
+void CallSiteProfilerTest::testThen()
+{
+	CallSiteProfiler::start();
+	QVERIFY(CallSiteProfiler::isEnabled());
+
+	Deferred::Ptr deferred = Deferred::create();
+	const int line = __LINE__ + 3;
+	Promise::Ptr promise = Promise::create(deferred)->then([](const QVariant&) {
+		QThread::msleep(5);
+	}, QTPROMISE_HERE);
+	QTest::qWait(5);
+	deferred->resolve();
+	QCOMPARE(promise->state(), Deferred::Resolved);
+
+	const CallSiteProfiler::Statistics statistics = statisticsAtLine(line);
+	QVERIFY(statistics.callSite.isValid());
+	QCOMPARE(statistics.callbackCount, Q_UINT64_C(1));
+	QVERIFY(statistics.callbackTotalTime >= 4 * oneMillisecond);
+	QCOMPARE(statistics.callbackMaxTime, statistics.callbackTotalTime);
+	QCOMPARE(statistics.pendingCount, Q_UINT64_C(1));
+	// The pending time includes the execution of the callback
+	QVERIFY(statistics.pendingTotalTime >= statistics.callbackTotalTime + 4 * oneMillisecond);
+	QCOMPARE(statistics.pendingMaxTime, statistics.pendingTotalTime);
+}
+
+/*! \test Tests the recording of a continuation registered on an already resolved Promise.
+ */
+void CallSiteProfilerTest::testThenOnSettledPromise()
+{
+	CallSiteProfiler::start();
+
+	bool called = false;
+	const int line = __LINE__ + 1;
+	Promise::createResolved()->then([&called](const QVariant&) { called = true; }, nullptr, QTPROMISE_HERE);
+	QVERIFY(called);
+
+	const CallSiteProfiler::Statistics statistics = statisticsAtLine(line);
+	QCOMPARE(statistics.callbackCount, Q_UINT64_C(1));
+	QCOMPARE(statistics.pendingCount, Q_UINT64_C(0));
+}
+
+/*! \test Tests the recording of Promise::always().
+ */
+void CallSiteProfilerTest::testAlways()
+{
+	CallSiteProfiler::start();
+
+	Deferred::Ptr deferred = Deferred::create();
+	const int line = __LINE__ + 1;
+	Promise::Ptr promise = Promise::create(deferred)->always([](const QVariant&) {}, QTPROMISE_HERE);
+	deferred->reject();
+
+	const CallSiteProfiler::Statistics statistics = statisticsAtLine(line);
+	QCOMPARE(statistics.callbackCount, Q_UINT64_C(1));
+	QCOMPARE(statistics.pendingCount, Q_UINT64_C(1));
+}
+
+/*! \test Tests the recording of the pending time of Promise::all() and Promise::create().
+ */
+void CallSiteProfilerTest::testAllAndCreate()
+{
+	CallSiteProfiler::start();
+
+	Deferred::Ptr first = Deferred::create();
+	Deferred::Ptr second = Deferred::create();
+	const int createLine = __LINE__ + 1;
+	Promise::Ptr firstPromise = Promise::create(first, QTPROMISE_HERE);
+	const int allLine = __LINE__ + 1;
+	Promise::Ptr combined = Promise::all({firstPromise, Promise::create(second)}, QTPROMISE_HERE);
+	QTest::qWait(5);
+	first->resolve();
+	second->resolve();
+	QCOMPARE(combined->state(), Deferred::Resolved);
+
+	const CallSiteProfiler::Statistics createStatistics = statisticsAtLine(createLine);
+	QCOMPARE(createStatistics.pendingCount, Q_UINT64_C(1));
+	QCOMPARE(createStatistics.callbackCount, Q_UINT64_C(0));
+	QVERIFY(createStatistics.pendingMaxTime >= 4 * oneMillisecond);
+
+	const CallSiteProfiler::Statistics allStatistics = statisticsAtLine(allLine);
+	QCOMPARE(allStatistics.pendingCount, Q_UINT64_C(1));
+	QVERIFY(allStatistics.pendingMaxTime >= 4 * oneMillisecond);
+}
+
+/*! \test Tests the CallSiteProfiler::topCallSites() and CallSiteProfiler::report() methods.
+ */
+void CallSiteProfilerTest::testTopCallSites()
+{
+	CallSiteProfiler::start();
+
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+	const int fastLine = __LINE__ + 1;
+	Promise::Ptr fast = promise->then([](const QVariant&) {}, QTPROMISE_HERE);
+	const int slowLine = __LINE__ + 1;
+	Promise::Ptr slow = promise->then([](const QVariant&) { QThread::msleep(5); }, QTPROMISE_HERE);
+	deferred->resolve();
+
+	QCOMPARE(CallSiteProfiler::statistics().size(), 2);
+
+	const QVector<CallSiteProfiler::Statistics> top = CallSiteProfiler::topCallSites(1);
+	QCOMPARE(top.size(), 1);
+	QCOMPARE(top.first().callSite.line, slowLine);
+	QCOMPARE(CallSiteProfiler::topCallSites(-1, CallSiteProfiler::CallbackCount).size(), 2);
+
+	const QString report = CallSiteProfiler::report();
+	QCOMPARE(report.count('\n'), 3);
+	QVERIFY(report.contains(QString("CallSiteProfilerTest.cpp:%1").arg(slowLine)));
+	QVERIFY(report.indexOf(QString(":%1").arg(slowLine)) < report.indexOf(QString(":%1").arg(fastLine)));
+}
+
+/*! \test Tests the CallSiteProfiler::clear() method.
+ */
+void CallSiteProfilerTest::testClear()
+{
+	CallSiteProfiler::start();
+	Promise::createResolved()->then([](const QVariant&) {}, QTPROMISE_HERE);
+	QCOMPARE(CallSiteProfiler::statistics().size(), 1);
+
+	CallSiteProfiler::clear();
+	QVERIFY(CallSiteProfiler::statistics().isEmpty());
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::CallSiteProfilerTest)
+#include "CallSiteProfilerTest.moc"
@@ -0,0 +1,175 @@
+#include <QtTest>
+#include "ContinuationWatchdog.h"
+#include "Promise.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the ContinuationWatchdog class.
+ *
+ * \author jochen.ulrich
+ */
+class ContinuationWatchdogTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void cleanup();
+
+	void testDisabled();
+	void testSlowContinuation();
+	void testFastContinuation();
+	void testDirectContinuation();
+	void testLogWarning();
+	void testLabelCapturedAtStart();
+};
+
+
+//####### Helper #######
+
+/*! Collects the reports of the ContinuationWatchdog.
+ */
+class ReportCollector
+{
+public:
+	ReportCollector()
+	{
+		ContinuationWatchdog::setHandler([this](const ContinuationWatchdog::SlowContinuation& report) {
+			reports.append(report);
+		});
+	}
+	~ReportCollector()
+	{
+		ContinuationWatchdog::setHandler(ContinuationWatchdog::Handler());
+	}
+
+	QVector<ContinuationWatchdog::SlowContinuation> reports;
+};
+
+/*! A callback blocking for 20 milliseconds. */
+void blockingCallback(const QVariant&)
+{
+	QThread::msleep(20);
+}
+
+
+//####### Tests #######
+void ContinuationWatchdogTest::cleanup()
+{
+	ContinuationWatchdog::stop();
+	ContinuationWatchdog::resetSlowContinuationCount();
+}
+
+/*! \test Tests that nothing is reported while the watchdog is stopped.
+ */
+void ContinuationWatchdogTest::testDisabled()
+{
+	ReportCollector collector;
+	QVERIFY(!ContinuationWatchdog::isEnabled());
+
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred)->then(blockingCallback);
+	deferred->resolve();
+
+	QVERIFY(collector.reports.isEmpty());
+	QCOMPARE(ContinuationWatchdog::slowContinuationCount(), Q_UINT64_C(0));
+}
+
+/*! \test Tests the report of a slow continuation.
+ */
+void ContinuationWatchdogTest::testSlowContinuation()
+{
+	ReportCollector collector;
+	ContinuationWatchdog::start(10);
+	QVERIFY(ContinuationWatchdog::isEnabled());
+	QCOMPARE(ContinuationWatchdog::threshold(), 10);
+
+	Deferred::Ptr deferred = Deferred::create();
+	deferred->setLabel("loadConfig");
+	const int line = __LINE__ + 1;
+	Promise::Ptr promise = Promise::create(deferred)->then(blockingCallback, QTPROMISE_HERE);
+	deferred->resolve();
+
+	QCOMPARE(collector.reports.size(), 1);
+	const ContinuationWatchdog::SlowContinuation& report = collector.reports.first();
+	QVERIFY(report.duration >= 10 * 1000000);
+	QCOMPARE(report.callSite.line, line);
+	QCOMPARE(report.deferred, static_cast<const void*>(deferred.data()));
+	QCOMPARE(report.deferredLabel, QString("loadConfig"));
+	QCOMPARE(report.threadId, QThread::currentThreadId());
+	QCOMPARE(ContinuationWatchdog::slowContinuationCount(), Q_UINT64_C(1));
+
+	const QString description = report.toString();
+	QVERIFY(description.contains(QString("ContinuationWatchdogTest.cpp:%1").arg(line)));
+	QVERIFY(description.contains("\"loadConfig\""));
+}
+
+/*! \test Tests that continuations below the threshold are not reported.
+ */
+void ContinuationWatchdogTest::testFastContinuation()
+{
+	ReportCollector collector;
+	ContinuationWatchdog::start(1000);
+
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred)->then(blockingCallback);
+	deferred->resolve();
+
+	QVERIFY(collector.reports.isEmpty());
+	QCOMPARE(ContinuationWatchdog::slowContinuationCount(), Q_UINT64_C(0));
+}
+
+/*! \test Tests the report of a continuation registered on an already resolved Promise.
+ */
+void ContinuationWatchdogTest::testDirectContinuation()
+{
+	ReportCollector collector;
+	ContinuationWatchdog::start(10);
+
+	Promise::Ptr resolvedPromise = Promise::createResolved();
+	Promise::Ptr promise = resolvedPromise->then(blockingCallback);
+
+	QCOMPARE(collector.reports.size(), 1);
+	QVERIFY(collector.reports.first().deferred != nullptr);
+}
+
+/*! \test Tests that a warning is logged if there is no handler.
+ */
+void ContinuationWatchdogTest::testLogWarning()
+{
+	ContinuationWatchdog::start(10);
+
+	QTest::ignoreMessage(QtWarningMsg, QRegularExpression("^Slow continuation took \\d+\\.\\d+ ms"));
+	Promise::createResolved()->then(blockingCallback);
+	QCOMPARE(ContinuationWatchdog::slowContinuationCount(), Q_UINT64_C(1));
+}
+
+/*! \test Tests that the report contains the label the Deferred had when the continuation started.
+ */
+void ContinuationWatchdogTest::testLabelCapturedAtStart()
+{
+	ReportCollector collector;
+	ContinuationWatchdog::start(10);
+
+	Deferred::Ptr deferred = Deferred::create();
+	deferred->setLabel("before");
+	Deferred* rawDeferred = deferred.data();
+	Promise::Ptr promise = Promise::create(deferred)->then([rawDeferred](const QVariant& value) {
+		rawDeferred->setLabel("after");
+		blockingCallback(value);
+	});
+	deferred->resolve();
+
+	QCOMPARE(collector.reports.size(), 1);
+	QCOMPARE(collector.reports.first().deferredLabel, QString("before"));
+	QCOMPARE(deferred->label(), QString("after"));
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::ContinuationWatchdogTest)
+#include "ContinuationWatchdogTest.moc"
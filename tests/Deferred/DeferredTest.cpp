@@ -21,6 +21,9 @@ private Q_SLOTS:
 	void testReject();
 	void testNotify();
 	void testQHash();
+	void testSettleHooks();
+	void testLabel();
+	void testLoggingCategory();
 
 private:
 	struct DeferredSpies
@@ -151,6 +154,78 @@ void DeferredTest::testQHash()
 	QVERIFY(qHash(firstDeferred) != qHash(secondDeferred));
 }
 
+/*! \test Tests the Deferred::addSettleHook() and Deferred::removeSettleHook() methods.
+ */
+void DeferredTest::testSettleHooks()
+{
+	Deferred::Ptr deferred = Deferred::create();
+
+	QVector<Deferred::State> calls;
+	int firstHook = deferred->addSettleHook([&calls](Deferred::State state) {
+		calls.append(state);
+	});
+	int secondHook = deferred->addSettleHook([&calls](Deferred::State state) {
+		calls.append(state);
+	});
+	QVERIFY(firstHook != 0);
+	QVERIFY(secondHook != 0);
+	QVERIFY(firstHook != secondHook);
+
+	QVERIFY(deferred->removeSettleHook(secondHook));
+	QVERIFY(!deferred->removeSettleHook(secondHook));
+
+	deferred->notify();
+	QVERIFY(calls.isEmpty());
+
+	deferred->reject();
+	QCOMPARE(calls, QVector<Deferred::State>{Deferred::Rejected});
+
+	// Hooks are called only once
+	QVERIFY(!deferred->removeSettleHook(firstHook));
+	QCOMPARE(deferred->addSettleHook([&calls](Deferred::State state) {
+		calls.append(state);
+	}), 0);
+	QCOMPARE(calls.size(), 1);
+}
+
+/*! \test Tests the Deferred::setLabel() and Deferred::label() methods.
+ */
+void DeferredTest::testLabel()
+{
+	Deferred::Ptr deferred = Deferred::create();
+	QVERIFY(deferred->label().isNull());
+
+	deferred->setLabel("fetchData");
+	QCOMPARE(deferred->label(), QString("fetchData"));
+
+	deferred->resolve();
+	deferred->setLabel("other");
+	QCOMPARE(deferred->label(), QString("other"));
+}
+
+/*! \test Tests that the messages of a Deferred are logged in the qtpromise.deferred category.
+ */
+void DeferredTest::testLoggingCategory()
+{
+	static QStringList messages;
+	messages.clear();
+	QtMessageHandler previousHandler = qInstallMessageHandler([](QtMsgType, const QMessageLogContext& context, const QString& message) {
+		messages.append(QString("%1: %2").arg(QString::fromLatin1(context.category), message));
+	});
+
+	Deferred::Ptr deferred = Deferred::create();
+	deferred->resolve();
+	deferred->resolve();
+	QCOMPARE(messages.size(), 1);
+	QVERIFY(messages.first().startsWith("qtpromise.deferred: Cannot resolve Deferred 0x"));
+
+	QLoggingCategory::setFilterRules("qtpromise.deferred.debug=false");
+	deferred->resolve();
+	QLoggingCategory::setFilterRules(QString());
+	qInstallMessageHandler(previousHandler);
+
+	QCOMPARE(messages.size(), 1);
+}
 
 }  // namespace Tests
 }  // namespace QtPromise
@@ -0,0 +1,184 @@
+#include <QtTest>
+#include "DeferredRegistry.h"
+#include "Deferred.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the DeferredRegistry class.
+ *
+ * \author jochen.ulrich
+ */
+class DeferredRegistryTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void cleanup();
+
+	void testDisabled();
+	void testRegistration();
+	void testAgeBuckets();
+	void testFinishedThread();
+	void testToString();
+};
+
+
+//####### Helper #######
+
+/*! Creates Deferreds in a separate thread which outlive the thread.
+ */
+class CreatingThread : public QThread
+{
+public:
+	explicit CreatingThread(int deferredCount) : m_deferredCount(deferredCount) {}
+
+	QVector<Deferred::Ptr> deferreds;
+
+protected:
+	void run() override
+	{
+		for (int i = 0; i < m_deferredCount; ++i)
+		{
+			Deferred::Ptr deferred = Deferred::create();
+			deferred->setLabel("thread");
+			deferred->moveToThread(nullptr);
+			deferreds.append(deferred);
+		}
+	}
+
+private:
+	int m_deferredCount;
+};
+
+
+//####### Tests #######
+void DeferredRegistryTest::cleanup()
+{
+	DeferredRegistry::setEnabled(false);
+}
+
+/*! \test Tests that Deferreds are not registered while the registry is disabled.
+ */
+void DeferredRegistryTest::testDisabled()
+{
+	QVERIFY(!DeferredRegistry::isEnabled());
+
+	Deferred::Ptr deferred = Deferred::create();
+	QCOMPARE(DeferredRegistry::snapshot().count, 0);
+}
+
+/*! \test Tests the registration and removal of Deferreds.
+ */
+void DeferredRegistryTest::testRegistration()
+{
+	DeferredRegistry::setEnabled(true);
+	QVERIFY(DeferredRegistry::isEnabled());
+
+	QVector<Deferred::Ptr> leaking;
+	for (int i = 0; i < 3; ++i)
+	{
+		leaking.append(Deferred::create());
+		leaking.last()->setLabel("leak");
+	}
+	Deferred::Ptr resolved = Deferred::create();
+	resolved->resolve();
+
+	DeferredRegistry::Snapshot snapshot = DeferredRegistry::snapshot();
+	QCOMPARE(snapshot.count, 4);
+	QCOMPARE(snapshot.pendingCount, 3);
+	QCOMPARE(snapshot.labelGroups.size(), 2);
+	QCOMPARE(snapshot.labelGroups.at(0).label, QString("leak"));
+	QCOMPARE(snapshot.labelGroups.at(0).type, PromiseMetrics::BaseDeferredType);
+	QCOMPARE(snapshot.labelGroups.at(0).count, 3);
+	QCOMPARE(snapshot.labelGroups.at(0).pendingCount, 3);
+	QCOMPARE(snapshot.labelGroups.at(1).label, QString());
+	QCOMPARE(snapshot.labelGroups.at(1).count, 1);
+	QCOMPARE(snapshot.labelGroups.at(1).pendingCount, 0);
+
+	// Disabling keeps the registered Deferreds
+	DeferredRegistry::setEnabled(false);
+	Deferred::Ptr unregistered = Deferred::create();
+	QCOMPARE(DeferredRegistry::snapshot().count, 4);
+
+	leaking.removeFirst();
+	QCOMPARE(DeferredRegistry::snapshot().count, 3);
+	leaking.clear();
+	resolved.reset();
+	QCOMPARE(DeferredRegistry::snapshot().count, 0);
+}
+
+/*! \test Tests the grouping of the Deferreds by age.
+ */
+void DeferredRegistryTest::testAgeBuckets()
+{
+	DeferredRegistry::setEnabled(true);
+
+	Deferred::Ptr old = Deferred::create();
+	QTest::qWait(60);
+	Deferred::Ptr young = Deferred::create();
+
+	DeferredRegistry::Snapshot snapshot = DeferredRegistry::snapshot(QVector<qint64>() << 50);
+	QCOMPARE(snapshot.ageBuckets.size(), 2);
+	QCOMPARE(snapshot.ageBuckets.at(0).minAge, Q_INT64_C(0));
+	QCOMPARE(snapshot.ageBuckets.at(0).maxAge, Q_INT64_C(50));
+	QCOMPARE(snapshot.ageBuckets.at(0).count, 1);
+	QCOMPARE(snapshot.ageBuckets.at(1).minAge, Q_INT64_C(50));
+	QCOMPARE(snapshot.ageBuckets.at(1).maxAge, Q_INT64_C(-1));
+	QCOMPARE(snapshot.ageBuckets.at(1).count, 1);
+	QCOMPARE(snapshot.labelGroups.size(), 1);
+	QVERIFY(snapshot.labelGroups.first().maxAge >= 50);
+
+	QCOMPARE(DeferredRegistry::snapshot().ageBuckets.size(), DeferredRegistry::defaultAgeBounds().size() + 1);
+}
+
+/*! \test Tests Deferreds which outlive the thread which created them.
+ */
+void DeferredRegistryTest::testFinishedThread()
+{
+	DeferredRegistry::setEnabled(true);
+
+	CreatingThread thread(5);
+	thread.start();
+	QVERIFY(thread.wait(5000));
+
+	DeferredRegistry::Snapshot snapshot = DeferredRegistry::snapshot();
+	QCOMPARE(snapshot.count, 5);
+	QCOMPARE(snapshot.labelGroups.first().label, QString("thread"));
+
+	// The list of the finished thread is reused
+	CreatingThread secondThread(2);
+	secondThread.start();
+	QVERIFY(secondThread.wait(5000));
+	QCOMPARE(DeferredRegistry::snapshot().count, 7);
+
+	thread.deferreds.clear();
+	QCOMPARE(DeferredRegistry::snapshot().count, 2);
+	secondThread.deferreds.clear();
+	QCOMPARE(DeferredRegistry::snapshot().count, 0);
+}
+
+/*! \test Tests the DeferredRegistry::Snapshot::toString() method.
+ */
+void DeferredRegistryTest::testToString()
+{
+	DeferredRegistry::setEnabled(true);
+
+	Deferred::Ptr deferred = Deferred::create();
+	deferred->setLabel("request");
+
+	const QString description = DeferredRegistry::snapshot().toString();
+	QVERIFY(description.startsWith("1 registered Deferreds, 1 pending\n"));
+	QVERIFY(description.contains("[0 ms, 1 s): 1 (1 pending)"));
+	QVERIFY(description.contains("[1 h, inf): 0 (0 pending)"));
+	QVERIFY(description.contains("request (Deferred): 1 (1 pending)"));
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::DeferredRegistryTest)
+#include "DeferredRegistryTest.moc"
@@ -34,6 +34,12 @@ private Q_SLOTS:
 	void testFinishedFuture();
 	void testFinishedDeferred_data();
 	void testFinishedDeferred();
+	void testLazyResults();
+	void testLazyResultsCancel();
+	void testTypedFuture();
+	void testStreamResults();
+	void testStreamResultsCoalescing();
+	void testOmitFinalResults();
 
 private:
 	struct PromiseSpies
@@ -417,6 +423,185 @@ void FuturePromiseTest::testFinishedDeferred()
 	QTEST(promise->results(), "expectedResults");
 }
 
+/*! \test Tests a FuturePromise with the LazyResults option.
+ */
+void FuturePromiseTest::testLazyResults()
+{
+	const QList<int> input{1, 2, 3};
+	QFuture<int> future = QtConcurrent::mapped(input, std::function<int(const int&)>([](const int& value) {
+		return value * 2;
+	}));
+
+	FuturePromise::Ptr promise = FuturePromise::create(future, FutureDeferred::LazyResults);
+	QSignalSpy baseResolvedSpy(promise.data(), &Promise::resolved);
+
+	QVariant callbackData;
+	QList<int> typedResults;
+	Promise::Ptr newPromise = promise->then([&](const QVariant& data) {
+		callbackData = data;
+		const QFuture<int> typedFuture = promise->future<int>();
+		for (int i = 0; i < typedFuture.resultCount(); ++i)
+			typedResults << typedFuture.resultAt(i);
+	});
+
+	QTRY_COMPARE(promise->state(), Deferred::Resolved);
+	QCOMPARE(baseResolvedSpy.count(), 1);
+	QCOMPARE(baseResolvedSpy.first().first(), QVariant(input.size()));
+	QCOMPARE(callbackData, QVariant(input.size()));
+	QCOMPARE(typedResults, QList<int>({2, 4, 6}));
+
+	// The results are still available as QVariantList
+	QCOMPARE(promise->results(), QVariantList({2, 4, 6}));
+
+	// The specialized signals provide the QVariantList when something is connected to them
+	FuturePromise::Ptr secondPromise = FuturePromise::create(future, FutureDeferred::LazyResults);
+	PromiseSpies spies(secondPromise);
+	QTRY_COMPARE(spies.resolved.count(), 1);
+	QCOMPARE(spies.resolved.first().first().toList(), QVariantList({2, 4, 6}));
+	QCOMPARE(spies.baseResolved.first().first(), QVariant(input.size()));
+}
+
+/*! \test Tests rejection of a FuturePromise with the LazyResults option.
+ */
+void FuturePromiseTest::testLazyResultsCancel()
+{
+	QFutureInterface<int> futureInterface;
+	futureInterface.reportStarted();
+	futureInterface.reportResult(7);
+
+	FutureDeferred::Ptr deferred = FutureDeferred::create(futureInterface.future(), FutureDeferred::LazyResults);
+	FuturePromise::Ptr promise = FuturePromise::create(deferred);
+	PromiseSpies spies(promise);
+
+	futureInterface.reportCanceled();
+	futureInterface.reportFinished();
+
+	QTRY_COMPARE(promise->state(), Deferred::Rejected);
+	QCOMPARE(spies.baseRejected.count(), 1);
+	QCOMPARE(spies.baseRejected.first().first(), QVariant(1));
+	QCOMPARE(spies.rejected.count(), 1);
+	QCOMPARE(spies.rejected.first().first().toList(), QVariantList({7}));
+	QCOMPARE(deferred->results(), QVariantList({7}));
+}
+
+/*! \test Tests the typed access to the QFuture of a FuturePromise.
+ */
+void FuturePromiseTest::testTypedFuture()
+{
+	QFutureInterface<int> futureInterface;
+	futureInterface.reportStarted();
+	FuturePromise::Ptr promise = FuturePromise::create(futureInterface.future());
+
+	QCOMPARE(promise->future<int>(), futureInterface.future());
+	QVERIFY(promise->future<QString>().isCanceled());
+	QCOMPARE(promise->future<QString>().resultCount(), 0);
+
+	futureInterface.reportFinished();
+	QTRY_COMPARE(promise->state(), Deferred::Resolved);
+}
+
+/*! \test Tests the delivery of result batches with the StreamResults option.
+ */
+void FuturePromiseTest::testStreamResults()
+{
+	QFutureInterface<int> futureInterface;
+	futureInterface.reportStarted();
+
+	FuturePromise::Ptr promise = FuturePromise::create(futureInterface.future(), FutureDeferred::StreamResults);
+	QSignalSpy batchSpy(promise.data(), &FuturePromise::resultsReady);
+	QVariantList notifiedBatches;
+	Promise::Ptr newPromise = promise->then(nullptr, nullptr, [&notifiedBatches](const QVariant& data) {
+		if (data.canConvert<FutureDeferred::ResultBatch>())
+			notifiedBatches << data;
+	});
+
+	futureInterface.reportResult(1);
+	futureInterface.reportResult(2);
+	QTRY_COMPARE(batchSpy.count(), 1);
+	FutureDeferred::ResultBatch batch = batchSpy.at(0).first().value<FutureDeferred::ResultBatch>();
+	QCOMPARE(batch.beginIndex, 0);
+	QCOMPARE(batch.endIndex, 2);
+	QCOMPARE(batch.results, QVariantList({1, 2}));
+	QCOMPARE(promise->state(), Deferred::Pending);
+
+	// Results which are ready out of order are delivered when the gap is filled
+	futureInterface.reportResult(4, 3);
+	QTest::qWait(50);
+	QCOMPARE(batchSpy.count(), 1);
+	futureInterface.reportResult(3, 2);
+	QTRY_COMPARE(batchSpy.count(), 2);
+	batch = batchSpy.at(1).first().value<FutureDeferred::ResultBatch>();
+	QCOMPARE(batch.beginIndex, 2);
+	QCOMPARE(batch.endIndex, 4);
+	QCOMPARE(batch.results, QVariantList({3, 4}));
+
+	futureInterface.reportResult(5);
+	futureInterface.reportFinished();
+
+	QTRY_COMPARE(promise->state(), Deferred::Resolved);
+	QCOMPARE(batchSpy.count(), 3);
+	batch = batchSpy.at(2).first().value<FutureDeferred::ResultBatch>();
+	QCOMPARE(batch.beginIndex, 4);
+	QCOMPARE(batch.results, QVariantList({5}));
+	QCOMPARE(notifiedBatches.size(), 3);
+	QCOMPARE(promise->results(), QVariantList({1, 2, 3, 4, 5}));
+}
+
+/*! \test Tests that results which become ready in quick succession are coalesced.
+ */
+void FuturePromiseTest::testStreamResultsCoalescing()
+{
+	const int resultCount = 1000;
+	QFutureInterface<int> futureInterface;
+	futureInterface.reportStarted();
+
+	FuturePromise::Ptr promise = FuturePromise::create(futureInterface.future(),
+	                                                   FutureDeferred::StreamResults | FutureDeferred::LazyResults);
+	QSignalSpy batchSpy(promise.data(), &FuturePromise::resultsReady);
+
+	for (int i = 0; i < resultCount; ++i)
+		futureInterface.reportResult(i);
+	futureInterface.reportFinished();
+
+	QTRY_COMPARE(promise->state(), Deferred::Resolved);
+	QVERIFY(batchSpy.count() < resultCount);
+	int expectedBeginIndex = 0;
+	for (const QList<QVariant>& arguments : batchSpy)
+	{
+		const FutureDeferred::ResultBatch batch = arguments.first().value<FutureDeferred::ResultBatch>();
+		QCOMPARE(batch.beginIndex, expectedBeginIndex);
+		// The results are not converted with LazyResults
+		QVERIFY(batch.results.isEmpty());
+		expectedBeginIndex = batch.endIndex;
+	}
+	QCOMPARE(expectedBeginIndex, resultCount);
+}
+
+/*! \test Tests the OmitFinalResults option.
+ */
+void FuturePromiseTest::testOmitFinalResults()
+{
+	const QList<int> input{1, 2, 3};
+	QFuture<int> future = QtConcurrent::mapped(input, std::function<int(const int&)>([](const int& value) {
+		return value * 2;
+	}));
+
+	FuturePromise::Ptr promise = FuturePromise::create(future, FutureDeferred::StreamResults | FutureDeferred::OmitFinalResults);
+	PromiseSpies spies(promise);
+	QSignalSpy batchSpy(promise.data(), &FuturePromise::resultsReady);
+
+	QTRY_COMPARE(promise->state(), Deferred::Resolved);
+	QCOMPARE(spies.baseResolved.first().first(), QVariant(input.size()));
+	QCOMPARE(spies.resolved.count(), 1);
+	QVERIFY(spies.resolved.first().first().toList().isEmpty());
+	QVERIFY(promise->results().isEmpty());
+
+	QVariantList streamedResults;
+	for (const QList<QVariant>& arguments : batchSpy)
+		streamedResults << arguments.first().value<FutureDeferred::ResultBatch>().results;
+	QCOMPARE(streamedResults, QVariantList({2, 4, 6}));
+}
+
 }  // namespace Tests
 }  // namespace QtPromise
 
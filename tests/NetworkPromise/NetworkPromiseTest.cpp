@@ -5,6 +5,9 @@
 #include <QNetworkAccessManager>
 #include <QNetworkDiskCache>
 #include "NetworkPromise.h"
+#include "LocalHttpServer.h"
+
+Q_DECLARE_METATYPE(QtPromise::Tests::LocalHttpServer::Response::Fault)
 
 
 namespace QtPromise
@@ -24,6 +27,10 @@ private Q_SLOTS:
 	void testSuccess();
 	void testFail();
 	void testHttp();
+	void testHttpError();
+	void testChunkedHttp();
+	void testConnectionFaults_data();
+	void testConnectionFaults();
 	void testUpload();
 	void testFinishedReply_data();
 	void testFinishedReply();
@@ -146,27 +153,113 @@ void NetworkPromiseTest::testFail()
  */
 void NetworkPromiseTest::testHttp()
 {
-	QNetworkAccessManager qnam;
-	if(qnam.networkAccessible() == QNetworkAccessManager::NotAccessible)
-		QSKIP("Network not accessible");
+	LocalHttpServer server;
+	QVERIFY(server.isListening());
+	LocalHttpServer::Response response;
+	response.bodySize = 100 * 1000;
+	server.setResponse("/data", response);
 
-	QNetworkRequest request(QUrl("http://www.google.com"));
+	QNetworkAccessManager qnam;
+	QNetworkRequest request(server.url("/data"));
 	QNetworkReply* reply = qnam.get(request);
 
 	NetworkPromise::Ptr promise = NetworkPromise::create(reply);
 
 	PromiseSpies spies(promise);
-	QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 20 * 1000);
-	if (reply->error() == QNetworkReply::NoError)
-		QCOMPARE(spies.resolved.count(), 1);
-	else
-		QCOMPARE(spies.rejected.count(), 1);
+	QVERIFY(spies.resolved.wait());
+	QCOMPARE(spies.rejected.count(), 0);
+	QCOMPARE(promise->replyData().data, LocalHttpServer::generatedBody(response.bodySize));
+	QVERIFY(spies.notified.count() > 0);
+	QCOMPARE(spies.notified.last().first().value<NetworkDeferred::ReplyProgress>().download.current, response.bodySize);
+	QCOMPARE(server.lastRequest().method, QByteArray("GET"));
+}
+
+/*! \test Tests a HTTP request which fails with an error status code.
+ */
+void NetworkPromiseTest::testHttpError()
+{
+	LocalHttpServer server;
+	LocalHttpServer::Response response;
+	response.statusCode = 404;
+	response.reasonPhrase = "Not Found";
+	response.body = "not found";
+	server.setDefaultResponse(response);
+
+	QNetworkAccessManager qnam;
+	QNetworkReply* reply = qnam.get(QNetworkRequest(server.url("/missing")));
+	NetworkPromise::Ptr promise = NetworkPromise::create(reply);
+
+	PromiseSpies spies(promise);
+	QVERIFY(spies.rejected.wait());
+	QCOMPARE(spies.resolved.count(), 0);
+	QCOMPARE(promise->error().code, QNetworkReply::ContentNotFoundError);
+	QCOMPARE(promise->error().replyData.qReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 404);
+}
+
+/*! \test Tests a HTTP response with chunked transfer encoding and limited bandwidth.
+ */
+void NetworkPromiseTest::testChunkedHttp()
+{
+	LocalHttpServer server;
+	LocalHttpServer::Response response;
+	response.bodySize = 64 * 1024;
+	response.chunked = true;
+	response.chunkSize = 8 * 1024;
+	response.bandwidth = 1024 * 1024;
+	server.setDefaultResponse(response);
+
+	QNetworkAccessManager qnam;
+	QNetworkReply* reply = qnam.get(QNetworkRequest(server.url()));
+	NetworkPromise::Ptr promise = NetworkPromise::create(reply);
+
+	PromiseSpies spies(promise);
+	QVERIFY(spies.resolved.wait());
+	QCOMPARE(promise->replyData().data, LocalHttpServer::generatedBody(response.bodySize));
+	// The body arrives in multiple parts
+	QVERIFY(spies.notified.count() > 1);
+}
+
+/*! Provides the data for the testConnectionFaults() test.
+ */
+void NetworkPromiseTest::testConnectionFaults_data()
+{
+	QTest::addColumn<LocalHttpServer::Response::Fault>("fault");
+
+	QTest::newRow("close before response") << LocalHttpServer::Response::CloseBeforeResponse;
+	QTest::newRow("close during body") << LocalHttpServer::Response::CloseDuringBody;
+	QTest::newRow("malformed response") << LocalHttpServer::Response::MalformedResponse;
+}
+
+/*! \test Tests that connection failures reject the NetworkPromise.
+ */
+void NetworkPromiseTest::testConnectionFaults()
+{
+	QFETCH(LocalHttpServer::Response::Fault, fault);
+
+	LocalHttpServer server;
+	LocalHttpServer::Response response;
+	response.bodySize = 10 * 1000;
+	response.fault = fault;
+	server.setDefaultResponse(response);
+
+	QNetworkAccessManager qnam;
+	QNetworkReply* reply = qnam.get(QNetworkRequest(server.url()));
+	NetworkPromise::Ptr promise = NetworkPromise::create(reply);
+
+	PromiseSpies spies(promise);
+	QVERIFY(spies.rejected.wait());
+	QCOMPARE(spies.resolved.count(), 0);
+	QVERIFY(promise->error().code != QNetworkReply::NoError);
 }
 
+/*! \test Tests an upload with a NetworkPromise.
+ */
 void NetworkPromiseTest::testUpload()
 {
+	LocalHttpServer server;
+
 	QNetworkAccessManager qnam;
-	QNetworkRequest request(QUrl("http://eu.httpbin.org/post"));
+	QNetworkRequest request(server.url("/echo"));
 	request.setHeader(QNetworkRequest::ContentTypeHeader, "text/plain");
 	QString data("foo bar");
 	QNetworkReply* reply = qnam.post(request, data.toUtf8());
@@ -174,11 +267,12 @@ void NetworkPromiseTest::testUpload()
 	NetworkPromise::Ptr promise = NetworkPromise::create(reply);
 
 	PromiseSpies spies(promise);
-	QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 20 * 1000);
+	QVERIFY(spies.resolved.wait());
 	QVERIFY(spies.notified.count() > 0);
 	QVERIFY(spies.notified.last().first().value<NetworkDeferred::ReplyProgress>().upload.current > 0);
-	QJsonDocument json = QJsonDocument::fromJson(promise->replyData().data);
-	QCOMPARE(json.object()["data"].toString(), data);
+	QCOMPARE(promise->replyData().data, data.toUtf8());
+	QCOMPARE(server.lastRequest().method, QByteArray("POST"));
+	QCOMPARE(server.lastRequest().body, data.toUtf8());
 }
 
 /*! Provides the data for the testFinishedReply() test.
@@ -248,11 +342,13 @@ void NetworkPromiseTest::testFinishedReply()
  */
 void NetworkPromiseTest::testDestroyReply()
 {
-	QNetworkAccessManager qnam;
-	if(qnam.networkAccessible() == QNetworkAccessManager::NotAccessible)
-		QSKIP("Network not accessible");
+	LocalHttpServer server;
+	LocalHttpServer::Response response;
+	response.latency = 10 * 1000;
+	server.setDefaultResponse(response);
 
-	QNetworkRequest request(QUrl("http://www.google.com"));
+	QNetworkAccessManager qnam;
+	QNetworkRequest request(server.url());
 	QNetworkReply* reply = qnam.get(request);
 
 	NetworkPromise::Ptr promise = NetworkPromise::create(reply);
@@ -270,11 +366,13 @@ void NetworkPromiseTest::testDestroyReply()
  */
 void NetworkPromiseTest::testAbortReply()
 {
-	QNetworkAccessManager qnam;
-	if(qnam.networkAccessible() == QNetworkAccessManager::NotAccessible)
-		QSKIP("Network not accessible");
+	LocalHttpServer server;
+	LocalHttpServer::Response response;
+	response.latency = 10 * 1000;
+	server.setDefaultResponse(response);
 
-	QNetworkRequest request(QUrl("http://www.google.com"));
+	QNetworkAccessManager qnam;
+	QNetworkRequest request(server.url());
 	QNetworkReply* reply = qnam.get(request);
 
 	NetworkPromise::Ptr promise = NetworkPromise::create(reply);
@@ -0,0 +1,280 @@
+#include <QtTest>
+#include <QSignalSpy>
+#include <QNetworkAccessManager>
+#include "NetworkRequestScheduler.h"
+#include "LocalHttpServer.h"
+
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the NetworkRequestScheduler class.
+ *
+ * \author jochen.ulrich
+ */
+class NetworkRequestSchedulerTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testRequest();
+	void testLimits();
+	void testPriorities();
+	void testSetPriority();
+	void testCancel();
+	void testFairQueuing();
+	void testTiming();
+	void testReplyKeptAlive();
+};
+
+
+//####### Helpers #######
+
+/*! \return A response which is sent after \p latency milliseconds. */
+LocalHttpServer::Response delayedResponse(int latency)
+{
+	LocalHttpServer::Response response;
+	response.body = "data";
+	response.latency = latency;
+	return response;
+}
+
+/*! Waits until \p promise is settled. */
+void waitForSettled(Promise::Ptr promise)
+{
+	QTRY_VERIFY(promise->state() != Deferred::Pending);
+}
+
+/*! \return The identifiers of the started requests recorded by \p spy. */
+QList<NetworkRequestScheduler::RequestId> startedIds(const QSignalSpy& spy)
+{
+	QList<NetworkRequestScheduler::RequestId> ids;
+	for (const QList<QVariant>& arguments : spy)
+		ids.append(arguments.first().value<NetworkRequestScheduler::RequestId>());
+	return ids;
+}
+
+
+//####### Tests #######
+/*! \test Tests a request scheduled with a NetworkRequestScheduler.
+ */
+void NetworkRequestSchedulerTest::testRequest()
+{
+	LocalHttpServer server;
+	QVERIFY(server.isListening());
+	QNetworkAccessManager qnam;
+	NetworkRequestScheduler scheduler(&qnam);
+
+	NetworkRequestScheduler::ScheduledRequest request = scheduler.post(QNetworkRequest(server.url("/echo")), "payload");
+	QVERIFY(request.id != 0);
+	QCOMPARE(scheduler.runningCount(), 1);
+
+	waitForSettled(request.promise);
+	QCOMPARE(request.promise->state(), Deferred::Resolved);
+	QCOMPARE(request.promise->data().value<NetworkDeferred::ReplyData>().data, QByteArray("payload"));
+	QCOMPARE(server.lastRequest().method, QByteArray("POST"));
+	QCOMPARE(scheduler.runningCount(), 0);
+}
+
+/*! \test Tests the per host and the global limit.
+ */
+void NetworkRequestSchedulerTest::testLimits()
+{
+	LocalHttpServer server;
+	server.setDefaultResponse(delayedResponse(50));
+	LocalHttpServer otherServer;
+	otherServer.setDefaultResponse(delayedResponse(50));
+	QNetworkAccessManager qnam;
+	NetworkRequestScheduler scheduler(&qnam);
+	scheduler.setPerHostLimit(2);
+	scheduler.setGlobalLimit(3);
+	QCOMPARE(scheduler.perHostLimit(), 2);
+	QCOMPARE(scheduler.globalLimit(), 3);
+
+	QList<Promise::Ptr> promises;
+	for (int i = 0; i < 4; ++i)
+		promises.append(scheduler.get(QNetworkRequest(server.url())).promise);
+	QCOMPARE(scheduler.runningCount(), 2);
+	QCOMPARE(scheduler.queuedCount(), 2);
+
+	for (int i = 0; i < 2; ++i)
+		promises.append(scheduler.get(QNetworkRequest(otherServer.url())).promise);
+	QCOMPARE(scheduler.runningCount(), 3);
+	QCOMPARE(scheduler.queuedCount(), 3);
+
+	for (const Promise::Ptr& promise : promises)
+	{
+		waitForSettled(promise);
+		QCOMPARE(promise->state(), Deferred::Resolved);
+	}
+	QCOMPARE(server.requestCount(), 4);
+	QCOMPARE(otherServer.requestCount(), 2);
+	QCOMPARE(scheduler.runningCount(), 0);
+	QCOMPARE(scheduler.queuedCount(), 0);
+}
+
+/*! \test Tests that requests with higher priorities are started first.
+ */
+void NetworkRequestSchedulerTest::testPriorities()
+{
+	LocalHttpServer server;
+	server.setDefaultResponse(delayedResponse(20));
+	QNetworkAccessManager qnam;
+	NetworkRequestScheduler scheduler(&qnam);
+	scheduler.setPerHostLimit(1);
+	QSignalSpy startedSpy(&scheduler, &NetworkRequestScheduler::requestStarted);
+
+	const QUrl url = server.url();
+	NetworkRequestScheduler::ScheduledRequest first = scheduler.get(QNetworkRequest(url));
+	NetworkRequestScheduler::ScheduledRequest low = scheduler.get(QNetworkRequest(url), NetworkRequestScheduler::LowPriority);
+	NetworkRequestScheduler::ScheduledRequest normal = scheduler.get(QNetworkRequest(url));
+	NetworkRequestScheduler::ScheduledRequest high = scheduler.get(QNetworkRequest(url), NetworkRequestScheduler::HighPriority);
+	NetworkRequestScheduler::ScheduledRequest secondNormal = scheduler.get(QNetworkRequest(url));
+	QVERIFY(scheduler.isQueued(low.id));
+	QVERIFY(!scheduler.isQueued(first.id));
+
+	waitForSettled(low.promise);
+	const QList<NetworkRequestScheduler::RequestId> expectedOrder{first.id, high.id, normal.id, secondNormal.id, low.id};
+	QCOMPARE(startedIds(startedSpy), expectedOrder);
+}
+
+/*! \test Tests NetworkRequestScheduler::setPriority().
+ */
+void NetworkRequestSchedulerTest::testSetPriority()
+{
+	LocalHttpServer server;
+	server.setDefaultResponse(delayedResponse(20));
+	QNetworkAccessManager qnam;
+	NetworkRequestScheduler scheduler(&qnam);
+	scheduler.setPerHostLimit(1);
+	QSignalSpy startedSpy(&scheduler, &NetworkRequestScheduler::requestStarted);
+
+	const QUrl url = server.url();
+	NetworkRequestScheduler::ScheduledRequest first = scheduler.get(QNetworkRequest(url));
+	NetworkRequestScheduler::ScheduledRequest second = scheduler.get(QNetworkRequest(url));
+	NetworkRequestScheduler::ScheduledRequest third = scheduler.get(QNetworkRequest(url));
+
+	QVERIFY(scheduler.setPriority(third.id, NetworkRequestScheduler::HighPriority));
+	QVERIFY(!scheduler.setPriority(first.id, NetworkRequestScheduler::HighPriority));
+
+	waitForSettled(second.promise);
+	const QList<NetworkRequestScheduler::RequestId> expectedOrder{first.id, third.id, second.id};
+	QCOMPARE(startedIds(startedSpy), expectedOrder);
+	QVERIFY(!scheduler.setPriority(second.id, NetworkRequestScheduler::LowPriority));
+}
+
+/*! \test Tests that cancelled requests are never sent.
+ */
+void NetworkRequestSchedulerTest::testCancel()
+{
+	LocalHttpServer server;
+	server.setDefaultResponse(delayedResponse(20));
+	QNetworkAccessManager qnam;
+	NetworkRequestScheduler scheduler(&qnam);
+	scheduler.setPerHostLimit(1);
+	QSignalSpy finishedSpy(&scheduler, &NetworkRequestScheduler::requestFinished);
+
+	NetworkRequestScheduler::ScheduledRequest running = scheduler.get(QNetworkRequest(server.url("/running")));
+	NetworkRequestScheduler::ScheduledRequest queued = scheduler.get(QNetworkRequest(server.url("/cancelled")));
+
+	QVERIFY(!scheduler.cancel(running.id));
+	QVERIFY(scheduler.cancel(queued.id));
+	QVERIFY(!scheduler.cancel(queued.id));
+	QCOMPARE(queued.promise->state(), Deferred::Rejected);
+	const NetworkDeferred::Error error = queued.promise->data().value<NetworkDeferred::Error>();
+	QCOMPARE(error.code, QNetworkReply::OperationCanceledError);
+	QCOMPARE(finishedSpy.count(), 1);
+	QCOMPARE(finishedSpy.first().at(1).value<NetworkRequestScheduler::Timing>().networkTime, Q_INT64_C(-1));
+
+	waitForSettled(running.promise);
+	QTest::qWait(50);
+	QCOMPARE(server.requestCount(), 1);
+	QCOMPARE(server.lastRequest().path, QByteArray("/running"));
+}
+
+/*! \test Tests that hosts with queued requests of the same priority are served in turns.
+ */
+void NetworkRequestSchedulerTest::testFairQueuing()
+{
+	LocalHttpServer server;
+	server.setDefaultResponse(delayedResponse(10));
+	LocalHttpServer otherServer;
+	otherServer.setDefaultResponse(delayedResponse(10));
+	QNetworkAccessManager qnam;
+	NetworkRequestScheduler scheduler(&qnam);
+	scheduler.setGlobalLimit(1);
+	QSignalSpy startedSpy(&scheduler, &NetworkRequestScheduler::requestStarted);
+
+	QList<NetworkRequestScheduler::RequestId> hostIds;
+	QList<NetworkRequestScheduler::RequestId> otherHostIds;
+	for (int i = 0; i < 3; ++i)
+		hostIds.append(scheduler.get(QNetworkRequest(server.url())).id);
+	Promise::Ptr last;
+	for (int i = 0; i < 3; ++i)
+	{
+		NetworkRequestScheduler::ScheduledRequest request = scheduler.get(QNetworkRequest(otherServer.url()));
+		otherHostIds.append(request.id);
+		last = request.promise;
+	}
+
+	waitForSettled(last);
+	const QList<NetworkRequestScheduler::RequestId> expectedOrder{hostIds[0], otherHostIds[0], hostIds[1],
+	                                                              otherHostIds[1], hostIds[2], otherHostIds[2]};
+	QCOMPARE(startedIds(startedSpy), expectedOrder);
+}
+
+/*! \test Tests the reporting of the queue time and the network time.
+ */
+void NetworkRequestSchedulerTest::testTiming()
+{
+	LocalHttpServer server;
+	server.setDefaultResponse(delayedResponse(50));
+	QNetworkAccessManager qnam;
+	NetworkRequestScheduler scheduler(&qnam);
+	scheduler.setPerHostLimit(1);
+	QSignalSpy finishedSpy(&scheduler, &NetworkRequestScheduler::requestFinished);
+
+	NetworkRequestScheduler::ScheduledRequest first = scheduler.get(QNetworkRequest(server.url()));
+	NetworkRequestScheduler::ScheduledRequest second = scheduler.get(QNetworkRequest(server.url()));
+	waitForSettled(second.promise);
+
+	QCOMPARE(finishedSpy.count(), 2);
+	QCOMPARE(finishedSpy.at(0).at(0).value<NetworkRequestScheduler::RequestId>(), first.id);
+	const NetworkRequestScheduler::Timing firstTiming = finishedSpy.at(0).at(1).value<NetworkRequestScheduler::Timing>();
+	const NetworkRequestScheduler::Timing secondTiming = finishedSpy.at(1).at(1).value<NetworkRequestScheduler::Timing>();
+	QVERIFY(firstTiming.queueTime >= 0);
+	QVERIFY(firstTiming.queueTime < 50);
+	QVERIFY(firstTiming.networkTime >= 50);
+	QVERIFY(secondTiming.queueTime >= 50);
+	QVERIFY(secondTiming.networkTime >= 50);
+}
+
+/*! \test Tests that the QNetworkReply of a finished request stays accessible.
+ */
+void NetworkRequestSchedulerTest::testReplyKeptAlive()
+{
+	LocalHttpServer server;
+	QNetworkAccessManager qnam;
+	NetworkRequestScheduler scheduler(&qnam);
+
+	Promise::Ptr promise = scheduler.get(QNetworkRequest(server.url())).promise;
+	waitForSettled(promise);
+	QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+	QCoreApplication::processEvents();
+
+	QPointer<QNetworkReply> reply = const_cast<QNetworkReply*>(promise->data().value<NetworkDeferred::ReplyData>().qReply);
+	QVERIFY(reply);
+	QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+
+	promise.clear();
+	QVERIFY(reply.isNull());
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::NetworkRequestSchedulerTest)
+#include "NetworkRequestSchedulerTest.moc"
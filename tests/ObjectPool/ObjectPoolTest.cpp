@@ -0,0 +1,364 @@
+#include <QtTest>
+#include "ObjectPool.h"
+#include "VirtualTimeScheduler.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! Pooled object used by the ObjectPool tests. */
+struct Connection
+{
+	int id;
+	bool healthy;
+};
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+Q_DECLARE_METATYPE(QSharedPointer<QtPromise::Tests::Connection>)
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the ObjectPool class.
+ *
+ * \author jochen.ulrich
+ */
+class ObjectPoolTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void cleanup();
+
+	void testLazyCreation();
+	void testReuse();
+	void testWaitersFifo();
+	void testLeaseNotHeldByChain();
+	void testAsynchronousFactory();
+	void testFactoryRejection();
+	void testInvalidate();
+	void testHealthCheck();
+	void testIdleEviction();
+	void testPrefill();
+	void testLeaseOutlivesPool();
+	void testPoolDestroyedWithWaiters();
+};
+
+
+//####### Helper #######
+
+typedef ObjectPool<Connection> ConnectionPool;
+
+/*! Factory creating Connections synchronously and counting them.
+ */
+class ConnectionFactory
+{
+public:
+	ObjectPoolBase::Factory factory()
+	{
+		return [this]() {
+			QSharedPointer<Connection> connection(new Connection{++created, true});
+			return Promise::createResolved(QVariant::fromValue(connection));
+		};
+	}
+
+	int created = 0;
+};
+
+/*! \return The lease of a resolved acquire() Promise. The lease can only be taken once. */
+ObjectLease::Ptr leaseOf(Promise::Ptr promise)
+{
+	return ObjectLease::take(promise->data());
+}
+
+/*! Waits until \p promise is settled and returns its lease. */
+ObjectLease::Ptr waitForLease(Promise::Ptr promise)
+{
+	[&promise]() { QTRY_VERIFY(promise->state() != Deferred::Pending); }();
+	return leaseOf(promise);
+}
+
+
+//####### Tests #######
+void ObjectPoolTest::cleanup()
+{
+	Scheduler::setInstance(nullptr);
+}
+
+/*! \test Tests that objects are only created on demand.
+ */
+void ObjectPoolTest::testLazyCreation()
+{
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 2);
+	QCOMPARE(pool->maximumSize(), 2);
+	QCOMPARE(pool->size(), 0);
+	QCOMPARE(factory.created, 0);
+
+	ObjectLease::Ptr lease = waitForLease(pool->acquire());
+	QVERIFY(lease);
+	QCOMPARE(lease->object<Connection>()->id, 1);
+	QCOMPARE(pool->size(), 1);
+	QCOMPARE(pool->idleCount(), 0);
+}
+
+/*! \test Tests that released objects are reused.
+ */
+void ObjectPoolTest::testReuse()
+{
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 2);
+
+	ObjectLease::Ptr lease = waitForLease(pool->acquire());
+	lease.clear();
+	QCOMPARE(pool->idleCount(), 1);
+
+	// An idle object is provided without waiting
+	Promise::Ptr promise = pool->acquire();
+	QCOMPARE(promise->state(), Deferred::Resolved);
+	ObjectLease::Ptr reusedLease = leaseOf(promise);
+	QCOMPARE(reusedLease->object<Connection>()->id, 1);
+	QCOMPARE(factory.created, 1);
+	QCOMPARE(pool->idleCount(), 0);
+}
+
+/*! \test Tests that waiting acquire() calls are served in FIFO order.
+ */
+void ObjectPoolTest::testWaitersFifo()
+{
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 1);
+
+	ObjectLease::Ptr lease = waitForLease(pool->acquire());
+	Promise::Ptr first = pool->acquire();
+	Promise::Ptr second = pool->acquire();
+	QCOMPARE(pool->waitingCount(), 2);
+	QCOMPARE(factory.created, 1);
+
+	lease.clear();
+	QCOMPARE(first->state(), Deferred::Resolved);
+	QCOMPARE(second->state(), Deferred::Pending);
+	QCOMPARE(pool->waitingCount(), 1);
+
+	ObjectLease::Ptr firstLease = leaseOf(first);
+	QCOMPARE(firstLease->object<Connection>()->id, 1);
+	// The lease can only be taken once
+	QVERIFY(!leaseOf(first));
+	// The Promise does not keep the taken lease
+	firstLease.clear();
+	QCOMPARE(second->state(), Deferred::Resolved);
+	QCOMPARE(pool->waitingCount(), 0);
+	QCOMPARE(factory.created, 1);
+}
+
+/*! \test Tests that the Deferreds of a Promise chain do not keep the lease.
+ */
+void ObjectPoolTest::testLeaseNotHeldByChain()
+{
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 1);
+
+	ObjectLease::Ptr lease;
+	// The void callback resolves the chained Promise with the data of the acquire() Promise
+	Promise::Ptr chain = pool->acquire()->then([&lease](const QVariant& data) {
+		lease = ObjectLease::take(data);
+	});
+	QTRY_COMPARE(chain->state(), Deferred::Resolved);
+	QVERIFY(lease);
+	QCOMPARE(pool->idleCount(), 0);
+
+	lease.clear();
+	QCOMPARE(pool->idleCount(), 1);
+	QVERIFY(!ObjectLease::take(chain->data()));
+}
+
+/*! \test Tests a factory which creates objects asynchronously.
+ */
+void ObjectPoolTest::testAsynchronousFactory()
+{
+	QVector<Deferred::Ptr> creations;
+	ConnectionPool::Ptr pool = ConnectionPool::create([&creations]() {
+		Deferred::Ptr deferred = Deferred::create();
+		creations.append(deferred);
+		return Promise::create(deferred);
+	}, 2);
+
+	Promise::Ptr first = pool->acquire();
+	Promise::Ptr second = pool->acquire();
+	Promise::Ptr third = pool->acquire();
+	QCOMPARE(creations.size(), 2);
+	QCOMPARE(pool->size(), 2);
+
+	// The first created object serves the oldest waiter
+	creations[1]->resolve(QVariant::fromValue(QSharedPointer<Connection>(new Connection{2, true})));
+	QCOMPARE(first->state(), Deferred::Resolved);
+	ObjectLease::Ptr firstLease = leaseOf(first);
+	QCOMPARE(firstLease->object<Connection>()->id, 2);
+	QCOMPARE(second->state(), Deferred::Pending);
+
+	creations[0]->resolve(QVariant::fromValue(QSharedPointer<Connection>(new Connection{1, true})));
+	ObjectLease::Ptr secondLease = leaseOf(second);
+	QCOMPARE(secondLease->object<Connection>()->id, 1);
+	QCOMPARE(third->state(), Deferred::Pending);
+}
+
+/*! \test Tests that a rejected creation rejects the oldest waiter.
+ */
+void ObjectPoolTest::testFactoryRejection()
+{
+	int calls = 0;
+	ConnectionPool::Ptr pool = ConnectionPool::create([&calls]() {
+		++calls;
+		return calls == 1 ? Promise::createRejected(QString("unreachable"))
+		                  : Promise::createResolved(QVariant::fromValue(QSharedPointer<Connection>(new Connection{calls, true})));
+	}, 1);
+
+	Promise::Ptr first = pool->acquire();
+	QTRY_COMPARE(first->state(), Deferred::Rejected);
+	QCOMPARE(first->data(), QVariant(QString("unreachable")));
+	QCOMPARE(pool->size(), 0);
+
+	ObjectLease::Ptr lease = waitForLease(pool->acquire());
+	QCOMPARE(lease->object<Connection>()->id, 2);
+
+	ConnectionPool::Ptr nullPool = ConnectionPool::create([]() { return Promise::Ptr(); }, 1);
+	Promise::Ptr promise = nullPool->acquire();
+	QTRY_COMPARE(promise->state(), Deferred::Rejected);
+}
+
+/*! \test Tests ObjectLease::invalidate().
+ */
+void ObjectPoolTest::testInvalidate()
+{
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 1);
+
+	ObjectLease::Ptr lease = waitForLease(pool->acquire());
+	Promise::Ptr waiting = pool->acquire();
+	lease->invalidate();
+	QVERIFY(lease->isInvalidated());
+	lease.clear();
+
+	// The waiter receives a new object
+	ObjectLease::Ptr newLease = waitForLease(waiting);
+	QCOMPARE(newLease->object<Connection>()->id, 2);
+	QCOMPARE(pool->size(), 1);
+}
+
+/*! \test Tests ObjectPool::setHealthCheck().
+ */
+void ObjectPoolTest::testHealthCheck()
+{
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 2);
+	pool->setHealthCheck([](const QSharedPointer<Connection>& connection) { return connection->healthy; });
+
+	ObjectLease::Ptr lease = waitForLease(pool->acquire());
+	QSharedPointer<Connection> connection = lease->object<Connection>();
+	lease.clear();
+	QCOMPARE(pool->idleCount(), 1);
+
+	connection->healthy = false;
+	ObjectLease::Ptr newLease = waitForLease(pool->acquire());
+	QCOMPARE(newLease->object<Connection>()->id, 2);
+	QCOMPARE(pool->size(), 1);
+
+	// Unhealthy objects are dropped when returned as well
+	newLease->object<Connection>()->healthy = false;
+	newLease.clear();
+	QCOMPARE(pool->size(), 0);
+	QCOMPARE(pool->idleCount(), 0);
+}
+
+/*! \test Tests the eviction of idle objects.
+ */
+void ObjectPoolTest::testIdleEviction()
+{
+	VirtualTimeScheduler scheduler;
+	Scheduler::setInstance(&scheduler);
+
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 3);
+	pool->setMinimumSize(1);
+	pool->setIdleTimeout(100);
+	QCOMPARE(pool->idleTimeout(), 100);
+
+	ObjectLease::Ptr first = waitForLease(pool->acquire());
+	ObjectLease::Ptr second = waitForLease(pool->acquire());
+	ObjectLease::Ptr third = waitForLease(pool->acquire());
+	QCOMPARE(pool->size(), 3);
+
+	first.clear();
+	scheduler.advanceBy(50);
+	second.clear();
+	third.clear();
+	QCOMPARE(pool->idleCount(), 3);
+
+	scheduler.advanceBy(50);
+	QCOMPARE(pool->idleCount(), 2);
+	scheduler.advanceBy(50);
+	// The minimum size is kept
+	QCOMPARE(pool->idleCount(), 1);
+	QCOMPARE(pool->size(), 1);
+	scheduler.advanceBy(1000);
+	QCOMPARE(pool->size(), 1);
+}
+
+/*! \test Tests ObjectPool::prefill().
+ */
+void ObjectPoolTest::testPrefill()
+{
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 4);
+	pool->setMinimumSize(2);
+	QCOMPARE(pool->minimumSize(), 2);
+
+	pool->prefill();
+	QCOMPARE(factory.created, 2);
+	QTRY_COMPARE(pool->idleCount(), 2);
+
+	pool->prefill();
+	QCOMPARE(factory.created, 2);
+}
+
+/*! \test Tests destroying a lease after its pool.
+ */
+void ObjectPoolTest::testLeaseOutlivesPool()
+{
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 1);
+
+	ObjectLease::Ptr lease = waitForLease(pool->acquire());
+	QWeakPointer<Connection> connection = lease->object<Connection>();
+	pool.clear();
+
+	QVERIFY(!connection.isNull());
+	lease.clear();
+	QVERIFY(connection.isNull());
+}
+
+/*! \test Tests that destroying a pool rejects the waiting acquire() calls.
+ */
+void ObjectPoolTest::testPoolDestroyedWithWaiters()
+{
+	ConnectionFactory factory;
+	ConnectionPool::Ptr pool = ConnectionPool::create(factory.factory(), 1);
+
+	ObjectLease::Ptr lease = waitForLease(pool->acquire());
+	Promise::Ptr waiting = pool->acquire();
+	pool.clear();
+
+	QCOMPARE(waiting->state(), Deferred::Rejected);
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::ObjectPoolTest)
+#include "ObjectPoolTest.moc"
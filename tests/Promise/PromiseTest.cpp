@@ -59,6 +59,13 @@ private Q_SLOTS:
 	void testQHash();
 	void testWhenFinished_data();
 	void testWhenFinished();
+	void testToFuture();
+	void testToFutureMultipleResults();
+	void testToFutureReject();
+	void testToFutureCancel();
+	void testToFutureProgress();
+	void testToFutureSettledPromise();
+	void testToFutureDeferredDestruction();
 
 private:
 	struct PromiseSpies
@@ -1246,6 +1253,125 @@ void PromiseTest::testWhenFinished()
 	QCOMPARE(actualResolveValue, expectedResolveValue);
 }
 
+/*! \test Tests Promise::toFuture() with a resolved Promise.
+ */
+void PromiseTest::testToFuture()
+{
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+
+	QFuture<int> future = promise->toFuture<int>();
+	QFuture<void> voidFuture = promise->toFuture<void>();
+	QVERIFY(future.isStarted());
+	QVERIFY(!future.isFinished());
+
+	deferred->resolve(42);
+
+	// The QFuture is finished synchronously
+	QVERIFY(future.isFinished());
+	QVERIFY(!future.isCanceled());
+	QCOMPARE(future.resultCount(), 1);
+	QCOMPARE(future.result(), 42);
+	QVERIFY(voidFuture.isFinished());
+	QVERIFY(!voidFuture.isCanceled());
+}
+
+/*! \test Tests Promise::toFuture() with a Promise resolved with a QVariantList.
+ */
+void PromiseTest::testToFutureMultipleResults()
+{
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+
+	QFuture<int> future = promise->toFuture<int>();
+	QFuture<QVariantList> listFuture = promise->toFuture<QVariantList>();
+
+	deferred->resolve(QVariantList{1, 2, 3});
+
+	QCOMPARE(future.results(), QList<int>({1, 2, 3}));
+	QCOMPARE(listFuture.resultCount(), 1);
+	QCOMPARE(listFuture.result(), QVariantList({1, 2, 3}));
+}
+
+/*! \test Tests Promise::toFuture() with a rejected Promise.
+ */
+void PromiseTest::testToFutureReject()
+{
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+
+	QFuture<int> future = promise->toFuture<int>();
+	deferred->reject(QString("error"));
+
+	QVERIFY(future.isFinished());
+	QVERIFY(future.isCanceled());
+	QCOMPARE(future.resultCount(), 0);
+}
+
+/*! \test Tests that canceling the QFuture rejects the Deferred.
+ */
+void PromiseTest::testToFutureCancel()
+{
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+	PromiseSpies spies(promise);
+
+	QFuture<int> future = promise->toFuture<int>(QString("canceled"));
+	future.cancel();
+
+	QTRY_COMPARE(deferred->state(), Deferred::Rejected);
+	QCOMPARE(deferred->data(), QVariant(QString("canceled")));
+	QTRY_COMPARE(spies.rejected.count(), 1);
+	QVERIFY(future.isFinished());
+}
+
+/*! \test Tests that notifications are reported as progress of the QFuture.
+ */
+void PromiseTest::testToFutureProgress()
+{
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+
+	QFuture<int> future = promise->toFuture<int>();
+	deferred->notify(10);
+	QCOMPARE(future.progressValue(), 10);
+	deferred->notify(QVariant::fromValue(QStringList{"no progress"}));
+	QCOMPARE(future.progressValue(), 10);
+	deferred->notify(20);
+	QCOMPARE(future.progressValue(), 20);
+
+	deferred->resolve(1);
+	QVERIFY(future.isFinished());
+}
+
+/*! \test Tests Promise::toFuture() with Promises which are already settled.
+ */
+void PromiseTest::testToFutureSettledPromise()
+{
+	QFuture<int> resolvedFuture = Promise::createResolved(7)->toFuture<int>();
+	QVERIFY(resolvedFuture.isFinished());
+	QCOMPARE(resolvedFuture.result(), 7);
+
+	QFuture<int> rejectedFuture = Promise::createRejected(7)->toFuture<int>();
+	QVERIFY(rejectedFuture.isFinished());
+	QVERIFY(rejectedFuture.isCanceled());
+}
+
+/*! \test Tests that the QFuture is canceled when the Deferred is destroyed while pending.
+ */
+void PromiseTest::testToFutureDeferredDestruction()
+{
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+	QFuture<int> future = promise->toFuture<int>();
+
+	deferred.reset();
+	promise.reset();
+
+	QVERIFY(future.isFinished());
+	QVERIFY(future.isCanceled());
+}
+
 
 //####### Helper #######
 
@@ -0,0 +1,316 @@
+#include <QtTest>
+#include "PromiseCoroutine.h"
+#include "AllocationCounter.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the coroutine support of promises.
+ *
+ * \author jochen.ulrich
+ */
+class PromiseCoroutineTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void initTestCase();
+
+	void testCoReturn();
+	void testAwaitPending();
+	void testAwaitSettled();
+	void testAwaitRejected();
+	void testAwaitFromOtherThread();
+	void testMultipleSteps();
+	void testAwaitTask();
+	void testSingleFrameAllocation();
+	void testSuspensionAllocations();
+};
+
+
+//####### Helper #######
+#ifdef QTPROMISE_HAS_COROUTINES
+
+Promise::Ptr returnValue(int value)
+{
+	co_return value;
+}
+
+Promise::Ptr forward(Promise::Ptr promise, QThread** resumingThread = nullptr)
+{
+	PromiseResult result = co_await promise;
+	if (resumingThread)
+		*resumingThread = QThread::currentThread();
+	co_return result;
+}
+
+Promise::Ptr addUp(QVector<Deferred::Ptr> deferreds)
+{
+	int sum = 0;
+	for (const Deferred::Ptr& deferred : deferreds)
+	{
+		PromiseResult result = co_await Promise::create(deferred);
+		if (result.isRejected())
+			co_return result;
+		sum += result.data.toInt();
+	}
+	co_return sum;
+}
+
+Promise::Ptr awaitTask(Task::Ptr task)
+{
+	co_return co_await task;
+}
+
+Promise::Ptr awaitAll(QVector<Promise::Ptr> promises)
+{
+	int count = 0;
+	for (const Promise::Ptr& promise : promises)
+	{
+		PromiseResult result = co_await promise;
+		count += result.isResolved() ? 1 : 0;
+	}
+	co_return count;
+}
+
+/*! Runs awaitAll() for \p steps pending Promises which are resolved one after the other.
+ *
+ * \param[out] result The data of the Promise of the coroutine.
+ * \return The number of allocations of the coroutine and its resumptions. The creation of the
+ * awaited Deferreds and Promises is not included.
+ */
+quint64 pendingStepsAllocations(int steps, QVariant* result)
+{
+	QVector<Deferred::Ptr> deferreds;
+	QVector<Promise::Ptr> promises;
+	for (int i = 0; i < steps; ++i)
+	{
+		deferreds.append(Deferred::create());
+		promises.append(Promise::create(deferreds.last()));
+	}
+
+	AllocationCounter counter;
+	Promise::Ptr promise = awaitAll(promises);
+	for (int i = 0; i < steps; ++i)
+	{
+		deferreds[i]->resolve(i);
+		QCoreApplication::sendPostedEvents();
+	}
+	const quint64 allocations = counter.allocations();
+	*result = promise->data();
+	return allocations;
+}
+
+#endif
+
+/*! Waits until \p promise is settled. */
+void waitForSettled(Promise::Ptr promise)
+{
+	QTRY_VERIFY(promise->state() != Deferred::Pending);
+}
+
+
+//####### Tests #######
+void PromiseCoroutineTest::initTestCase()
+{
+#ifndef QTPROMISE_HAS_COROUTINES
+	QSKIP("The compiler does not support C++20 coroutines");
+#endif
+}
+
+/*! \test Tests a coroutine which returns a value without awaiting.
+ */
+void PromiseCoroutineTest::testCoReturn()
+{
+#ifdef QTPROMISE_HAS_COROUTINES
+	Promise::Ptr promise = returnValue(42);
+
+	QCOMPARE(promise->state(), Deferred::Resolved);
+	QCOMPARE(promise->data(), QVariant(42));
+#endif
+}
+
+/*! \test Tests awaiting a pending Promise.
+ */
+void PromiseCoroutineTest::testAwaitPending()
+{
+#ifdef QTPROMISE_HAS_COROUTINES
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = forward(Promise::create(deferred));
+	QCOMPARE(promise->state(), Deferred::Pending);
+
+	deferred->resolve(7);
+
+	// The coroutine is resumed from the event loop
+	QCOMPARE(promise->state(), Deferred::Pending);
+	waitForSettled(promise);
+	QCOMPARE(promise->state(), Deferred::Resolved);
+	QCOMPARE(promise->data(), QVariant(7));
+#endif
+}
+
+/*! \test Tests awaiting a Promise which is already settled.
+ */
+void PromiseCoroutineTest::testAwaitSettled()
+{
+#ifdef QTPROMISE_HAS_COROUTINES
+	Promise::Ptr promise = forward(Promise::createResolved(3));
+
+	QCOMPARE(promise->state(), Deferred::Resolved);
+	QCOMPARE(promise->data(), QVariant(3));
+#endif
+}
+
+/*! \test Tests awaiting a Promise which is rejected.
+ */
+void PromiseCoroutineTest::testAwaitRejected()
+{
+#ifdef QTPROMISE_HAS_COROUTINES
+	QVector<Deferred::Ptr> deferreds{Deferred::create(), Deferred::create(), Deferred::create()};
+	Promise::Ptr promise = addUp(deferreds);
+
+	deferreds[0]->resolve(1);
+	QCoreApplication::processEvents();
+	deferreds[1]->reject(QString("error"));
+
+	waitForSettled(promise);
+	QCOMPARE(promise->state(), Deferred::Rejected);
+	QCOMPARE(promise->data(), QVariant(QString("error")));
+	QCOMPARE(deferreds[2]->state(), Deferred::Pending);
+#endif
+}
+
+/*! \test Tests that the coroutine is resumed in the awaiting thread when the Deferred
+ * is settled in another thread.
+ */
+void PromiseCoroutineTest::testAwaitFromOtherThread()
+{
+#ifdef QTPROMISE_HAS_COROUTINES
+	Deferred::Ptr deferred = Deferred::create();
+	QThread* resumingThread = nullptr;
+	Promise::Ptr promise = forward(Promise::create(deferred), &resumingThread);
+
+	QThread thread;
+	QObject::connect(&thread, &QThread::started, [deferred]() { deferred->resolve(5); });
+	thread.start();
+	thread.wait();
+
+	waitForSettled(promise);
+	QCOMPARE(promise->data(), QVariant(5));
+	QCOMPARE(resumingThread, QThread::currentThread());
+#endif
+}
+
+/*! \test Tests a coroutine awaiting multiple Promises.
+ */
+void PromiseCoroutineTest::testMultipleSteps()
+{
+#ifdef QTPROMISE_HAS_COROUTINES
+	QVector<Deferred::Ptr> deferreds;
+	for (int i = 1; i <= 10; ++i)
+		deferreds.append(Deferred::create());
+	Promise::Ptr promise = addUp(deferreds);
+
+	for (int i = 0; i < deferreds.size(); ++i)
+	{
+		QCOMPARE(promise->state(), Deferred::Pending);
+		deferreds[i]->resolve(i + 1);
+		QCoreApplication::processEvents();
+	}
+
+	waitForSettled(promise);
+	QCOMPARE(promise->data(), QVariant(55));
+#endif
+}
+
+/*! \test Tests that awaiting a Task starts it.
+ */
+void PromiseCoroutineTest::testAwaitTask()
+{
+#ifdef QTPROMISE_HAS_COROUTINES
+	bool started = false;
+	Task::Ptr task = Task::create([&started]() {
+		started = true;
+		return Promise::delayedResolve(9);
+	});
+	QVERIFY(!started);
+
+	Promise::Ptr promise = awaitTask(task);
+	QVERIFY(started);
+	waitForSettled(promise);
+	QCOMPARE(promise->data(), QVariant(9));
+#endif
+}
+
+/*! \test Tests that the state of all steps of a coroutine lives in the coroutine frame
+ * which is allocated once per call.
+ *
+ * The awaited Promises are settled, so the coroutine never suspends and awaiting does not
+ * allocate at all. The allocations of suspensions are tested by testSuspensionAllocations().
+ */
+void PromiseCoroutineTest::testSingleFrameAllocation()
+{
+#ifdef QTPROMISE_HAS_COROUTINES
+	if (!AllocationCounter::isSupported())
+		QSKIP("Allocations are not counted in this build");
+
+	const int steps = 50;
+	QVector<Promise::Ptr> promises;
+	for (int i = 0; i < steps; ++i)
+		promises.append(Promise::createResolved(i));
+	const QVector<Promise::Ptr> singlePromise{promises.first()};
+
+	// Exclude one-time allocations like thread local data
+	awaitAll(promises);
+
+	AllocationCounter counter;
+	Promise::Ptr singleStep = awaitAll(singlePromise);
+	const quint64 singleStepAllocations = counter.allocations();
+	counter.reset();
+	Promise::Ptr multipleSteps = awaitAll(promises);
+	const quint64 multipleStepsAllocations = counter.allocations();
+
+	QCOMPARE(singleStep->data(), QVariant(1));
+	QCOMPARE(multipleSteps->data(), QVariant(steps));
+	QVERIFY(singleStepAllocations > 0);
+	QCOMPARE(multipleStepsAllocations, singleStepAllocations);
+#endif
+}
+
+/*! \test Tests the allocations of a coroutine which suspends at each step.
+ *
+ * The coroutine frame is still allocated once. But each suspension on a pending Promise
+ * allocates the storage of the settle hook on the awaited Deferred and the event which
+ * resumes the coroutine. Depending on the platform, the settle hook might need another
+ * allocation, so up to three allocations per step are accepted.
+ */
+void PromiseCoroutineTest::testSuspensionAllocations()
+{
+#ifdef QTPROMISE_HAS_COROUTINES
+	if (!AllocationCounter::isSupported())
+		QSKIP("Allocations are not counted in this build");
+
+	const int steps = 50;
+	QVariant result;
+	// Exclude one-time allocations like the CoroutineResumer of the thread
+	pendingStepsAllocations(steps, &result);
+
+	const quint64 noStepAllocations = pendingStepsAllocations(0, &result);
+	QCOMPARE(result, QVariant(0));
+	const quint64 multipleStepsAllocations = pendingStepsAllocations(steps, &result);
+	QCOMPARE(result, QVariant(steps));
+
+	const quint64 stepAllocations = multipleStepsAllocations - noStepAllocations;
+	QVERIFY2(stepAllocations <= static_cast<quint64>(3 * steps),
+	         qPrintable(QString("%1 allocations for %2 suspensions").arg(stepAllocations).arg(steps)));
+#endif
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::PromiseCoroutineTest)
+#include "PromiseCoroutineTest.moc"
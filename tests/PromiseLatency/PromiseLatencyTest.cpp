@@ -0,0 +1,198 @@
+
+#include <QtTest>
+#include <QThread>
+#include "PromiseLatency.h"
+#include "Promise.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the LatencyHistogram and PromiseLatency classes.
+ *
+ * \author jochen.ulrich
+ */
+class PromiseLatencyTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testBucketIndex_data();
+	void testBucketIndex();
+	void testBucketBounds();
+	void testHistogramStatistics();
+	void testHistogramMerge();
+	void testContinuationLatency();
+	void testAsyncEmissionLatency();
+};
+
+
+//####### Helper #######
+
+/*! \return The histograms of the current thread.
+ */
+PromiseLatency::ThreadHistograms currentThreadHistograms()
+{
+	for (const PromiseLatency::ThreadHistograms& histograms : PromiseLatency::threadHistograms())
+	{
+		if (histograms.threadId == QThread::currentThreadId())
+			return histograms;
+	}
+	return PromiseLatency::ThreadHistograms();
+}
+
+
+//####### Tests #######
+/*! Provides the data for the testBucketIndex() test.
+ */
+void PromiseLatencyTest::testBucketIndex_data()
+{
+	QTest::addColumn<qint64>("value");
+	QTest::addColumn<int>("expectedIndex");
+
+	QTest::newRow("negative") << Q_INT64_C(-5) << 0;
+	QTest::newRow("zero") << Q_INT64_C(0) << 0;
+	QTest::newRow("linear range") << Q_INT64_C(15) << 15;
+	QTest::newRow("first logarithmic bucket") << Q_INT64_C(16) << 16;
+	QTest::newRow("end of first power") << Q_INT64_C(31) << 31;
+	QTest::newRow("second power") << Q_INT64_C(32) << 32;
+	QTest::newRow("second power, rounded down") << Q_INT64_C(33) << 32;
+	QTest::newRow("one millisecond") << Q_INT64_C(1000000) << 16 + 15 * 16 + 14;
+	QTest::newRow("overflow") << std::numeric_limits<qint64>::max() << LatencyHistogram::BucketCount - 1;
+}
+
+/*! \test Tests the LatencyHistogram::bucketIndex() method.
+ */
+void PromiseLatencyTest::testBucketIndex()
+{
+	QFETCH(qint64, value);
+	QFETCH(int, expectedIndex);
+
+	QCOMPARE(LatencyHistogram::bucketIndex(value), expectedIndex);
+}
+
+/*! \test Tests that the bucket bounds are consistent with LatencyHistogram::bucketIndex().
+ */
+void PromiseLatencyTest::testBucketBounds()
+{
+	for (int index = 0; index < LatencyHistogram::BucketCount - 1; ++index)
+	{
+		const qint64 lowerBound = LatencyHistogram::bucketLowerBound(index);
+		const qint64 upperBound = LatencyHistogram::bucketUpperBound(index);
+		QVERIFY(lowerBound <= upperBound);
+		QCOMPARE(LatencyHistogram::bucketIndex(lowerBound), index);
+		QCOMPARE(LatencyHistogram::bucketIndex(upperBound), index);
+		QCOMPARE(LatencyHistogram::bucketLowerBound(index + 1), upperBound + 1);
+		// The relative error is bounded by the number of sub-buckets
+		QVERIFY(upperBound - lowerBound <= lowerBound / LatencyHistogram::SubBucketCount);
+	}
+}
+
+/*! \test Tests the statistics provided by LatencyHistogram.
+ */
+void PromiseLatencyTest::testHistogramStatistics()
+{
+	LatencyHistogram histogram;
+	QCOMPARE(histogram.count(), Q_UINT64_C(0));
+	QCOMPARE(histogram.min(), Q_INT64_C(0));
+	QCOMPARE(histogram.max(), Q_INT64_C(0));
+	QCOMPARE(histogram.valueAtPercentile(50.0), Q_INT64_C(0));
+
+	for (qint64 value = 1; value <= 100; ++value)
+		histogram.record(value * 1000);
+
+	QCOMPARE(histogram.count(), Q_UINT64_C(100));
+	QCOMPARE(histogram.min(), Q_INT64_C(1000));
+	QCOMPARE(histogram.max(), Q_INT64_C(100000));
+	QCOMPARE(histogram.mean(), 50500.0);
+
+	const qint64 median = histogram.valueAtPercentile(50.0);
+	QVERIFY(median >= 50000);
+	QVERIFY(median <= 50000 + 50000 / LatencyHistogram::SubBucketCount);
+	QCOMPARE(histogram.valueAtPercentile(100.0), Q_INT64_C(100000));
+	QCOMPARE(histogram.countAtBucket(LatencyHistogram::bucketIndex(1000)), Q_UINT64_C(1));
+}
+
+/*! \test Tests the LatencyHistogram::merge() method.
+ */
+void PromiseLatencyTest::testHistogramMerge()
+{
+	LatencyHistogram first;
+	first.record(10);
+	first.record(20);
+	LatencyHistogram second;
+	second.record(5);
+	second.record(40);
+
+	LatencyHistogram merged;
+	merged.merge(first);
+	merged.merge(LatencyHistogram());
+	merged.merge(second);
+
+	QCOMPARE(merged.count(), Q_UINT64_C(4));
+	QCOMPARE(merged.min(), Q_INT64_C(5));
+	QCOMPARE(merged.max(), Q_INT64_C(40));
+	QCOMPARE(merged.mean(), 18.75);
+}
+
+/*! \test Tests the timing of continuations registered with Promise::then().
+ */
+void PromiseLatencyTest::testContinuationLatency()
+{
+	if (!PromiseLatency::isEnabled())
+		QSKIP("Built without QTPROMISE_LATENCY_HISTOGRAMS");
+
+	const PromiseLatency::ThreadHistograms before = currentThreadHistograms();
+
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+	// Slow slot delaying the continuation
+	QObject::connect(deferred.data(), &Deferred::resolved, []() {
+		QThread::msleep(20);
+	});
+	Promise::Ptr newPromise = promise->then([](const QVariant&) {
+		QThread::msleep(10);
+	});
+	deferred->resolve();
+
+	const PromiseLatency::ThreadHistograms after = currentThreadHistograms();
+	QCOMPARE(after.queueDelay.count() - before.queueDelay.count(), Q_UINT64_C(1));
+	QCOMPARE(after.executionTime.count() - before.executionTime.count(), Q_UINT64_C(1));
+	QVERIFY(after.queueDelay.max() >= 20 * 1000 * 1000);
+	QVERIFY(after.executionTime.max() >= 10 * 1000 * 1000);
+
+	// Directly executed continuations do not have a queueing delay
+	Promise::Ptr directPromise = promise->then([](const QVariant&) {});
+	const PromiseLatency::ThreadHistograms direct = currentThreadHistograms();
+	QCOMPARE(direct.queueDelay.count(), after.queueDelay.count());
+	QCOMPARE(direct.executionTime.count() - after.executionTime.count(), Q_UINT64_C(1));
+}
+
+/*! \test Tests the timing of the asynchronous signal emission of a Promise
+ * which is created for a settled Deferred.
+ */
+void PromiseLatencyTest::testAsyncEmissionLatency()
+{
+	if (!PromiseLatency::isEnabled())
+		QSKIP("Built without QTPROMISE_LATENCY_HISTOGRAMS");
+
+	const PromiseLatency::ThreadHistograms before = currentThreadHistograms();
+
+	Promise::Ptr promise = Promise::createRejected(QVariant());
+	QSignalSpy rejectedSpy(promise.data(), &Promise::rejected);
+	QThread::msleep(10);
+	QVERIFY(rejectedSpy.wait());
+
+	const PromiseLatency::ThreadHistograms after = currentThreadHistograms();
+	QCOMPARE(after.queueDelay.count() - before.queueDelay.count(), Q_UINT64_C(1));
+	QVERIFY(after.queueDelay.max() >= 10 * 1000 * 1000);
+	QVERIFY(PromiseLatency::total().queueDelay.count() >= after.queueDelay.count());
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::PromiseLatencyTest)
+#include "PromiseLatencyTest.moc"
@@ -0,0 +1,240 @@
+
+#include <QtTest>
+#include <QThread>
+#include "PromiseMetrics.h"
+#include "Promise.h"
+#include "PromiseSitter.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the PromiseMetrics class.
+ *
+ * Since the metrics are process wide, the tests only check the differences
+ * between snapshots.
+ *
+ * \author jochen.ulrich
+ */
+class PromiseMetricsTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testDeferredCounters();
+	void testDeferredTypes();
+	void testThreadAggregation();
+	void testSitterPromises();
+	void testPendingActions();
+	void testRates();
+	void testPrometheusText();
+};
+
+
+//####### Helper #######
+
+/*! Creates rejected Deferreds in a separate thread.
+ */
+class RejectingThread : public QThread
+{
+public:
+	explicit RejectingThread(int deferredCount) : m_deferredCount(deferredCount) {}
+
+protected:
+	void run() override
+	{
+		for (int i = 0; i < m_deferredCount; ++i)
+			Deferred::create(Deferred::Rejected, QVariant());
+	}
+
+private:
+	int m_deferredCount;
+};
+
+
+//####### Tests #######
+/*! \test Tests the counters and gauges of the Deferreds.
+ */
+void PromiseMetricsTest::testDeferredCounters()
+{
+	const PromiseMetrics::Snapshot before = PromiseMetrics::snapshot();
+	const PromiseMetrics::DeferredCounters& base = before.deferreds[PromiseMetrics::BaseDeferredType];
+
+	Deferred::Ptr resolvedDeferred = Deferred::create();
+	Deferred::Ptr rejectedDeferred = Deferred::create();
+	Deferred::Ptr pendingDeferred = Deferred::create();
+
+	PromiseMetrics::Snapshot snapshot = PromiseMetrics::snapshot();
+	PromiseMetrics::DeferredCounters counters = snapshot.deferreds[PromiseMetrics::BaseDeferredType];
+	QCOMPARE(counters.created - base.created, Q_INT64_C(3));
+	QCOMPARE(counters.live - base.live, Q_INT64_C(3));
+	QCOMPARE(counters.pending - base.pending, Q_INT64_C(3));
+
+	resolvedDeferred->resolve();
+	rejectedDeferred->reject();
+	// Settling again must not be counted
+	resolvedDeferred->reject();
+
+	snapshot = PromiseMetrics::snapshot();
+	counters = snapshot.deferreds[PromiseMetrics::BaseDeferredType];
+	QCOMPARE(counters.resolved - base.resolved, Q_INT64_C(1));
+	QCOMPARE(counters.rejected - base.rejected, Q_INT64_C(1));
+	QCOMPARE(counters.pending - base.pending, Q_INT64_C(1));
+	QCOMPARE(counters.live - base.live, Q_INT64_C(3));
+
+	resolvedDeferred.clear();
+	rejectedDeferred.clear();
+	pendingDeferred.clear();
+
+	snapshot = PromiseMetrics::snapshot();
+	counters = snapshot.deferreds[PromiseMetrics::BaseDeferredType];
+	QCOMPARE(counters.live - base.live, Q_INT64_C(0));
+	QCOMPARE(counters.pending - base.pending, Q_INT64_C(0));
+	QCOMPARE(counters.created - base.created, Q_INT64_C(3));
+}
+
+/*! \test Tests that the Deferreds are accounted per type.
+ */
+void PromiseMetricsTest::testDeferredTypes()
+{
+	const PromiseMetrics::Snapshot before = PromiseMetrics::snapshot();
+
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+	Promise::Ptr childPromise = promise->then([](const QVariant& value) { return value; });
+
+	const PromiseMetrics::Snapshot after = PromiseMetrics::snapshot();
+	QCOMPARE(after.deferreds[PromiseMetrics::BaseDeferredType].created - before.deferreds[PromiseMetrics::BaseDeferredType].created, Q_INT64_C(1));
+	QCOMPARE(after.deferreds[PromiseMetrics::ChildDeferredType].created - before.deferreds[PromiseMetrics::ChildDeferredType].created, Q_INT64_C(1));
+	QCOMPARE(after.total().created - before.total().created, Q_INT64_C(2));
+
+	QCOMPARE(PromiseMetrics::typeName(PromiseMetrics::BaseDeferredType), QString("Deferred"));
+	QCOMPARE(PromiseMetrics::typeName(PromiseMetrics::ChildDeferredType), QString("ChildDeferred"));
+	QCOMPARE(PromiseMetrics::typeName(PromiseMetrics::NetworkDeferredType), QString("NetworkDeferred"));
+	QCOMPARE(PromiseMetrics::typeName(PromiseMetrics::FutureDeferredType), QString("FutureDeferred"));
+
+	deferred->resolve();
+	QTRY_COMPARE(childPromise->state(), Deferred::Resolved);
+}
+
+/*! \test Tests that the counters of other threads are included,
+ * also after the threads have finished.
+ */
+void PromiseMetricsTest::testThreadAggregation()
+{
+	const PromiseMetrics::Snapshot before = PromiseMetrics::snapshot();
+
+	RejectingThread thread(10);
+	thread.start();
+	QVERIFY(thread.wait(5000));
+
+	const PromiseMetrics::Snapshot after = PromiseMetrics::snapshot();
+	const qint64 created = after.deferreds[PromiseMetrics::BaseDeferredType].created - before.deferreds[PromiseMetrics::BaseDeferredType].created;
+	const qint64 rejected = after.deferreds[PromiseMetrics::BaseDeferredType].rejected - before.deferreds[PromiseMetrics::BaseDeferredType].rejected;
+	QCOMPARE(created, Q_INT64_C(10));
+	QCOMPARE(rejected, Q_INT64_C(10));
+	QCOMPARE(after.deferreds[PromiseMetrics::BaseDeferredType].live, before.deferreds[PromiseMetrics::BaseDeferredType].live);
+}
+
+/*! \test Tests the gauge of the promises held by PromiseSitters.
+ */
+void PromiseMetricsTest::testSitterPromises()
+{
+	const qint64 before = PromiseMetrics::snapshot().sitterPromises;
+
+	Deferred::Ptr firstDeferred = Deferred::create();
+	Promise::Ptr firstPromise = Promise::create(firstDeferred);
+	Deferred::Ptr secondDeferred = Deferred::create();
+	Promise::Ptr secondPromise = Promise::create(secondDeferred);
+	{
+		PromiseSitter sitter;
+		sitter.add(firstPromise);
+		sitter.add(secondPromise);
+		QCOMPARE(PromiseMetrics::snapshot().sitterPromises - before, Q_INT64_C(2));
+
+		sitter.remove(firstPromise);
+		QCOMPARE(PromiseMetrics::snapshot().sitterPromises - before, Q_INT64_C(1));
+	}
+	QCOMPARE(PromiseMetrics::snapshot().sitterPromises - before, Q_INT64_C(0));
+
+	// Prevent warnings
+	firstDeferred->resolve();
+	secondDeferred->resolve();
+}
+
+/*! \test Tests the gauges of the asynchronous and timer based actions.
+ */
+void PromiseMetricsTest::testPendingActions()
+{
+	// Let the actions of the previous tests finish
+	QTest::qWait(10);
+	const PromiseMetrics::Snapshot before = PromiseMetrics::snapshot();
+
+	Promise::Ptr resolvedPromise = Promise::createResolved(QVariant());
+	Promise::Ptr delayedPromise = Promise::delayedResolve(QVariant(), 20);
+
+	PromiseMetrics::Snapshot snapshot = PromiseMetrics::snapshot();
+	QCOMPARE(snapshot.asyncQueueDepth - before.asyncQueueDepth, Q_INT64_C(1));
+	QCOMPARE(snapshot.pendingTimers - before.pendingTimers, Q_INT64_C(1));
+
+	QTRY_COMPARE(delayedPromise->state(), Deferred::Resolved);
+	QTRY_COMPARE(PromiseMetrics::snapshot().asyncQueueDepth, before.asyncQueueDepth);
+	QCOMPARE(PromiseMetrics::snapshot().pendingTimers, before.pendingTimers);
+}
+
+/*! \test Tests the PromiseMetrics::Snapshot::settlesPerSecond() and
+ * PromiseMetrics::Snapshot::rejectionRate() methods.
+ */
+void PromiseMetricsTest::testRates()
+{
+	PromiseMetrics::Snapshot earlier;
+	earlier.timestamp = 1000;
+	earlier.deferreds[PromiseMetrics::BaseDeferredType].resolved = 10;
+	earlier.deferreds[PromiseMetrics::ChildDeferredType].rejected = 5;
+
+	PromiseMetrics::Snapshot later = earlier;
+	later.timestamp = 3000;
+	later.deferreds[PromiseMetrics::BaseDeferredType].resolved = 40;
+	later.deferreds[PromiseMetrics::ChildDeferredType].rejected = 15;
+
+	QCOMPARE(later.settlesPerSecond(earlier), 20.0);
+	QCOMPARE(later.rejectionRate(earlier), 0.25);
+
+	QCOMPARE(earlier.settlesPerSecond(earlier), 0.0);
+	QCOMPARE(earlier.rejectionRate(earlier), 0.0);
+}
+
+/*! \test Tests the PromiseMetrics::toPrometheusText() method.
+ */
+void PromiseMetricsTest::testPrometheusText()
+{
+	PromiseMetrics::Snapshot snapshot;
+	snapshot.deferreds[PromiseMetrics::NetworkDeferredType].live = 3;
+	snapshot.deferreds[PromiseMetrics::FutureDeferredType].rejected = 7;
+	snapshot.sitterPromises = 4;
+	snapshot.asyncQueueDepth = 5;
+	snapshot.pendingTimers = 6;
+
+	const QByteArray text = PromiseMetrics::toPrometheusText(snapshot);
+	const QList<QByteArray> lines = text.split('\n');
+
+	QVERIFY(lines.contains("# TYPE qtpromise_deferreds gauge"));
+	QVERIFY(lines.contains("qtpromise_deferreds{type=\"NetworkDeferred\"} 3"));
+	QVERIFY(lines.contains("qtpromise_deferreds{type=\"Deferred\"} 0"));
+	QVERIFY(lines.contains("# TYPE qtpromise_deferreds_settled_total counter"));
+	QVERIFY(lines.contains("qtpromise_deferreds_settled_total{type=\"FutureDeferred\",state=\"rejected\"} 7"));
+	QVERIFY(lines.contains("qtpromise_sitter_promises 4"));
+	QVERIFY(lines.contains("qtpromise_async_queue_depth 5"));
+	QVERIFY(lines.contains("qtpromise_pending_timers 6"));
+	QVERIFY(text.endsWith('\n'));
+
+	QVERIFY(PromiseMetrics::toPrometheusText().contains("qtpromise_deferreds_created_total{type=\"ChildDeferred\"}"));
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::PromiseMetricsTest)
+#include "PromiseMetricsTest.moc"
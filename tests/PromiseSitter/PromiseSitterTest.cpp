@@ -3,7 +3,14 @@
 #include <QtDebug>
 #include <QWeakPointer>
 #include <QScopedPointer>
+#include <QThreadPool>
+#include <QRunnable>
 #include "PromiseSitter.h"
+#include "VirtualTimeScheduler.h"
+
+Q_DECLARE_METATYPE(QtPromise::PromiseSitter::OverflowPolicy)
+Q_DECLARE_METATYPE(QtPromise::PromiseSitter::DrainMode)
+Q_DECLARE_METATYPE(QtPromise::PromiseSitter::ExpiryAction)
 
 
 namespace QtPromise
@@ -25,6 +32,8 @@ class PromiseSitterTest : public QObject
 	Q_OBJECT
 
 private Q_SLOTS:
+	void cleanup();
+
 	void testAddContainsRemove();
 	void testPromiseLifetime_data();
 	void testPromiseLifetime();
@@ -34,6 +43,20 @@ private Q_SLOTS:
 	void testContextObjects();
 	void testDestructor();
 	void testPromiseAccess();
+	void testCount();
+	void testConcurrentAddRemove();
+	void testBatchedRemoval();
+	void testCapacity_data();
+	void testCapacity();
+	void testWhenSpaceAvailable();
+	void testCapacityIncreaseReleasesWaiters();
+	void testWatermarks();
+	void testDrain();
+	void testDrainTimeout_data();
+	void testDrainTimeout();
+	void testExpiry_data();
+	void testExpiry();
+	void testMaxAgeOverride();
 
 private:
 	struct PromiseSpies
@@ -50,6 +73,61 @@ private:
 
 //####### Helper #######
 
+/*! Adds and removes promises to/from a PromiseSitter from a worker thread.
+ */
+class AddRemoveRunnable : public QRunnable
+{
+public:
+	AddRemoveRunnable(PromiseSitter* sitter, int promiseCount)
+		: m_sitter(sitter), m_promiseCount(promiseCount), m_failures(0) {}
+
+	void run() override
+	{
+		QVector<Deferred::Ptr> deferreds;
+		QVector<Promise::Ptr> promises;
+		for (int i=0; i < m_promiseCount; ++i)
+		{
+			Deferred::Ptr deferred = Deferred::create();
+			Promise::Ptr promise = Promise::create(deferred);
+			m_sitter->add(promise);
+			deferreds.append(deferred);
+			promises.append(promise);
+		}
+		for (Promise::Ptr promise : const_cast<const QVector<Promise::Ptr>&>(promises))
+		{
+			if (!m_sitter->contains(promise) || !m_sitter->remove(promise))
+				++m_failures;
+		}
+		// Prevent warnings
+		for (Deferred::Ptr deferred : const_cast<const QVector<Deferred::Ptr>&>(deferreds))
+			deferred->resolve();
+	}
+
+	int failures() const { return m_failures; }
+
+private:
+	PromiseSitter* m_sitter;
+	int m_promiseCount;
+	int m_failures;
+};
+
+/*! Counts the queued method invocations delivered to an object.
+ */
+class MetaCallCounter : public QObject
+{
+public:
+	explicit MetaCallCounter(QObject* watched) { watched->installEventFilter(this); }
+
+	bool eventFilter(QObject*, QEvent* event) override
+	{
+		if (event->type() == QEvent::MetaCall)
+			++count;
+		return false;
+	}
+
+	int count = 0;
+};
+
 PromiseSitterTest::PromiseSpies::PromiseSpies(Promise::Ptr promise)
 	: resolved(promise.data(), &Promise::resolved),
 	  rejected(promise.data(), &Promise::rejected),
@@ -58,6 +136,11 @@ PromiseSitterTest::PromiseSpies::PromiseSpies(Promise::Ptr promise)
 }
 
 //####### Tests #######
+void PromiseSitterTest::cleanup()
+{
+	Scheduler::setInstance(nullptr);
+}
+
 
 /*! \test Tests the PromiseSitter::add(), PromiseSitter::contains()
  * and PromiseSitter::remove() methods.
@@ -323,6 +406,428 @@ void PromiseSitterTest::testPromiseAccess()
 	QVERIFY(sitter->promises().indexOf(promise2WPointer.toStrongRef()) >= 0);
 }
 
+/*! \test Tests the PromiseSitter::count() method.
+ */
+void PromiseSitterTest::testCount()
+{
+	PromiseSitter sitter;
+	QCOMPARE(sitter.count(), 0);
+
+	Deferred::Ptr deferred1 = Deferred::create();
+	Deferred::Ptr deferred2 = Deferred::create();
+	Promise::Ptr promise1 = Promise::create(deferred1);
+	Promise::Ptr promise2 = Promise::create(deferred2);
+
+	sitter.add(promise1);
+	sitter.add(promise2);
+	sitter.add(promise2);
+	QCOMPARE(sitter.count(), 2);
+
+	QVERIFY(sitter.remove(promise2));
+	QCOMPARE(sitter.count(), 1);
+
+	deferred1->resolve();
+	QTRY_COMPARE(sitter.count(), 0);
+
+	// Prevent warning
+	deferred2->resolve();
+}
+
+/*! \test Tests adding and removing promises from multiple threads concurrently.
+ */
+void PromiseSitterTest::testConcurrentAddRemove()
+{
+	const int threadCount = 8;
+	const int promisesPerThread = 200;
+
+	PromiseSitter sitter;
+	QThreadPool pool;
+	pool.setMaxThreadCount(threadCount);
+
+	QVector<AddRemoveRunnable*> runnables;
+	for (int i=0; i < threadCount; ++i)
+	{
+		auto runnable = new AddRemoveRunnable(&sitter, promisesPerThread);
+		runnable->setAutoDelete(false);
+		runnables.append(runnable);
+		pool.start(runnable);
+	}
+	QVERIFY(pool.waitForDone(20000));
+
+	for (AddRemoveRunnable* runnable : const_cast<const QVector<AddRemoveRunnable*>&>(runnables))
+		QCOMPARE(runnable->failures(), 0);
+	qDeleteAll(runnables);
+
+	QCOMPARE(sitter.count(), 0);
+	QVERIFY(sitter.promises().isEmpty());
+}
+
+/*! \test Tests that promises which are settled together are removed with a single
+ * posted event.
+ */
+void PromiseSitterTest::testBatchedRemoval()
+{
+	PromiseSitter sitter;
+	MetaCallCounter removalCalls(&sitter);
+
+	QVector<Deferred::Ptr> deferreds;
+	QVector<QWeakPointer<Promise>> promiseWPointers;
+	for (int i=0; i < 3; ++i)
+	{
+		Deferred::Ptr deferred = Deferred::create();
+		Promise::Ptr promise = Promise::create(deferred);
+		sitter.add(promise);
+		deferreds.append(deferred);
+		promiseWPointers.append(promise);
+	}
+	QCOMPARE(sitter.count(), 3);
+
+	for (Deferred::Ptr deferred : const_cast<const QVector<Deferred::Ptr>&>(deferreds))
+		deferred->resolve();
+
+	// The promises must not be released synchronously
+	QCOMPARE(sitter.count(), 3);
+	for (const QWeakPointer<Promise>& promiseWPointer : const_cast<const QVector<QWeakPointer<Promise>>&>(promiseWPointers))
+		QVERIFY(!promiseWPointer.isNull());
+
+	QCOMPARE(removalCalls.count, 0);
+
+	QCoreApplication::sendPostedEvents(&sitter, QEvent::MetaCall);
+
+	// All settlements are coalesced into one removeSettledPromises() invocation
+	QCOMPARE(removalCalls.count, 1);
+	QCOMPARE(sitter.count(), 0);
+	for (const QWeakPointer<Promise>& promiseWPointer : const_cast<const QVector<QWeakPointer<Promise>>&>(promiseWPointers))
+		QVERIFY(promiseWPointer.isNull());
+}
+
+/*! Provides the data for the testCapacity() test.
+ */
+void PromiseSitterTest::testCapacity_data()
+{
+	QTest::addColumn<PromiseSitter::OverflowPolicy>("policy");
+
+	QTest::newRow("reject new") << PromiseSitter::RejectNew;
+	QTest::newRow("evict oldest") << PromiseSitter::EvictOldest;
+}
+
+/*! \test Tests the capacity limit of the PromiseSitter.
+ */
+void PromiseSitterTest::testCapacity()
+{
+	QFETCH(PromiseSitter::OverflowPolicy, policy);
+
+	PromiseSitter sitter;
+	sitter.setCapacity(2, policy);
+	QCOMPARE(sitter.capacity(), 2);
+	QCOMPARE(sitter.overflowPolicy(), policy);
+
+	QVector<Deferred::Ptr> deferreds;
+	QVector<Promise::Ptr> promises;
+	for (int i=0; i < 3; ++i)
+	{
+		deferreds.append(Deferred::create());
+		promises.append(Promise::create(deferreds.last()));
+	}
+
+	QVERIFY(sitter.add(promises[0]));
+	QVERIFY(sitter.add(promises[1]));
+	// Adding an already contained promise works even when the sitter is full
+	QVERIFY(sitter.add(promises[1]));
+
+	if (policy == PromiseSitter::RejectNew)
+	{
+		QVERIFY(!sitter.add(promises[2]));
+		QVERIFY(sitter.contains(promises[0]));
+		QVERIFY(!sitter.contains(promises[2]));
+	}
+	else
+	{
+		QVERIFY(sitter.add(promises[2]));
+		QVERIFY(!sitter.contains(promises[0]));
+		QVERIFY(sitter.contains(promises[2]));
+	}
+	QVERIFY(sitter.contains(promises[1]));
+	QCOMPARE(sitter.count(), 2);
+
+	// Prevent warnings
+	for (Deferred::Ptr deferred : const_cast<const QVector<Deferred::Ptr>&>(deferreds))
+		deferred->resolve();
+}
+
+/*! \test Tests the PromiseSitter::whenSpaceAvailable() method.
+ */
+void PromiseSitterTest::testWhenSpaceAvailable()
+{
+	PromiseSitter sitter;
+	QCOMPARE(sitter.whenSpaceAvailable()->state(), Deferred::Resolved);
+
+	sitter.setCapacity(1);
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+	QVERIFY(sitter.add(promise));
+
+	Promise::Ptr firstWaiter = sitter.whenSpaceAvailable();
+	Promise::Ptr secondWaiter = sitter.whenSpaceAvailable();
+	QCOMPARE(firstWaiter->state(), Deferred::Pending);
+	QCOMPARE(secondWaiter->state(), Deferred::Pending);
+
+	QVERIFY(sitter.remove(promise));
+	QCOMPARE(firstWaiter->state(), Deferred::Resolved);
+	// Only one waiter is served per freed slot
+	QCOMPARE(secondWaiter->state(), Deferred::Pending);
+
+	sitter.setCapacity(0);
+	QCOMPARE(secondWaiter->state(), Deferred::Resolved);
+
+	// Prevent warning
+	deferred->resolve();
+}
+
+/*! \test Tests that increasing the capacity serves one waiter per new free slot
+ * without emitting PromiseSitter::lowWatermarkReached().
+ */
+void PromiseSitterTest::testCapacityIncreaseReleasesWaiters()
+{
+	PromiseSitter sitter;
+	sitter.setWatermarks(1, 1);
+	sitter.setCapacity(1);
+	QSignalSpy lowSpy(&sitter, &PromiseSitter::lowWatermarkReached);
+
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+	QVERIFY(sitter.add(promise));
+
+	QVector<Promise::Ptr> waiters;
+	for (int i=0; i < 3; ++i)
+		waiters.append(sitter.whenSpaceAvailable());
+	for (const Promise::Ptr& waiter : const_cast<const QVector<Promise::Ptr>&>(waiters))
+		QCOMPARE(waiter->state(), Deferred::Pending);
+
+	sitter.setCapacity(3);
+	QCOMPARE(waiters[0]->state(), Deferred::Resolved);
+	QCOMPARE(waiters[1]->state(), Deferred::Resolved);
+	QCOMPARE(waiters[2]->state(), Deferred::Pending);
+	QCOMPARE(lowSpy.count(), 0);
+
+	sitter.setCapacity(0);
+	QCOMPARE(waiters[2]->state(), Deferred::Resolved);
+	QCOMPARE(lowSpy.count(), 0);
+	QCOMPARE(sitter.count(), 1);
+
+	// Prevent warning
+	deferred->resolve();
+}
+
+/*! \test Tests the PromiseSitter::highWatermarkReached() and PromiseSitter::lowWatermarkReached()
+ * signals.
+ */
+void PromiseSitterTest::testWatermarks()
+{
+	PromiseSitter sitter;
+	sitter.setWatermarks(1, 3);
+	QCOMPARE(sitter.lowWatermark(), 1);
+	QCOMPARE(sitter.highWatermark(), 3);
+
+	QSignalSpy highSpy(&sitter, &PromiseSitter::highWatermarkReached);
+	QSignalSpy lowSpy(&sitter, &PromiseSitter::lowWatermarkReached);
+
+	QVector<Deferred::Ptr> deferreds;
+	QVector<Promise::Ptr> promises;
+	for (int i=0; i < 4; ++i)
+	{
+		deferreds.append(Deferred::create());
+		promises.append(Promise::create(deferreds.last()));
+		sitter.add(promises.last());
+	}
+
+	QCOMPARE(highSpy.count(), 1);
+	QCOMPARE(highSpy.first().first().toInt(), 3);
+	QCOMPARE(lowSpy.count(), 0);
+
+	sitter.remove(promises[0]);
+	sitter.remove(promises[1]);
+	QCOMPARE(lowSpy.count(), 0);
+	sitter.remove(promises[2]);
+	QCOMPARE(lowSpy.count(), 1);
+	QCOMPARE(lowSpy.first().first().toInt(), 1);
+	sitter.remove(promises[3]);
+	QCOMPARE(lowSpy.count(), 1);
+	QCOMPARE(highSpy.count(), 1);
+
+	// Prevent warnings
+	for (Deferred::Ptr deferred : const_cast<const QVector<Deferred::Ptr>&>(deferreds))
+		deferred->resolve();
+}
+/*! \test Tests the PromiseSitter::drain() method when all promises settle in time.
+ */
+void PromiseSitterTest::testDrain()
+{
+	PromiseSitter sitter;
+	QCOMPARE(sitter.drain()->state(), Deferred::Resolved);
+
+	Deferred::Ptr deferred1 = Deferred::create();
+	Deferred::Ptr deferred2 = Deferred::create();
+	sitter.add(Promise::create(deferred1));
+	sitter.add(Promise::create(deferred2));
+
+	Promise::Ptr drainPromise = sitter.drain(10000);
+	QCOMPARE(drainPromise->state(), Deferred::Pending);
+
+	deferred1->resolve();
+	QTest::qWait(10);
+	QCOMPARE(drainPromise->state(), Deferred::Pending);
+
+	deferred2->reject();
+	QTRY_COMPARE(drainPromise->state(), Deferred::Resolved);
+	QCOMPARE(sitter.count(), 0);
+}
+
+/*! Provides the data for the testDrainTimeout() test.
+ */
+void PromiseSitterTest::testDrainTimeout_data()
+{
+	QTest::addColumn<PromiseSitter::DrainMode>("mode");
+
+	QTest::newRow("keep") << PromiseSitter::KeepStragglers;
+	QTest::newRow("remove") << PromiseSitter::RemoveStragglers;
+	QTest::newRow("reject") << PromiseSitter::RejectStragglers;
+}
+
+/*! \test Tests the PromiseSitter::drain() method when promises do not settle in time.
+ */
+void PromiseSitterTest::testDrainTimeout()
+{
+	QFETCH(PromiseSitter::DrainMode, mode);
+
+	VirtualTimeScheduler scheduler;
+	Scheduler::setInstance(&scheduler);
+
+	PromiseSitter sitter;
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+	sitter.add(promise);
+
+	Promise::Ptr drainPromise = sitter.drain(20, mode);
+	scheduler.advanceBy(19);
+	QCOMPARE(drainPromise->state(), Deferred::Pending);
+	scheduler.advanceBy(1);
+	QCOMPARE(drainPromise->state(), Deferred::Rejected);
+
+	QList<PromiseSitter::Straggler> stragglers = drainPromise->data().value<QList<PromiseSitter::Straggler>>();
+	QCOMPARE(stragglers.size(), 1);
+	QCOMPARE(stragglers.first().promise, promise);
+	QCOMPARE(stragglers.first().age, Q_INT64_C(20));
+
+	switch (mode)
+	{
+	case PromiseSitter::KeepStragglers:
+		QVERIFY(sitter.contains(promise));
+		QCOMPARE(deferred->state(), Deferred::Pending);
+		// Prevent warning
+		deferred->resolve();
+		break;
+	case PromiseSitter::RemoveStragglers:
+		QVERIFY(!sitter.contains(promise));
+		QCOMPARE(deferred->state(), Deferred::Pending);
+		// Prevent warning
+		deferred->resolve();
+		break;
+	case PromiseSitter::RejectStragglers:
+		QCOMPARE(deferred->state(), Deferred::Rejected);
+		QVERIFY(deferred->data().canConvert<PromiseSitter::Timeout>());
+		QTRY_VERIFY(!sitter.contains(promise));
+		break;
+	}
+}
+
+/*! Provides the data for the testExpiry() test.
+ */
+void PromiseSitterTest::testExpiry_data()
+{
+	QTest::addColumn<PromiseSitter::ExpiryAction>("action");
+
+	QTest::newRow("remove") << PromiseSitter::RemoveExpired;
+	QTest::newRow("reject") << PromiseSitter::RejectExpired;
+}
+
+/*! \test Tests the expiry of promises which are held longer than PromiseSitter::maxAge().
+ */
+void PromiseSitterTest::testExpiry()
+{
+	QFETCH(PromiseSitter::ExpiryAction, action);
+
+	VirtualTimeScheduler scheduler;
+	Scheduler::setInstance(&scheduler);
+
+	PromiseSitter sitter;
+	sitter.setMaxAge(20, action);
+	QCOMPARE(sitter.maxAge(), 20);
+	QCOMPARE(sitter.expiryAction(), action);
+
+	QSignalSpy expiredSpy(&sitter, &PromiseSitter::expired);
+
+	Deferred::Ptr expiringDeferred = Deferred::create();
+	Promise::Ptr expiringPromise = Promise::create(expiringDeferred);
+	Deferred::Ptr settlingDeferred = Deferred::create();
+	Promise::Ptr settlingPromise = Promise::create(settlingDeferred);
+	sitter.add(expiringPromise);
+	sitter.add(settlingPromise);
+	settlingDeferred->resolve();
+
+	// The expiry is checked with a granularity of ExpiryResolution
+	scheduler.advanceBy(PromiseSitter::ExpiryResolution - 1);
+	QVERIFY(sitter.contains(expiringPromise));
+	QCOMPARE(sitter.expiredCount(), static_cast<quint64>(0));
+	scheduler.advanceBy(1);
+	QTRY_VERIFY(!sitter.contains(expiringPromise));
+	QVERIFY(!sitter.contains(settlingPromise));
+	QCOMPARE(sitter.expiredCount(), static_cast<quint64>(1));
+	QCOMPARE(expiredSpy.count(), 1);
+	QCOMPARE(expiredSpy.first().first().toInt(), 1);
+
+	switch (action)
+	{
+	case PromiseSitter::RemoveExpired:
+		QCOMPARE(expiringDeferred->state(), Deferred::Pending);
+		// Prevent warning
+		expiringDeferred->resolve();
+		break;
+	case PromiseSitter::RejectExpired:
+		QCOMPARE(expiringDeferred->state(), Deferred::Rejected);
+		QVERIFY(expiringDeferred->data().canConvert<PromiseSitter::Timeout>());
+		QCOMPARE(expiringDeferred->data().value<PromiseSitter::Timeout>().age, static_cast<qint64>(PromiseSitter::ExpiryResolution));
+		break;
+	}
+}
+
+/*! \test Tests the \p maxAgeMs parameter of PromiseSitter::add().
+ */
+void PromiseSitterTest::testMaxAgeOverride()
+{
+	VirtualTimeScheduler scheduler;
+	Scheduler::setInstance(&scheduler);
+
+	PromiseSitter sitter;
+	sitter.setMaxAge(20);
+
+	Deferred::Ptr neverExpiringDeferred = Deferred::create();
+	Promise::Ptr neverExpiringPromise = Promise::create(neverExpiringDeferred);
+	Deferred::Ptr expiringDeferred = Deferred::create();
+	Promise::Ptr expiringPromise = Promise::create(expiringDeferred);
+	sitter.add(neverExpiringPromise, QVector<const QObject*>(), 0);
+	sitter.add(expiringPromise);
+
+	scheduler.advanceBy(PromiseSitter::ExpiryResolution);
+	QVERIFY(!sitter.contains(expiringPromise));
+	scheduler.advanceBy(60 * 60 * 1000);
+	QVERIFY(sitter.contains(neverExpiringPromise));
+	QCOMPARE(scheduler.pendingTaskCount(), 0);
+
+	// Prevent warnings
+	neverExpiringDeferred->resolve();
+	expiringDeferred->resolve();
+}
 
 }  // namespace Tests
 }  // namespace QtPromise
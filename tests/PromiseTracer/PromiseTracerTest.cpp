@@ -0,0 +1,234 @@
+
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include "PromiseTracer.h"
+#include "Promise.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the PromiseTracer class.
+ *
+ * \author jochen.ulrich
+ */
+class PromiseTracerTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void cleanup();
+
+	void testDisabled();
+	void testLifecycleEvents();
+	void testFlowEvents();
+	void testBufferCapacity();
+	void testClear();
+	void testWriteChromeTrace();
+};
+
+
+//####### Helper #######
+
+/*! Exports the recorded events and returns the trace events.
+ */
+QJsonArray exportTraceEvents()
+{
+	const QJsonDocument document = QJsonDocument::fromJson(PromiseTracer::toChromeTraceJson());
+	return document.object().value("traceEvents").toArray();
+}
+
+/*! \return The trace events with the given phase and optionally the given name.
+ */
+QList<QJsonObject> findEvents(const QJsonArray& traceEvents, const QString& phase, const QString& name = QString())
+{
+	QList<QJsonObject> result;
+	for (const QJsonValue& value : traceEvents)
+	{
+		const QJsonObject event = value.toObject();
+		if (event.value("ph").toString() == phase && (name.isNull() || event.value("name").toString() == name))
+			result.append(event);
+	}
+	return result;
+}
+
+/*! Records events in a separate thread.
+ */
+class TracingThread : public QThread
+{
+public:
+	explicit TracingThread(int deferredCount) : m_deferredCount(deferredCount) {}
+
+protected:
+	void run() override
+	{
+		for (int i = 0; i < m_deferredCount; ++i)
+			Deferred::create(Deferred::Resolved, QVariant());
+	}
+
+private:
+	int m_deferredCount;
+};
+
+
+//####### Tests #######
+void PromiseTracerTest::cleanup()
+{
+	PromiseTracer::stop();
+	PromiseTracer::clear();
+}
+
+/*! \test Tests that nothing is recorded while the tracer is stopped.
+ */
+void PromiseTracerTest::testDisabled()
+{
+	QVERIFY(!PromiseTracer::isEnabled());
+
+	Deferred::Ptr deferred = Deferred::create();
+	Promise::Ptr promise = Promise::create(deferred);
+	bool called = false;
+	Promise::Ptr newPromise = promise->then([&called](const QVariant&) { called = true; });
+	deferred->resolve();
+	QVERIFY(called);
+
+	const QJsonArray traceEvents = exportTraceEvents();
+	QVERIFY(findEvents(traceEvents, "b").isEmpty());
+	QVERIFY(findEvents(traceEvents, "B").isEmpty());
+}
+
+/*! \test Tests the events recorded during the lifecycle of a Deferred.
+ */
+void PromiseTracerTest::testLifecycleEvents()
+{
+	PromiseTracer::start();
+	QVERIFY(PromiseTracer::isEnabled());
+
+	Deferred::Ptr deferred = Deferred::create();
+	deferred->setLabel("loadConfig");
+	QCOMPARE(deferred->label(), QString("loadConfig"));
+	Promise::Ptr promise = Promise::create(deferred);
+	Promise::Ptr newPromise = promise->then([](const QVariant&) {});
+	deferred->notify(50);
+	deferred->resolve();
+	PromiseTracer::stop();
+
+	const QJsonArray traceEvents = exportTraceEvents();
+
+	const QList<QJsonObject> lifetimeBegins = findEvents(traceEvents, "b", "loadConfig");
+	QCOMPARE(lifetimeBegins.size(), 1);
+	const QString id = lifetimeBegins.first().value("id").toString();
+	QCOMPARE(lifetimeBegins.first().value("args").toObject().value("type").toString(), QString("Deferred"));
+
+	const QList<QJsonObject> lifetimeEnds = findEvents(traceEvents, "e", "loadConfig");
+	QCOMPARE(lifetimeEnds.size(), 1);
+	QCOMPARE(lifetimeEnds.first().value("id").toString(), id);
+	QCOMPARE(lifetimeEnds.first().value("args").toObject().value("state").toString(), QString("resolved"));
+	QVERIFY(lifetimeEnds.first().value("ts").toDouble() >= lifetimeBegins.first().value("ts").toDouble());
+
+	bool thenFound = false;
+	for (const QJsonObject& event : findEvents(traceEvents, "n", "then"))
+		thenFound = thenFound || event.value("id").toString() == id;
+	QVERIFY(thenFound);
+
+	// The ChildDeferred created by then() is notified and resolved as well
+	QCOMPARE(findEvents(traceEvents, "i", "notify").size(), 2);
+	QCOMPARE(findEvents(traceEvents, "B", "resolve").size(), 2);
+	QCOMPARE(findEvents(traceEvents, "B", "continuation").size(), 1);
+	QCOMPARE(findEvents(traceEvents, "E").size(), 3);
+	QVERIFY(!findEvents(traceEvents, "M", "thread_name").isEmpty());
+}
+
+/*! \test Tests the flow events between parents and ChildDeferreds.
+ */
+void PromiseTracerTest::testFlowEvents()
+{
+	PromiseTracer::start();
+
+	Deferred::Ptr first = Deferred::create();
+	Deferred::Ptr second = Deferred::create();
+	Promise::Ptr combined = Promise::all({Promise::create(first), Promise::create(second)});
+	first->resolve();
+	second->resolve();
+	QTRY_COMPARE(combined->state(), Deferred::Resolved);
+	PromiseTracer::stop();
+
+	const QJsonArray traceEvents = exportTraceEvents();
+	const QList<QJsonObject> flowStarts = findEvents(traceEvents, "s", "link");
+	const QList<QJsonObject> flowEnds = findEvents(traceEvents, "f", "link");
+	QCOMPARE(flowStarts.size(), 2);
+	QCOMPARE(flowEnds.size(), 2);
+	for (int i = 0; i < flowStarts.size(); ++i)
+	{
+		QCOMPARE(flowStarts.at(i).value("id").toInt(), flowEnds.at(i).value("id").toInt());
+		QVERIFY(flowStarts.at(i).value("ts").toDouble() <= flowEnds.at(i).value("ts").toDouble());
+	}
+	QCOMPARE(findEvents(traceEvents, "b", "ChildDeferred").size(), 1);
+}
+
+/*! \test Tests that the number of recorded events per thread is bounded.
+ */
+void PromiseTracerTest::testBufferCapacity()
+{
+	PromiseTracer::start(10);
+
+	// Each Deferred records a creation and a resolution
+	TracingThread thread(100);
+	thread.start();
+	QVERIFY(thread.wait(5000));
+	PromiseTracer::stop();
+
+	const QJsonArray traceEvents = exportTraceEvents();
+	const QList<QJsonObject> lifetimeBegins = findEvents(traceEvents, "b", "Deferred");
+	const QList<QJsonObject> lifetimeEnds = findEvents(traceEvents, "e", "Deferred");
+	QVERIFY(lifetimeBegins.size() + lifetimeEnds.size() <= 10);
+	QVERIFY(!lifetimeEnds.isEmpty());
+}
+
+/*! \test Tests the PromiseTracer::clear() method.
+ */
+void PromiseTracerTest::testClear()
+{
+	PromiseTracer::start();
+	Deferred::Ptr deferred = Deferred::create();
+	QCOMPARE(findEvents(exportTraceEvents(), "b").size(), 1);
+
+	PromiseTracer::clear();
+	QVERIFY(findEvents(exportTraceEvents(), "b").isEmpty());
+
+	deferred->resolve();
+	QCOMPARE(findEvents(exportTraceEvents(), "B", "resolve").size(), 1);
+}
+
+/*! \test Tests the PromiseTracer::writeChromeTrace() method.
+ */
+void PromiseTracerTest::testWriteChromeTrace()
+{
+	PromiseTracer::start();
+	Deferred::create(Deferred::Rejected, QVariant());
+	PromiseTracer::stop();
+
+	QTemporaryDir tempDir;
+	QVERIFY(tempDir.isValid());
+	const QString filePath = tempDir.filePath("trace.json");
+	QVERIFY(PromiseTracer::writeChromeTrace(filePath));
+
+	QFile file(filePath);
+	QVERIFY(file.open(QIODevice::ReadOnly));
+	QJsonParseError error;
+	const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+	QCOMPARE(error.error, QJsonParseError::NoError);
+	QCOMPARE(findEvents(document.object().value("traceEvents").toArray(), "B", "reject").size(), 1);
+
+	QVERIFY(!PromiseTracer::writeChromeTrace(tempDir.filePath("missing/trace.json")));
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::PromiseTracerTest)
+#include "PromiseTracerTest.moc"
@@ -0,0 +1,295 @@
+#include <QtTest>
+#include <QScopedPointer>
+#include "Scheduler.h"
+#include "VirtualTimeScheduler.h"
+#include "Promise.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the Scheduler, SystemScheduler and VirtualTimeScheduler classes.
+ *
+ * \author jochen.ulrich
+ */
+class SchedulerTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void cleanup();
+
+	void testInstance();
+	void testSystemScheduler();
+	void testSystemSchedulerCancel();
+	void testVirtualTimeOrder();
+	void testVirtualTimeNestedTasks();
+	void testVirtualTimeCancel();
+	void testVirtualTimeContextDestroyed();
+	void testVirtualTimeOtherThread();
+	void testDelayedPromises();
+	void benchmarkDelayedPromises();
+};
+
+
+//####### Helper #######
+
+/*! Runs an event loop in a separate thread until it is destroyed.
+ */
+class EventLoopThread : public QThread
+{
+public:
+	EventLoopThread() { start(); }
+	~EventLoopThread() { quit(); wait(); }
+};
+
+
+//####### Tests #######
+void SchedulerTest::cleanup()
+{
+	Scheduler::setInstance(nullptr);
+}
+
+/*! \test Tests the Scheduler::instance() and Scheduler::setInstance() methods.
+ */
+void SchedulerTest::testInstance()
+{
+	QVERIFY(Scheduler::systemScheduler());
+	QCOMPARE(Scheduler::instance(), Scheduler::systemScheduler());
+
+	VirtualTimeScheduler scheduler;
+	Scheduler::setInstance(&scheduler);
+	QCOMPARE(Scheduler::instance(), &scheduler);
+
+	Scheduler::setInstance(nullptr);
+	QCOMPARE(Scheduler::instance(), Scheduler::systemScheduler());
+}
+
+/*! \test Tests the execution of tasks by the SystemScheduler.
+ */
+void SchedulerTest::testSystemScheduler()
+{
+	Scheduler* scheduler = Scheduler::systemScheduler();
+	QObject context;
+	QStringList executed;
+
+	const qint64 start = scheduler->now();
+	const Scheduler::TaskId later = scheduler->schedule(20, &context, [&executed]() { executed << "later"; });
+	const Scheduler::TaskId sooner = scheduler->schedule(0, &context, [&executed]() { executed << "sooner"; });
+	QVERIFY(later != 0);
+	QVERIFY(sooner != later);
+	QVERIFY(executed.isEmpty());
+
+	QTRY_COMPARE(executed, QStringList() << "sooner" << "later");
+	QVERIFY(scheduler->now() - start >= 20);
+
+	// Context destroyed before the task is due
+	QScopedPointer<QObject> shortLivedContext(new QObject);
+	scheduler->schedule(0, shortLivedContext.data(), [&executed]() { executed << "destroyed"; });
+	shortLivedContext.reset();
+	QTest::qWait(10);
+	QCOMPARE(executed.size(), 2);
+}
+
+/*! \test Tests the SystemScheduler::cancel() method.
+ */
+void SchedulerTest::testSystemSchedulerCancel()
+{
+	Scheduler* scheduler = Scheduler::systemScheduler();
+	QObject context;
+	int cancelledCount = 0;
+	int executedCount = 0;
+
+	const Scheduler::TaskId cancelled = scheduler->schedule(0, &context, [&cancelledCount]() { ++cancelledCount; });
+	const Scheduler::TaskId executed = scheduler->schedule(0, &context, [&executedCount]() { ++executedCount; });
+	scheduler->cancel(cancelled);
+
+	QTRY_COMPARE(executedCount, 1);
+	QCOMPARE(cancelledCount, 0);
+
+	// Cancelling an executed task does nothing
+	scheduler->cancel(executed);
+	scheduler->cancel(cancelled);
+}
+
+/*! \test Tests the order of the execution of tasks by the VirtualTimeScheduler.
+ */
+void SchedulerTest::testVirtualTimeOrder()
+{
+	VirtualTimeScheduler scheduler(1000);
+	QObject context;
+	QStringList executed;
+	QVector<qint64> executionTimes;
+	auto record = [&](const QString& name) {
+		return [&, name]() {
+			executed << name;
+			executionTimes << scheduler.now();
+		};
+	};
+
+	QCOMPARE(scheduler.now(), Q_INT64_C(1000));
+	QCOMPARE(scheduler.nextTaskTime(), Q_INT64_C(-1));
+
+	scheduler.schedule(30, &context, record("c"));
+	scheduler.schedule(10, &context, record("a"));
+	scheduler.schedule(30, &context, record("d"));
+	scheduler.schedule(20, &context, record("b"));
+	QCOMPARE(scheduler.pendingTaskCount(), 4);
+	QCOMPARE(scheduler.nextTaskTime(), Q_INT64_C(1010));
+	QVERIFY(executed.isEmpty());
+
+	QCOMPARE(scheduler.advanceBy(9), 0);
+	QCOMPARE(scheduler.now(), Q_INT64_C(1009));
+	QVERIFY(executed.isEmpty());
+
+	QCOMPARE(scheduler.advanceBy(11), 2);
+	QCOMPARE(executed, QStringList() << "a" << "b");
+	QCOMPARE(scheduler.now(), Q_INT64_C(1020));
+
+	QVERIFY(scheduler.advanceToNextTask());
+	QCOMPARE(executed, QStringList() << "a" << "b" << "c" << "d");
+	QCOMPARE(executionTimes, QVector<qint64>() << 1010 << 1020 << 1030 << 1030);
+	QCOMPARE(scheduler.now(), Q_INT64_C(1030));
+	QCOMPARE(scheduler.pendingTaskCount(), 0);
+	QVERIFY(!scheduler.advanceToNextTask());
+
+	// Advancing into the past does not change the time
+	QCOMPARE(scheduler.advanceTo(0), 0);
+	QCOMPARE(scheduler.now(), Q_INT64_C(1030));
+}
+
+/*! \test Tests tasks scheduled by tasks of the VirtualTimeScheduler.
+ */
+void SchedulerTest::testVirtualTimeNestedTasks()
+{
+	VirtualTimeScheduler scheduler;
+	QObject context;
+	QVector<qint64> executionTimes;
+
+	std::function<void()> periodic;
+	periodic = [&]() {
+		executionTimes << scheduler.now();
+		scheduler.schedule(10, &context, periodic);
+	};
+	scheduler.schedule(10, &context, periodic);
+	scheduler.schedule(0, &context, [&]() {
+		scheduler.schedule(0, &context, [&]() { executionTimes << -1; });
+	});
+
+	QCOMPARE(scheduler.advanceBy(0), 2);
+	QCOMPARE(executionTimes, QVector<qint64>() << -1);
+
+	QCOMPARE(scheduler.advanceBy(35), 3);
+	QCOMPARE(executionTimes, QVector<qint64>() << -1 << 10 << 20 << 30);
+	QCOMPARE(scheduler.now(), Q_INT64_C(35));
+	QCOMPARE(scheduler.nextTaskTime(), Q_INT64_C(40));
+}
+
+/*! \test Tests the VirtualTimeScheduler::cancel() method.
+ */
+void SchedulerTest::testVirtualTimeCancel()
+{
+	VirtualTimeScheduler scheduler;
+	QObject context;
+	int executedCount = 0;
+
+	const Scheduler::TaskId cancelled = scheduler.schedule(10, &context, [&executedCount]() { ++executedCount; });
+	scheduler.schedule(10, &context, [&executedCount]() { ++executedCount; });
+	scheduler.cancel(cancelled);
+	QCOMPARE(scheduler.pendingTaskCount(), 1);
+	scheduler.cancel(cancelled);
+
+	QCOMPARE(scheduler.advanceBy(10), 1);
+	QCOMPARE(executedCount, 1);
+}
+
+/*! \test Tests that the VirtualTimeScheduler discards tasks whose context object was destroyed.
+ */
+void SchedulerTest::testVirtualTimeContextDestroyed()
+{
+	VirtualTimeScheduler scheduler;
+	int executedCount = 0;
+
+	QScopedPointer<QObject> context(new QObject);
+	scheduler.schedule(10, context.data(), [&executedCount]() { ++executedCount; });
+	context.reset();
+
+	QCOMPARE(scheduler.advanceBy(10), 0);
+	QCOMPARE(executedCount, 0);
+	QCOMPARE(scheduler.pendingTaskCount(), 0);
+}
+
+/*! \test Tests that tasks of context objects in other threads are executed in those threads.
+ */
+void SchedulerTest::testVirtualTimeOtherThread()
+{
+	VirtualTimeScheduler scheduler;
+	EventLoopThread thread;
+	QObject* context = new QObject;
+	context->moveToThread(&thread);
+	connect(&thread, &QThread::finished, context, &QObject::deleteLater);
+
+	QAtomicPointer<QThread> executingThread;
+	scheduler.schedule(10, context, [&executingThread]() { executingThread.storeRelease(QThread::currentThread()); });
+
+	QCOMPARE(scheduler.advanceBy(10), 1);
+	QTRY_COMPARE(executingThread.loadAcquire(), static_cast<QThread*>(&thread));
+}
+
+/*! \test Tests Promise::delayedResolve() and Promise::delayedReject() with virtual time.
+ */
+void SchedulerTest::testDelayedPromises()
+{
+	VirtualTimeScheduler scheduler;
+	Scheduler::setInstance(&scheduler);
+
+	Promise::Ptr resolvedPromise = Promise::delayedResolve(42, 60 * 1000);
+	Promise::Ptr rejectedPromise = Promise::delayedReject("error", 2 * 60 * 1000);
+	Promise::Ptr immediatePromise = Promise::delayedResolve(17);
+
+	QCOMPARE(scheduler.advanceBy(0), 1);
+	QCOMPARE(immediatePromise->state(), Deferred::Resolved);
+	QCOMPARE(immediatePromise->data(), QVariant(17));
+
+	scheduler.advanceBy(60 * 1000 - 1);
+	QCOMPARE(resolvedPromise->state(), Deferred::Pending);
+	scheduler.advanceBy(1);
+	QCOMPARE(resolvedPromise->state(), Deferred::Resolved);
+	QCOMPARE(resolvedPromise->data(), QVariant(42));
+	QCOMPARE(rejectedPromise->state(), Deferred::Pending);
+
+	QVERIFY(scheduler.advanceToNextTask());
+	QCOMPARE(rejectedPromise->state(), Deferred::Rejected);
+	QCOMPARE(rejectedPromise->data(), QVariant("error"));
+	QCOMPARE(scheduler.now(), Q_INT64_C(2 * 60 * 1000));
+}
+
+/*! \test Benchmarks settling many delayed promises with virtual time.
+ */
+void SchedulerTest::benchmarkDelayedPromises()
+{
+	VirtualTimeScheduler scheduler;
+	Scheduler::setInstance(&scheduler);
+
+	const int promiseCount = 100000;
+	QVector<Promise::Ptr> promises;
+	promises.reserve(promiseCount);
+	int resolvedCount = 0;
+
+	QBENCHMARK_ONCE
+	{
+		for (int i = 0; i < promiseCount; ++i)
+			promises.append(Promise::delayedResolve(i, 1000 + i)->then([&resolvedCount](const QVariant&) { ++resolvedCount; }));
+		scheduler.advanceBy(1000 + promiseCount);
+	}
+
+	QCOMPARE(resolvedCount, promiseCount);
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::SchedulerTest)
+#include "SchedulerTest.moc"
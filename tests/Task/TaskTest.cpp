@@ -0,0 +1,192 @@
+#include <QtTest>
+#include "Task.h"
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Unit tests for the Task class.
+ *
+ * \author jochen.ulrich
+ */
+class TaskTest : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void testNotStartedUntilRequested();
+	void testStart();
+	void testThen();
+	void testAlways();
+	void testToPromise();
+	void testUnconsumedTask();
+	void testNullPromise();
+	void testConcurrentStart();
+};
+
+
+//####### Helper #######
+
+/*! Creates a Task which counts how often its work is executed.
+ */
+Task::Ptr createCountingTask(QAtomicInt& startCount, const QVariant& value)
+{
+	return Task::create([&startCount, value]() {
+		startCount.ref();
+		return Promise::delayedResolve(value);
+	});
+}
+
+
+//####### Tests #######
+/*! \test Tests that a Task does not execute its work before it is requested.
+ */
+void TaskTest::testNotStartedUntilRequested()
+{
+	QAtomicInt startCount;
+	Task::Ptr task = createCountingTask(startCount, 1);
+
+	QCoreApplication::processEvents();
+	QVERIFY(!task->isStarted());
+	QCOMPARE(startCount.load(), 0);
+}
+
+/*! \test Tests Task::start().
+ */
+void TaskTest::testStart()
+{
+	QAtomicInt startCount;
+	Task::Ptr task = createCountingTask(startCount, 2);
+
+	Promise::Ptr promise = task->start();
+	QVERIFY(task->isStarted());
+	QCOMPARE(startCount.load(), 1);
+
+	// The work is executed only once
+	QCOMPARE(task->start(), promise);
+	QCOMPARE(startCount.load(), 1);
+
+	QTRY_COMPARE(promise->state(), Deferred::Resolved);
+	QCOMPARE(promise->data(), QVariant(2));
+}
+
+/*! \test Tests that Task::then() starts the Task.
+ */
+void TaskTest::testThen()
+{
+	QAtomicInt startCount;
+	Task::Ptr task = createCountingTask(startCount, 3);
+
+	Promise::Ptr chained = task->then([](const QVariant& value) { return value.toInt() * 2; });
+	QCOMPARE(startCount.load(), 1);
+
+	QTRY_COMPARE(chained->state(), Deferred::Resolved);
+	QCOMPARE(chained->data(), QVariant(6));
+
+	Promise::Ptr secondChained = task->then([](const QVariant& value) { return value.toInt() + 1; });
+	QTRY_COMPARE(secondChained->state(), Deferred::Resolved);
+	QCOMPARE(secondChained->data(), QVariant(4));
+	QCOMPARE(startCount.load(), 1);
+}
+
+/*! \test Tests that Task::always() starts the Task.
+ */
+void TaskTest::testAlways()
+{
+	QAtomicInt startCount;
+	Task::Ptr task = createCountingTask(startCount, 4);
+
+	bool called = false;
+	Promise::Ptr chained = task->always([&called](const QVariant&) { called = true; });
+	QCOMPARE(startCount.load(), 1);
+	QTRY_VERIFY(called);
+}
+
+/*! \test Tests the conversion of a Task to a Promise.
+ */
+void TaskTest::testToPromise()
+{
+	QAtomicInt startCount;
+	Task::Ptr task = createCountingTask(startCount, 5);
+
+	Promise::Ptr promise = task->toPromise();
+	QCOMPARE(startCount.load(), 1);
+	QCOMPARE(task->start(), promise);
+	QTRY_COMPARE(promise->state(), Deferred::Resolved);
+}
+
+/*! \test Tests that a Task which is not consumed does not execute its work.
+ */
+void TaskTest::testUnconsumedTask()
+{
+	QAtomicInt startCount;
+	QSharedPointer<QObject> resource(new QObject);
+	QWeakPointer<QObject> weakResource = resource;
+
+	Task::Ptr task = Task::create([&startCount, resource]() {
+		startCount.ref();
+		return Promise::createResolved();
+	});
+	resource.reset();
+	QVERIFY(!weakResource.isNull());
+
+	task.reset();
+
+	// The work and its captures are released without being executed
+	QVERIFY(weakResource.isNull());
+	QCOMPARE(startCount.load(), 0);
+}
+
+/*! \test Tests a Task whose work does not return a Promise.
+ */
+void TaskTest::testNullPromise()
+{
+	Task::Ptr task = Task::create([]() { return Promise::Ptr(); });
+
+	Promise::Ptr promise = task->start();
+	QVERIFY(promise);
+	QCOMPARE(promise->state(), Deferred::Rejected);
+
+	Task::Ptr emptyTask = Task::create(Task::Work());
+	QCOMPARE(emptyTask->start()->state(), Deferred::Rejected);
+}
+
+/*! \test Tests starting a Task from multiple threads.
+ */
+void TaskTest::testConcurrentStart()
+{
+	QAtomicInt startCount;
+	Task::Ptr task = Task::create([&startCount]() {
+		startCount.ref();
+		return Promise::createResolved();
+	});
+
+	QVector<QThread*> threads;
+	QVector<Promise::Ptr> promises(8);
+	for (int i = 0; i < promises.size(); ++i)
+	{
+		QThread* thread = new QThread;
+		QObject::connect(thread, &QThread::started, [task, &promises, i]() { promises[i] = task->start(); });
+		threads.append(thread);
+	}
+	for (QThread* thread : threads)
+		thread->start();
+	for (QThread* thread : threads)
+	{
+		thread->quit();
+		thread->wait();
+	}
+	qDeleteAll(threads);
+
+	QCOMPARE(startCount.load(), 1);
+	for (const Promise::Ptr& promise : promises)
+		QCOMPARE(promise, promises.first());
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+
+QTEST_MAIN(QtPromise::Tests::TaskTest)
+#include "TaskTest.moc"
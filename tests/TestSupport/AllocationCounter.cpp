@@ -0,0 +1,180 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+/* The sanitizers replace the allocation functions themselves. */
+#	define QTPROMISE_NO_ALLOCATION_COUNTING
+#elif defined(__GLIBC__)
+#	define QTPROMISE_INTERPOSE_MALLOC
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+}
+#endif
+
+#if defined(__GNUC__)
+/* The counters must not be allocated lazily since they are accessed from within malloc(). */
+#	define QTPROMISE_TLS_INITIAL_EXEC __attribute__((tls_model("initial-exec")))
+#else
+#	define QTPROMISE_TLS_INITIAL_EXEC
+#endif
+
+namespace
+{
+
+struct ThreadCounters
+{
+	quint64 allocations;
+	quint64 deallocations;
+	quint64 bytes;
+};
+
+thread_local ThreadCounters threadCounters QTPROMISE_TLS_INITIAL_EXEC = {0, 0, 0};
+
+inline void countAllocation(std::size_t size)
+{
+	threadCounters.allocations += 1;
+	threadCounters.bytes += size;
+}
+
+inline void countDeallocation()
+{
+	threadCounters.deallocations += 1;
+}
+
+} // namespace
+
+
+#ifdef QTPROMISE_INTERPOSE_MALLOC
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+	countAllocation(size);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+	countAllocation(count * size);
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+	if (pointer)
+		countDeallocation();
+	if (size > 0)
+		countAllocation(size);
+	return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer)
+{
+	if (pointer)
+		countDeallocation();
+	__libc_free(pointer);
+}
+
+} // extern "C"
+
+#elif !defined(QTPROMISE_NO_ALLOCATION_COUNTING)
+
+void* operator new(std::size_t size)
+{
+	countAllocation(size);
+	if (void* pointer = std::malloc(size > 0 ? size : 1))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	countAllocation(size);
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+	return ::operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	if (pointer)
+		countDeallocation();
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	::operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	::operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+	::operator delete(pointer);
+}
+
+#endif
+
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+AllocationCounter::Counts AllocationCounter::counts() const
+{
+	const Counts current = threadCounts();
+	Counts result;
+	result.allocations = current.allocations - m_start.allocations;
+	result.deallocations = current.deallocations - m_start.deallocations;
+	result.bytes = current.bytes - m_start.bytes;
+	return result;
+}
+
+bool AllocationCounter::isSupported()
+{
+#ifdef QTPROMISE_NO_ALLOCATION_COUNTING
+	return false;
+#else
+	return true;
+#endif
+}
+
+bool AllocationCounter::countsMalloc()
+{
+#ifdef QTPROMISE_INTERPOSE_MALLOC
+	return true;
+#else
+	return false;
+#endif
+}
+
+AllocationCounter::Counts AllocationCounter::threadCounts()
+{
+	Counts result;
+	result.allocations = threadCounters.allocations;
+	result.deallocations = threadCounters.deallocations;
+	result.bytes = threadCounters.bytes;
+	return result;
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
@@ -0,0 +1,89 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_TESTS_ALLOCATIONCOUNTER_H_
+#define QTPROMISE_TESTS_ALLOCATIONCOUNTER_H_
+
+#include <QtGlobal>
+
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief Counts the heap allocations of the current thread.
+ *
+ * Linking AllocationCounter.cpp into an executable interposes the heap allocation functions
+ * of the executable:
+ * - With glibc, `malloc()`, `calloc()`, `realloc()` and `free()` are replaced. Since the
+ * standard `operator new` and `operator delete` use them, this also counts C++ allocations
+ * including the ones of the Qt libraries.
+ * - On other platforms, the global `operator new` and `operator delete` are replaced.
+ * Allocations using `malloc()` directly (for example by Qt's containers) are not counted.
+ *
+ * The counters are kept per thread, so only the allocations of the thread which created the
+ * AllocationCounter are counted.
+ *
+ * \code
+ * AllocationCounter counter;
+ * Promise::Ptr promise = Promise::create(deferred)->then(callback);
+ * QVERIFY(counter.allocations() <= 20);
+ * \endcode
+ *
+ * When building with AddressSanitizer or ThreadSanitizer, nothing is counted since the sanitizers
+ * replace the allocation functions themselves. See isSupported().
+ *
+ * \note Only link AllocationCounter.cpp into test and benchmark executables.
+ *
+ * \author jochen.ulrich
+ */
+class AllocationCounter
+{
+public:
+	/*! The number of allocations and deallocations. */
+	struct Counts
+	{
+		/*! The number of allocations. */
+		quint64 allocations = 0;
+		/*! The number of deallocations. */
+		quint64 deallocations = 0;
+		/*! The number of allocated bytes. */
+		quint64 bytes = 0;
+	};
+
+	/*! Starts counting the allocations of the current thread. */
+	AllocationCounter() { reset(); }
+
+	/*! Restarts counting. */
+	void reset() { m_start = threadCounts(); }
+
+	/*! \return The counts since the construction or the last reset(). */
+	Counts counts() const;
+	/*! \return The number of allocations since the construction or the last reset(). */
+	quint64 allocations() const { return counts().allocations; }
+	/*! \return The number of deallocations since the construction or the last reset(). */
+	quint64 deallocations() const { return counts().deallocations; }
+	/*! \return The number of allocated bytes since the construction or the last reset(). */
+	quint64 bytes() const { return counts().bytes; }
+
+	/*! \return \c true if allocations are counted in this build. */
+	static bool isSupported();
+	/*! \return \c true if `malloc()` is interposed and allocations of C code and Qt containers
+	 * are counted as well. */
+	static bool countsMalloc();
+
+	/*! \return The total counts of the current thread since it was started. */
+	static Counts threadCounts();
+
+private:
+	Counts m_start;
+};
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_TESTS_ALLOCATIONCOUNTER_H_ */
@@ -0,0 +1,218 @@
+#include "LocalHttpServer.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! Handles the requests of one client connection.
+ */
+class LocalHttpServer::Connection : public QObject
+{
+public:
+	Connection(LocalHttpServer* server, QTcpSocket* socket)
+		: QObject(server), m_server(server), m_socket(socket)
+	{
+		m_socket->setParent(this);
+		QObject::connect(m_socket, &QTcpSocket::readyRead, this, [this]() { this->readRequest(); });
+		QObject::connect(m_socket, &QTcpSocket::disconnected, this, &QObject::deleteLater);
+	}
+
+private:
+	void readRequest()
+	{
+		m_buffer += m_socket->readAll();
+		if (m_responding)
+			return;
+
+		const int headerEnd = m_buffer.indexOf("\r\n\r\n");
+		if (headerEnd < 0)
+			return;
+
+		Request request;
+		const QList<QByteArray> lines = m_buffer.left(headerEnd).split('\n');
+		const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+		if (requestLine.size() < 2)
+		{
+			m_socket->disconnectFromHost();
+			return;
+		}
+		request.method = requestLine.at(0);
+		request.path = requestLine.at(1);
+		for (int index = 1; index < lines.size(); ++index)
+		{
+			const QByteArray& line = lines.at(index);
+			const int colon = line.indexOf(':');
+			if (colon > 0)
+				request.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+		}
+
+		const int bodyLength = request.headers.value("content-length", "0").toInt();
+		const int requestLength = headerEnd + 4 + bodyLength;
+		if (m_buffer.size() < requestLength)
+			return;
+		request.body = m_buffer.mid(headerEnd + 4, bodyLength);
+		m_buffer.remove(0, requestLength);
+
+		m_server->requestReceived(request);
+		respond(request);
+	}
+
+	void respond(const Request& request)
+	{
+		m_responding = true;
+		const int queryStart = request.path.indexOf('?');
+		const QByteArray path = queryStart < 0 ? request.path : request.path.left(queryStart);
+		m_response = m_server->responseFor(path);
+		if (path == "/echo")
+			m_body = request.body;
+		else
+			m_body = m_response.bodySize >= 0 ? generatedBody(m_response.bodySize) : m_response.body;
+		m_closeAfterResponse = request.headers.value("connection").toLower() == "close";
+
+		if (m_response.latency > 0)
+			QTimer::singleShot(m_response.latency, this, [this]() { this->startResponse(); });
+		else
+			startResponse();
+	}
+
+	void startResponse()
+	{
+		switch (m_response.fault)
+		{
+		case Response::CloseBeforeResponse:
+			m_socket->disconnectFromHost();
+			return;
+		case Response::MalformedResponse:
+			m_socket->write("This is not HTTP\r\n\r\n");
+			m_socket->disconnectFromHost();
+			return;
+		default:
+			break;
+		}
+
+		QByteArray header = "HTTP/1.1 " + QByteArray::number(m_response.statusCode) + ' ' + m_response.reasonPhrase + "\r\n";
+		bool hasContentType = false;
+		for (const auto& responseHeader : m_response.headers)
+		{
+			header += responseHeader.first + ": " + responseHeader.second + "\r\n";
+			hasContentType = hasContentType || responseHeader.first.toLower() == "content-type";
+		}
+		if (!hasContentType)
+			header += "Content-Type: application/octet-stream\r\n";
+		if (m_response.chunked)
+			header += "Transfer-Encoding: chunked\r\n";
+		else
+			header += "Content-Length: " + QByteArray::number(m_body.size()) + "\r\n";
+		if (m_closeAfterResponse)
+			header += "Connection: close\r\n";
+		header += "\r\n";
+		m_socket->write(header);
+
+		m_bodyOffset = 0;
+		m_bodyEnd = (m_response.fault == Response::CloseDuringBody) ? m_body.size() / 2 : m_body.size();
+		sendBody();
+	}
+
+	void sendBody()
+	{
+		const int sliceSize = (m_response.chunked || m_response.bandwidth > 0) ? qMax(1, m_response.chunkSize) : m_bodyEnd;
+		while (m_bodyOffset < m_bodyEnd)
+		{
+			const int size = qMin(sliceSize, m_bodyEnd - m_bodyOffset);
+			if (m_response.chunked)
+				m_socket->write(QByteArray::number(size, 16) + "\r\n" + m_body.mid(m_bodyOffset, size) + "\r\n");
+			else
+				m_socket->write(m_body.constData() + m_bodyOffset, size);
+			m_bodyOffset += size;
+
+			if (m_response.bandwidth > 0 && m_bodyOffset < m_bodyEnd)
+			{
+				const int interval = static_cast<int>(qMax(Q_INT64_C(1), static_cast<qint64>(size) * 1000 / m_response.bandwidth));
+				QTimer::singleShot(interval, this, [this]() { this->sendBody(); });
+				return;
+			}
+		}
+		finishResponse();
+	}
+
+	void finishResponse()
+	{
+		if (m_response.fault == Response::CloseDuringBody)
+		{
+			m_socket->disconnectFromHost();
+			return;
+		}
+		if (m_response.chunked)
+			m_socket->write("0\r\n\r\n");
+		if (m_closeAfterResponse)
+		{
+			m_socket->disconnectFromHost();
+			return;
+		}
+
+		m_responding = false;
+		m_body.clear();
+		// Handle pipelined requests
+		if (!m_buffer.isEmpty())
+			readRequest();
+	}
+
+	LocalHttpServer* m_server;
+	QTcpSocket* m_socket;
+	QByteArray m_buffer;
+	bool m_responding = false;
+	Response m_response;
+	QByteArray m_body;
+	int m_bodyOffset = 0;
+	int m_bodyEnd = 0;
+	bool m_closeAfterResponse = false;
+};
+
+
+LocalHttpServer::LocalHttpServer(QObject* parent)
+	: QTcpServer(parent)
+{
+	QObject::connect(this, &QTcpServer::newConnection, this, &LocalHttpServer::acceptConnections);
+	listen(QHostAddress::LocalHost, 0);
+}
+
+QUrl LocalHttpServer::url(const QString& path) const
+{
+	return QUrl(QString("http://127.0.0.1:%1%2").arg(serverPort()).arg(path));
+}
+
+QByteArray LocalHttpServer::generatedBody(qint64 size)
+{
+	static const QByteArray pattern = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ\n";
+	QByteArray result;
+	result.reserve(static_cast<int>(size));
+	while (result.size() + pattern.size() <= size)
+		result += pattern;
+	result += pattern.left(static_cast<int>(size) - result.size());
+	return result;
+}
+
+void LocalHttpServer::acceptConnections()
+{
+	while (QTcpSocket* socket = nextPendingConnection())
+		new Connection(this, socket);
+}
+
+const LocalHttpServer::Response& LocalHttpServer::responseFor(const QByteArray& path) const
+{
+	auto iter = m_responses.constFind(path);
+	return iter == m_responses.constEnd() ? m_defaultResponse : iter.value();
+}
+
+void LocalHttpServer::requestReceived(const Request& request)
+{
+	m_requestCount += 1;
+	m_lastRequest = request;
+}
+
+}  // namespace Tests
+}  // namespace QtPromise
@@ -0,0 +1,138 @@
+/*! \file
+ *
+ * \date Created on: 17.10.2026
+ * \author jochen.ulrich
+ */
+
+#ifndef QTPROMISE_TESTS_LOCALHTTPSERVER_H_
+#define QTPROMISE_TESTS_LOCALHTTPSERVER_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QTcpServer>
+#include <QUrl>
+
+
+namespace QtPromise
+{
+namespace Tests
+{
+
+/*! \brief A minimal in-process HTTP/1.1 server for tests and benchmarks.
+ *
+ * The server listens on a random port of the loopback interface and answers requests with
+ * configurable responses. This allows testing network code without depending on the network
+ * or on external services.
+ *
+ * The responses can simulate:
+ * - latency before the response is sent,
+ * - limited bandwidth,
+ * - bodies of arbitrary size,
+ * - chunked transfer encoding and
+ * - faults like closed connections and malformed responses.
+ *
+ * Requests to the path `/echo` are answered with the body of the request.
+ *
+ * The server handles its connections in the thread it lives in. Since QNetworkAccessManager
+ * performs HTTP requests in a separate thread, the server can live in the same thread as the
+ * code under test as long as that thread runs an event loop.
+ *
+ * \author jochen.ulrich
+ */
+class LocalHttpServer : public QTcpServer
+{
+public:
+	/*! The behavior of the server when answering a request. */
+	struct Response
+	{
+		/*! Simulated faults. */
+		enum Fault
+		{
+			NoFault,             //!< A regular response is sent.
+			CloseBeforeResponse, //!< The connection is closed without sending a response.
+			CloseDuringBody,     //!< The connection is closed after sending half of the body.
+			MalformedResponse    //!< Data which is not HTTP is sent and the connection is closed.
+		};
+
+		/*! The HTTP status code. */
+		int statusCode = 200;
+		/*! The HTTP reason phrase. */
+		QByteArray reasonPhrase = "OK";
+		/*! Additional response headers. */
+		QList<QPair<QByteArray, QByteArray>> headers;
+		/*! The body of the response. Ignored if #bodySize is not negative. */
+		QByteArray body;
+		/*! If not negative, a generated body of this size is sent instead of #body. */
+		qint64 bodySize = -1;
+		/*! Delay in milliseconds before the response is sent. */
+		int latency = 0;
+		/*! Maximum number of body bytes sent per second. \c 0 means unlimited. */
+		qint64 bandwidth = 0;
+		/*! If \c true, the body is sent using chunked transfer encoding. */
+		bool chunked = false;
+		/*! The size of the chunks of the body. Also the size of the slices sent when the
+		 * #bandwidth is limited. */
+		int chunkSize = 16 * 1024;
+		/*! The simulated fault. */
+		Fault fault = NoFault;
+	};
+
+	/*! A request received by the server. */
+	struct Request
+	{
+		QByteArray method;
+		QByteArray path;
+		QHash<QByteArray, QByteArray> headers;
+		QByteArray body;
+	};
+
+	/*! Creates a LocalHttpServer listening on a random port of the loopback interface.
+	 *
+	 * \param parent The parent QObject.
+	 */
+	explicit LocalHttpServer(QObject* parent = nullptr);
+
+	/*! Defines the response for requests to paths without a specific response.
+	 *
+	 * \param response The default response.
+	 */
+	void setDefaultResponse(const Response& response) { m_defaultResponse = response; }
+	/*! Defines the response for requests to a path.
+	 *
+	 * \param path The path of the requests, for example `/data`. Query strings are ignored.
+	 * \param response The response for the path.
+	 */
+	void setResponse(const QByteArray& path, const Response& response) { m_responses.insert(path, response); }
+
+	/*! \return The URL of the server for the given \p path. */
+	QUrl url(const QString& path = QStringLiteral("/")) const;
+
+	/*! \return The number of completely received requests. */
+	int requestCount() const { return m_requestCount; }
+	/*! \return The last completely received request. */
+	Request lastRequest() const { return m_lastRequest; }
+
+	/*! \return The body generated for a Response::bodySize of \p size. */
+	static QByteArray generatedBody(qint64 size);
+
+private:
+	class Connection;
+	friend class Connection;
+
+	void acceptConnections();
+	const Response& responseFor(const QByteArray& path) const;
+	void requestReceived(const Request& request);
+
+	Response m_defaultResponse;
+	QHash<QByteArray, Response> m_responses;
+	int m_requestCount = 0;
+	Request m_lastRequest;
+};
+
+}  // namespace Tests
+}  // namespace QtPromise
+
+#endif /* QTPROMISE_TESTS_LOCALHTTPSERVER_H_ */